@@ -7,7 +7,17 @@
 
 # Signaling library source files.
 set( ICE_SOURCES
-     "source/ice_api.c" )
+     "source/ice_api.c"
+     "source/ice_hash.c"
+     "source/ice_crc32.c"
+     "source/ice_hmac_sha1.c"
+     "source/ice_timer_wheel.c"
+     "source/ice_agent_manager.c"
+     "source/ice_connection_table.c"
+     "source/ice_lite.c"
+     "source/ice_stats.c"
+     "source/ice_log.c"
+     "source/ice_random.c" )
 
 # Signaling library Public Include directories.
 set( ICE_INCLUDE_PUBLIC_DIRS
@@ -16,4 +26,14 @@ set( ICE_INCLUDE_PUBLIC_DIRS
 # Signaling library public include header files.
 set( ICE_INCLUDE_PUBLIC_FILES
      "source/include/ice_api.h"
-     "source/include/ice_data_types.h" )
\ No newline at end of file
+     "source/include/ice_data_types.h"
+     "source/include/ice_hash.h"
+     "source/include/ice_crc32.h"
+     "source/include/ice_hmac_sha1.h"
+     "source/include/ice_timer_wheel.h"
+     "source/include/ice_agent_manager.h"
+     "source/include/ice_connection_table.h"
+     "source/include/ice_lite.h"
+     "source/include/ice_stats.h"
+     "source/include/ice_log.h"
+     "source/include/ice_random.h" )
\ No newline at end of file
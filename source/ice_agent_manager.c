@@ -0,0 +1,468 @@
+#include "ice_agent_manager.h"
+#include "ice_api.h"
+#include "ice_hash.h"
+#include "ice_stats.h"
+#include "ice_random.h"
+
+/* Standard defines. */
+#include <stdlib.h>
+#include <string.h>
+
+/* Ice_AgentManagerLayoutMemory - Computes the placement of the manager arrays inside the application provided memory
+ * block, and sets them up when pManagerMemory and pAgentManager are given. Returns the number of bytes required. */
+
+static size_t Ice_AgentManagerLayoutMemory( const IceAgentManagerConfig_t * pManagerConfig,
+                                            uint8_t * pManagerMemory,
+                                            IceAgentManager_t * pAgentManager )
+{
+    size_t offset = 0;
+    bool isAssign = ( pManagerMemory != NULL ) && ( pAgentManager != NULL );
+    uint32_t transactionBucketCount = Ice_HashIndexGetBucketCount( pManagerConfig->maxAgentCount * pManagerConfig->maxTransactionIdCount );
+
+    if( isAssign )
+    {
+        pAgentManager->pEntries = ( IceAgentManagerEntry_t * )( pManagerMemory + offset );
+        pAgentManager->maxAgentCount = pManagerConfig->maxAgentCount;
+        pAgentManager->maxTransactionIdCount = pManagerConfig->maxTransactionIdCount;
+    }
+    offset += ICE_AGENT_MEMORY_ALIGN( sizeof( IceAgentManagerEntry_t ) * pManagerConfig->maxAgentCount );
+
+    if( isAssign )
+    {
+        Ice_HashIndexInit( &( pAgentManager->usernameIndex ),
+                           ( IceHashBucket_t * )( pManagerMemory + offset ),
+                           Ice_HashIndexGetBucketCount( pManagerConfig->maxAgentCount ) );
+    }
+    offset += ICE_AGENT_MEMORY_ALIGN( sizeof( IceHashBucket_t ) * Ice_HashIndexGetBucketCount( pManagerConfig->maxAgentCount ) );
+
+    if( isAssign )
+    {
+        Ice_HashIndexInit( &( pAgentManager->transactionIndex ),
+                           ( IceHashBucket_t * )( pManagerMemory + offset ),
+                           transactionBucketCount );
+    }
+    offset += ICE_AGENT_MEMORY_ALIGN( sizeof( IceHashBucket_t ) * transactionBucketCount );
+
+    return offset;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_GetAgentManagerMemorySize - Returns the size of the memory block the application hands to Ice_CreateAgentManager. */
+
+IceResult_t Ice_GetAgentManagerMemorySize( const IceAgentManagerConfig_t * pManagerConfig,
+                                           size_t * pManagerMemorySize )
+{
+    IceResult_t retStatus = ICE_RESULT_OK;
+
+    if( ( pManagerConfig == NULL ) ||
+        ( pManagerMemorySize == NULL ) ||
+        ( pManagerConfig->maxAgentCount == 0 ) ||
+        ( pManagerConfig->maxAgentCount > ICE_MAX_MANAGED_AGENT_COUNT ) ||
+        ( pManagerConfig->maxTransactionIdCount == 0 ) ||
+        ( pManagerConfig->maxTransactionIdCount > MAX_STORED_TRANSACTION_ID_COUNT ) )
+    {
+        retStatus = ICE_RESULT_BAD_PARAM;
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        *pManagerMemorySize = Ice_AgentManagerLayoutMemory( pManagerConfig,
+                                                            NULL,
+                                                            NULL );
+    }
+
+    return retStatus;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_CreateAgentManager - Creates an empty agent manager over the application provided memory block, which must be
+ * at least the size returned by Ice_GetAgentManagerMemorySize and stay valid for the lifetime of the manager. */
+
+IceResult_t Ice_CreateAgentManager( IceAgentManager_t * pAgentManager,
+                                    const IceAgentManagerConfig_t * pManagerConfig,
+                                    uint8_t * pManagerMemory,
+                                    size_t managerMemorySize )
+{
+    IceResult_t retStatus = ICE_RESULT_OK;
+    size_t requiredMemorySize = 0;
+    uint32_t i;
+
+    if( ( pAgentManager == NULL ) ||
+        ( pManagerMemory == NULL ) )
+    {
+        retStatus = ICE_RESULT_BAD_PARAM;
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        retStatus = Ice_GetAgentManagerMemorySize( pManagerConfig,
+                                                   &requiredMemorySize );
+    }
+
+    if( ( retStatus == ICE_RESULT_OK ) && ( managerMemorySize < requiredMemorySize ) )
+    {
+        retStatus = ICE_RESULT_OUT_OF_MEMORY;
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        ( void ) Ice_AgentManagerLayoutMemory( pManagerConfig,
+                                               pManagerMemory,
+                                               pAgentManager );
+
+        /* Chain every entry into the free list. */
+        for( i = 0; i < pAgentManager->maxAgentCount; i++ )
+        {
+            pAgentManager->pEntries[ i ].pIceAgent = NULL;
+            pAgentManager->pEntries[ i ].usernameHash = 0;
+            pAgentManager->pEntries[ i ].nextFree = ( i + 1 < pAgentManager->maxAgentCount ) ? ( i + 1 ) : ICE_TRANSACTION_INVALID_INDEX;
+        }
+
+        pAgentManager->freeEntry = 0;
+        pAgentManager->agentCount = 0;
+        retStatus = Ice_RandomGetEntropy( ( uint8_t * ) &( pAgentManager->hashSeed ),
+                                          sizeof( pAgentManager->hashSeed ) );
+    }
+
+    return retStatus;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_AgentManagerAddAgent - Registers an agent, created with Ice_CreateIceAgent, with the manager. Its local username
+ * must be unique among the registered agents. From now on the agent's transaction store also indexes its outstanding
+ * transaction IDs in the manager, until the agent is removed. */
+
+IceResult_t Ice_AgentManagerAddAgent( IceAgentManager_t * pAgentManager,
+                                      IceAgent_t * pIceAgent )
+{
+    IceResult_t retStatus = ICE_RESULT_OK;
+    IceAgentManagerEntry_t * pEntry = NULL;
+    uint32_t entryIndex = ICE_TRANSACTION_INVALID_INDEX;
+    size_t usernameLength = 0;
+
+    if( ( pAgentManager == NULL ) ||
+        ( pIceAgent == NULL ) ||
+        ( pIceAgent->stunBindingRequestTransactionIdStore.pSharedIndex != NULL ) ||
+        ( pIceAgent->stunBindingRequestTransactionIdStore.maxTransactionIdsCount > pAgentManager->maxTransactionIdCount ) )
+    {
+        retStatus = ICE_RESULT_BAD_PARAM;
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        usernameLength = pIceAgent->localUsernameLength;
+
+        if( Ice_AgentManagerFindAgentByUsername( pAgentManager,
+                                                 pIceAgent->localUsername,
+                                                 usernameLength ) != NULL )
+        {
+            retStatus = ICE_RESULT_DUPLICATE_USERNAME;
+        }
+    }
+
+    if( ( retStatus == ICE_RESULT_OK ) &&
+        ( pAgentManager->freeEntry == ICE_TRANSACTION_INVALID_INDEX ) )
+    {
+        retStatus = ICE_RESULT_OUT_OF_MEMORY;
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        entryIndex = pAgentManager->freeEntry;
+        pEntry = &( pAgentManager->pEntries[ entryIndex ] );
+
+        pEntry->usernameHash = Ice_HashBytes( ( const uint8_t * ) pIceAgent->localUsername,
+                                              usernameLength,
+                                              pAgentManager->hashSeed );
+
+        retStatus = Ice_HashIndexInsert( &( pAgentManager->usernameIndex ),
+                                         pEntry->usernameHash,
+                                         entryIndex );
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        /* The transaction index is sized for maxTransactionIdCount IDs per agent, so this cannot run out of room. */
+        retStatus = Ice_TransactionIdStoreShareIndex( &( pIceAgent->stunBindingRequestTransactionIdStore ),
+                                                      &( pAgentManager->transactionIndex ),
+                                                      pAgentManager->hashSeed,
+                                                      entryIndex );
+
+        if( retStatus != ICE_RESULT_OK )
+        {
+            ( void ) Ice_TransactionIdStoreShareIndex( &( pIceAgent->stunBindingRequestTransactionIdStore ),
+                                                       NULL,
+                                                       0,
+                                                       0 );
+            Ice_HashIndexRemove( &( pAgentManager->usernameIndex ),
+                                 pEntry->usernameHash,
+                                 entryIndex );
+        }
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        pAgentManager->freeEntry = pEntry->nextFree;
+        pEntry->pIceAgent = pIceAgent;
+        pAgentManager->agentCount++;
+    }
+
+    return retStatus;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_AgentManagerRemoveAgent - Unregisters an agent. Its outstanding transaction IDs leave the manager's index,
+ * the agent itself is left untouched and may be added again. */
+
+IceResult_t Ice_AgentManagerRemoveAgent( IceAgentManager_t * pAgentManager,
+                                         IceAgent_t * pIceAgent )
+{
+    IceResult_t retStatus = ICE_RESULT_OK;
+    IceAgentManagerEntry_t * pEntry = NULL;
+    uint32_t entryIndex = 0;
+
+    if( ( pAgentManager == NULL ) ||
+        ( pIceAgent == NULL ) )
+    {
+        retStatus = ICE_RESULT_BAD_PARAM;
+    }
+
+    /* The entry of a registered agent is remembered by its transaction store. */
+    if( ( retStatus == ICE_RESULT_OK ) &&
+        ( pIceAgent->stunBindingRequestTransactionIdStore.pSharedIndex != &( pAgentManager->transactionIndex ) ) )
+    {
+        retStatus = ICE_RESULT_AGENT_NOT_FOUND;
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        entryIndex = pIceAgent->stunBindingRequestTransactionIdStore.sharedEntry;
+        pEntry = &( pAgentManager->pEntries[ entryIndex ] );
+
+        ( void ) Ice_TransactionIdStoreShareIndex( &( pIceAgent->stunBindingRequestTransactionIdStore ),
+                                                   NULL,
+                                                   0,
+                                                   0 );
+        Ice_HashIndexRemove( &( pAgentManager->usernameIndex ),
+                             pEntry->usernameHash,
+                             entryIndex );
+
+        pEntry->pIceAgent = NULL;
+        pEntry->nextFree = pAgentManager->freeEntry;
+        pAgentManager->freeEntry = entryIndex;
+        pAgentManager->agentCount--;
+    }
+
+    return retStatus;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_AgentManagerFindAgentByUsername - Returns the registered agent whose local username is the given string
+ * ( not NUL terminated ), or NULL. */
+
+IceAgent_t * Ice_AgentManagerFindAgentByUsername( IceAgentManager_t * pAgentManager,
+                                                  const char * pUsername,
+                                                  size_t usernameLength )
+{
+    IceAgent_t * pIceAgent = NULL;
+    IceAgent_t * pCandidateAgent;
+    uint32_t hash, entryIndex;
+    uint32_t cursor = ICE_HASH_INDEX_CURSOR_START;
+
+    if( ( pAgentManager != NULL ) &&
+        ( pUsername != NULL ) &&
+        ( usernameLength <= MAX_ICE_CONFIG_USER_NAME_LEN ) &&
+        ( pAgentManager->agentCount > 0 ) )
+    {
+        hash = Ice_HashBytes( ( const uint8_t * ) pUsername,
+                              usernameLength,
+                              pAgentManager->hashSeed );
+
+        while( ( pIceAgent == NULL ) &&
+               ( ( entryIndex = Ice_HashIndexFindNext( &( pAgentManager->usernameIndex ), hash, &cursor ) ) != ICE_HASH_INDEX_NOT_FOUND ) )
+        {
+            pCandidateAgent = pAgentManager->pEntries[ entryIndex ].pIceAgent;
+
+            if( ( pCandidateAgent != NULL ) &&
+                ( pCandidateAgent->localUsernameLength == usernameLength ) &&
+                ( memcmp( pCandidateAgent->localUsername, pUsername, usernameLength ) == 0 ) )
+            {
+                pIceAgent = pCandidateAgent;
+            }
+        }
+    }
+
+    return pIceAgent;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_AgentManagerFindAgentByTransactionId - Returns the registered agent with an outstanding request of the given
+ * transaction ID, or NULL. */
+
+IceAgent_t * Ice_AgentManagerFindAgentByTransactionId( IceAgentManager_t * pAgentManager,
+                                                       uint8_t * pTransactionId )
+{
+    IceAgent_t * pIceAgent = NULL;
+    IceAgent_t * pCandidateAgent;
+    uint32_t hash, entryIndex;
+    uint32_t cursor = ICE_HASH_INDEX_CURSOR_START;
+
+    if( ( pAgentManager != NULL ) &&
+        ( pTransactionId != NULL ) &&
+        ( pAgentManager->transactionIndex.entryCount > 0 ) )
+    {
+        hash = Ice_HashBytes( pTransactionId,
+                              STUN_HEADER_TRANSACTION_ID_LENGTH,
+                              pAgentManager->hashSeed );
+
+        while( ( pIceAgent == NULL ) &&
+               ( ( entryIndex = Ice_HashIndexFindNext( &( pAgentManager->transactionIndex ), hash, &cursor ) ) != ICE_HASH_INDEX_NOT_FOUND ) )
+        {
+            pCandidateAgent = pAgentManager->pEntries[ entryIndex ].pIceAgent;
+
+            if( ( pCandidateAgent != NULL ) &&
+                Ice_TransactionIdStoreHasId( &( pCandidateAgent->stunBindingRequestTransactionIdStore ), pTransactionId ) )
+            {
+                pIceAgent = pCandidateAgent;
+            }
+        }
+    }
+
+    return pIceAgent;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_AgentManagerFindAgent - The application calls this API for every STUN packet received on a shared socket, before
+ * handing it to the agent returned in ppIceAgent. Requests and indications are routed by the local ufrag in their
+ * USERNAME, responses by their transaction ID. Only the header and the attribute headers up to USERNAME are read,
+ * the agent validates the packet in full. */
+
+IceResult_t Ice_AgentManagerFindAgent( IceAgentManager_t * pAgentManager,
+                                       const uint8_t * pStunMessageBuffer,
+                                       size_t stunMessageBufferLength,
+                                       IceAgent_t ** ppIceAgent )
+{
+    IceResult_t retStatus = ICE_RESULT_OK;
+    IceAgent_t * pIceAgent = NULL;
+    uint8_t transactionId[ STUN_HEADER_TRANSACTION_ID_LENGTH ];
+    const char * pUsername = NULL;
+    const char * pSeparator;
+    uint16_t messageType, attributeType, attributeLength;
+    size_t offset = STUN_HEADER_LENGTH, usernameLength = 0;
+
+    if( ( pAgentManager == NULL ) ||
+        ( pStunMessageBuffer == NULL ) ||
+        ( ppIceAgent == NULL ) )
+    {
+        retStatus = ICE_RESULT_BAD_PARAM;
+    }
+
+    if( ( retStatus == ICE_RESULT_OK ) &&
+        ( ( stunMessageBufferLength < STUN_HEADER_LENGTH ) || ( pStunMessageBuffer[ 0 ] > 3 ) ) )
+    {
+        retStatus = ICE_RESULT_NOT_STUN_PACKET;
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        messageType = ( uint16_t ) ( ( pStunMessageBuffer[ 0 ] << 8 ) | pStunMessageBuffer[ 1 ] );
+
+        if( ( messageType & ICE_STUN_MESSAGE_CLASS_RESPONSE_BIT ) != 0 )
+        {
+            memcpy( transactionId,
+                    pStunMessageBuffer + STUN_HEADER_TRANSACTION_ID_OFFSET,
+                    STUN_HEADER_TRANSACTION_ID_LENGTH );
+            pIceAgent = Ice_AgentManagerFindAgentByTransactionId( pAgentManager,
+                                                                  transactionId );
+        }
+        else
+        {
+            while( ( pUsername == NULL ) &&
+                   ( offset + STUN_ATTRIBUTE_HEADER_LENGTH <= stunMessageBufferLength ) )
+            {
+                attributeType = ( uint16_t ) ( ( pStunMessageBuffer[ offset ] << 8 ) | pStunMessageBuffer[ offset + 1 ] );
+                attributeLength = ( uint16_t ) ( ( pStunMessageBuffer[ offset + 2 ] << 8 ) | pStunMessageBuffer[ offset + 3 ] );
+
+                if( offset + STUN_ATTRIBUTE_HEADER_LENGTH + attributeLength > stunMessageBufferLength )
+                {
+                    break;
+                }
+
+                if( attributeType == STUN_ATTRIBUTE_TYPE_USERNAME )
+                {
+                    pUsername = ( const char * ) ( pStunMessageBuffer + offset + STUN_ATTRIBUTE_HEADER_LENGTH );
+                    usernameLength = attributeLength;
+                }
+
+                offset += STUN_ATTRIBUTE_HEADER_LENGTH + ( ( ( size_t ) attributeLength + 3 ) & ~( ( size_t ) 3 ) );
+            }
+
+            if( pUsername != NULL )
+            {
+                /* USERNAME is "<our ufrag>:<peer ufrag>" in the requests the peer sends us. */
+                pSeparator = memchr( pUsername, ':', usernameLength );
+
+                if( pSeparator != NULL )
+                {
+                    usernameLength = ( size_t ) ( pSeparator - pUsername );
+                }
+
+                pIceAgent = Ice_AgentManagerFindAgentByUsername( pAgentManager,
+                                                                 pUsername,
+                                                                 usernameLength );
+            }
+        }
+
+        if( pIceAgent == NULL )
+        {
+            retStatus = ICE_RESULT_AGENT_NOT_FOUND;
+        }
+
+        *ppIceAgent = pIceAgent;
+    }
+
+    return retStatus;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_AgentManagerGetStats - Sums the counters and histograms of every registered agent into pStats. Called from the
+ * thread driving the agents; threads running their own manager aggregate further with Ice_AccumulateAgentStats. */
+
+IceResult_t Ice_AgentManagerGetStats( const IceAgentManager_t * pAgentManager,
+                                      IceAgentStats_t * pStats )
+{
+    IceResult_t retStatus = ICE_RESULT_OK;
+    uint32_t i;
+
+    if( ( pAgentManager == NULL ) ||
+        ( pStats == NULL ) )
+    {
+        retStatus = ICE_RESULT_BAD_PARAM;
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        memset( pStats,
+                0,
+                sizeof( IceAgentStats_t ) );
+
+        for( i = 0; i < pAgentManager->maxAgentCount; i++ )
+        {
+            if( pAgentManager->pEntries[ i ].pIceAgent != NULL )
+            {
+                Ice_AccumulateAgentStats( pStats,
+                                          &( pAgentManager->pEntries[ i ].pIceAgent->stats ) );
+            }
+        }
+    }
+
+    return retStatus;
+}
@@ -1,4 +1,12 @@
 #include "ice_api.h"
+#include "ice_hash.h"
+#include "ice_crc32.h"
+#include "ice_hmac_sha1.h"
+#include "ice_timer_wheel.h"
+#include "ice_connection_table.h"
+#include "ice_stats.h"
+#include "ice_log.h"
+#include "ice_random.h"
 
 /* STUN defines. */
 #include "stun_data_types.h"
@@ -6,65 +14,657 @@
 #include "stun_deserializer.h"
 
 /* Standard defines. */
-#include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <stdbool.h>
 #include <string.h>
 
-/* Ice_CreateIceAgent - The application calls this API for starting a new ICE agent. */
+/* Ice_GetIceAgentMemorySize - The application calls this API to find the size of the memory block needed by Ice_CreateIceAgent. */
+
+IceResult_t Ice_GetIceAgentMemorySize( const IceAgentConfig_t * pAgentConfig,
+                                       size_t * pAgentMemorySize )
+{
+    IceResult_t retStatus = ICE_RESULT_OK;
+
+    if( ( pAgentConfig == NULL ) ||
+        ( pAgentMemorySize == NULL ) ||
+        ( pAgentConfig->maxLocalCandidates == 0 ) ||
+        ( pAgentConfig->maxLocalCandidates > ICE_MAX_LOCAL_CANDIDATE_COUNT ) ||
+        ( pAgentConfig->maxRemoteCandidates == 0 ) ||
+        ( pAgentConfig->maxRemoteCandidates > ICE_MAX_REMOTE_CANDIDATE_COUNT ) ||
+        ( pAgentConfig->maxCandidatePairs == 0 ) ||
+        ( pAgentConfig->maxCandidatePairs > ICE_MAX_CANDIDATE_PAIR_COUNT ) ||
+        ( pAgentConfig->stunMessageBufferCount == 0 ) ||
+        ( pAgentConfig->stunMessageBufferCount > ICE_MAX_CANDIDATE_PAIR_COUNT ) ||
+        ( pAgentConfig->stunMessageBufferSize < STUN_HEADER_LENGTH ) ||
+        ( pAgentConfig->stunMessageBufferSize > ICE_STUN_MESSAGE_BUFFER_SIZE ) ||
+        ( pAgentConfig->maxTransactionIdCount == 0 ) ||
+        ( pAgentConfig->maxTransactionIdCount > MAX_STORED_TRANSACTION_ID_COUNT ) ||
+        ( pAgentConfig->nominationPolicy > ICE_NOMINATION_POLICY_LOWEST_RTT ) ||
+        ( pAgentConfig->nominationPriorityWindow > 100 ) )
+    {
+        retStatus = ICE_RESULT_BAD_PARAM;
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        *pAgentMemorySize = Ice_LayoutIceAgentMemory( pAgentConfig,
+                                                      NULL,
+                                                      NULL );
+    }
+
+    return retStatus;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_CopyCredential - Copies a NUL terminated credential of at most maxLength characters, with its terminator, into
+ * pDestination ( maxLength + 1 bytes ) and stores its length. Longer credentials are rejected, nothing is copied. */
+
+static IceResult_t Ice_CopyCredential( char * pDestination,
+                                       size_t * pDestinationLength,
+                                       const char * pCredential,
+                                       size_t maxLength )
+{
+    IceResult_t retStatus = ICE_RESULT_OK;
+    size_t length = strnlen( pCredential,
+                             maxLength + 1 );
+
+    if( length > maxLength )
+    {
+        retStatus = ICE_RESULT_BAD_PARAM;
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        memcpy( pDestination,
+                pCredential,
+                length + 1 );
+        *pDestinationLength = length;
+    }
+
+    return retStatus;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_SetRemoteCredentials - Sets the remote username fragment and password, e.g. when the answer arrives after the agent
+ * was created, or on ICE restart. combinedUserName ( "remote:local" ), the MESSAGE-INTEGRITY key state of our requests
+ * and the request templates follow; the agent is left unchanged when a credential is too long. */
+
+IceResult_t Ice_SetRemoteCredentials( IceAgent_t * pIceAgent,
+                                      const char * remoteUsername,
+                                      const char * remotePassword )
+{
+    IceResult_t retStatus = ICE_RESULT_OK;
+    size_t offset;
+
+    if( ( pIceAgent == NULL ) ||
+        ( remoteUsername == NULL ) ||
+        ( remotePassword == NULL ) ||
+        ( strnlen( remoteUsername, MAX_ICE_CONFIG_USER_NAME_LEN + 1 ) > MAX_ICE_CONFIG_USER_NAME_LEN ) ||
+        ( strnlen( remotePassword, MAX_ICE_CONFIG_CREDENTIAL_LEN + 1 ) > MAX_ICE_CONFIG_CREDENTIAL_LEN ) )
+    {
+        retStatus = ICE_RESULT_BAD_PARAM;
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        ( void ) Ice_CopyCredential( pIceAgent->remoteUsername,
+                                     &( pIceAgent->remoteUsernameLength ),
+                                     remoteUsername,
+                                     MAX_ICE_CONFIG_USER_NAME_LEN );
+        ( void ) Ice_CopyCredential( pIceAgent->remotePassword,
+                                     &( pIceAgent->remotePasswordLength ),
+                                     remotePassword,
+                                     MAX_ICE_CONFIG_CREDENTIAL_LEN );
+
+        memcpy( pIceAgent->combinedUserName,
+                pIceAgent->remoteUsername,
+                pIceAgent->remoteUsernameLength );
+        offset = pIceAgent->remoteUsernameLength;
+        pIceAgent->combinedUserName[ offset++ ] = ':';
+        memcpy( &( pIceAgent->combinedUserName[ offset ] ),
+                pIceAgent->localUsername,
+                pIceAgent->localUsernameLength + 1 );
+        pIceAgent->combinedUserNameLength = offset + pIceAgent->localUsernameLength;
+
+        /* Hash the HMAC key pads once, signing a message then only costs its own blocks. */
+        Ice_HmacSha1SetKey( &( pIceAgent->remotePasswordKey ),
+                            ( const uint8_t * ) pIceAgent->remotePassword,
+                            pIceAgent->remotePasswordLength );
+        Ice_InvalidateRequestTemplates( pIceAgent );
+    }
+
+    return retStatus;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_CreateIceAgent - The application calls this API for starting a new ICE agent. Credentials are NUL terminated, of at
+ * most MAX_ICE_CONFIG_USER_NAME_LEN / MAX_ICE_CONFIG_CREDENTIAL_LEN characters. */
 
 IceResult_t Ice_CreateIceAgent( IceAgent_t * pIceAgent,
-                                char * localUsername,
-                                char * localPassword,
-                                char * remoteUsername,
-                                char * remotePassword,
-                                char * combinedUsername,
-                                TransactionIdStore_t * pBuffer )
+                                const IceAgentConfig_t * pAgentConfig,
+                                uint8_t * pAgentMemory,
+                                size_t agentMemorySize,
+                                const char * localUsername,
+                                const char * localPassword,
+                                const char * remoteUsername,
+                                const char * remotePassword )
 {
     IceResult_t retStatus = ICE_RESULT_OK;
-    int i;
+    size_t requiredMemorySize = 0;
+    uint32_t i;
 
     if( ( pIceAgent == NULL ) ||
+        ( pAgentMemory == NULL ) ||
+        ( ( ( uintptr_t ) pAgentMemory % ICE_AGENT_MEMORY_ALIGNMENT ) != 0 ) ||
         ( localPassword == NULL ) ||
         ( localUsername == NULL ) ||
         ( remotePassword == NULL ) ||
+        ( remoteUsername == NULL ) )
+    {
+        retStatus = ICE_RESULT_BAD_PARAM;
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        retStatus = Ice_GetIceAgentMemorySize( pAgentConfig,
+                                               &requiredMemorySize );
+    }
+
+    if( ( retStatus == ICE_RESULT_OK ) && ( agentMemorySize < requiredMemorySize ) )
+    {
+        retStatus = ICE_RESULT_OUT_OF_MEMORY;
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        retStatus = Ice_RandomInit( &( pIceAgent->random ),
+                                    pAgentConfig->randomSource,
+                                    pAgentConfig->pRandomSourceData );
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        retStatus = Ice_CopyCredential( pIceAgent->localUsername,
+                                        &( pIceAgent->localUsernameLength ),
+                                        localUsername,
+                                        MAX_ICE_CONFIG_USER_NAME_LEN );
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        retStatus = Ice_CopyCredential( pIceAgent->localPassword,
+                                        &( pIceAgent->localPasswordLength ),
+                                        localPassword,
+                                        MAX_ICE_CONFIG_CREDENTIAL_LEN );
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        retStatus = Ice_SetRemoteCredentials( pIceAgent,
+                                              remoteUsername,
+                                              remotePassword );
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        Ice_HmacSha1SetKey( &( pIceAgent->localPasswordKey ),
+                            ( const uint8_t * ) pIceAgent->localPassword,
+                            pIceAgent->localPasswordLength );
+
+        pIceAgent->localCandidateCount = 0;
+        pIceAgent->remoteCandidateCount = 0;
+        pIceAgent->iceCandidatePairCount = 0;
+        pIceAgent->checkListCount = 0;
+        pIceAgent->isControlling = 0;
+        pIceAgent->tieBreaker = Ice_RandomUint64( &( pIceAgent->random ) ); //required as an attribute for STUN packet
+        Ice_InvalidateRequestTemplates( pIceAgent );
+        pIceAgent->nextCheckTime = 0;
+        pIceAgent->pConnectionTable = NULL;
+        pIceAgent->logger.callback = NULL;
+        pIceAgent->logger.pUserData = NULL;
+        pIceAgent->logger.level = ICE_LOG_LEVEL_NONE;
+        pIceAgent->maxRequestCount = ( pAgentConfig->maxRequestCount != 0 ) ? pAgentConfig->maxRequestCount :
+                                     ICE_DEFAULT_MAX_REQUEST_COUNT;
+        pIceAgent->checkPacingInterval = ( pAgentConfig->checkPacingInterval != 0 ) ? pAgentConfig->checkPacingInterval :
+                                         ICE_DEFAULT_CHECK_PACING_INTERVAL_MS;
+        pIceAgent->nominationPolicy = pAgentConfig->nominationPolicy;
+        pIceAgent->nominationPriorityWindow = pAgentConfig->nominationPriorityWindow;
+
+        /* Only the candidate and candidate pair arrays need to start out zeroed (INVALID state),
+         * the outbound STUN buffers are always fully written by the serializer before use. */
+        ( void ) Ice_LayoutIceAgentMemory( pAgentConfig,
+                                           pAgentMemory,
+                                           pIceAgent );
+
+        memset( pIceAgent->localCandidates, 0, sizeof( IceCandidate_t ) * pIceAgent->maxLocalCandidates );
+        memset( pIceAgent->remoteCandidates, 0, sizeof( IceCandidate_t ) * pIceAgent->maxRemoteCandidates );
+        memset( pIceAgent->iceCandidatePairs, 0, sizeof( IceCandidatePair_t ) * pIceAgent->maxCandidatePairs );
+
+        /* Every outbound buffer starts free, buffer 0 on top of the stack. */
+        for( i = 0; i < pIceAgent->stunMessageBufferCount; i++ )
+        {
+            pIceAgent->pOutboundBuffers[ i ].pBuffer = pIceAgent->stunMessageBuffers + ( ( size_t ) i * pIceAgent->stunMessageBufferSize );
+            pIceAgent->pOutboundBuffers[ i ].length = 0;
+            pIceAgent->pOutboundBuffers[ i ].index = i;
+            pIceAgent->pOutboundBuffers[ i ].isInUse = 0;
+            pIceAgent->pOutboundFreeStack[ i ] = pIceAgent->stunMessageBufferCount - 1 - i;
+        }
+        pIceAgent->outboundFreeCount = pIceAgent->stunMessageBufferCount;
+        pIceAgent->outboundReadyHead = 0;
+        pIceAgent->outboundReadyCount = 0;
+
+        Ice_HashIndexInit( &( pIceAgent->localCandidateIndex ),
+                           pIceAgent->localCandidateIndex.pBuckets,
+                           pIceAgent->localCandidateIndex.bucketMask + 1 );
+        Ice_HashIndexInit( &( pIceAgent->remoteCandidateIndex ),
+                           pIceAgent->remoteCandidateIndex.pBuckets,
+                           pIceAgent->remoteCandidateIndex.bucketMask + 1 );
+        Ice_HashIndexInit( &( pIceAgent->candidatePairIndex ),
+                           pIceAgent->candidatePairIndex.pBuckets,
+                           pIceAgent->candidatePairIndex.bucketMask + 1 );
+        pIceAgent->hashSeed = Ice_RandomUint32( &( pIceAgent->random ) );
+
+        pIceAgent->currentTime = 0;
+        pIceAgent->connectStartTime = 0;
+        pIceAgent->connectPhase = ICE_CONNECT_PHASE_IDLE;
+        pIceAgent->statsClock = pAgentConfig->statsClock;
+        memset( &( pIceAgent->stats ), 0, sizeof( pIceAgent->stats ) );
+        retStatus = Ice_CreateTransactionIdStore( pAgentConfig->maxTransactionIdCount,
+                                                  ICE_DEFAULT_TRANSACTION_TIMEOUT_MS,
+                                                  Ice_RandomUint32( &( pIceAgent->random ) ),
+                                                  pIceAgent->stunBindingRequestTransactionIdStore.pTransactions,
+                                                  pIceAgent->stunBindingRequestTransactionIdStore.transactionIndex.pBuckets,
+                                                  &( pIceAgent->stunBindingRequestTransactionIdStore ) );
+        pIceAgent->stunBindingRequestTransactionIdStore.pTimerContext = pIceAgent;
+
+        if( pAgentConfig->initialRto != 0 )
+        {
+            pIceAgent->stunBindingRequestTransactionIdStore.initialRto = pAgentConfig->initialRto;
+        }
+    }
+
+    return retStatus;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_ResetAgent - Starts a new session on an existing agent, e.g. one taken back from a pool of agents or on ICE restart,
+ * with new credentials. Only what the previous session used is cleared: its candidate and candidate pair slots, their
+ * index entries, its outstanding transactions ( and their timers ) and its connection table entries, so the cost follows
+ * the previous session's candidate count rather than the configured maximums. The memory, configuration, timer wheel and
+ * connection table attachments, logger, random generator and cumulative stats are kept. An agent registered with an agent
+ * manager must be removed from it first, its username changes. Nothing is changed when a credential is too long. */
+
+IceResult_t Ice_ResetAgent( IceAgent_t * pIceAgent,
+                            const char * localUsername,
+                            const char * localPassword,
+                            const char * remoteUsername,
+                            const char * remotePassword )
+{
+    IceResult_t retStatus = ICE_RESULT_OK;
+    IceCandidate_t * pCandidate;
+    IceCandidatePair_t * pIceCandidatePair;
+    uint32_t i, index;
+    bool isPairIndexSparse, isLocalIndexSparse, isRemoteIndexSparse;
+
+    if( ( pIceAgent == NULL ) ||
+        ( pIceAgent->stunBindingRequestTransactionIdStore.pSharedIndex != NULL ) ||
+        ( localUsername == NULL ) ||
+        ( localPassword == NULL ) ||
         ( remoteUsername == NULL ) ||
-        ( combinedUsername == NULL ) ||
-        ( pBuffer == NULL ) )
+        ( remotePassword == NULL ) ||
+        ( strnlen( localUsername, MAX_ICE_CONFIG_USER_NAME_LEN + 1 ) > MAX_ICE_CONFIG_USER_NAME_LEN ) ||
+        ( strnlen( localPassword, MAX_ICE_CONFIG_CREDENTIAL_LEN + 1 ) > MAX_ICE_CONFIG_CREDENTIAL_LEN ) ||
+        ( strnlen( remoteUsername, MAX_ICE_CONFIG_USER_NAME_LEN + 1 ) > MAX_ICE_CONFIG_USER_NAME_LEN ) ||
+        ( strnlen( remotePassword, MAX_ICE_CONFIG_CREDENTIAL_LEN + 1 ) > MAX_ICE_CONFIG_CREDENTIAL_LEN ) )
     {
         retStatus = ICE_RESULT_BAD_PARAM;
     }
 
     if( retStatus == ICE_RESULT_OK )
     {
-        strncpy( pIceAgent->localUsername,
-                localUsername,
-                strlen( localUsername ) );
-        strncpy( pIceAgent->localPassword,
-                localPassword,
-                strlen( localPassword ) );
-        strncpy( pIceAgent->remoteUsername,
-                remoteUsername,
-                strlen( remoteUsername ) );
-        strncpy( pIceAgent->remotePassword,
-                remotePassword,
-                strlen( remotePassword ) );
-        strncpy( pIceAgent->combinedUserName,
-                combinedUsername,
-                strlen( combinedUsername ) );
-
-        pIceAgent->stunMessageBufferUsedCount = 0;
+        /* Cancels the timers of the outstanding transactions as well. */
+        Ice_TransactionIdStoreClear( &( pIceAgent->stunBindingRequestTransactionIdStore ) );
+
+        /* A sparse index only has the bucket runs of its entries cleared. A denser one ( an entry per 64 buckets or more )
+         * is zeroed whole: that is cheaper than rehashing its entries and still bounded by the number of entries. */
+        isPairIndexSparse = ( ( pIceAgent->candidatePairIndex.entryCount << 6 ) < ( pIceAgent->candidatePairIndex.bucketMask + 1 ) );
+        isLocalIndexSparse = ( ( pIceAgent->localCandidateIndex.entryCount << 6 ) < ( pIceAgent->localCandidateIndex.bucketMask + 1 ) );
+        isRemoteIndexSparse = ( ( pIceAgent->remoteCandidateIndex.entryCount << 6 ) < ( pIceAgent->remoteCandidateIndex.bucketMask + 1 ) );
+
+        for( i = 0; i < pIceAgent->iceCandidatePairCount; i++ )
+        {
+            pIceCandidatePair = &( pIceAgent->iceCandidatePairs[ i ] );
+
+            if( ( pIceAgent->pConnectionTable != NULL ) &&
+                ( ( pIceCandidatePair->state == ICE_CANDIDATE_PAIR_STATE_NOMINATED ) ||
+                  ( pIceCandidatePair->state == ICE_CANDIDATE_PAIR_STATE_SUCCEEDED ) ) )
+            {
+                Ice_ConnectionTableRemove( pIceAgent->pConnectionTable,
+                                           &( pIceCandidatePair->local->ipAddress.ipAddress ),
+                                           &( pIceCandidatePair->remote->ipAddress.ipAddress ) );
+            }
+
+            if( isPairIndexSparse )
+            {
+                Ice_HashIndexClearRun( &( pIceAgent->candidatePairIndex ),
+                                       Ice_HashCandidatePair( pIceAgent,
+                                                              pIceCandidatePair->local,
+                                                              &( pIceCandidatePair->remote->ipAddress ) ) );
+            }
+        }
+
+        for( i = 0; isLocalIndexSparse && ( i < pIceAgent->localCandidateCount ); i++ )
+        {
+            pCandidate = &( pIceAgent->localCandidates[ i ] );
+            Ice_HashIndexClearRun( &( pIceAgent->localCandidateIndex ),
+                                   Ice_HashAddress( &( pCandidate->ipAddress.ipAddress ), pCandidate->remoteProtocol, pIceAgent->hashSeed ) );
+        }
+
+        for( i = 0; isRemoteIndexSparse && ( i < pIceAgent->remoteCandidateCount ); i++ )
+        {
+            pCandidate = &( pIceAgent->remoteCandidates[ i ] );
+            Ice_HashIndexClearRun( &( pIceAgent->remoteCandidateIndex ),
+                                   Ice_HashAddress( &( pCandidate->ipAddress.ipAddress ), pCandidate->remoteProtocol, pIceAgent->hashSeed ) );
+        }
+
+        /* Every entry is keyed on its slot's current contents, so a sparse index is empty now. Should an entry have been
+         * left behind anyway, it is zeroed whole as well. */
+        if( !isPairIndexSparse || ( pIceAgent->candidatePairIndex.entryCount != 0 ) )
+        {
+            Ice_HashIndexInit( &( pIceAgent->candidatePairIndex ),
+                               pIceAgent->candidatePairIndex.pBuckets,
+                               pIceAgent->candidatePairIndex.bucketMask + 1 );
+        }
+
+        if( !isLocalIndexSparse || ( pIceAgent->localCandidateIndex.entryCount != 0 ) )
+        {
+            Ice_HashIndexInit( &( pIceAgent->localCandidateIndex ),
+                               pIceAgent->localCandidateIndex.pBuckets,
+                               pIceAgent->localCandidateIndex.bucketMask + 1 );
+        }
+
+        if( !isRemoteIndexSparse || ( pIceAgent->remoteCandidateIndex.entryCount != 0 ) )
+        {
+            Ice_HashIndexInit( &( pIceAgent->remoteCandidateIndex ),
+                               pIceAgent->remoteCandidateIndex.pBuckets,
+                               pIceAgent->remoteCandidateIndex.bucketMask + 1 );
+        }
+
+        /* Slots past the counts were never written since they were last cleared. */
+        memset( pIceAgent->localCandidates, 0, sizeof( IceCandidate_t ) * pIceAgent->localCandidateCount );
+        memset( pIceAgent->remoteCandidates, 0, sizeof( IceCandidate_t ) * pIceAgent->remoteCandidateCount );
+        memset( pIceAgent->iceCandidatePairs, 0, sizeof( IceCandidatePair_t ) * pIceAgent->iceCandidatePairCount );
+        pIceAgent->localCandidateCount = 0;
+        pIceAgent->remoteCandidateCount = 0;
+        pIceAgent->iceCandidatePairCount = 0;
+        pIceAgent->checkListCount = 0;
+
+        /* Messages the application has not collected are dropped. Buffers it holds come back through
+         * Ice_ReleaseOutboundBuffer as usual. */
+        while( pIceAgent->outboundReadyCount > 0 )
+        {
+            index = pIceAgent->pOutboundReadyQueue[ pIceAgent->outboundReadyHead ];
+            pIceAgent->pOutboundBuffers[ index ].isInUse = 0;
+            pIceAgent->pOutboundFreeStack[ pIceAgent->outboundFreeCount++ ] = index;
+            pIceAgent->outboundReadyHead = ( pIceAgent->outboundReadyHead + 1 < pIceAgent->stunMessageBufferCount ) ?
+                                           ( pIceAgent->outboundReadyHead + 1 ) : 0;
+            pIceAgent->outboundReadyCount--;
+        }
+        pIceAgent->outboundReadyHead = 0;
+
+        ( void ) Ice_CopyCredential( pIceAgent->localUsername,
+                                     &( pIceAgent->localUsernameLength ),
+                                     localUsername,
+                                     MAX_ICE_CONFIG_USER_NAME_LEN );
+        ( void ) Ice_CopyCredential( pIceAgent->localPassword,
+                                     &( pIceAgent->localPasswordLength ),
+                                     localPassword,
+                                     MAX_ICE_CONFIG_CREDENTIAL_LEN );
+        Ice_HmacSha1SetKey( &( pIceAgent->localPasswordKey ),
+                            ( const uint8_t * ) pIceAgent->localPassword,
+                            pIceAgent->localPasswordLength );
+        ( void ) Ice_SetRemoteCredentials( pIceAgent,
+                                           remoteUsername,
+                                           remotePassword );
+
+        /* A new session gets new seeds and tie-breaker, as from Ice_CreateIceAgent. */
         pIceAgent->isControlling = 0;
-        pIceAgent->tieBreaker = ( uint64_t ) rand(); //required as an attribute for STUN packet
+        pIceAgent->tieBreaker = Ice_RandomUint64( &( pIceAgent->random ) );
+        pIceAgent->hashSeed = Ice_RandomUint32( &( pIceAgent->random ) );
+        pIceAgent->stunBindingRequestTransactionIdStore.hashSeed = Ice_RandomUint32( &( pIceAgent->random ) );
+        Ice_InvalidateRequestTemplates( pIceAgent );
+        pIceAgent->nextCheckTime = 0;
+        pIceAgent->connectStartTime = 0;
+        pIceAgent->connectPhase = ICE_CONNECT_PHASE_IDLE;
+    }
+
+    return retStatus;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_UpdateCurrentTime - The application calls this API to advance the agent clock ( milliseconds, any monotonic origin ).
+ * Outstanding transaction IDs whose deadline has passed are aged out. */
+
+void Ice_UpdateCurrentTime( IceAgent_t * pIceAgent,
+                            uint64_t currentTime )
+{
+    if( pIceAgent != NULL )
+    {
+        pIceAgent->currentTime = currentTime;
+
+        ( void ) Ice_TransactionIdStoreExpire( &( pIceAgent->stunBindingRequestTransactionIdStore ),
+                                               currentTime );
+    }
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_LayoutIceAgentMemory - Computes the placement of the agent arrays inside the application provided memory block.
+ * When pAgentMemory and pIceAgent are given, the agent array pointers and capacities are set up as well.
+ * Returns the total number of bytes the layout requires. */
+
+size_t Ice_LayoutIceAgentMemory( const IceAgentConfig_t * pAgentConfig,
+                                 uint8_t * pAgentMemory,
+                                 IceAgent_t * pIceAgent )
+{
+    size_t offset = 0;
+    bool isAssign = ( pAgentMemory != NULL ) && ( pIceAgent != NULL );
+
+    if( isAssign )
+    {
+        pIceAgent->localCandidates = ( IceCandidate_t * )( pAgentMemory + offset );
+        pIceAgent->maxLocalCandidates = pAgentConfig->maxLocalCandidates;
+    }
+    offset += ICE_AGENT_MEMORY_ALIGN( sizeof( IceCandidate_t ) * pAgentConfig->maxLocalCandidates );
+
+    if( isAssign )
+    {
+        pIceAgent->remoteCandidates = ( IceCandidate_t * )( pAgentMemory + offset );
+        pIceAgent->maxRemoteCandidates = pAgentConfig->maxRemoteCandidates;
+    }
+    offset += ICE_AGENT_MEMORY_ALIGN( sizeof( IceCandidate_t ) * pAgentConfig->maxRemoteCandidates );
+
+    if( isAssign )
+    {
+        pIceAgent->localCandidateIndex.pBuckets = ( IceHashBucket_t * )( pAgentMemory + offset );
+        pIceAgent->localCandidateIndex.bucketMask = Ice_HashIndexGetBucketCount( pAgentConfig->maxLocalCandidates ) - 1;
+    }
+    offset += ICE_AGENT_MEMORY_ALIGN( sizeof( IceHashBucket_t ) * Ice_HashIndexGetBucketCount( pAgentConfig->maxLocalCandidates ) );
+
+    if( isAssign )
+    {
+        pIceAgent->remoteCandidateIndex.pBuckets = ( IceHashBucket_t * )( pAgentMemory + offset );
+        pIceAgent->remoteCandidateIndex.bucketMask = Ice_HashIndexGetBucketCount( pAgentConfig->maxRemoteCandidates ) - 1;
+    }
+    offset += ICE_AGENT_MEMORY_ALIGN( sizeof( IceHashBucket_t ) * Ice_HashIndexGetBucketCount( pAgentConfig->maxRemoteCandidates ) );
+
+    if( isAssign )
+    {
+        pIceAgent->candidatePairIndex.pBuckets = ( IceHashBucket_t * )( pAgentMemory + offset );
+        pIceAgent->candidatePairIndex.bucketMask = Ice_HashIndexGetBucketCount( pAgentConfig->maxCandidatePairs ) - 1;
+    }
+    offset += ICE_AGENT_MEMORY_ALIGN( sizeof( IceHashBucket_t ) * Ice_HashIndexGetBucketCount( pAgentConfig->maxCandidatePairs ) );
+
+    if( isAssign )
+    {
+        pIceAgent->iceCandidatePairs = ( IceCandidatePair_t * )( pAgentMemory + offset );
+        pIceAgent->maxCandidatePairs = pAgentConfig->maxCandidatePairs;
+    }
+    offset += ICE_AGENT_MEMORY_ALIGN( sizeof( IceCandidatePair_t ) * pAgentConfig->maxCandidatePairs );
+
+    if( isAssign )
+    {
+        pIceAgent->pCheckList = ( uint32_t * )( pAgentMemory + offset );
+    }
+    offset += ICE_AGENT_MEMORY_ALIGN( sizeof( uint32_t ) * pAgentConfig->maxCandidatePairs );
+
+    if( isAssign )
+    {
+        pIceAgent->stunBindingRequestTransactionIdStore.pTransactions = ( IceTransaction_t * )( pAgentMemory + offset );
+    }
+    offset += ICE_AGENT_MEMORY_ALIGN( sizeof( IceTransaction_t ) * pAgentConfig->maxTransactionIdCount );
+
+    if( isAssign )
+    {
+        pIceAgent->stunBindingRequestTransactionIdStore.transactionIndex.pBuckets = ( IceHashBucket_t * )( pAgentMemory + offset );
+    }
+    offset += ICE_AGENT_MEMORY_ALIGN( sizeof( IceHashBucket_t ) * Ice_HashIndexGetBucketCount( pAgentConfig->maxTransactionIdCount ) );
+
+    if( isAssign )
+    {
+        pIceAgent->pOutboundBuffers = ( IceOutboundBuffer_t * )( pAgentMemory + offset );
+        pIceAgent->stunMessageBufferCount = pAgentConfig->stunMessageBufferCount;
+        pIceAgent->stunMessageBufferSize = pAgentConfig->stunMessageBufferSize;
+    }
+    offset += ICE_AGENT_MEMORY_ALIGN( sizeof( IceOutboundBuffer_t ) * pAgentConfig->stunMessageBufferCount );
+
+    if( isAssign )
+    {
+        pIceAgent->pOutboundFreeStack = ( uint32_t * )( pAgentMemory + offset );
+    }
+    offset += ICE_AGENT_MEMORY_ALIGN( sizeof( uint32_t ) * pAgentConfig->stunMessageBufferCount );
+
+    if( isAssign )
+    {
+        pIceAgent->pOutboundReadyQueue = ( uint32_t * )( pAgentMemory + offset );
+    }
+    offset += ICE_AGENT_MEMORY_ALIGN( sizeof( uint32_t ) * pAgentConfig->stunMessageBufferCount );
+
+    if( isAssign )
+    {
+        pIceAgent->stunMessageBuffers = pAgentMemory + offset;
+    }
+    offset += ICE_AGENT_MEMORY_ALIGN( ( size_t ) pAgentConfig->stunMessageBufferSize * pAgentConfig->stunMessageBufferCount );
+
+    return offset;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_GetStunMessageLength - Returns the total length of a serialized STUN message, read from its header. */
 
-        memset( pIceAgent->localCandidates, 0, sizeof( pIceAgent->localCandidates ) );
-        memset( pIceAgent->remoteCandidates, 0, sizeof( pIceAgent->remoteCandidates ) );
-        memset( pIceAgent->stunMessageBuffers, 0, sizeof( pIceAgent->stunMessageBuffers ) );
-        memset( pIceAgent->iceCandidatePairs, 0, sizeof( pIceAgent->iceCandidatePairs ) );
+size_t Ice_GetStunMessageLength( const uint8_t * pStunMessageBuffer )
+{
+    return STUN_HEADER_LENGTH + ( ( ( size_t ) pStunMessageBuffer[ 2 ] << 8 ) | pStunMessageBuffer[ 3 ] );
+}
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_AcquireOutboundBuffer - Takes the most recently released buffer of the agent's outbound pool, still warm in the
+ * cache. Returns NULL when every buffer is waiting to be sent or being sent. */
+
+static IceOutboundBuffer_t * Ice_AcquireOutboundBuffer( IceAgent_t * pIceAgent )
+{
+    IceOutboundBuffer_t * pOutboundBuffer = NULL;
+
+    if( pIceAgent->outboundFreeCount > 0 )
+    {
+        pIceAgent->outboundFreeCount--;
+        pOutboundBuffer = &( pIceAgent->pOutboundBuffers[ pIceAgent->pOutboundFreeStack[ pIceAgent->outboundFreeCount ] ] );
+        pOutboundBuffer->isInUse = 1;
+    }
+
+    return pOutboundBuffer;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_QueueOutboundBuffer - Hands a buffer holding a complete STUN message to the application, through
+ * Ice_GetOutboundBuffer, to be sent to pDestination. */
+
+static void Ice_QueueOutboundBuffer( IceAgent_t * pIceAgent,
+                                     IceOutboundBuffer_t * pOutboundBuffer,
+                                     const IceIPAddress_t * pDestination )
+{
+    uint32_t tail = pIceAgent->outboundReadyHead + pIceAgent->outboundReadyCount;
+
+    if( tail >= pIceAgent->stunMessageBufferCount )
+    {
+        tail -= pIceAgent->stunMessageBufferCount;
+    }
+
+    pOutboundBuffer->length = ( uint32_t ) Ice_GetStunMessageLength( pOutboundBuffer->pBuffer );
+    pOutboundBuffer->destination = *pDestination;
+    pIceAgent->pOutboundReadyQueue[ tail ] = pOutboundBuffer->index;
+    pIceAgent->outboundReadyCount++;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_GetOutboundBuffer - The application calls this API after handling received packets to collect the STUN messages
+ * the agent produced, oldest first, until it returns NULL. Each buffer holds length bytes to send to destination and
+ * must be given back with Ice_ReleaseOutboundBuffer once sent. */
+
+IceOutboundBuffer_t * Ice_GetOutboundBuffer( IceAgent_t * pIceAgent )
+{
+    IceOutboundBuffer_t * pOutboundBuffer = NULL;
+
+    if( ( pIceAgent != NULL ) && ( pIceAgent->outboundReadyCount > 0 ) )
+    {
+        pOutboundBuffer = &( pIceAgent->pOutboundBuffers[ pIceAgent->pOutboundReadyQueue[ pIceAgent->outboundReadyHead ] ] );
+        pIceAgent->outboundReadyHead++;
+        pIceAgent->outboundReadyCount--;
+
+        if( pIceAgent->outboundReadyHead >= pIceAgent->stunMessageBufferCount )
+        {
+            pIceAgent->outboundReadyHead = 0;
+        }
+    }
 
-        pIceAgent->pStunBindingRequestTransactionIdStore = pBuffer;
-        retStatus = Ice_CreateTransactionIdStore( DEFAULT_MAX_STORED_TRANSACTION_ID_COUNT,
-                                                  pIceAgent->pStunBindingRequestTransactionIdStore );
+    return pOutboundBuffer;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_ReleaseOutboundBuffer - Returns a buffer obtained from Ice_GetOutboundBuffer to the agent's outbound pool.
+ * A buffer already back in the pool is rejected, so a double release cannot hand one buffer out twice. */
+
+IceResult_t Ice_ReleaseOutboundBuffer( IceAgent_t * pIceAgent,
+                                       IceOutboundBuffer_t * pOutboundBuffer )
+{
+    IceResult_t retStatus = ICE_RESULT_OK;
+
+    if( ( pIceAgent == NULL ) ||
+        ( pOutboundBuffer == NULL ) ||
+        ( pOutboundBuffer->index >= pIceAgent->stunMessageBufferCount ) ||
+        ( pOutboundBuffer != &( pIceAgent->pOutboundBuffers[ pOutboundBuffer->index ] ) ) ||
+        ( pOutboundBuffer->isInUse == 0 ) ||
+        ( pIceAgent->outboundFreeCount >= pIceAgent->stunMessageBufferCount ) )
+    {
+        retStatus = ICE_RESULT_BAD_PARAM;
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        pOutboundBuffer->length = 0;
+        pOutboundBuffer->isInUse = 0;
+        pIceAgent->pOutboundFreeStack[ pIceAgent->outboundFreeCount ] = pOutboundBuffer->index;
+        pIceAgent->outboundFreeCount++;
     }
 
     return retStatus;
@@ -72,17 +672,18 @@ IceResult_t Ice_CreateIceAgent( IceAgent_t * pIceAgent,
 
 /*------------------------------------------------------------------------------------------------------------------*/
 
-/* Ice_AddHostCandidate - The application calls this API for adding host candidate. */
+/* Ice_AddHostCandidate - The application calls this API for adding host candidate. On success *ppCandidate, if
+ * ppCandidate is not NULL, points to the stored candidate. */
 
 IceResult_t Ice_AddHostCandidate( const IceIPAddress_t ipAddr,
                                   IceAgent_t * pIceAgent,
-                                  IceCandidate_t * pCandidate )
+                                  IceCandidate_t ** ppCandidate )
 {
     IceResult_t retStatus = ICE_RESULT_OK;
     IceCandidate_t iceCandidate ;
     int localCandidateCount = Ice_GetValidLocalCandidateCount( pIceAgent );
 
-    if( localCandidateCount == ICE_MAX_LOCAL_CANDIDATE_COUNT )
+    if( ( uint32_t ) localCandidateCount == pIceAgent->maxLocalCandidates )
     {
         retStatus = ICE_RESULT_MAX_CANDIDATE_THRESHOLD;
     }
@@ -96,6 +697,7 @@ IceResult_t Ice_AddHostCandidate( const IceIPAddress_t ipAddr,
         iceCandidate.isRemote = 0;
         iceCandidate.ipAddress = ipAddr;
         iceCandidate.iceCandidateType = ICE_CANDIDATE_TYPE_HOST;
+        iceCandidate.remoteProtocol = ICE_SOCKET_PROTOCOL_UDP;
         iceCandidate.state = ICE_CANDIDATE_STATE_VALID;
         iceCandidate.priority = Ice_ComputeCandidatePriority( &iceCandidate );
 
@@ -103,9 +705,9 @@ IceResult_t Ice_AddHostCandidate( const IceIPAddress_t ipAddr,
                                               iceCandidate );
     }
 
-    if( retStatus == ICE_RESULT_OK )
+    if( ( retStatus == ICE_RESULT_OK ) && ( ppCandidate != NULL ) )
     {
-        pCandidate = &iceCandidate;
+        *ppCandidate = &( pIceAgent->localCandidates[ localCandidateCount ] );
     }
 
     return retStatus;
@@ -113,20 +715,23 @@ IceResult_t Ice_AddHostCandidate( const IceIPAddress_t ipAddr,
 
 /*------------------------------------------------------------------------------------------------------------------*/
 
-/* Ice_AddSrflxCandidate - The application calls this API for adding Server Reflex candidate. */
+/* Ice_AddSrflxCandidate - The application calls this API for adding Server Reflex candidate. On success *ppCandidate, if
+ * ppCandidate is not NULL, points to the stored candidate. */
 
 IceResult_t Ice_AddSrflxCandidate( const IceIPAddress_t ipAddr,
                                    IceAgent_t * pIceAgent,
-                                   IceCandidate_t * pCandidate,
+                                   IceCandidate_t ** ppCandidate,
                                    uint8_t * pStunMessageBuffer,
                                    uint8_t * pTransactionIdBuffer )
 {
     IceResult_t retStatus = ICE_RESULT_OK;
     IceCandidate_t iceCandidate ;
+    IceCandidate_t * pCandidate;
+    IceTransaction_t * pTransaction;
 
     int localCandidateCount = Ice_GetValidLocalCandidateCount( pIceAgent );
 
-    if( localCandidateCount == ICE_MAX_LOCAL_CANDIDATE_COUNT )
+    if( ( uint32_t ) localCandidateCount == pIceAgent->maxLocalCandidates )
     {
         retStatus = ICE_RESULT_MAX_CANDIDATE_THRESHOLD;
     }
@@ -140,6 +745,7 @@ IceResult_t Ice_AddSrflxCandidate( const IceIPAddress_t ipAddr,
         iceCandidate.isRemote = 0;
         iceCandidate.ipAddress = ipAddr;
         iceCandidate.iceCandidateType = ICE_CANDIDATE_TYPE_SERVER_REFLEXIVE;
+        iceCandidate.remoteProtocol = ICE_SOCKET_PROTOCOL_UDP;
         iceCandidate.state = ICE_CANDIDATE_STATE_NEW;
         iceCandidate.priority = Ice_ComputeCandidatePriority( &iceCandidate );
 
@@ -155,7 +761,20 @@ IceResult_t Ice_AddSrflxCandidate( const IceIPAddress_t ipAddr,
 
         if( retStatus == ICE_RESULT_OK )
         {
-            pCandidate = &iceCandidate;
+            pCandidate = &( pIceAgent->localCandidates[ localCandidateCount ] );
+            pTransaction = Ice_TransactionIdStoreFind( &( pIceAgent->stunBindingRequestTransactionIdStore ),
+                                                       pTransactionIdBuffer );
+
+            /* Remember which candidate the request was gathered for, so its response updates that candidate. */
+            if( pTransaction != NULL )
+            {
+                pTransaction->pLocalCandidate = pCandidate;
+            }
+
+            if( ppCandidate != NULL )
+            {
+                *ppCandidate = pCandidate;
+            }
         }
 
     }
@@ -164,22 +783,24 @@ IceResult_t Ice_AddSrflxCandidate( const IceIPAddress_t ipAddr,
 
 /*------------------------------------------------------------------------------------------------------------------*/
 
-/* Ice_AddRemoteCandidate - The application calls this API for adding remote candidates. */
+/* Ice_AddRemoteCandidate - The application calls this API for adding remote candidates. On success *ppCandidate, if
+ * ppCandidate is not NULL, points to the stored candidate. */
 
 IceResult_t Ice_AddRemoteCandidate( IceAgent_t * pIceAgent,
                                     IceCandidateType_t iceCandidateType,
-                                    IceCandidate_t * pCandidate,
+                                    IceCandidate_t ** ppCandidate,
                                     const IceIPAddress_t ipAddr,
                                     IceSocketProtocol_t remoteProtocol,
                                     const uint32_t priority )
 {
     IceResult_t retStatus = ICE_RESULT_OK;
     IceCandidate_t iceCandidate;
-    int i;
+    IceCandidate_t * pCandidate;
+    int i, localCandidateCount;
 
     int remoteCandidateCount = Ice_GetValidRemoteCandidateCount( pIceAgent );
 
-    if( remoteCandidateCount == ICE_MAX_REMOTE_CANDIDATE_COUNT )
+    if( ( uint32_t ) remoteCandidateCount == pIceAgent->maxRemoteCandidates )
     {
         retStatus = ICE_RESULT_MAX_CANDIDATE_THRESHOLD;
     }
@@ -203,43 +824,56 @@ IceResult_t Ice_AddRemoteCandidate( IceAgent_t * pIceAgent,
 
     if( retStatus == ICE_RESULT_OK )
     {
-        pCandidate = &iceCandidate;
+        /* Pair against the stored slot, the local copy goes out of scope on return. */
+        pCandidate = &( pIceAgent->remoteCandidates[ remoteCandidateCount ] );
+        localCandidateCount = Ice_GetValidLocalCandidateCount( pIceAgent );
 
-        for( i = 0; ( ( i < Ice_GetValidLocalCandidateCount( pIceAgent ) ) && ( retStatus == ICE_RESULT_OK ) ); i++ )
+        for( i = 0; ( ( i < localCandidateCount ) && ( retStatus == ICE_RESULT_OK ) ); i++ )
         {
             if( pIceAgent->localCandidates[ i ].state == ICE_CANDIDATE_STATE_VALID )
             {
                 retStatus = Ice_CreateCandidatePair( pIceAgent,
                                                      &( pIceAgent->localCandidates[ i ] ),
                                                      pCandidate );
-                printf("Status=%d\n",retStatus);
             }
         }
+
+        if( ppCandidate != NULL )
+        {
+            *ppCandidate = pCandidate;
+        }
     }
 
     return retStatus;
 }
 /*------------------------------------------------------------------------------------------------------------------*/
 
-/*  Ice_checkRemotePeerReflexiveCandidate - The library calls this API for creating remote peer reflexive candidates on receiving a STUN binding request. */
+/*  Ice_checkRemotePeerReflexiveCandidate - The library calls this API for creating remote peer reflexive candidates on receiving a STUN binding request
+ *  from a source address that does not match any known remote candidate. */
 
 IceResult_t Ice_CheckPeerReflexiveCandidate( IceAgent_t * pIceAgent,
                                              IceIPAddress_t pIpAddr,
-                                             uint32_t priority,
-                                             IceCandidatePair_t * pIceCandidatePair )
+                                             uint32_t priority )
 {
     IceResult_t retStatus = ICE_RESULT_OK;
-    IceCandidate_t peerReflexiveCandidate;
-
-    peerReflexiveCandidate = Ice_FindCandidateFromIp( pIceAgent,
-                                                      pIpAddr,
-                                                      1 );
-    retStatus = Ice_AddRemoteCandidate( pIceAgent,
-                                        ICE_CANDIDATE_TYPE_PEER_REFLEXIVE,
-                                        &peerReflexiveCandidate,
-                                        pIpAddr,
-                                        0,
-                                        priority );
+
+    if( Ice_FindCandidateFromIp( pIceAgent,
+                                 &pIpAddr,
+                                 ICE_SOCKET_PROTOCOL_UDP,
+                                 true ) == NULL )
+    {
+        retStatus = Ice_AddRemoteCandidate( pIceAgent,
+                                            ICE_CANDIDATE_TYPE_PEER_REFLEXIVE,
+                                            NULL,
+                                            pIpAddr,
+                                            ICE_SOCKET_PROTOCOL_UDP,
+                                            priority );
+
+        if( retStatus == ICE_RESULT_OK )
+        {
+            pIceAgent->stats.peerReflexiveCandidates++;
+        }
+    }
 
     return retStatus;
 }
@@ -266,7 +900,7 @@ IceResult_t Ice_CreateCandidatePair( IceAgent_t * pIceAgent,
     {
         iceCandidatePairCount = Ice_GetValidCandidatePairCount( pIceAgent );
 
-        if( iceCandidatePairCount == ICE_MAX_CANDIDATE_PAIR_COUNT )
+        if( ( uint32_t ) iceCandidatePairCount == pIceAgent->maxCandidatePairs )
         {
             retStatus = ICE_RESULT_MAX_CANDIDATE_PAIR_THRESHOLD;
         }
@@ -283,11 +917,15 @@ IceResult_t Ice_CreateCandidatePair( IceAgent_t * pIceAgent,
             iceCandidatePair.priority = Ice_ComputeCandidatePairPriority( &iceCandidatePair,
                                                                           pIceAgent->isControlling );
             iceCandidatePair.connectivityChecks = 0;
+            iceCandidatePair.smoothedRtt = 0;
+            iceCandidatePair.rttVariation = 0;
+            iceCandidatePair.rttSampleCount = 0;
+
+            Ice_InsertCandidatePair( pIceAgent,
+                                     iceCandidatePair,
+                                     iceCandidatePairCount );
+            pIceAgent->stats.pairStateTransitions[ ICE_CANDIDATE_PAIR_STATE_WAITING ]++;
         }
-
-        Ice_InsertCandidatePair( pIceAgent,
-                                 iceCandidatePair,
-                                 iceCandidatePairCount );
     }
 
     return retStatus;
@@ -295,62 +933,297 @@ IceResult_t Ice_CreateCandidatePair( IceAgent_t * pIceAgent,
 
 /*------------------------------------------------------------------------------------------------------------------*/
 
-/* Ice_insertCandidatePair : This API is called internally to insert candidate paits based on decreasing priority. */
+/* Ice_InsertCandidatePair : This API is called internally to store a candidate pair and queue it on the check list.
+ * Pairs keep their slot in iceCandidatePairs for their whole lifetime, so pointers to them stay valid;
+ * the priority order is kept by the check list heap, which only moves slot indices around.
+ * Pairs on a server reflexive local candidate are never queued, they are redundant with the pair on their host base
+ * ( RFC 8445 section 6.1.2.4 ). */
 
 void Ice_InsertCandidatePair( IceAgent_t * pIceAgent,
                               IceCandidatePair_t iceCandidatePair,
                               int iceCandidatePairCount )
 {
-    int i;
-    int pivot = -1;
+    IceCandidatePair_t * pIceCandidatePair = &( pIceAgent->iceCandidatePairs[ iceCandidatePairCount ] );
+
+    *pIceCandidatePair = iceCandidatePair;
+    pIceCandidatePair->checkListIndex = ICE_CHECK_LIST_INVALID_INDEX;
+    pIceAgent->iceCandidatePairCount = iceCandidatePairCount + 1;
+
+    ( void ) Ice_HashIndexInsert( &( pIceAgent->candidatePairIndex ),
+                                  Ice_HashCandidatePair( pIceAgent,
+                                                         pIceCandidatePair->local,
+                                                         &( pIceCandidatePair->remote->ipAddress ) ),
+                                  ( uint32_t ) iceCandidatePairCount );
+
+    if( ( ( pIceCandidatePair->state == ICE_CANDIDATE_PAIR_STATE_WAITING ) ||
+          ( pIceCandidatePair->state == ICE_CANDIDATE_PAIR_STATE_FROZEN ) ) &&
+        ( pIceCandidatePair->local->iceCandidateType != ICE_CANDIDATE_TYPE_SERVER_REFLEXIVE ) )
+    {
+        ( void ) Ice_CheckListPush( pIceAgent,
+                                    pIceCandidatePair );
+    }
+
+    return;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_CheckListIsHigher - Heap ordering of the check list: higher pair priority first, older pair first on a tie. */
+
+static bool Ice_CheckListIsHigher( IceAgent_t * pIceAgent,
+                                   uint32_t pairIndex1,
+                                   uint32_t pairIndex2 )
+{
+    uint64_t priority1 = pIceAgent->iceCandidatePairs[ pairIndex1 ].priority;
+    uint64_t priority2 = pIceAgent->iceCandidatePairs[ pairIndex2 ].priority;
+
+    return ( priority1 > priority2 ) || ( ( priority1 == priority2 ) && ( pairIndex1 < pairIndex2 ) );
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_CheckListPlace - Stores a pair slot index at a heap position and records the position in the pair. */
+
+static void Ice_CheckListPlace( IceAgent_t * pIceAgent,
+                                uint32_t heapIndex,
+                                uint32_t pairIndex )
+{
+    pIceAgent->pCheckList[ heapIndex ] = pairIndex;
+    pIceAgent->iceCandidatePairs[ pairIndex ].checkListIndex = heapIndex;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_CheckListSiftUp - Moves the entry at heapIndex towards the root until the heap order holds. */
+
+static void Ice_CheckListSiftUp( IceAgent_t * pIceAgent,
+                                 uint32_t heapIndex )
+{
+    uint32_t pairIndex = pIceAgent->pCheckList[ heapIndex ];
+    uint32_t parentIndex;
+
+    while( heapIndex > 0 )
+    {
+        parentIndex = ( heapIndex - 1 ) >> 1;
+
+        if( !Ice_CheckListIsHigher( pIceAgent, pairIndex, pIceAgent->pCheckList[ parentIndex ] ) )
+        {
+            break;
+        }
+
+        Ice_CheckListPlace( pIceAgent, heapIndex, pIceAgent->pCheckList[ parentIndex ] );
+        heapIndex = parentIndex;
+    }
+
+    Ice_CheckListPlace( pIceAgent, heapIndex, pairIndex );
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_CheckListSiftDown - Moves the entry at heapIndex towards the leaves until the heap order holds. */
+
+static void Ice_CheckListSiftDown( IceAgent_t * pIceAgent,
+                                   uint32_t heapIndex )
+{
+    uint32_t pairIndex = pIceAgent->pCheckList[ heapIndex ];
+    uint32_t childIndex;
 
-    for( i = 0; i < iceCandidatePairCount; i++ )
+    while( ( childIndex = ( heapIndex << 1 ) + 1 ) < pIceAgent->checkListCount )
     {
-        if( iceCandidatePair.priority >= pIceAgent->iceCandidatePairs[i].priority ) {
-            pivot = i;
+        if( ( childIndex + 1 < pIceAgent->checkListCount ) &&
+            Ice_CheckListIsHigher( pIceAgent, pIceAgent->pCheckList[ childIndex + 1 ], pIceAgent->pCheckList[ childIndex ] ) )
+        {
+            childIndex++;
+        }
+
+        if( !Ice_CheckListIsHigher( pIceAgent, pIceAgent->pCheckList[ childIndex ], pairIndex ) )
+        {
             break;
         }
+
+        Ice_CheckListPlace( pIceAgent, heapIndex, pIceAgent->pCheckList[ childIndex ] );
+        heapIndex = childIndex;
+    }
+
+    Ice_CheckListPlace( pIceAgent, heapIndex, pairIndex );
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_CheckListPush - Queues a candidate pair on the check list in O(log n). Queuing an already queued pair is a no-op. */
+
+IceResult_t Ice_CheckListPush( IceAgent_t * pIceAgent,
+                               IceCandidatePair_t * pIceCandidatePair )
+{
+    IceResult_t retStatus = ICE_RESULT_OK;
+
+    if( ( pIceAgent == NULL ) ||
+        ( pIceCandidatePair == NULL ) ||
+        ( pIceCandidatePair < pIceAgent->iceCandidatePairs ) ||
+        ( pIceCandidatePair >= pIceAgent->iceCandidatePairs + pIceAgent->iceCandidatePairCount ) )
+    {
+        retStatus = ICE_RESULT_BAD_PARAM;
     }
 
-    if( pivot == -1 )
+    if( ( retStatus == ICE_RESULT_OK ) && ( pIceCandidatePair->checkListIndex == ICE_CHECK_LIST_INVALID_INDEX ) )
     {
-        pivot = iceCandidatePairCount;
+        pIceAgent->pCheckList[ pIceAgent->checkListCount ] = ( uint32_t )( pIceCandidatePair - pIceAgent->iceCandidatePairs );
+        pIceAgent->checkListCount++;
+
+        Ice_CheckListSiftUp( pIceAgent,
+                             pIceAgent->checkListCount - 1 );
     }
-    else
+
+    return retStatus;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_CheckListRemove - Takes a candidate pair off the check list in O(log n). */
+
+void Ice_CheckListRemove( IceAgent_t * pIceAgent,
+                          IceCandidatePair_t * pIceCandidatePair )
+{
+    uint32_t heapIndex;
+
+    if( ( pIceAgent != NULL ) &&
+        ( pIceCandidatePair != NULL ) &&
+        ( pIceCandidatePair->checkListIndex != ICE_CHECK_LIST_INVALID_INDEX ) )
     {
-        for( i = iceCandidatePairCount; i > pivot; i-- )
+        heapIndex = pIceCandidatePair->checkListIndex;
+        pIceCandidatePair->checkListIndex = ICE_CHECK_LIST_INVALID_INDEX;
+        pIceAgent->checkListCount--;
+
+        if( heapIndex != pIceAgent->checkListCount )
         {
-            pIceAgent->iceCandidatePairs[ i ] = pIceAgent->iceCandidatePairs[ i - 1 ];
+            Ice_CheckListPlace( pIceAgent, heapIndex, pIceAgent->pCheckList[ pIceAgent->checkListCount ] );
+            Ice_CheckListSiftUp( pIceAgent, heapIndex );
+            Ice_CheckListSiftDown( pIceAgent, pIceAgent->iceCandidatePairs[ pIceAgent->pCheckList[ heapIndex ] ].checkListIndex );
         }
     }
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
 
-    pIceAgent->iceCandidatePairs[pivot] = iceCandidatePair;
+/* Ice_CheckListPopNextWaitingPair - Removes and returns the highest priority pair still in the WAITING state.
+ * Pairs whose state moved on while queued (e.g. validated by a triggered check) are dropped on the way.
+ * Returns NULL when no pair is waiting. */
 
-    return;
+IceCandidatePair_t * Ice_CheckListPopNextWaitingPair( IceAgent_t * pIceAgent )
+{
+    IceCandidatePair_t * pIceCandidatePair = NULL;
+    IceCandidatePair_t * pTopPair;
+
+    while( ( pIceAgent != NULL ) && ( pIceAgent->checkListCount > 0 ) && ( pIceCandidatePair == NULL ) )
+    {
+        pTopPair = &( pIceAgent->iceCandidatePairs[ pIceAgent->pCheckList[ 0 ] ] );
+
+        if( pTopPair->state == ICE_CANDIDATE_PAIR_STATE_FROZEN )
+        {
+            /* The highest priority pair is frozen, nothing can be checked until it is unfrozen. */
+            break;
+        }
+
+        Ice_CheckListRemove( pIceAgent,
+                             pTopPair );
+
+        if( pTopPair->state == ICE_CANDIDATE_PAIR_STATE_WAITING )
+        {
+            pIceCandidatePair = pTopPair;
+        }
+    }
+
+    return pIceCandidatePair;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_CheckListUpdatePriority - Restores the heap order after the priority of a queued pair changed, in O(log n). */
+
+void Ice_CheckListUpdatePriority( IceAgent_t * pIceAgent,
+                                  IceCandidatePair_t * pIceCandidatePair )
+{
+    if( ( pIceAgent != NULL ) &&
+        ( pIceCandidatePair != NULL ) &&
+        ( pIceCandidatePair->checkListIndex != ICE_CHECK_LIST_INVALID_INDEX ) )
+    {
+        Ice_CheckListSiftUp( pIceAgent,
+                             pIceCandidatePair->checkListIndex );
+        Ice_CheckListSiftDown( pIceAgent,
+                               pIceCandidatePair->checkListIndex );
+    }
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_CheckListRebuild - Recomputes every pair priority for the current role and re-heapifies the check list in O(n).
+ * Used when the agent role changes, since that changes the priority of all pairs at once. */
+
+void Ice_CheckListRebuild( IceAgent_t * pIceAgent )
+{
+    uint32_t i;
+
+    if( pIceAgent != NULL )
+    {
+        for( i = 0; i < pIceAgent->iceCandidatePairCount; i++ )
+        {
+            pIceAgent->iceCandidatePairs[ i ].priority = Ice_ComputeCandidatePairPriority( &( pIceAgent->iceCandidatePairs[ i ] ),
+                                                                                         pIceAgent->isControlling );
+        }
+
+        for( i = pIceAgent->checkListCount >> 1; i > 0; i-- )
+        {
+            Ice_CheckListSiftDown( pIceAgent,
+                                   i - 1 );
+        }
+    }
 }
 
 /*------------------------------------------------------------------------------------------------------------------*/
 
-/* Ice_UpdateSrflxCandidateAddress : This API will be called by processStunPacket, if the binding request is for finding srflx candidate to update the candidate address */
+/* Ice_UpdateSrflxCandidateAddress : This API will be called by processStunPacket, if the binding request is for finding srflx candidate to update the candidate address.
+ * The candidate is paired with the remote candidates on its first update only; a later update ( e.g. a duplicate or
+ * retransmitted STUN server response ) moves the candidate to the new address and keeps its pairs. */
 
 IceResult_t Ice_UpdateSrflxCandidateAddress( IceAgent_t * pIceAgent,
                                              IceCandidate_t * pCandidate,
                                              const IceIPAddress_t * pIpAddr )
 {
     IceResult_t retStatus = ICE_RESULT_OK;
-    int i;
+    int i, remoteCandidateCount = 0;
+    bool isPaired = false;
 
-    if( ( pCandidate == NULL ) ||
+    if( ( pIceAgent == NULL ) ||
+        ( pCandidate == NULL ) ||
         ( pIpAddr == NULL ) ||
         ( pCandidate->iceCandidateType != ICE_CANDIDATE_TYPE_SERVER_REFLEXIVE ) )
     {
         retStatus = ICE_RESULT_BAD_PARAM;
     }
 
-    pCandidate->ipAddress = *pIpAddr;
-    pCandidate->state = ICE_CANDIDATE_STATE_VALID;
+    if( retStatus == ICE_RESULT_OK )
+    {
+        isPaired = ( pCandidate->state == ICE_CANDIDATE_STATE_VALID );
+
+        /* The address is part of the index key, so re-index the candidate under its mapped address. */
+        Ice_HashIndexRemove( &( pIceAgent->localCandidateIndex ),
+                             Ice_HashAddress( &( pCandidate->ipAddress.ipAddress ), pCandidate->remoteProtocol, pIceAgent->hashSeed ),
+                             ( uint32_t )( pCandidate - pIceAgent->localCandidates ) );
+
+        pCandidate->ipAddress = *pIpAddr;
+        pCandidate->state = ICE_CANDIDATE_STATE_VALID;
+
+        retStatus = Ice_HashIndexInsert( &( pIceAgent->localCandidateIndex ),
+                                         Ice_HashAddress( &( pCandidate->ipAddress.ipAddress ), pCandidate->remoteProtocol, pIceAgent->hashSeed ),
+                                         ( uint32_t )( pCandidate - pIceAgent->localCandidates ) );
+    }
+
+    if( ( retStatus == ICE_RESULT_OK ) && !isPaired )
+    {
+        remoteCandidateCount = Ice_GetValidRemoteCandidateCount( pIceAgent );
+    }
 
-    for( i = 0; ( ( i < Ice_GetValidRemoteCandidateCount( pIceAgent ) ) && ( retStatus == ICE_RESULT_OK ) ); i++ )
+    for( i = 0; ( ( i < remoteCandidateCount ) && ( retStatus == ICE_RESULT_OK ) ); i++ )
     {
         retStatus = Ice_CreateCandidatePair( pIceAgent,
                                              pCandidate,
@@ -362,6 +1235,79 @@ IceResult_t Ice_UpdateSrflxCandidateAddress( IceAgent_t * pIceAgent,
 
 /*------------------------------------------------------------------------------------------------------------------*/
 
+/* Ice_ReadUint16 / Ice_ReadUint32 - Read a big-endian ( network order ) value from a received buffer. */
+
+static uint16_t Ice_ReadUint16( const uint8_t * pBuffer )
+{
+    return ( uint16_t ) ( ( ( uint16_t ) pBuffer[ 0 ] << 8 ) | pBuffer[ 1 ] );
+}
+
+static uint32_t Ice_ReadUint32( const uint8_t * pBuffer )
+{
+    return ( ( uint32_t ) pBuffer[ 0 ] << 24 ) | ( ( uint32_t ) pBuffer[ 1 ] << 16 ) |
+           ( ( uint32_t ) pBuffer[ 2 ] << 8 ) | ( uint32_t ) pBuffer[ 3 ];
+}
+
+/* Ice_WriteUint16 / Ice_WriteUint32 - Write a value in big-endian ( network order ) into an outbound buffer. */
+
+static void Ice_WriteUint16( uint8_t * pBuffer,
+                             uint16_t value )
+{
+    pBuffer[ 0 ] = ( uint8_t ) ( value >> 8 );
+    pBuffer[ 1 ] = ( uint8_t ) value;
+}
+
+static void Ice_WriteUint32( uint8_t * pBuffer,
+                             uint32_t value )
+{
+    pBuffer[ 0 ] = ( uint8_t ) ( value >> 24 );
+    pBuffer[ 1 ] = ( uint8_t ) ( value >> 16 );
+    pBuffer[ 2 ] = ( uint8_t ) ( value >> 8 );
+    pBuffer[ 3 ] = ( uint8_t ) value;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_AppendIntegrityAndFingerprint - Ends a STUN message whose attributes fill the first messageLength bytes of
+ * pStunMessageBuffer with MESSAGE-INTEGRITY, keyed with pIntegrityKey, and FINGERPRINT, and sets the header length.
+ * The buffer must have ICE_STUN_MESSAGE_TRAILER_LENGTH bytes of room after messageLength.
+ * Returns the total message length. */
+
+size_t Ice_AppendIntegrityAndFingerprint( const IceHmacSha1Key_t * pIntegrityKey,
+                                          uint8_t * pStunMessageBuffer,
+                                          size_t messageLength )
+{
+    size_t offset = messageLength;
+
+    /* The length field covers MESSAGE-INTEGRITY while it is computed, and FINGERPRINT while the CRC is computed. */
+    Ice_WriteUint16( pStunMessageBuffer + 2,
+                     ( uint16_t ) ( offset - STUN_HEADER_LENGTH + STUN_ATTRIBUTE_HEADER_LENGTH + STUN_HMAC_VALUE_LENGTH ) );
+    Ice_HmacSha1( pIntegrityKey,
+                  pStunMessageBuffer,
+                  offset,
+                  pStunMessageBuffer + offset + STUN_ATTRIBUTE_HEADER_LENGTH );
+    Ice_WriteUint16( pStunMessageBuffer + offset,
+                     STUN_ATTRIBUTE_TYPE_MESSAGE_INTEGRITY );
+    Ice_WriteUint16( pStunMessageBuffer + offset + 2,
+                     STUN_HMAC_VALUE_LENGTH );
+    offset += STUN_ATTRIBUTE_HEADER_LENGTH + STUN_HMAC_VALUE_LENGTH;
+
+    Ice_WriteUint16( pStunMessageBuffer + 2,
+                     ( uint16_t ) ( offset - STUN_HEADER_LENGTH + STUN_ATTRIBUTE_HEADER_LENGTH + sizeof( uint32_t ) ) );
+    Ice_WriteUint32( pStunMessageBuffer + offset + STUN_ATTRIBUTE_HEADER_LENGTH,
+                     Ice_Crc32( 0,
+                                pStunMessageBuffer,
+                                offset ) ^ STUN_ATTRIBUTE_FINGERPRINT_XOR_VALUE );
+    Ice_WriteUint16( pStunMessageBuffer + offset,
+                     STUN_ATTRIBUTE_TYPE_FINGERPRINT );
+    Ice_WriteUint16( pStunMessageBuffer + offset + 2,
+                     sizeof( uint32_t ) );
+
+    return offset + STUN_ATTRIBUTE_HEADER_LENGTH + sizeof( uint32_t );
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
 /* Ice_InitializeStunPacket - This API populates the Stun packet, whose memory has been allocated by the application.
  *  4 types of packets need to be created:
  *   1. Send Srflx Request
@@ -372,12 +1318,12 @@ IceResult_t Ice_UpdateSrflxCandidateAddress( IceAgent_t * pIceAgent,
 IceResult_t Ice_InitializeStunPacket( StunContext_t * pStunCxt,
                                       uint8_t * transactionId,
                                       uint8_t * pStunMessageBuffer,
+                                      size_t stunMessageBufferLength,
                                       StunHeader_t * pStunHeader,
                                       uint8_t isGenerateTransactionID,
                                       uint8_t isStunBindingRequest )
 {
     IceResult_t retStatus = ICE_RESULT_OK;
-    int i;
 
     if( pStunMessageBuffer == NULL )
     {
@@ -404,19 +1350,10 @@ IceResult_t Ice_InitializeStunPacket( StunContext_t * pStunCxt,
          *  b. 1 --> Populate values with randomized values.
          *  c. 2 --> Populate values with randomized values, for creating Srflx request.
          */
-        if( isGenerateTransactionID == 2 )
+        if( ( isGenerateTransactionID == 1 ) || ( isGenerateTransactionID == 2 ) )
         {
-            for( i = 0; i < STUN_HEADER_TRANSACTION_ID_LENGTH; i++ )
-            {
-                pStunHeader->pTransactionId[ i ] = ( uint8_t )( rand() % 0x100 );
-            }
-        }
-        else if( isGenerateTransactionID == 1 )
-        {
-            for( i = 0; i < STUN_HEADER_TRANSACTION_ID_LENGTH; i++ )
-            {
-                pStunHeader->pTransactionId[ i ] = ( uint8_t )( rand() % 0xFF );
-            }
+            retStatus = Ice_RandomFillThreadLocal( pStunHeader->pTransactionId,
+                                                   STUN_HEADER_TRANSACTION_ID_LENGTH );
         }
         else if( isGenerateTransactionID == 0 )
         {
@@ -424,12 +1361,15 @@ IceResult_t Ice_InitializeStunPacket( StunContext_t * pStunCxt,
                     &( transactionId[ 0 ] ),
                     STUN_HEADER_TRANSACTION_ID_LENGTH );
         }
+    }
 
-        /* Create a STUN message. */
-        retStatus = StunSerializer_Init( pStunCxt,
-                                         pStunMessageBuffer,
-                                         1024, //Keeping the  STUN packet buffer size = 1024 , if required, the size can be dynamic as well.
-                                         pStunHeader );
+    /* Create a STUN message. */
+    if( retStatus == ICE_RESULT_OK )
+    {
+        retStatus = ( IceResult_t ) StunSerializer_Init( pStunCxt,
+                                                         pStunMessageBuffer,
+                                                         stunMessageBufferLength,
+                                                         pStunHeader );
     }
 
     return retStatus;
@@ -437,62 +1377,61 @@ IceResult_t Ice_InitializeStunPacket( StunContext_t * pStunCxt,
 
 /*------------------------------------------------------------------------------------------------------------------*/
 
-/* Ice_PackageStunPacket - This API takes care of the serialization of the Stun Packet and appends the requited attributes .*/
+/* Ice_PackageStunPacket - This API takes care of the serialization of the Stun Packet and appends the requited attributes .
+ * MESSAGE-INTEGRITY is added when pIntegrityKey is given, computed from the precomputed HMAC key state of the password. */
 
 IceResult_t Ice_PackageStunPacket( StunContext_t * pStunCxt,
-                                   uint8_t * password,
-                                   uint32_t passwordLen )
+                                   const IceHmacSha1Key_t * pIntegrityKey )
 {
     IceResult_t retStatus = ICE_RESULT_OK;
     uint8_t * pIntBuffer;
     uint8_t * pFinBuffer;
     uint8_t messageIntegrity[STUN_HMAC_VALUE_LENGTH];
-    uint32_t hmacLen, crc32, stunMessageLength;
+    uint32_t crc32, stunMessageLength;
     uint16_t bufferLength;
 
-    if( ( ( password == NULL ) && ( passwordLen > 0 ) ) || ( ( password != NULL ) && ( passwordLen == 0 ) ) )
-    {
-        retStatus = ICE_RESULT_BAD_PARAM;
-    }
-
     //Add Integrity attribute
-    if( ( retStatus == ICE_RESULT_OK ) && ( password != NULL ) )
+    if( pIntegrityKey != NULL )
     {
-        retStatus = StunSerializer_GetIntegrityBuffer( pStunCxt,
-                                                       &pIntBuffer,
-                                                       &bufferLength );
+        retStatus = ( IceResult_t ) StunSerializer_GetIntegrityBuffer( pStunCxt,
+                                                                       &pIntBuffer,
+                                                                       &bufferLength );
 
         if( ( pIntBuffer != NULL ) && ( retStatus == ICE_RESULT_OK ) )
         {
-            //hmac_function(password, (int32_t) passwordLen, pIntBuffer, bufferLength, messageIntegrity, &hmacLen); 
-            //compute HMAC using a function pointer, with the function defined in the application.
+            Ice_HmacSha1( pIntegrityKey,
+                          pIntBuffer,
+                          bufferLength,
+                          messageIntegrity );
+
+            retStatus = ( IceResult_t ) StunSerializer_AddAttributeIntegrity( pStunCxt,
+                                                                              messageIntegrity,
+                                                                              STUN_HMAC_VALUE_LENGTH );
         }
-
-        retStatus = StunSerializer_AddAttributeIntegrity( pStunCxt,
-                                                          messageIntegrity,
-                                                          STUN_HMAC_VALUE_LENGTH );
     }
 
     //Add Fingerprint attribute
     if( retStatus == ICE_RESULT_OK )
     {
-        retStatus = StunSerializer_GetFingerprintBuffer( pStunCxt,
-                                                         &pFinBuffer,
-                                                         &bufferLength );
+        retStatus = ( IceResult_t ) StunSerializer_GetFingerprintBuffer( pStunCxt,
+                                                                         &pFinBuffer,
+                                                                         &bufferLength );
 
         if( ( pFinBuffer != NULL ) && ( retStatus == ICE_RESULT_OK ) )
         {
-            //crc32 = crcFunction( pFinBuffer, bufferLength ); 
-            //compute CRC using a function pointer, with the function defined in the application.
+            crc32 = Ice_Crc32( 0,
+                               pFinBuffer,
+                               bufferLength );
+
+            retStatus = ( IceResult_t ) StunSerializer_AddAttributeFingerprint( pStunCxt,
+                                                                                crc32 );
         }
-        retStatus = StunSerializer_AddAttributeFingerprint( pStunCxt,
-                                                            crc32 );
     }
 
     if( retStatus == ICE_RESULT_OK )
     {
-        retStatus = StunSerializer_Finalize( pStunCxt,
-                                             &( stunMessageLength ) );
+        retStatus = ( IceResult_t ) StunSerializer_Finalize( pStunCxt,
+                                                             &( stunMessageLength ) );
     }
 
     return retStatus;
@@ -500,6 +1439,18 @@ IceResult_t Ice_PackageStunPacket( StunContext_t * pStunCxt,
 
 /*------------------------------------------------------------------------------------------------------------------*/
 
+/* Ice_GenerateTransactionId - Fills pTransactionIdBuffer with the ID of a new transaction. */
+
+static void Ice_GenerateTransactionId( IceAgent_t * pIceAgent,
+                                       uint8_t * pTransactionIdBuffer )
+{
+    Ice_RandomFill( &( pIceAgent->random ),
+                    pTransactionIdBuffer,
+                    STUN_HEADER_TRANSACTION_ID_LENGTH );
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
 /* Ice_CreateRequestForSrflxCandidate - This API creates Stun Packet for sending Srflx candidate request to ICE STUN server. */
 
 IceResult_t Ice_CreateRequestForSrflxCandidate( IceAgent_t * pIceAgent,
@@ -510,21 +1461,36 @@ IceResult_t Ice_CreateRequestForSrflxCandidate( IceAgent_t * pIceAgent,
     StunContext_t pStunCxt;
     StunHeader_t pStunHeader;
 
+    Ice_GenerateTransactionId( pIceAgent,
+                               pTransactionIdBuffer );
+
     retStatus = Ice_InitializeStunPacket( &pStunCxt,
                                           pTransactionIdBuffer,
                                           pStunMessageBuffer,
+                                          pIceAgent->stunMessageBufferSize,
                                           &pStunHeader,
-                                          2,
+                                          0,
                                           1 );
 
     if( retStatus == ICE_RESULT_OK )
     {
-        Ice_TransactionIdStoreInsert( pIceAgent->pStunBindingRequestTransactionIdStore,
-                                      pStunHeader.pTransactionId );
+        retStatus = Ice_TransactionIdStoreInsert( &( pIceAgent->stunBindingRequestTransactionIdStore ),
+                                                  pStunHeader.pTransactionId,
+                                                  ICE_TRANSACTION_PURPOSE_SRFLX_REQUEST,
+                                                  NULL,
+                                                  NULL,
+                                                  pIceAgent->currentTime );
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        pIceAgent->stats.requestsSent++;
+    }
 
+    if( retStatus == ICE_RESULT_OK )
+    {
         retStatus = Ice_PackageStunPacket( &pStunCxt,
-                                           NULL,
-                                           0 );
+                                           NULL );
     }
 
     return retStatus;
@@ -532,417 +1498,2043 @@ IceResult_t Ice_CreateRequestForSrflxCandidate( IceAgent_t * pIceAgent,
 
 /*------------------------------------------------------------------------------------------------------------------*/
 
-/* Ice_CreateRequestForNominatingValidCandidatePair - This API creates Stun Packet for nomination of the valid candidate Pair sent by the Controlling ICE agent. */
+/* Ice_CountCheckSent - Counts a connectivity check or nomination sent for the first time. The first one starts the
+ * timeToConnect measurement. */
 
-IceResult_t Ice_CreateRequestForNominatingValidCandidatePair( IceAgent_t * pIceAgent,
-                                                              uint8_t * pStunMessageBuffer,
-                                                              IceCandidatePair_t * pIceCandidatePair,
-                                                              uint8_t * pTransactionIdBuffer )
+static void Ice_CountCheckSent( IceAgent_t * pIceAgent )
 {
-    IceResult_t retStatus = ICE_RESULT_OK;
-    StunContext_t pStunCxt;
-    StunHeader_t pStunHeader;
-
-    retStatus = Ice_InitializeStunPacket( &pStunCxt,
-                                          pTransactionIdBuffer,
-                                          pStunMessageBuffer,
-                                          &pStunHeader,
-                                          1,
-                                          1 );
+    pIceAgent->stats.requestsSent++;
 
-    if( retStatus == ICE_RESULT_OK )
+    if( pIceAgent->connectPhase == ICE_CONNECT_PHASE_IDLE )
     {
-        retStatus = StunSerializer_AddAttributeUsername( &pStunCxt,
-                                                         pIceAgent->combinedUserName,
-                                                         strlen( pIceAgent->combinedUserName ) );
+        pIceAgent->connectPhase = ICE_CONNECT_PHASE_CHECKING;
+        pIceAgent->connectStartTime = pIceAgent->currentTime;
     }
+}
 
-    if( retStatus == ICE_RESULT_OK )
-    {
-        retStatus = StunSerializer_AddAttributePriority( &pStunCxt,
-                                                         pIceCandidatePair->local->priority );
-    }
+/*------------------------------------------------------------------------------------------------------------------*/
 
-    if( retStatus == ICE_RESULT_OK )
-    {
-        retStatus = StunSerializer_AddAttributeIceControlling( &pStunCxt,
-                                                               pIceAgent->tieBreaker );
-    }
+/* Ice_SetCandidatePairState - Moves a pair to a new state, counting the transition. The first pair nominated or
+ * succeeded ends the timeToConnect measurement. */
 
-    if( retStatus == ICE_RESULT_OK )
-    {
-        retStatus = StunSerializer_AddAttributeUseCandidate( &pStunCxt );
-    }
+static void Ice_SetCandidatePairState( IceAgent_t * pIceAgent,
+                                       IceCandidatePair_t * pIceCandidatePair,
+                                       IceCandidatePairState_t state )
+{
+    pIceCandidatePair->state = state;
+    pIceAgent->stats.pairStateTransitions[ state ]++;
 
-    if( retStatus == ICE_RESULT_OK )
+    if( ( ( state == ICE_CANDIDATE_PAIR_STATE_NOMINATED ) || ( state == ICE_CANDIDATE_PAIR_STATE_SUCCEEDED ) ) &&
+        ( pIceAgent->connectPhase == ICE_CONNECT_PHASE_CHECKING ) )
     {
-        retStatus = Ice_PackageStunPacket( &pStunCxt,
-                                           ( uint8_t * ) pIceAgent->remotePassword,
-                                           ( uint32_t ) strlen( pIceAgent->remotePassword ) * sizeof( char ) );
+        pIceAgent->connectPhase = ICE_CONNECT_PHASE_CONNECTED;
+        Ice_HistogramRecord( &( pIceAgent->stats.timeToConnect ),
+                             ( pIceAgent->currentTime > pIceAgent->connectStartTime ) ? ( pIceAgent->currentTime - pIceAgent->connectStartTime ) : 0 );
     }
-
-    return retStatus;
-
 }
 
 /*------------------------------------------------------------------------------------------------------------------*/
 
-/* Ice_CreateRequestForConnectivityCheck - This API creates Stun Packet for connectivity check to the remote candidate . */
+/* Ice_UpdatePairRtt - Folds one round trip time sample, in milliseconds, into the smoothed RTT and RTT variation of a
+ * pair with the RFC 6298 gains ( alpha 1/8, beta 1/4 ), and counts it in the agent's pairRtt histogram. */
 
-IceResult_t Ice_CreateRequestForConnectivityCheck( IceAgent_t * pIceAgent,
-                                                   uint8_t * pStunMessageBuffer,
-                                                   uint8_t * pTransactionIdBuffer )
+static void Ice_UpdatePairRtt( IceAgent_t * pIceAgent,
+                               IceCandidatePair_t * pIceCandidatePair,
+                               uint64_t rtt )
 {
-    IceResult_t retStatus = ICE_RESULT_OK;
-    StunContext_t pStunCxt;
-    StunHeader_t pStunHeader;
-
-    retStatus = Ice_InitializeStunPacket( &pStunCxt,
-                                          pTransactionIdBuffer,
-                                          pStunMessageBuffer,
-                                          &pStunHeader,
-                                          1,
-                                          1 );
+    uint32_t sample = ( uint32_t ) ( ( rtt < ICE_MAX_RTT_SAMPLE_MS ) ? rtt : ICE_MAX_RTT_SAMPLE_MS ) * 1000;
+    uint32_t delta;
 
-    if( retStatus == ICE_RESULT_OK )
+    if( pIceCandidatePair->rttSampleCount == 0 )
     {
-        retStatus = StunSerializer_AddAttributeUsername( &pStunCxt,
-                                                         pIceAgent->combinedUserName,
-                                                         strlen( pIceAgent->combinedUserName ) );
+        pIceCandidatePair->smoothedRtt = sample;
+        pIceCandidatePair->rttVariation = sample / 2;
     }
-
-    if( retStatus == ICE_RESULT_OK )
+    else
     {
-        retStatus = StunSerializer_AddAttributePriority( &pStunCxt,
-                                                         0 );
+        delta = ( pIceCandidatePair->smoothedRtt > sample ) ? ( pIceCandidatePair->smoothedRtt - sample ) :
+                ( sample - pIceCandidatePair->smoothedRtt );
+        pIceCandidatePair->rttVariation = pIceCandidatePair->rttVariation - ( pIceCandidatePair->rttVariation / 4 ) + ( delta / 4 );
+        pIceCandidatePair->smoothedRtt = pIceCandidatePair->smoothedRtt - ( pIceCandidatePair->smoothedRtt / 8 ) + ( sample / 8 );
     }
 
-    if( retStatus == ICE_RESULT_OK )
-    {
-        if( pIceAgent->isControlling == 0 )
-        {
-            retStatus = StunSerializer_AddAttributeIceControlled( &pStunCxt,
-                                                                  pIceAgent->tieBreaker );
-        }
-        else
-        {
-            retStatus = StunSerializer_AddAttributeIceControlling( &pStunCxt,
-                                                                   pIceAgent->tieBreaker );
-        }
-    }
+    pIceCandidatePair->rttSampleCount++;
 
-    if( retStatus == ICE_RESULT_OK )
-    {
-        retStatus = Ice_PackageStunPacket( &pStunCxt,
-                                           ( uint8_t * ) pIceAgent->remotePassword,
-                                           ( uint32_t ) strlen( pIceAgent->remotePassword ) * sizeof( char ) );
-    }
+    Ice_HistogramRecord( &( pIceAgent->stats.pairRtt ),
+                         rtt );
+}
 
-    return retStatus;
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_InvalidateRequestTemplates - Drops the pre-encoded binding requests of both roles, they are rebuilt on next use.
+ * Ice_SetRemoteCredentials calls it when combinedUserName changes. Role and tie-breaker changes are picked up on their own. */
+
+void Ice_InvalidateRequestTemplates( IceAgent_t * pIceAgent )
+{
+    pIceAgent->requestTemplates[ 0 ].length = 0;
+    pIceAgent->requestTemplates[ 1 ].length = 0;
 }
+
 /*------------------------------------------------------------------------------------------------------------------*/
 
-/* Ice_CreateResponseForRequest - This API creates Stun Packet for response to a Stun Binding Request. */
+/* Ice_GetRequestTemplate - Returns the binding request template of a role, building it through the serializer when it is
+ * not built yet or encodes an outdated tie-breaker. The PRIORITY value is located with the receive path's attribute walk. */
 
-IceResult_t Ice_CreateResponseForRequest( IceAgent_t * pIceAgent,
-                                          uint8_t * pStunMessageBuffer,
-                                          IceIPAddress_t * pSrcAddr,
-                                          uint8_t * pTransactionIdBuffer )
+static IceRequestTemplate_t * Ice_GetRequestTemplate( IceAgent_t * pIceAgent,
+                                                      uint32_t isControlling )
 {
     IceResult_t retStatus = ICE_RESULT_OK;
-    StunContext_t pStunCxt;
-    StunHeader_t pStunHeader;
-    StunAttributeAddress_t pStunMappedAddress = pSrcAddr->ipAddress;
-
-    if( ( pIceAgent == NULL ) ||
-        ( pStunMessageBuffer == NULL ) )
+    IceRequestTemplate_t * pTemplate = &( pIceAgent->requestTemplates[ isControlling != 0 ] );
+    StunContext_t stunCxt;
+    StunHeader_t stunHeader;
+    IceStunAttributeTable_t attributeTable;
+    uint8_t transactionId[ STUN_HEADER_TRANSACTION_ID_LENGTH ] = { 0 };
+    uint32_t templateLength = 0;
+
+    if( ( pTemplate->length == 0 ) ||
+        ( pTemplate->tieBreaker != pIceAgent->tieBreaker ) )
     {
-        retStatus = ICE_RESULT_BAD_PARAM;
-    }
+        pTemplate->length = 0;
 
-    if( retStatus == ICE_RESULT_OK )
+        stunHeader.messageType = STUN_MESSAGE_TYPE_BINDING_REQUEST;
+        stunHeader.pTransactionId = transactionId;
+
+        retStatus = ( IceResult_t ) StunSerializer_Init( &stunCxt,
+                                                         pTemplate->buffer,
+                                                         sizeof( pTemplate->buffer ),
+                                                         &stunHeader );
+
+        if( retStatus == ICE_RESULT_OK )
+        {
+            retStatus = ( IceResult_t ) StunSerializer_AddAttributeUsername( &stunCxt,
+                                                                             pIceAgent->combinedUserName,
+                                                                             pIceAgent->combinedUserNameLength );
+        }
+
+        if( retStatus == ICE_RESULT_OK )
+        {
+            retStatus = ( IceResult_t ) StunSerializer_AddAttributePriority( &stunCxt,
+                                                                             0 );
+        }
+
+        if( retStatus == ICE_RESULT_OK )
+        {
+            if( isControlling == 0 )
+            {
+                retStatus = ( IceResult_t ) StunSerializer_AddAttributeIceControlled( &stunCxt,
+                                                                                      pIceAgent->tieBreaker );
+            }
+            else
+            {
+                retStatus = ( IceResult_t ) StunSerializer_AddAttributeIceControlling( &stunCxt,
+                                                                                       pIceAgent->tieBreaker );
+            }
+        }
+
+        if( retStatus == ICE_RESULT_OK )
+        {
+            retStatus = ( IceResult_t ) StunSerializer_Finalize( &stunCxt,
+                                                                 &( templateLength ) );
+        }
+
+        if( retStatus == ICE_RESULT_OK )
+        {
+            retStatus = ( IceResult_t ) StunDeserializer_Init( &stunCxt,
+                                                               pTemplate->buffer,
+                                                               templateLength,
+                                                               &stunHeader );
+        }
+
+        if( retStatus == ICE_RESULT_OK )
+        {
+            retStatus = Ice_DeserializeStunPacket( &stunCxt,
+                                                   &stunHeader,
+                                                   &attributeTable );
+        }
+
+        if( retStatus == ICE_RESULT_OK )
+        {
+            pTemplate->priorityOffset = attributeTable.valueOffsets[ ICE_STUN_ATTRIBUTE_INDEX_PRIORITY ];
+            pTemplate->tieBreaker = pIceAgent->tieBreaker;
+            pTemplate->length = ( uint16_t ) templateLength;
+        }
+    }
+
+    return ( pTemplate->length != 0 ) ? pTemplate : NULL;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_SerializeRequestFromTemplate - Writes a binding request of the given role into pStunMessageBuffer: the role's template
+ * is copied and the transaction ID and PRIORITY patched in, USE-CANDIDATE is appended for a nomination, followed by
+ * MESSAGE-INTEGRITY ( remote password ) and FINGERPRINT. */
+
+static IceResult_t Ice_SerializeRequestFromTemplate( IceAgent_t * pIceAgent,
+                                                     uint32_t isControlling,
+                                                     uint32_t priority,
+                                                     bool isNomination,
+                                                     uint8_t * pStunMessageBuffer,
+                                                     size_t stunMessageBufferLength,
+                                                     const uint8_t * pTransactionId )
+{
+    IceResult_t retStatus = ICE_RESULT_OK;
+    const IceRequestTemplate_t * pTemplate;
+    size_t offset;
+
+    pTemplate = Ice_GetRequestTemplate( pIceAgent,
+                                        isControlling );
+
+    if( pTemplate == NULL )
+    {
+        retStatus = ICE_RESULT_OUT_OF_MEMORY;
+    }
+    else if( stunMessageBufferLength < ( size_t ) pTemplate->length + STUN_ATTRIBUTE_HEADER_LENGTH + ICE_STUN_MESSAGE_TRAILER_LENGTH )
+    {
+        retStatus = ICE_RESULT_OUT_OF_MEMORY;
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        memcpy( pStunMessageBuffer,
+                pTemplate->buffer,
+                pTemplate->length );
+        memcpy( pStunMessageBuffer + STUN_HEADER_TRANSACTION_ID_OFFSET,
+                pTransactionId,
+                STUN_HEADER_TRANSACTION_ID_LENGTH );
+        Ice_WriteUint32( pStunMessageBuffer + pTemplate->priorityOffset,
+                         priority );
+        offset = pTemplate->length;
+
+        if( isNomination )
+        {
+            Ice_WriteUint16( pStunMessageBuffer + offset,
+                             STUN_ATTRIBUTE_TYPE_USE_CANDIDATE );
+            Ice_WriteUint16( pStunMessageBuffer + offset + 2,
+                             0 );
+            offset += STUN_ATTRIBUTE_HEADER_LENGTH;
+        }
+
+        ( void ) Ice_AppendIntegrityAndFingerprint( &( pIceAgent->remotePasswordKey ),
+                                                    pStunMessageBuffer,
+                                                    offset );
+    }
+
+    return retStatus;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_RecordRequestRole - Keeps the role and PRIORITY of the request just inserted in the store with its transaction,
+ * so its retransmissions repeat them even if the agent's role changes meanwhile. */
+
+static void Ice_RecordRequestRole( TransactionIdStore_t * pTransactionIdStore,
+                                   uint32_t isControlling,
+                                   uint32_t priority )
+{
+    IceTransaction_t * pTransaction = &( pTransactionIdStore->pTransactions[ pTransactionIdStore->newestTransactionIndex ] );
+
+    pTransaction->isControlling = ( uint8_t ) ( isControlling != 0 );
+    pTransaction->priority = priority;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_CreateRequestForNominatingValidCandidatePair - This API creates Stun Packet for nomination of the valid candidate Pair sent by the Controlling ICE agent. */
+
+IceResult_t Ice_CreateRequestForNominatingValidCandidatePair( IceAgent_t * pIceAgent,
+                                                              uint8_t * pStunMessageBuffer,
+                                                              IceCandidatePair_t * pIceCandidatePair,
+                                                              uint8_t * pTransactionIdBuffer )
+{
+    IceResult_t retStatus = ICE_RESULT_OK;
+
+    if( ( pIceAgent == NULL ) ||
+        ( pStunMessageBuffer == NULL ) ||
+        ( pIceCandidatePair == NULL ) ||
+        ( pTransactionIdBuffer == NULL ) )
+    {
+        retStatus = ICE_RESULT_BAD_PARAM;
+    }
+
+    /* Nominations are sent by the controlling agent. */
+    if( retStatus == ICE_RESULT_OK )
+    {
+        Ice_GenerateTransactionId( pIceAgent,
+                                   pTransactionIdBuffer );
+
+        retStatus = Ice_SerializeRequestFromTemplate( pIceAgent,
+                                                      1,
+                                                      pIceCandidatePair->local->priority,
+                                                      true,
+                                                      pStunMessageBuffer,
+                                                      pIceAgent->stunMessageBufferSize,
+                                                      pTransactionIdBuffer );
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        retStatus = Ice_TransactionIdStoreInsert( &( pIceAgent->stunBindingRequestTransactionIdStore ),
+                                                  pTransactionIdBuffer,
+                                                  ICE_TRANSACTION_PURPOSE_NOMINATION,
+                                                  pIceCandidatePair,
+                                                  pIceCandidatePair->local,
+                                                  pIceAgent->currentTime );
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        Ice_RecordRequestRole( &( pIceAgent->stunBindingRequestTransactionIdStore ),
+                               1,
+                               pIceCandidatePair->local->priority );
+        Ice_CountCheckSent( pIceAgent );
+    }
+
+    return retStatus;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_SelectPairToNominate - The controlling agent calls this API once checks have produced valid pairs
+ * ( ICE_RESULT_START_NOMINATION ) to pick the pair to nominate. With ICE_NOMINATION_POLICY_PRIORITY it is the valid
+ * pair of highest priority. With ICE_NOMINATION_POLICY_LOWEST_RTT it is, among the valid pairs whose priority is within
+ * nominationPriorityWindow percent of the highest, the one with the lowest smoothed RTT; pairs without an RTT sample
+ * are only picked when no pair of the window has one. Returns NULL when no pair is valid. */
+
+IceCandidatePair_t * Ice_SelectPairToNominate( IceAgent_t * pIceAgent )
+{
+    IceCandidatePair_t * pSelectedPair = NULL;
+    IceCandidatePair_t * pIceCandidatePair;
+    uint64_t highestPriority = 0;
+    uint64_t lowestPriority;
+    uint32_t i;
+
+    if( pIceAgent != NULL )
+    {
+        for( i = 0; i < pIceAgent->iceCandidatePairCount; i++ )
+        {
+            pIceCandidatePair = &( pIceAgent->iceCandidatePairs[ i ] );
+
+            if( ( pIceCandidatePair->state == ICE_CANDIDATE_PAIR_STATE_VALID ) &&
+                ( ( pSelectedPair == NULL ) || ( pIceCandidatePair->priority > highestPriority ) ) )
+            {
+                pSelectedPair = pIceCandidatePair;
+                highestPriority = pIceCandidatePair->priority;
+            }
+        }
+
+        if( ( pSelectedPair != NULL ) && ( pIceAgent->nominationPolicy == ICE_NOMINATION_POLICY_LOWEST_RTT ) )
+        {
+            lowestPriority = highestPriority - ( highestPriority / 100 ) * pIceAgent->nominationPriorityWindow;
+
+            for( i = 0; i < pIceAgent->iceCandidatePairCount; i++ )
+            {
+                pIceCandidatePair = &( pIceAgent->iceCandidatePairs[ i ] );
+
+                if( ( pIceCandidatePair->state != ICE_CANDIDATE_PAIR_STATE_VALID ) ||
+                    ( pIceCandidatePair->priority < lowestPriority ) ||
+                    ( pIceCandidatePair->rttSampleCount == 0 ) )
+                {
+                    continue;
+                }
+
+                if( ( pSelectedPair->rttSampleCount == 0 ) ||
+                    ( pIceCandidatePair->smoothedRtt < pSelectedPair->smoothedRtt ) ||
+                    ( ( pIceCandidatePair->smoothedRtt == pSelectedPair->smoothedRtt ) &&
+                      ( pIceCandidatePair->priority > pSelectedPair->priority ) ) )
+                {
+                    pSelectedPair = pIceCandidatePair;
+                }
+            }
+        }
+    }
+
+    return pSelectedPair;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_GetCandidatePairRtt - Reads the smoothed RTT and RTT variation ( jitter ) measured on a pair, in microseconds.
+ * Either output may be NULL. Returns ICE_RESULT_NO_RTT_SAMPLE until a check on the pair was answered on its first send. */
+
+IceResult_t Ice_GetCandidatePairRtt( const IceCandidatePair_t * pIceCandidatePair,
+                                     uint32_t * pSmoothedRtt,
+                                     uint32_t * pRttVariation )
+{
+    IceResult_t retStatus = ICE_RESULT_OK;
+
+    if( pIceCandidatePair == NULL )
+    {
+        retStatus = ICE_RESULT_BAD_PARAM;
+    }
+    else if( pIceCandidatePair->rttSampleCount == 0 )
+    {
+        retStatus = ICE_RESULT_NO_RTT_SAMPLE;
+    }
+    else
+    {
+        if( pSmoothedRtt != NULL )
+        {
+            *pSmoothedRtt = pIceCandidatePair->smoothedRtt;
+        }
+
+        if( pRttVariation != NULL )
+        {
+            *pRttVariation = pIceCandidatePair->rttVariation;
+        }
+    }
+
+    return retStatus;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_ComputeCheckPriority - PRIORITY of a connectivity check: the priority the local candidate would have as a
+ * peer reflexive candidate ( RFC 8445 section 7.1.1 ). */
+
+static uint32_t Ice_ComputeCheckPriority( const IceCandidate_t * pLocalCandidate )
+{
+    IceCandidate_t peerReflexiveCandidate = *pLocalCandidate;
+
+    peerReflexiveCandidate.iceCandidateType = ICE_CANDIDATE_TYPE_PEER_REFLEXIVE;
+
+    return Ice_ComputeCandidatePriority( &peerReflexiveCandidate );
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_CreateRequestForConnectivityCheck - This API creates Stun Packet for connectivity check to the remote candidate .
+ * The request is not tied to a pair, its PRIORITY is computed from the first local candidate. */
+
+IceResult_t Ice_CreateRequestForConnectivityCheck( IceAgent_t * pIceAgent,
+                                                   uint8_t * pStunMessageBuffer,
+                                                   uint8_t * pTransactionIdBuffer )
+{
+    IceResult_t retStatus = ICE_RESULT_OK;
+    IceCandidate_t localCandidate;
+
+    if( ( pIceAgent == NULL ) ||
+        ( pStunMessageBuffer == NULL ) ||
+        ( pTransactionIdBuffer == NULL ) )
+    {
+        retStatus = ICE_RESULT_BAD_PARAM;
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        /* Without a local candidate yet, the priority of a peer reflexive candidate on a regular interface is sent. */
+        memset( &localCandidate, 0, sizeof( IceCandidate_t ) );
+
+        if( pIceAgent->localCandidateCount > 0 )
+        {
+            localCandidate = pIceAgent->localCandidates[ 0 ];
+        }
+
+        Ice_GenerateTransactionId( pIceAgent,
+                                   pTransactionIdBuffer );
+
+        retStatus = Ice_SerializeRequestFromTemplate( pIceAgent,
+                                                      pIceAgent->isControlling,
+                                                      Ice_ComputeCheckPriority( &localCandidate ),
+                                                      false,
+                                                      pStunMessageBuffer,
+                                                      pIceAgent->stunMessageBufferSize,
+                                                      pTransactionIdBuffer );
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        retStatus = Ice_TransactionIdStoreInsert( &( pIceAgent->stunBindingRequestTransactionIdStore ),
+                                                  pTransactionIdBuffer,
+                                                  ICE_TRANSACTION_PURPOSE_CONNECTIVITY_CHECK,
+                                                  NULL,
+                                                  NULL,
+                                                  pIceAgent->currentTime );
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        Ice_CountCheckSent( pIceAgent );
+    }
+
+    return retStatus;
+}
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_SerializeConnectivityCheck - Writes the binding request checking one candidate pair into pStunMessageBuffer. */
+
+static IceResult_t Ice_SerializeConnectivityCheck( IceAgent_t * pIceAgent,
+                                                   IceCandidatePair_t * pIceCandidatePair,
+                                                   uint8_t * pStunMessageBuffer,
+                                                   size_t stunMessageBufferLength,
+                                                   uint8_t * pTransactionIdBuffer )
+{
+    IceResult_t retStatus = ICE_RESULT_OK;
+    uint32_t priority = Ice_ComputeCheckPriority( pIceCandidatePair->local );
+
+    Ice_GenerateTransactionId( pIceAgent,
+                               pTransactionIdBuffer );
+
+    retStatus = Ice_SerializeRequestFromTemplate( pIceAgent,
+                                                  pIceAgent->isControlling,
+                                                  priority,
+                                                  false,
+                                                  pStunMessageBuffer,
+                                                  stunMessageBufferLength,
+                                                  pTransactionIdBuffer );
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        retStatus = Ice_TransactionIdStoreInsert( &( pIceAgent->stunBindingRequestTransactionIdStore ),
+                                                  pTransactionIdBuffer,
+                                                  ICE_TRANSACTION_PURPOSE_CONNECTIVITY_CHECK,
+                                                  pIceCandidatePair,
+                                                  pIceCandidatePair->local,
+                                                  pIceAgent->currentTime );
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        Ice_RecordRequestRole( &( pIceAgent->stunBindingRequestTransactionIdStore ),
+                               pIceAgent->isControlling,
+                               priority );
+        Ice_CountCheckSent( pIceAgent );
+    }
+
+    return retStatus;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_CreateConnectivityChecks - The application calls this API to generate the connectivity checks for the waiting
+ * candidate pairs in one pass, highest priority first. The messages are written back to back into pPacketArena and
+ * described by pPackets, ready to be handed to sendmmsg or io_uring. Generation stops when maxPacketCount checks were
+ * written, the arena cannot hold another message or no pair is waiting; pairs not reached stay on the check list. */
+
+IceResult_t Ice_CreateConnectivityChecks( IceAgent_t * pIceAgent,
+                                          uint8_t * pPacketArena,
+                                          size_t packetArenaSize,
+                                          IceOutboundPacket_t * pPackets,
+                                          uint32_t maxPacketCount,
+                                          uint32_t * pPacketCount )
+{
+    IceResult_t retStatus = ICE_RESULT_OK;
+    IceCandidatePair_t * pIceCandidatePair;
+    IceOutboundPacket_t * pPacket;
+    uint8_t transactionId[ STUN_HEADER_TRANSACTION_ID_LENGTH ];
+    size_t offset = 0;
+    uint32_t packetCount = 0;
+
+    if( ( pIceAgent == NULL ) ||
+        ( pPacketArena == NULL ) ||
+        ( pPackets == NULL ) ||
+        ( pPacketCount == NULL ) )
+    {
+        retStatus = ICE_RESULT_BAD_PARAM;
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        while( ( retStatus == ICE_RESULT_OK ) &&
+               ( packetCount < maxPacketCount ) &&
+               ( packetArenaSize - offset >= pIceAgent->stunMessageBufferSize ) &&
+               ( ( pIceCandidatePair = Ice_CheckListPopNextWaitingPair( pIceAgent ) ) != NULL ) )
+        {
+            if( ( pIceCandidatePair->connectivityChecks & 1 ) != 0 )
+            {
+                /* A check of the pair is already outstanding ( e.g. a triggered check ), it stays WAITING until answered. */
+                continue;
+            }
+
+            retStatus = Ice_SerializeConnectivityCheck( pIceAgent,
+                                                        pIceCandidatePair,
+                                                        pPacketArena + offset,
+                                                        pIceAgent->stunMessageBufferSize,
+                                                        transactionId );
+
+            if( retStatus == ICE_RESULT_OK )
+            {
+                pIceCandidatePair->connectivityChecks |= 1 << 0;
+
+                pPacket = &( pPackets[ packetCount ] );
+                pPacket->destination = pIceCandidatePair->remote->ipAddress;
+                pPacket->localAddress = pIceCandidatePair->local->ipAddress;
+                pPacket->pIceCandidatePair = pIceCandidatePair;
+                pPacket->offset = ( uint32_t ) offset;
+                pPacket->length = ( uint32_t ) Ice_GetStunMessageLength( pPacketArena + offset );
+
+                offset += ICE_AGENT_MEMORY_ALIGN( pPacket->length );
+                packetCount++;
+            }
+            else
+            {
+                /* Keep the pair queued so it is checked on a later call. */
+                ( void ) Ice_CheckListPush( pIceAgent,
+                                            pIceCandidatePair );
+            }
+        }
+
+        *pPacketCount = packetCount;
+    }
+
+    return retStatus;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_Tick - The application calls this API with the current time in milliseconds whenever the deadline returned by
+ * the previous call is reached, and after adding remote candidates. Transactions past their timeout are aged out and, at
+ * most once every Ta ( checkPacingInterval ), the connectivity check of the highest priority waiting pair is written into
+ * pPacketArena and described in pPackets, as by Ice_CreateConnectivityChecks. A frozen pair at the head of the check list
+ * is unfrozen first, as no waiting pair can be picked before it ( RFC 8445 section 6.1.4.2 ).
+ * *pNextDeadline receives the time the agent needs its next tick, ICE_TIME_INFINITE when nothing is scheduled,
+ * so an application driving many agents can park each one on a timer instead of polling it. */
+
+IceResult_t Ice_Tick( IceAgent_t * pIceAgent,
+                      uint64_t currentTime,
+                      uint8_t * pPacketArena,
+                      size_t packetArenaSize,
+                      IceOutboundPacket_t * pPackets,
+                      uint32_t maxPacketCount,
+                      uint32_t * pPacketCount,
+                      uint64_t * pNextDeadline )
+{
+    IceResult_t retStatus = ICE_RESULT_OK;
+    IceCandidatePair_t * pTopPair;
+    const TransactionIdStore_t * pTransactionIdStore;
+    uint64_t nextDeadline = ICE_TIME_INFINITE;
+    uint32_t packetCount = 0;
+
+    if( ( pIceAgent == NULL ) ||
+        ( pPacketArena == NULL ) ||
+        ( packetArenaSize < pIceAgent->stunMessageBufferSize ) ||
+        ( pPackets == NULL ) ||
+        ( maxPacketCount == 0 ) ||
+        ( pPacketCount == NULL ) ||
+        ( pNextDeadline == NULL ) )
+    {
+        retStatus = ICE_RESULT_BAD_PARAM;
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        Ice_UpdateCurrentTime( pIceAgent,
+                               currentTime );
+
+        if( ( currentTime >= pIceAgent->nextCheckTime ) && ( pIceAgent->checkListCount > 0 ) )
+        {
+            pTopPair = &( pIceAgent->iceCandidatePairs[ pIceAgent->pCheckList[ 0 ] ] );
+
+            if( pTopPair->state == ICE_CANDIDATE_PAIR_STATE_FROZEN )
+            {
+                Ice_SetCandidatePairState( pIceAgent,
+                                           pTopPair,
+                                           ICE_CANDIDATE_PAIR_STATE_WAITING );
+            }
+
+            retStatus = Ice_CreateConnectivityChecks( pIceAgent,
+                                                      pPacketArena,
+                                                      packetArenaSize,
+                                                      pPackets,
+                                                      1,
+                                                      &packetCount );
+
+            if( packetCount > 0 )
+            {
+                pIceAgent->nextCheckTime = currentTime + pIceAgent->checkPacingInterval;
+            }
+        }
+
+        if( pIceAgent->checkListCount > 0 )
+        {
+            nextDeadline = ( pIceAgent->nextCheckTime > currentTime ) ? pIceAgent->nextCheckTime : currentTime;
+        }
+
+        /* Transactions share one timeout, the oldest one expires first. With a timer wheel they are timed by the wheel. */
+        pTransactionIdStore = &( pIceAgent->stunBindingRequestTransactionIdStore );
+
+        if( ( pTransactionIdStore->pTimerWheel == NULL ) &&
+            ( pTransactionIdStore->oldestTransactionIndex != ICE_TRANSACTION_INVALID_INDEX ) &&
+            ( pTransactionIdStore->pTransactions[ pTransactionIdStore->oldestTransactionIndex ].deadline < nextDeadline ) )
+        {
+            nextDeadline = pTransactionIdStore->pTransactions[ pTransactionIdStore->oldestTransactionIndex ].deadline;
+        }
+
+        *pPacketCount = packetCount;
+        *pNextDeadline = nextDeadline;
+    }
+
+    return retStatus;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_UpdateConnection - Publishes a nominated or succeeded pair in the agent's connection table, and withdraws it
+ * in any other state. A full table only costs the data path its fast lookup, the pair itself is unaffected. */
+
+static void Ice_UpdateConnection( IceAgent_t * pIceAgent,
+                                  IceCandidatePair_t * pIceCandidatePair )
+{
+    if( pIceAgent->pConnectionTable != NULL )
+    {
+        if( ( pIceCandidatePair->state == ICE_CANDIDATE_PAIR_STATE_NOMINATED ) ||
+            ( pIceCandidatePair->state == ICE_CANDIDATE_PAIR_STATE_SUCCEEDED ) )
+        {
+            ( void ) Ice_ConnectionTableInsert( pIceAgent->pConnectionTable,
+                                                &( pIceCandidatePair->local->ipAddress.ipAddress ),
+                                                &( pIceCandidatePair->remote->ipAddress.ipAddress ),
+                                                pIceAgent,
+                                                pIceCandidatePair );
+        }
+        else
+        {
+            Ice_ConnectionTableRemove( pIceAgent->pConnectionTable,
+                                       &( pIceCandidatePair->local->ipAddress.ipAddress ),
+                                       &( pIceCandidatePair->remote->ipAddress.ipAddress ) );
+        }
+    }
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_IsRetransmittedTransaction - Requests on a candidate pair are retransmitted, their destination is known. A server
+ * reflexive request is sent by the application to its STUN server, the agent only times it out. */
+
+static bool Ice_IsRetransmittedTransaction( const IceTransaction_t * pTransaction )
+{
+    return ( pTransaction->pIceCandidatePair != NULL ) &&
+           ( pTransaction->purpose != ICE_TRANSACTION_PURPOSE_SRFLX_REQUEST );
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_ScheduleTransactionTimer - Arms the timer of a transaction just sent for the first time. */
+
+static void Ice_ScheduleTransactionTimer( TransactionIdStore_t * pTransactionIdStore,
+                                          IceTransaction_t * pTransaction )
+{
+    Ice_TimerInit( &( pTransaction->timer ),
+                   pTransactionIdStore->pTimerContext );
+    pTransaction->rto = pTransactionIdStore->initialRto;
+    pTransaction->requestCount = 1;
+
+    Ice_TimerWheelSchedule( pTransactionIdStore->pTimerWheel,
+                            &( pTransaction->timer ),
+                            pTransaction->sendTime + ( Ice_IsRetransmittedTransaction( pTransaction ) ? pTransaction->rto :
+                                                       pTransactionIdStore->transactionTimeout ) );
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_SetTimerWheel - Hands the retransmission and timeout of the agent's transactions to pTimerWheel, usually shared by
+ * all the agents driven from one thread and serviced by Ice_HandleExpiredTimers. Outstanding transactions are armed as if
+ * just sent. NULL detaches the agent, its transactions are then aged out by Ice_UpdateCurrentTime again. */
+
+IceResult_t Ice_SetTimerWheel( IceAgent_t * pIceAgent,
+                               IceTimerWheel_t * pTimerWheel )
+{
+    IceResult_t retStatus = ICE_RESULT_OK;
+    TransactionIdStore_t * pTransactionIdStore;
+    uint32_t transactionIndex;
+
+    if( pIceAgent == NULL )
+    {
+        retStatus = ICE_RESULT_BAD_PARAM;
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        pTransactionIdStore = &( pIceAgent->stunBindingRequestTransactionIdStore );
+
+        for( transactionIndex = pTransactionIdStore->oldestTransactionIndex;
+             transactionIndex != ICE_TRANSACTION_INVALID_INDEX;
+             transactionIndex = pTransactionIdStore->pTransactions[ transactionIndex ].next )
+        {
+            if( pTransactionIdStore->pTimerWheel != NULL )
+            {
+                Ice_TimerWheelCancel( pTransactionIdStore->pTimerWheel,
+                                      &( pTransactionIdStore->pTransactions[ transactionIndex ].timer ) );
+            }
+
+            if( pTimerWheel != NULL )
+            {
+                pTransactionIdStore->pTimerWheel = pTimerWheel;
+                Ice_ScheduleTransactionTimer( pTransactionIdStore,
+                                              &( pTransactionIdStore->pTransactions[ transactionIndex ] ) );
+            }
+        }
+
+        pTransactionIdStore->pTimerWheel = pTimerWheel;
+        pTransactionIdStore->pTimerContext = pIceAgent;
+    }
+
+    return retStatus;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_SetConnectionTable - Makes the agent publish its nominated and succeeded pairs in pConnectionTable, usually shared
+ * by all the agents of the application, for the data path lookups of Ice_ConnectionTableLookup. Pairs already
+ * nominated are published now. NULL withdraws the agent's pairs, which the application must do before destroying it. */
+
+IceResult_t Ice_SetConnectionTable( IceAgent_t * pIceAgent,
+                                    IceConnectionTable_t * pConnectionTable )
+{
+    IceResult_t retStatus = ICE_RESULT_OK;
+    IceCandidatePair_t * pIceCandidatePair;
+    uint32_t i;
+
+    if( pIceAgent == NULL )
+    {
+        retStatus = ICE_RESULT_BAD_PARAM;
+    }
+
+    for( i = 0; ( retStatus == ICE_RESULT_OK ) && ( i < pIceAgent->iceCandidatePairCount ); i++ )
+    {
+        pIceCandidatePair = &( pIceAgent->iceCandidatePairs[ i ] );
+
+        if( ( pIceCandidatePair->state == ICE_CANDIDATE_PAIR_STATE_NOMINATED ) ||
+            ( pIceCandidatePair->state == ICE_CANDIDATE_PAIR_STATE_SUCCEEDED ) )
+        {
+            if( pIceAgent->pConnectionTable != NULL )
+            {
+                Ice_ConnectionTableRemove( pIceAgent->pConnectionTable,
+                                           &( pIceCandidatePair->local->ipAddress.ipAddress ),
+                                           &( pIceCandidatePair->remote->ipAddress.ipAddress ) );
+            }
+
+            if( pConnectionTable != NULL )
+            {
+                retStatus = Ice_ConnectionTableInsert( pConnectionTable,
+                                                       &( pIceCandidatePair->local->ipAddress.ipAddress ),
+                                                       &( pIceCandidatePair->remote->ipAddress.ipAddress ),
+                                                       pIceAgent,
+                                                       pIceCandidatePair );
+            }
+        }
+    }
+
+    if( pIceAgent != NULL )
+    {
+        pIceAgent->pConnectionTable = pConnectionTable;
+    }
+
+    return retStatus;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_HandleExpiredTimers - The application calls this API with the current time in milliseconds when the time returned
+ * by Ice_TimerWheelGetNextExpiry is reached. It serves the expired transaction timers of every agent on the wheel:
+ * a pair request not answered within its RTO is sent again with the same transaction ID, into pPacketArena and described
+ * in pPackets as by Ice_CreateConnectivityChecks, and its RTO doubled ( RFC 5389 section 7.2.1 ). After the last of
+ * maxRequestCount sends the agent waits ICE_FINAL_RESPONSE_WAIT_MULTIPLIER initial RTOs, then the transaction is dropped
+ * and its pair, unless another check validated it meanwhile, marked failed. When the arena or pPackets are full the remaining timers are served on the next call. */
+
+IceResult_t Ice_HandleExpiredTimers( IceTimerWheel_t * pTimerWheel,
+                                     uint64_t currentTime,
+                                     uint8_t * pPacketArena,
+                                     size_t packetArenaSize,
+                                     IceOutboundPacket_t * pPackets,
+                                     uint32_t maxPacketCount,
+                                     uint32_t * pPacketCount )
+{
+    IceResult_t retStatus = ICE_RESULT_OK;
+    IceTimer_t * pTimer;
+    IceAgent_t * pIceAgent;
+    IceTransaction_t * pTransaction;
+    IceCandidatePair_t * pIceCandidatePair;
+    IceOutboundPacket_t * pPacket;
+    TransactionIdStore_t * pTransactionIdStore;
+    size_t offset = 0;
+    uint32_t packetCount = 0;
+    uint64_t wait;
+
+    if( ( pTimerWheel == NULL ) ||
+        ( pPacketArena == NULL ) ||
+        ( pPackets == NULL ) ||
+        ( pPacketCount == NULL ) )
+    {
+        retStatus = ICE_RESULT_BAD_PARAM;
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        Ice_TimerWheelAdvance( pTimerWheel,
+                               currentTime );
+
+        while( ( packetCount < maxPacketCount ) &&
+               ( ( pTimer = Ice_TimerWheelPopExpired( pTimerWheel ) ) != NULL ) )
+        {
+            pIceAgent = ( IceAgent_t * ) pTimer->pContext;
+            pTransactionIdStore = &( pIceAgent->stunBindingRequestTransactionIdStore );
+            pTransaction = ( IceTransaction_t * ) ( ( uint8_t * ) pTimer - offsetof( IceTransaction_t, timer ) );
+            pIceCandidatePair = pTransaction->pIceCandidatePair;
+
+            if( Ice_IsRetransmittedTransaction( pTransaction ) &&
+                ( pTransaction->requestCount < pIceAgent->maxRequestCount ) )
+            {
+                if( packetArenaSize - offset < pIceAgent->stunMessageBufferSize )
+                {
+                    /* No room left, serve it on the next call. */
+                    Ice_TimerWheelSchedule( pTimerWheel,
+                                            pTimer,
+                                            currentTime );
+                    break;
+                }
+
+                /* Same role and PRIORITY as the first send, the agent may have switched roles since. */
+                retStatus = Ice_SerializeRequestFromTemplate( pIceAgent,
+                                                              pTransaction->isControlling,
+                                                              pTransaction->priority,
+                                                              pTransaction->purpose == ICE_TRANSACTION_PURPOSE_NOMINATION,
+                                                              pPacketArena + offset,
+                                                              pIceAgent->stunMessageBufferSize,
+                                                              pTransaction->transactionId );
+
+                if( retStatus != ICE_RESULT_OK )
+                {
+                    Ice_TransactionIdStoreRemove( pTransactionIdStore,
+                                                  pTransaction->transactionId );
+                    break;
+                }
+
+                pPacket = &( pPackets[ packetCount ] );
+                pPacket->destination = pIceCandidatePair->remote->ipAddress;
+                pPacket->localAddress = pIceCandidatePair->local->ipAddress;
+                pPacket->pIceCandidatePair = pIceCandidatePair;
+                pPacket->offset = ( uint32_t ) offset;
+                pPacket->length = ( uint32_t ) Ice_GetStunMessageLength( pPacketArena + offset );
+
+                offset += ICE_AGENT_MEMORY_ALIGN( pPacket->length );
+                packetCount++;
+
+                pTransaction->requestCount++;
+                pIceAgent->stats.retransmissions++;
+
+                if( pTransaction->requestCount == pIceAgent->maxRequestCount )
+                {
+                    wait = ( uint64_t ) pTransactionIdStore->initialRto * ICE_FINAL_RESPONSE_WAIT_MULTIPLIER;
+                }
+                else
+                {
+                    pTransaction->rto <<= 1;
+                    wait = pTransaction->rto;
+                }
+
+                Ice_TimerWheelSchedule( pTimerWheel,
+                                        pTimer,
+                                        currentTime + wait );
+            }
+            else
+            {
+                /* No response to any of the requests, give the transaction up. The pair fails only while its checks
+                 * are in progress, a pair another check already validated keeps its state. */
+                if( Ice_IsRetransmittedTransaction( pTransaction ) )
+                {
+                    pIceAgent->stats.transactionTimeouts++;
+
+                    if( ( pIceCandidatePair->state == ICE_CANDIDATE_PAIR_STATE_FROZEN ) ||
+                        ( pIceCandidatePair->state == ICE_CANDIDATE_PAIR_STATE_WAITING ) )
+                    {
+                        Ice_SetCandidatePairState( pIceAgent,
+                                                   pIceCandidatePair,
+                                                   ICE_CANDIDATE_PAIR_STATE_FAILED );
+                        Ice_UpdateConnection( pIceAgent,
+                                              pIceCandidatePair );
+                    }
+                }
+
+                Ice_TransactionIdStoreRemove( pTransactionIdStore,
+                                              pTransaction->transactionId );
+            }
+        }
+
+        *pPacketCount = packetCount;
+    }
+
+    return retStatus;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_CreateResponseForRequest - This API creates Stun Packet for response to a Stun Binding Request. */
+
+IceResult_t Ice_CreateResponseForRequest( IceAgent_t * pIceAgent,
+                                          uint8_t * pStunMessageBuffer,
+                                          IceIPAddress_t * pSrcAddr,
+                                          uint8_t * pTransactionIdBuffer )
+{
+    IceResult_t retStatus = ICE_RESULT_OK;
+    StunContext_t pStunCxt;
+    StunHeader_t pStunHeader;
+    StunAttributeAddress_t pStunMappedAddress = pSrcAddr->ipAddress;
+
+    if( ( pIceAgent == NULL ) ||
+        ( pStunMessageBuffer == NULL ) )
+    {
+        retStatus = ICE_RESULT_BAD_PARAM;
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        /* A response carries the transaction ID of the request it answers. */
+        retStatus = Ice_InitializeStunPacket( &pStunCxt,
+                                              pTransactionIdBuffer,
+                                              pStunMessageBuffer,
+                                              pIceAgent->stunMessageBufferSize,
+                                              &pStunHeader,
+                                              0,
+                                              0 );
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        retStatus = ( IceResult_t ) StunSerializer_AddAttributeXorMappedAddress( &pStunCxt,
+                                                                                 &pStunMappedAddress );
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        if( pIceAgent->isControlling == 0 )
+        {
+            retStatus = ( IceResult_t ) StunSerializer_AddAttributeIceControlled( &pStunCxt,
+                                                                                  pIceAgent->tieBreaker );
+        }
+        else
+        {
+            retStatus = ( IceResult_t ) StunSerializer_AddAttributeIceControlling( &pStunCxt,
+                                                                                   pIceAgent->tieBreaker );
+        }
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        retStatus = Ice_PackageStunPacket( &pStunCxt,
+                                           &( pIceAgent->localPasswordKey ) );
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        pIceAgent->stats.responsesSent++;
+    }
+    return retStatus;
+}
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_DeserializeStunPacket - This API deserializes a received STUN packet in a single walk over its attributes,
+ * recording where each attribute the agent acts on is found in pAttributeTable. Only the first occurrence of an
+ * attribute counts, and attributes following MESSAGE-INTEGRITY other than FINGERPRINT are ignored ( RFC 5389 15.4 ). */
+
+IceResult_t Ice_DeserializeStunPacket( StunContext_t * pStunCxt,
+                                       StunHeader_t * pStunHeader,
+                                       IceStunAttributeTable_t * pAttributeTable )
+{
+    IceResult_t retStatus = ICE_RESULT_OK;
+    StunAttribute_t stunAttribute;
+    IceStunAttributeIndex_t attributeIndex;
+
+    if( ( pStunCxt == NULL ) ||
+        ( pStunHeader == NULL ) ||
+        ( pAttributeTable == NULL ) )
+    {
+        retStatus = ICE_RESULT_BAD_PARAM;
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        pAttributeTable->pMessage = pStunCxt->pStart;
+        pAttributeTable->messageType = pStunHeader->messageType;
+        pAttributeTable->flags = 0;
+    }
+
+    while( retStatus == ICE_RESULT_OK )
+    {
+        retStatus = ( IceResult_t ) StunDeserializer_GetNextAttribute( pStunCxt,
+                                                                       &stunAttribute );
+
+        if( retStatus == ICE_RESULT_OK )
+        {
+            switch( stunAttribute.attributeType )
+            {
+            case STUN_ATTRIBUTE_TYPE_XOR_MAPPED_ADDRESS:
+                attributeIndex = ICE_STUN_ATTRIBUTE_INDEX_XOR_MAPPED_ADDRESS;
+                break;
+            case STUN_ATTRIBUTE_TYPE_PRIORITY:
+                attributeIndex = ICE_STUN_ATTRIBUTE_INDEX_PRIORITY;
+                break;
+            case STUN_ATTRIBUTE_TYPE_USE_CANDIDATE:
+                attributeIndex = ICE_STUN_ATTRIBUTE_INDEX_USE_CANDIDATE;
+                break;
+            case STUN_ATTRIBUTE_TYPE_ICE_CONTROLLED:
+                attributeIndex = ICE_STUN_ATTRIBUTE_INDEX_ICE_CONTROLLED;
+                break;
+            case STUN_ATTRIBUTE_TYPE_ICE_CONTROLLING:
+                attributeIndex = ICE_STUN_ATTRIBUTE_INDEX_ICE_CONTROLLING;
+                break;
+            case STUN_ATTRIBUTE_TYPE_USERNAME:
+                attributeIndex = ICE_STUN_ATTRIBUTE_INDEX_USERNAME;
+                break;
+            case STUN_ATTRIBUTE_TYPE_MESSAGE_INTEGRITY:
+                attributeIndex = ICE_STUN_ATTRIBUTE_INDEX_MESSAGE_INTEGRITY;
+                break;
+            case STUN_ATTRIBUTE_TYPE_FINGERPRINT:
+                attributeIndex = ICE_STUN_ATTRIBUTE_INDEX_FINGERPRINT;
+                break;
+            default:
+                attributeIndex = ICE_STUN_ATTRIBUTE_INDEX_COUNT;
+                break;
+            }
+
+            if( ( pAttributeTable->flags & ICE_STUN_ATTRIBUTE_FLAG( ICE_STUN_ATTRIBUTE_INDEX_MESSAGE_INTEGRITY ) ) &&
+                ( attributeIndex != ICE_STUN_ATTRIBUTE_INDEX_FINGERPRINT ) )
+            {
+                attributeIndex = ICE_STUN_ATTRIBUTE_INDEX_COUNT;
+            }
+
+            if( ( attributeIndex != ICE_STUN_ATTRIBUTE_INDEX_COUNT ) &&
+                ( ( pAttributeTable->flags & ICE_STUN_ATTRIBUTE_FLAG( attributeIndex ) ) == 0 ) )
+            {
+                pAttributeTable->flags |= ICE_STUN_ATTRIBUTE_FLAG( attributeIndex );
+                pAttributeTable->valueOffsets[ attributeIndex ] = ( uint16_t ) ( stunAttribute.pAttributeValue - pStunCxt->pStart );
+                pAttributeTable->valueLengths[ attributeIndex ] = stunAttribute.attributeValueLength;
+            }
+        }
+    }
+
+    /* Running out of attributes is the normal end of the walk, it is not an error. */
+    if( ( StunResult_t ) retStatus == STUN_RESULT_NO_MORE_ATTRIBUTE_FOUND )
+    {
+        retStatus = ICE_RESULT_OK;
+    }
+
+    return retStatus;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_GetStunAttributeUint32 / Ice_GetStunAttributeUint64 - Read a 32 bit ( PRIORITY ) or 64 bit ( ICE-CONTROLLED,
+ * ICE-CONTROLLING tie-breaker ) attribute value recorded by Ice_DeserializeStunPacket. 0 when the attribute is absent. */
+
+uint32_t Ice_GetStunAttributeUint32( const IceStunAttributeTable_t * pAttributeTable,
+                                     IceStunAttributeIndex_t attributeIndex )
+{
+    uint32_t value = 0;
+
+    if( ( pAttributeTable->flags & ICE_STUN_ATTRIBUTE_FLAG( attributeIndex ) ) &&
+        ( pAttributeTable->valueLengths[ attributeIndex ] >= sizeof( uint32_t ) ) )
+    {
+        value = Ice_ReadUint32( pAttributeTable->pMessage + pAttributeTable->valueOffsets[ attributeIndex ] );
+    }
+
+    return value;
+}
+
+uint64_t Ice_GetStunAttributeUint64( const IceStunAttributeTable_t * pAttributeTable,
+                                     IceStunAttributeIndex_t attributeIndex )
+{
+    uint64_t value = 0;
+    const uint8_t * pValue;
+
+    if( ( pAttributeTable->flags & ICE_STUN_ATTRIBUTE_FLAG( attributeIndex ) ) &&
+        ( pAttributeTable->valueLengths[ attributeIndex ] >= sizeof( uint64_t ) ) )
+    {
+        pValue = pAttributeTable->pMessage + pAttributeTable->valueOffsets[ attributeIndex ];
+        value = ( ( uint64_t ) Ice_ReadUint32( pValue ) << 32 ) | Ice_ReadUint32( pValue + 4 );
+    }
+
+    return value;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_GetStunAttributeAddress - Decodes the ( XOR ) address attribute recorded by Ice_DeserializeStunPacket, in place. */
+
+IceResult_t Ice_GetStunAttributeAddress( StunContext_t * pStunCxt,
+                                         const IceStunAttributeTable_t * pAttributeTable,
+                                         IceStunAttributeIndex_t attributeIndex,
+                                         StunAttributeAddress_t * pStunAttributeAddress )
+{
+    IceResult_t retStatus = ICE_RESULT_OK;
+    StunAttribute_t stunAttribute;
+
+    if( ( pStunCxt == NULL ) ||
+        ( pAttributeTable == NULL ) ||
+        ( pStunAttributeAddress == NULL ) ||
+        ( attributeIndex != ICE_STUN_ATTRIBUTE_INDEX_XOR_MAPPED_ADDRESS ) ||
+        ( ( pAttributeTable->flags & ICE_STUN_ATTRIBUTE_FLAG( attributeIndex ) ) == 0 ) )
+    {
+        retStatus = ICE_RESULT_BAD_PARAM;
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        stunAttribute.attributeType = STUN_ATTRIBUTE_TYPE_XOR_MAPPED_ADDRESS;
+        stunAttribute.pAttributeValue = pAttributeTable->pMessage + pAttributeTable->valueOffsets[ attributeIndex ];
+        stunAttribute.attributeValueLength = pAttributeTable->valueLengths[ attributeIndex ];
+
+        retStatus = ( IceResult_t ) StunDeserializer_ParseAttributeAddress( pStunCxt,
+                                                                            &stunAttribute,
+                                                                            pStunAttributeAddress );
+    }
+
+    return retStatus;
+}
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/*
+ +-----+-----+-----+-----+-----+
+ |     | BIT3| BIT2| BIT1| BIT0|
+ +-----+-----+-----+-----+-----+
+
+    This depicts the connectivityChecks in a candidate pair, these 4 bits show which bit stands for which STUN request/ response.
+
+     1. BIT0 - STUN request from local candidate to remote candidate.
+     2. BIT1 - STUN response from remote candidate to local candidate.
+     3. BIT2 - STUN request from remote candidate to local candidate.
+     4. BIT3 - STUN response from local candidate to remote candidate.
+
+ */
+
+/* Ice_QueueResponseForRequest / Ice_QueueTriggeredCheck - Write the response to a received request, or the triggered
+ * check of its candidate pair towards its source, into a buffer of the outbound pool and queue it for the application.
+ * The triggered check is a transaction of the pair like any other check, retransmitted until answered. */
+
+static IceResult_t Ice_QueueResponseForRequest( IceAgent_t * pIceAgent,
+                                                IceIPAddress_t * pSrcAddr,
+                                                uint8_t * pTransactionIdBuffer )
+{
+    IceResult_t retStatus = ICE_RESULT_OK;
+    IceOutboundBuffer_t * pOutboundBuffer = Ice_AcquireOutboundBuffer( pIceAgent );
+
+    if( pOutboundBuffer == NULL )
+    {
+        retStatus = ICE_RESULT_OUT_OF_MEMORY;
+    }
+    else
+    {
+        retStatus = Ice_CreateResponseForRequest( pIceAgent,
+                                                  pOutboundBuffer->pBuffer,
+                                                  pSrcAddr,
+                                                  pTransactionIdBuffer );
+
+        if( retStatus == ICE_RESULT_OK )
+        {
+            Ice_QueueOutboundBuffer( pIceAgent,
+                                     pOutboundBuffer,
+                                     pSrcAddr );
+        }
+        else
+        {
+            ( void ) Ice_ReleaseOutboundBuffer( pIceAgent,
+                                                pOutboundBuffer );
+        }
+    }
+
+    return retStatus;
+}
+
+static IceResult_t Ice_QueueTriggeredCheck( IceAgent_t * pIceAgent,
+                                            IceIPAddress_t * pSrcAddr,
+                                            IceCandidatePair_t * pIceCandidatePair )
+{
+    IceResult_t retStatus = ICE_RESULT_OK;
+    IceOutboundBuffer_t * pOutboundBuffer = Ice_AcquireOutboundBuffer( pIceAgent );
+    uint8_t transactionId[ STUN_HEADER_TRANSACTION_ID_LENGTH ];
+
+    if( pOutboundBuffer == NULL )
+    {
+        retStatus = ICE_RESULT_OUT_OF_MEMORY;
+    }
+    else
+    {
+        retStatus = Ice_SerializeConnectivityCheck( pIceAgent,
+                                                    pIceCandidatePair,
+                                                    pOutboundBuffer->pBuffer,
+                                                    pIceAgent->stunMessageBufferSize,
+                                                    transactionId );
+
+        if( retStatus == ICE_RESULT_OK )
+        {
+            Ice_QueueOutboundBuffer( pIceAgent,
+                                     pOutboundBuffer,
+                                     pSrcAddr );
+
+            /* The pair is checked now, the check list must not send it a second, ordinary check. */
+            Ice_CheckListRemove( pIceAgent,
+                                 pIceCandidatePair );
+        }
+        else
+        {
+            ( void ) Ice_ReleaseOutboundBuffer( pIceAgent,
+                                                pOutboundBuffer );
+        }
+    }
+
+    return retStatus;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_ProcessStunPacket - Acts on a deserialized STUN packet for its candidate pair, reading the attribute values
+ * through the table filled by Ice_DeserializeStunPacket. */
+
+static IceResult_t Ice_ProcessStunPacket( IceAgent_t * pIceAgent,
+                                          StunContext_t * pStunCxt,
+                                          const IceStunAttributeTable_t * pAttributeTable,
+                                          uint8_t * pTransactionIdBuffer,
+                                          IceCandidate_t * pLocalCandidate,
+                                          IceIPAddress_t pSrcAddr,
+                                          IceCandidatePair_t * pIceCandidatePair )
+{
+    IceResult_t retStatus = ICE_RESULT_OK;
+    uint8_t * pStunMessageBuffer = pStunCxt->pStart;
+    StunAttributeAddress_t pStunAttributeAddress;
+    IceTransaction_t * pTransaction;
+
+    switch( pAttributeTable->messageType )
+    {
+    case STUN_MESSAGE_TYPE_BINDING_REQUEST:
+    {
+        /* Check if received candidate with USE_CANDIDATE FLAG */
+        if( ( pAttributeTable->flags & ICE_STUN_ATTRIBUTE_FLAG( ICE_STUN_ATTRIBUTE_INDEX_USE_CANDIDATE ) ) &&
+            ( pIceCandidatePair->connectivityChecks == ICE_CONNECTIVITY_SUCCESS_FLAG ) )
+        {
+            ICE_LOG_INFO( pIceAgent, "Received binding request with USE-CANDIDATE, candidate pair nominated." );
+            Ice_SetCandidatePairState( pIceAgent,
+                                       pIceCandidatePair,
+                                       ICE_CANDIDATE_PAIR_STATE_NOMINATED );
+            Ice_UpdateConnection( pIceAgent,
+                                  pIceCandidatePair );
+            retStatus = Ice_QueueResponseForRequest( pIceAgent,
+                                                     &pSrcAddr,
+                                                     pTransactionIdBuffer );
+
+            if( retStatus == ICE_RESULT_OK )
+            {
+                retStatus = ICE_RESULT_SEND_STUN_REQUEST_RESPONSE;
+            }
+        }
+        else
+        {
+            /* Check if we need to add Remote Peer Reflexive candidates. */
+            if( pIceCandidatePair->state == ICE_CANDIDATE_PAIR_STATE_INVALID )
+            {
+                retStatus = Ice_CheckPeerReflexiveCandidate( pIceAgent,
+                                                             pSrcAddr,
+                                                             Ice_GetStunAttributeUint32( pAttributeTable,
+                                                                                         ICE_STUN_ATTRIBUTE_INDEX_PRIORITY ) );
+            }
+
+            pIceCandidatePair->connectivityChecks |= 1 << 2;
+
+            /* Create a response from local to remote candidate. */
+            retStatus = Ice_QueueResponseForRequest( pIceAgent,
+                                                     &pSrcAddr,
+                                                     pTransactionIdBuffer );
+            if( retStatus == ICE_RESULT_OK )
+            {
+                pIceCandidatePair->connectivityChecks |= 1 << 3;
+                retStatus = ICE_RESULT_SEND_STUN_LOCAL_REMOTE;
+            }
+
+            if( ( pIceCandidatePair->connectivityChecks & 1 ) == 0 )
+            {
+                /* Create a request from local to remote candidate. */
+                pIceCandidatePair->connectivityChecks |= 1 << 0;
+
+                retStatus = Ice_QueueTriggeredCheck( pIceAgent,
+                                                     &pSrcAddr,
+                                                     pIceCandidatePair );
+                if( retStatus == ICE_RESULT_OK )
+                {
+                    retStatus = ICE_RESULT_SEND_STUN_REQUEST_RESPONSE;
+                }
+            }
+        }
+    }
+    break;
+    case STUN_MESSAGE_TYPE_BINDING_SUCCESS_RESPONSE:
+    {
+        pTransaction = Ice_TransactionIdStoreFind( &( pIceAgent->stunBindingRequestTransactionIdStore ),
+                                                   pStunMessageBuffer + STUN_HEADER_TRANSACTION_ID_OFFSET );
+
+        if( ( pTransaction != NULL ) && ( pTransaction->purpose == ICE_TRANSACTION_PURPOSE_SRFLX_REQUEST ) )
+        {
+            if( Ice_GetStunAttributeAddress( pStunCxt,
+                                             pAttributeTable,
+                                             ICE_STUN_ATTRIBUTE_INDEX_XOR_MAPPED_ADDRESS,
+                                             &pStunAttributeAddress ) == ICE_RESULT_OK )
+            {
+                retStatus = Ice_HandleServerReflexiveCandidateResponse( pIceAgent,
+                                                                        &pStunAttributeAddress,
+                                                                        ( pTransaction->pLocalCandidate != NULL ) ? pTransaction->pLocalCandidate : pLocalCandidate );
+
+                if( retStatus == ICE_RESULT_OK )
+                {
+                    /* The candidate is gathered, timed from the request to the STUN server. */
+                    Ice_HistogramRecord( &( pIceAgent->stats.gatheringTime ),
+                                         ( pIceAgent->currentTime > pTransaction->sendTime ) ? ( pIceAgent->currentTime - pTransaction->sendTime ) : 0 );
+                    Ice_TransactionIdStoreRemove( &( pIceAgent->stunBindingRequestTransactionIdStore ),
+                                                  pStunMessageBuffer + STUN_HEADER_TRANSACTION_ID_OFFSET );
+                }
+            }
+        }
+        else
+        {
+            if( pTransaction != NULL )
+            {
+                /* Only a request sent once tells which send the response answers ( Karn's algorithm ). */
+                if( ( pTransaction->requestCount <= 1 ) && ( pIceAgent->currentTime >= pTransaction->sendTime ) )
+                {
+                    Ice_UpdatePairRtt( pIceAgent,
+                                       ( pTransaction->pIceCandidatePair != NULL ) ? pTransaction->pIceCandidatePair : pIceCandidatePair,
+                                       pIceAgent->currentTime - pTransaction->sendTime );
+                }
+
+                /* The response answers one of our connectivity checks, the transaction is complete and so are the
+                 * pair's other checks of the same kind still waiting for an answer ( e.g. an ordinary and a triggered check ). */
+                if( pTransaction->pIceCandidatePair != NULL )
+                {
+                    ( void ) Ice_TransactionIdStoreRemovePair( &( pIceAgent->stunBindingRequestTransactionIdStore ),
+                                                               pTransaction->pIceCandidatePair,
+                                                               pTransaction->purpose );
+                }
+                else
+                {
+                    Ice_TransactionIdStoreRemove( &( pIceAgent->stunBindingRequestTransactionIdStore ),
+                                                  pStunMessageBuffer + STUN_HEADER_TRANSACTION_ID_OFFSET );
+                }
+            }
+
+
+            if( pIceCandidatePair->connectivityChecks == ICE_CONNECTIVITY_SUCCESS_FLAG )
+            {
+                if( pIceCandidatePair->state == ICE_CANDIDATE_PAIR_STATE_NOMINATED )
+                {
+                    Ice_SetCandidatePairState( pIceAgent,
+                                               pIceCandidatePair,
+                                               ICE_CANDIDATE_PAIR_STATE_SUCCEEDED );
+                    Ice_UpdateConnection( pIceAgent,
+                                          pIceCandidatePair );
+                    retStatus = ICE_RESULT_CANDIDATE_PAIR_READY;
+                }
+                else
+                {
+                    Ice_SetCandidatePairState( pIceAgent,
+                                               pIceCandidatePair,
+                                               ICE_CANDIDATE_PAIR_STATE_VALID );
+                    retStatus = ICE_RESULT_START_NOMINATION;
+                }
+            }
+            else
+            {
+                pIceCandidatePair->connectivityChecks |= 1 << 1;
+
+                if( Ice_GetStunAttributeAddress( pStunCxt,
+                                                 pAttributeTable,
+                                                 ICE_STUN_ATTRIBUTE_INDEX_XOR_MAPPED_ADDRESS,
+                                                 &pStunAttributeAddress ) == ICE_RESULT_OK )
+                {
+                    if( ( pIceCandidatePair->local->iceCandidateType == ICE_CANDIDATE_TYPE_SERVER_REFLEXIVE ) &&
+                        ( pIceCandidatePair->remote->iceCandidateType == ICE_CANDIDATE_TYPE_SERVER_REFLEXIVE ) &&
+                        ( Ice_IsSameIpAddress( &pStunAttributeAddress,
+                                               &pIceCandidatePair->local->ipAddress.ipAddress,
+                                               false ) == 0 ) )
+                    {
+                        ICE_LOG_INFO( pIceAgent, "XOR-MAPPED-ADDRESS of the binding response differs from the local candidate address." );
+
+                        IceIPAddress_t pAddr;
+                        pAddr.ipAddress = pStunAttributeAddress;
+                        pAddr.isPointToPoint = 0;
+
+                        retStatus = Ice_CheckPeerReflexiveCandidate( pIceAgent,
+                                                                     pAddr,
+                                                                     pIceCandidatePair->local->priority );
+                    }
+                }
+                else
+                {
+                    ICE_LOG_WARN( pIceAgent, "Binding response without XOR-MAPPED-ADDRESS dropped." );
+                }
+
+            }
+        }
+    }
+    break;
+    case STUN_MESSAGE_TYPE_BINDING_INDICATION:
+        ICE_LOG_DEBUG( pIceAgent, "Received STUN binding indication." );
+        break;
+    default:
+        ICE_LOG_WARN( pIceAgent, "STUN message of type 0x%04X is neither a binding request nor a binding response, ignored.", ( unsigned int ) pAttributeTable->messageType );
+        break;
+    }
+
+    return retStatus;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_HandleStunResponse - This API handles the processing of Stun Response. */
+
+IceResult_t Ice_HandleStunResponse( IceAgent_t * pIceAgent,
+                                    uint8_t * pStunMessageBuffer,
+                                    size_t pStunMessageBufferLength,
+                                    uint8_t * pTransactionIdBuffer,
+                                    IceCandidate_t * pLocalCandidate,
+                                    IceIPAddress_t pSrcAddr,
+                                    IceCandidatePair_t * pIceCandidatePair )
+{
+    IceResult_t retStatus = ICE_RESULT_OK;
+    StunContext_t pStunCxt;
+    StunHeader_t pStunHeader;
+    IceStunAttributeTable_t attributeTable;
+
+    if( ( pIceAgent == NULL ) ||
+        ( pStunMessageBuffer == NULL ) )
     {
-        retStatus = Ice_InitializeStunPacket( &pStunCxt,
-                                              pTransactionIdBuffer,
-                                              pStunMessageBuffer,
-                                              &pStunHeader,
-                                              1,
-                                              0 );
+        retStatus = ICE_RESULT_BAD_PARAM;
     }
 
+    /* Initialize STUN context for deserializing. */
     if( retStatus == ICE_RESULT_OK )
     {
-        retStatus = StunSerializer_AddAttributeXorMappedAddress( &pStunCxt,
-                                                                 &pStunMappedAddress );
+        retStatus = ( IceResult_t ) StunDeserializer_Init( &pStunCxt,
+                                                           pStunMessageBuffer,
+                                                           pStunMessageBufferLength,
+                                                           &pStunHeader );
     }
 
     if( retStatus == ICE_RESULT_OK )
     {
-        if( pIceAgent->isControlling == 0 )
+        retStatus = Ice_DeserializeStunPacket( &pStunCxt,
+                                               &pStunHeader,
+                                               &attributeTable );
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        retStatus = Ice_ProcessStunPacket( pIceAgent,
+                                           &pStunCxt,
+                                           &attributeTable,
+                                           pTransactionIdBuffer,
+                                           pLocalCandidate,
+                                           pSrcAddr,
+                                           pIceCandidatePair );
+    }
+
+    return retStatus;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_ConstantTimeEquals - Compares two buffers in a time that does not depend on where they differ. */
+
+static bool Ice_ConstantTimeEquals( const uint8_t * pBuffer1,
+                                    const uint8_t * pBuffer2,
+                                    size_t length )
+{
+    uint8_t difference = 0;
+    size_t i;
+
+    for( i = 0; i < length; i++ )
+    {
+        difference |= pBuffer1[ i ] ^ pBuffer2[ i ];
+    }
+
+    return difference == 0;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_ValidateStunPacket - Cheap validation of a received datagram before any agent state is looked at or changed.
+ * In order: the first byte must be in the STUN range 0-3 ( RFC 7983 ), the magic cookie must match, the header length
+ * must match the datagram and the attribute headers must tile the message, a FINGERPRINT must be last and match,
+ * only the FINGERPRINT may follow MESSAGE-INTEGRITY, and MESSAGE-INTEGRITY must verify ( in constant time ) wherever
+ * present. MESSAGE-INTEGRITY and FINGERPRINT must be present on binding requests, and on responses unless
+ * isResponseIntegrityRequired is false ( the response of a STUN server ).
+ * Requests are verified with pRequestKey, other messages with pResponseKey. Each rejection is counted in
+ * pRejectCounters. The length field of the header is patched while the integrity is computed and restored afterwards. */
+
+IceResult_t Ice_ValidateStunPacket( IceRejectCounters_t * pRejectCounters,
+                                    const IceHmacSha1Key_t * pRequestKey,
+                                    const IceHmacSha1Key_t * pResponseKey,
+                                    uint8_t * pStunMessageBuffer,
+                                    size_t stunMessageBufferLength,
+                                    bool isResponseIntegrityRequired )
+{
+    IceResult_t retStatus = ICE_RESULT_OK;
+    const IceHmacSha1Key_t * pIntegrityKey;
+    uint8_t messageIntegrity[ STUN_HMAC_VALUE_LENGTH ];
+    uint8_t savedLength[ 2 ];
+    uint16_t messageType, attributeType, attributeLength, integrityLength = 0;
+    size_t offset = STUN_HEADER_LENGTH, integrityOffset = 0, fingerprintOffset = 0;
+    bool hasIntegrity = false, hasFingerprint = false, isIntegrityRequired = false;
+
+    if( ( pRejectCounters == NULL ) ||
+        ( pRequestKey == NULL ) ||
+        ( pResponseKey == NULL ) ||
+        ( pStunMessageBuffer == NULL ) )
+    {
+        retStatus = ICE_RESULT_BAD_PARAM;
+    }
+
+    if( ( retStatus == ICE_RESULT_OK ) &&
+        ( ( stunMessageBufferLength == 0 ) || ( pStunMessageBuffer[ 0 ] > 3 ) ) )
+    {
+        pRejectCounters->notStun++;
+        retStatus = ICE_RESULT_NOT_STUN_PACKET;
+    }
+
+    if( ( retStatus == ICE_RESULT_OK ) && ( stunMessageBufferLength < STUN_HEADER_LENGTH ) )
+    {
+        pRejectCounters->badLength++;
+        retStatus = ICE_RESULT_MALFORMED_STUN_PACKET;
+    }
+
+    if( ( retStatus == ICE_RESULT_OK ) &&
+        ( Ice_ReadUint32( pStunMessageBuffer + STUN_HEADER_MAGIC_COOKIE_OFFSET ) != STUN_HEADER_MAGIC_COOKIE ) )
+    {
+        pRejectCounters->badMagicCookie++;
+        retStatus = ICE_RESULT_NOT_STUN_PACKET;
+    }
+
+    if( ( retStatus == ICE_RESULT_OK ) &&
+        ( ( Ice_GetStunMessageLength( pStunMessageBuffer ) != stunMessageBufferLength ) ||
+          ( ( stunMessageBufferLength & 3 ) != 0 ) ) )
+    {
+        pRejectCounters->badLength++;
+        retStatus = ICE_RESULT_MALFORMED_STUN_PACKET;
+    }
+
+    /* Walk the attribute headers only, to locate MESSAGE-INTEGRITY and FINGERPRINT. */
+    while( ( retStatus == ICE_RESULT_OK ) && ( offset < stunMessageBufferLength ) )
+    {
+        if( offset + STUN_ATTRIBUTE_HEADER_LENGTH > stunMessageBufferLength )
         {
-            retStatus = StunSerializer_AddAttributeIceControlled( &pStunCxt,
-                                                                  pIceAgent->tieBreaker );
+            retStatus = ICE_RESULT_MALFORMED_STUN_PACKET;
         }
         else
         {
-            retStatus = StunSerializer_AddAttributeIceControlling( &pStunCxt,
-                                                                   pIceAgent->tieBreaker );
+            attributeType = Ice_ReadUint16( pStunMessageBuffer + offset );
+            attributeLength = Ice_ReadUint16( pStunMessageBuffer + offset + 2 );
+
+            if( ( offset + STUN_ATTRIBUTE_HEADER_LENGTH + attributeLength > stunMessageBufferLength ) ||
+                hasFingerprint ||
+                ( hasIntegrity && ( attributeType != STUN_ATTRIBUTE_TYPE_FINGERPRINT ) ) )
+            {
+                /* Overruns the message, follows the FINGERPRINT which must be the last attribute, or follows the
+                 * MESSAGE-INTEGRITY where only the FINGERPRINT may, an attribute there would not be authenticated. */
+                retStatus = ICE_RESULT_MALFORMED_STUN_PACKET;
+            }
+            else if( attributeType == STUN_ATTRIBUTE_TYPE_MESSAGE_INTEGRITY )
+            {
+                hasIntegrity = true;
+                integrityOffset = offset;
+                integrityLength = attributeLength;
+            }
+            else if( attributeType == STUN_ATTRIBUTE_TYPE_FINGERPRINT )
+            {
+                hasFingerprint = true;
+                fingerprintOffset = offset;
+
+                if( attributeLength != sizeof( uint32_t ) )
+                {
+                    retStatus = ICE_RESULT_MALFORMED_STUN_PACKET;
+                }
+            }
+
+            offset += STUN_ATTRIBUTE_HEADER_LENGTH + ( ( ( size_t ) attributeLength + 3 ) & ~( ( size_t ) 3 ) );
+        }
+
+        if( retStatus == ICE_RESULT_MALFORMED_STUN_PACKET )
+        {
+            pRejectCounters->badLength++;
         }
     }
 
     if( retStatus == ICE_RESULT_OK )
     {
-        retStatus = Ice_PackageStunPacket( &pStunCxt,
-                                           ( uint8_t * ) pIceAgent->localPassword,
-                                           ( uint32_t ) strlen( pIceAgent->localPassword ) * sizeof( char ) );
+        /* Indications and the responses of a STUN server are not authenticated, connectivity checks and their
+         * responses must be. */
+        messageType = Ice_ReadUint16( pStunMessageBuffer );
+        isIntegrityRequired = ( messageType == STUN_MESSAGE_TYPE_BINDING_REQUEST ) ||
+                              ( isResponseIntegrityRequired &&
+                                ( ( messageType == STUN_MESSAGE_TYPE_BINDING_SUCCESS_RESPONSE ) ||
+                                  ( messageType == STUN_MESSAGE_TYPE_BINDING_FAILURE_RESPONSE ) ) );
+    }
+
+    if( ( retStatus == ICE_RESULT_OK ) && !hasFingerprint && isIntegrityRequired )
+    {
+        pRejectCounters->badFingerprint++;
+        retStatus = ICE_RESULT_FINGERPRINT_MISSING;
+    }
+
+    if( ( retStatus == ICE_RESULT_OK ) && hasFingerprint &&
+        ( ( Ice_Crc32( 0, pStunMessageBuffer, fingerprintOffset ) ^ STUN_ATTRIBUTE_FINGERPRINT_XOR_VALUE ) !=
+          Ice_ReadUint32( pStunMessageBuffer + fingerprintOffset + STUN_ATTRIBUTE_HEADER_LENGTH ) ) )
+    {
+        pRejectCounters->badFingerprint++;
+        retStatus = ICE_RESULT_FINGERPRINT_MISMATCH;
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        if( !hasIntegrity )
+        {
+            if( isIntegrityRequired )
+            {
+                pRejectCounters->missingIntegrity++;
+                retStatus = ICE_RESULT_INTEGRITY_MISSING;
+            }
+        }
+        else if( integrityLength != STUN_HMAC_VALUE_LENGTH )
+        {
+            pRejectCounters->badLength++;
+            retStatus = ICE_RESULT_MALFORMED_STUN_PACKET;
+        }
+        else
+        {
+            pIntegrityKey = ( messageType == STUN_MESSAGE_TYPE_BINDING_REQUEST ) ? pRequestKey : pResponseKey;
+
+            /* The HMAC covers a header whose length ends with the MESSAGE-INTEGRITY attribute. */
+            savedLength[ 0 ] = pStunMessageBuffer[ 2 ];
+            savedLength[ 1 ] = pStunMessageBuffer[ 3 ];
+            pStunMessageBuffer[ 2 ] = ( uint8_t ) ( ( integrityOffset + STUN_ATTRIBUTE_HEADER_LENGTH + STUN_HMAC_VALUE_LENGTH - STUN_HEADER_LENGTH ) >> 8 );
+            pStunMessageBuffer[ 3 ] = ( uint8_t ) ( integrityOffset + STUN_ATTRIBUTE_HEADER_LENGTH + STUN_HMAC_VALUE_LENGTH - STUN_HEADER_LENGTH );
+
+            Ice_HmacSha1( pIntegrityKey,
+                          pStunMessageBuffer,
+                          integrityOffset,
+                          messageIntegrity );
+
+            pStunMessageBuffer[ 2 ] = savedLength[ 0 ];
+            pStunMessageBuffer[ 3 ] = savedLength[ 1 ];
+
+            if( !Ice_ConstantTimeEquals( messageIntegrity,
+                                         pStunMessageBuffer + integrityOffset + STUN_ATTRIBUTE_HEADER_LENGTH,
+                                         STUN_HMAC_VALUE_LENGTH ) )
+            {
+                pRejectCounters->badIntegrity++;
+                retStatus = ICE_RESULT_INTEGRITY_MISMATCH;
+            }
+        }
     }
+
     return retStatus;
 }
+
 /*------------------------------------------------------------------------------------------------------------------*/
 
-/* Ice_DeserializeStunPacket - This API deserializes a received STUN packet . */
+/* Ice_ClassifyStunPacket - Validates a received datagram for the agent with Ice_ValidateStunPacket: requests are
+ * verified with the local password, responses with the remote password, rejections are counted in
+ * pIceAgent->stats.rejectCounters. Only responses to a server reflexive request may come without MESSAGE-INTEGRITY. */
 
-IceResult_t Ice_DeserializeStunPacket( StunContext_t * pStunCxt,
-                                       StunHeader_t * pStunHeader,
-                                       StunAttribute_t * pStunAttribute,
-                                       StunAttributeAddress_t * pStunAttributeAddress,
-                                       uint32_t priority )
+IceResult_t Ice_ClassifyStunPacket( IceAgent_t * pIceAgent,
+                                    uint8_t * pStunMessageBuffer,
+                                    size_t stunMessageBufferLength )
 {
-
     IceResult_t retStatus = ICE_RESULT_OK;
+    IceTransaction_t * pTransaction;
+    bool isResponseIntegrityRequired = true;
 
-    while( retStatus == ICE_RESULT_OK )
+    if( pIceAgent == NULL )
+    {
+        retStatus = ICE_RESULT_BAD_PARAM;
+    }
+
+    /* The purpose of the transaction a response answers tells whether it must be authenticated. */
+    if( ( retStatus == ICE_RESULT_OK ) &&
+        ( pStunMessageBuffer != NULL ) &&
+        ( stunMessageBufferLength >= STUN_HEADER_LENGTH ) &&
+        ( ( pStunMessageBuffer[ 0 ] & 0x01 ) != 0 ) )
+    {
+        pTransaction = Ice_TransactionIdStoreFind( &( pIceAgent->stunBindingRequestTransactionIdStore ),
+                                                   pStunMessageBuffer + STUN_HEADER_TRANSACTION_ID_OFFSET );
+
+        isResponseIntegrityRequired = ( pTransaction == NULL ) ||
+                                      ( pTransaction->purpose != ICE_TRANSACTION_PURPOSE_SRFLX_REQUEST );
+    }
+
+    if( retStatus == ICE_RESULT_OK )
     {
-        retStatus = StunDeserializer_GetNextAttribute( pStunCxt,
-                                                       pStunAttribute );
+        retStatus = Ice_ValidateStunPacket( &( pIceAgent->stats.rejectCounters ),
+                                            &( pIceAgent->localPasswordKey ),
+                                            &( pIceAgent->remotePasswordKey ),
+                                            pStunMessageBuffer,
+                                            stunMessageBufferLength,
+                                            isResponseIntegrityRequired );
 
         if( retStatus == ICE_RESULT_OK )
         {
-            switch( pStunAttribute->attributeType )
-            {
-            case STUN_ATTRIBUTE_TYPE_XOR_MAPPED_ADDRESS:
+            pIceAgent->stats.packetsAccepted++;
+        }
+    }
+
+    return retStatus;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_RouteReceivedStunPacket - Deserializes a received STUN packet that arrived on a known local candidate, resolves its
+ * candidate pair and hands both to Ice_ProcessStunPacket. The attributes are walked once, here. Responses to a request
+ * echo the transaction ID of the received header. */
+
+static IceResult_t Ice_RouteReceivedStunPacket( IceAgent_t * pIceAgent,
+                                                uint8_t * pStunMessageBuffer,
+                                                size_t stunMessageBufferLength,
+                                                IceCandidate_t * pLocalCandidate,
+                                                const IceIPAddress_t * pSrcAddress,
+                                                IceCandidatePair_t ** ppIceCandidatePair )
+{
+    IceResult_t retStatus = ICE_RESULT_OK;
+    IceCandidatePair_t * pIceCandidatePair = NULL;
+    IceTransaction_t * pTransaction = NULL;
+    StunContext_t stunCxt;
+    StunHeader_t stunHeader;
+    IceStunAttributeTable_t attributeTable;
+
+    retStatus = ( IceResult_t ) StunDeserializer_Init( &stunCxt,
+                                                       pStunMessageBuffer,
+                                                       stunMessageBufferLength,
+                                                       &stunHeader );
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        retStatus = Ice_DeserializeStunPacket( &stunCxt,
+                                               &stunHeader,
+                                               &attributeTable );
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        if( attributeTable.messageType == STUN_MESSAGE_TYPE_BINDING_REQUEST )
+        {
+            pIceCandidatePair = Ice_FindCandidatePair( pIceAgent,
+                                                       pLocalCandidate,
+                                                       pSrcAddress );
+
+            if( pIceCandidatePair == NULL )
             {
-                retStatus = StunDeserializer_ParseAttributeAddress( pStunCxt,
-                                                                    pStunAttribute,
-                                                                    pStunAttributeAddress );
-                retStatus = ICE_RESULT_UPDATE_SRFLX_CANDIDATE;
+                /* Unknown source address, learn it as a remote peer reflexive candidate, which pairs it with the local candidates. */
+                retStatus = Ice_CheckPeerReflexiveCandidate( pIceAgent,
+                                                             *pSrcAddress,
+                                                             Ice_GetStunAttributeUint32( &attributeTable,
+                                                                                         ICE_STUN_ATTRIBUTE_INDEX_PRIORITY ) );
+
+                if( retStatus == ICE_RESULT_OK )
+                {
+                    pIceCandidatePair = Ice_FindCandidatePair( pIceAgent,
+                                                               pLocalCandidate,
+                                                               pSrcAddress );
+                }
             }
-            break;
-            case STUN_ATTRIBUTE_TYPE_USE_CANDIDATE:
+        }
+        else
+        {
+            pTransaction = Ice_TransactionIdStoreFind( &( pIceAgent->stunBindingRequestTransactionIdStore ),
+                                                       pStunMessageBuffer + STUN_HEADER_TRANSACTION_ID_OFFSET );
+
+            if( pTransaction == NULL )
             {
-                retStatus = ICE_RESULT_USE_CANDIDATE_FLAG;
+                retStatus = ICE_RESULT_TRANSACTION_NOT_FOUND;
             }
-            break;
-            case STUN_ATTRIBUTE_TYPE_PRIORITY:
+            else if( pTransaction->purpose == ICE_TRANSACTION_PURPOSE_SRFLX_REQUEST )
             {
-                retStatus = StunDeserializer_ParseAttributePriority( pStunCxt,
-                                                                     pStunAttribute,
-                                                                     &( priority ) );
+                if( pTransaction->pLocalCandidate != NULL )
+                {
+                    pLocalCandidate = pTransaction->pLocalCandidate;
+                }
             }
-            break;
-            default:
-                break;
+            else
+            {
+                pIceCandidatePair = pTransaction->pIceCandidatePair;
+
+                if( pIceCandidatePair == NULL )
+                {
+                    pIceCandidatePair = Ice_FindCandidatePair( pIceAgent,
+                                                               pLocalCandidate,
+                                                               pSrcAddress );
+                }
             }
         }
     }
-    return retStatus;
-}
-/*------------------------------------------------------------------------------------------------------------------*/
 
-/*
- +-----+-----+-----+-----+-----+
- |     | BIT3| BIT2| BIT1| BIT0|
- +-----+-----+-----+-----+-----+
+    if( ( retStatus == ICE_RESULT_OK ) &&
+        ( pIceCandidatePair == NULL ) &&
+        ( ( pTransaction == NULL ) || ( pTransaction->purpose != ICE_TRANSACTION_PURPOSE_SRFLX_REQUEST ) ) )
+    {
+        /* No pair could be formed, e.g. the candidate pair array is full. */
+        retStatus = ICE_RESULT_MAX_CANDIDATE_PAIR_THRESHOLD;
+    }
 
-    This depicts the connectivityChecks in a candidate pair, these 4 bits show which bit stands for which STUN request/ response.
+    if( retStatus == ICE_RESULT_OK )
+    {
+        *ppIceCandidatePair = pIceCandidatePair;
+
+        retStatus = Ice_ProcessStunPacket( pIceAgent,
+                                           &stunCxt,
+                                           &attributeTable,
+                                           stunHeader.pTransactionId,
+                                           pLocalCandidate,
+                                           *pSrcAddress,
+                                           pIceCandidatePair );
+    }
 
-     1. BIT0 - STUN request from local candidate to remote candidate.
-     2. BIT1 - STUN response from remote candidate to local candidate.
-     3. BIT2 - STUN request from remote candidate to local candidate.
-     4. BIT3 - STUN response from local candidate to remote candidate.
+    return retStatus;
+}
 
- */
+/*------------------------------------------------------------------------------------------------------------------*/
 
-/* Ice_HandleStunResponse - This API handles the processing of Stun Response. */
+/* Ice_HandleReceivedStunPacket - The application calls this API for every STUN packet received on a local socket.
+ * The packet is routed to its candidate pair by the library: responses through the outstanding transaction,
+ * requests through the ( local candidate, source address ) pair index. A request from an unknown source
+ * address creates a remote peer reflexive candidate and its pairs before it is processed.
+ * Packets failing Ice_ClassifyStunPacket are dropped before the agent state is touched.
+ * On return *ppIceCandidatePair holds the pair the packet was processed for, NULL if it was not pair related. */
 
-IceResult_t Ice_HandleStunResponse( IceAgent_t * pIceAgent,
-                                    uint8_t * pStunMessageBuffer,
-                                    uint8_t pStunMessageBufferLength,
-                                    uint8_t * pTransactionIdBuffer,
-                                    IceCandidate_t * pLocalCandidate,
-                                    IceIPAddress_t pSrcAddr,
-                                    IceCandidatePair_t * pIceCandidatePair )
+IceResult_t Ice_HandleReceivedStunPacket( IceAgent_t * pIceAgent,
+                                          uint8_t * pStunMessageBuffer,
+                                          size_t stunMessageBufferLength,
+                                          const IceIPAddress_t * pLocalAddress,
+                                          const IceIPAddress_t * pSrcAddress,
+                                          IceCandidatePair_t ** ppIceCandidatePair )
 {
     IceResult_t retStatus = ICE_RESULT_OK;
-    uint32_t priority = 0;
-    StunContext_t pStunCxt;
-    StunHeader_t pStunHeader;
-    StunAttribute_t pStunAttribute;
-    StunAttributeAddress_t pStunAttributeAddress;
+    IceCandidate_t * pLocalCandidate = NULL;
 
     if( ( pIceAgent == NULL ) ||
-        ( pStunMessageBuffer == NULL ) )
+        ( pStunMessageBuffer == NULL ) ||
+        ( pLocalAddress == NULL ) ||
+        ( pSrcAddress == NULL ) ||
+        ( ppIceCandidatePair == NULL ) )
     {
         retStatus = ICE_RESULT_BAD_PARAM;
     }
 
-    /* Initialize STUN context for deserializing. */
     if( retStatus == ICE_RESULT_OK )
     {
-        retStatus = StunDeserializer_Init( &pStunCxt,
-                                           pStunMessageBuffer,
-                                           pStunMessageBufferLength,
-                                           &pStunHeader );
+        *ppIceCandidatePair = NULL;
+
+        retStatus = Ice_ClassifyStunPacket( pIceAgent,
+                                            pStunMessageBuffer,
+                                            stunMessageBufferLength );
     }
 
     if( retStatus == ICE_RESULT_OK )
     {
-        retStatus = Ice_DeserializeStunPacket( &pStunCxt,
-                                               &pStunHeader,
-                                               &pStunAttribute,
-                                               &pStunAttributeAddress,
-                                               priority );
+        pLocalCandidate = Ice_FindCandidateFromIp( pIceAgent,
+                                                   pLocalAddress,
+                                                   ICE_SOCKET_PROTOCOL_UDP,
+                                                   false );
+
+        if( pLocalCandidate == NULL )
+        {
+            retStatus = ICE_RESULT_LOCAL_CANDIDATE_NOT_FOUND;
+        }
     }
 
-    if( ( retStatus == ICE_RESULT_OK ) ||
-        ( retStatus == ICE_RESULT_UPDATE_SRFLX_CANDIDATE ) ||
-        ( retStatus == ICE_RESULT_USE_CANDIDATE_FLAG ) )
+    if( retStatus == ICE_RESULT_OK )
     {
-        switch( pStunHeader.messageType )
-        {
-        case STUN_MESSAGE_TYPE_BINDING_REQUEST:
-        {
-            /* Check if received candidate with USE_CANDIDATE FLAG */
-            if( ( retStatus == ICE_RESULT_USE_CANDIDATE_FLAG ) && ( pIceCandidatePair->connectivityChecks == ICE_CONNECTIVITY_SUCCESS_FLAG ) )
-            {
-                printf( "Received candidate with USE_CANDIDATE flag.\n" );
-                pIceCandidatePair->state = ICE_CANDIDATE_PAIR_STATE_NOMINATED;
-                retStatus = Ice_CreateResponseForRequest( pIceAgent,
-                                                          &( pIceAgent->stunMessageBuffers[ pIceAgent->stunMessageBufferUsedCount++ ][ ICE_STUN_MESSAGE_BUFFER_SIZE ] ),
-                                                          &pSrcAddr,
-                                                          pTransactionIdBuffer );
+        retStatus = Ice_RouteReceivedStunPacket( pIceAgent,
+                                                 pStunMessageBuffer,
+                                                 stunMessageBufferLength,
+                                                 pLocalCandidate,
+                                                 pSrcAddress,
+                                                 ppIceCandidatePair );
+    }
 
-                if( retStatus == ICE_RESULT_OK )
-                {
-                    retStatus = ICE_RESULT_SEND_STUN_REQUEST_RESPONSE;
-                }
-            }
-            else
-            {
-                /* Check if we need to add Remote Peer Reflexive candidates. */
-                if( pIceCandidatePair->state == ICE_CANDIDATE_PAIR_STATE_INVALID )
-                {
-                    retStatus = Ice_CheckPeerReflexiveCandidate( pIceAgent,
-                                                                 pSrcAddr,
-                                                                 priority,
-                                                                 pIceCandidatePair );
-                }
+    return retStatus;
+}
 
-                pIceCandidatePair->connectivityChecks |= 1 << 2;
+/*------------------------------------------------------------------------------------------------------------------*/
 
-                /* Create a response from local to remote candidate. */
-                retStatus = Ice_CreateResponseForRequest( pIceAgent,
-                                                          pIceAgent->stunMessageBuffers[ pIceAgent->stunMessageBufferUsedCount++ ],
-                                                          &pSrcAddr,
-                                                          pTransactionIdBuffer );
-                if( retStatus == ICE_RESULT_OK )
-                {
-                    pIceCandidatePair->connectivityChecks |= 1 << 3;
-                    retStatus = ICE_RESULT_SEND_STUN_LOCAL_REMOTE;
-                }
+/* Ice_HandleStunPackets - The application calls this API with a batch of received datagrams ( e.g. one recvmmsg call ).
+ * Each packet is classified and handled as by Ice_HandleReceivedStunPacket and gets its own entry in pResults. Consecutive packets
+ * that arrived on the same local socket share a single local candidate lookup.
+ * Outbound messages are queued in the agent's outbound pool ( see Ice_GetOutboundBuffer ), so handling stops early once
+ * fewer than ICE_MAX_OUTBOUND_MESSAGES_PER_PACKET buffers are free; the application sends and releases the produced
+ * messages and calls again with the remaining packets. Returns the number of packets handled. */
+
+uint32_t Ice_HandleStunPackets( IceAgent_t * pIceAgent,
+                                const IceReceivedPacket_t * pPackets,
+                                IcePacketResult_t * pResults,
+                                uint32_t packetCount )
+{
+    uint32_t i = 0;
+    uint32_t readyCount;
+    uint64_t startTime = 0;
+    IceCandidate_t * pLocalCandidate = NULL;
+    const IceIPAddress_t * pLastLocalAddress = NULL;
+    IcePacketResult_t * pResult;
 
-                if( ( pIceCandidatePair->connectivityChecks & 1 ) == 0 )
-                {
-                    /* Create a request from local to remote candidate. */
-                    pIceCandidatePair->connectivityChecks |= 1 << 0;
+    if( ( pIceAgent == NULL ) ||
+        ( pPackets == NULL ) ||
+        ( pResults == NULL ) )
+    {
+        packetCount = 0;
+    }
 
-                    retStatus = Ice_CreateRequestForConnectivityCheck( pIceAgent,
-                                                                       pIceAgent->stunMessageBuffers[ pIceAgent->stunMessageBufferUsedCount++ ],
-                                                                       pTransactionIdBuffer );
-                    if( retStatus == ICE_RESULT_OK )
-                    {
-                        retStatus = ICE_RESULT_SEND_STUN_REQUEST_RESPONSE;
-                    }
-                }
-            }
+    for( i = 0; i < packetCount; i++ )
+    {
+        if( pIceAgent->outboundFreeCount < ICE_MAX_OUTBOUND_MESSAGES_PER_PACKET )
+        {
+            break;
         }
-        break;
-        case STUN_MESSAGE_TYPE_BINDING_SUCCESS_RESPONSE:
+
+        if( pIceAgent->statsClock != NULL )
         {
-            if( Ice_TransactionIdStoreHasId( pIceAgent->pStunBindingRequestTransactionIdStore,
-                                             pStunMessageBuffer + STUN_HEADER_TRANSACTION_ID_OFFSET ) )
-            {
-                if( retStatus == ICE_RESULT_UPDATE_SRFLX_CANDIDATE )
-                {
-                    retStatus = Ice_HandleServerReflexiveCandidateResponse( pIceAgent,
-                                                                            &pStunAttributeAddress,
-                                                                            pLocalCandidate );
+            startTime = pIceAgent->statsClock();
+        }
 
-                    if( retStatus == ICE_RESULT_OK )
-                    {
-                        Ice_TransactionIdStoreRemove( pIceAgent->pStunBindingRequestTransactionIdStore,
-                                                      pStunMessageBuffer + STUN_HEADER_TRANSACTION_ID_OFFSET );
-                    }
-                }
-            }
-            else
-            {
+        pResult = &( pResults[ i ] );
+        pResult->pIceCandidatePair = NULL;
+        readyCount = pIceAgent->outboundReadyCount;
 
-                if( pIceCandidatePair->connectivityChecks == ICE_CONNECTIVITY_SUCCESS_FLAG )
-                {
-                    if( pIceCandidatePair->state == ICE_CANDIDATE_PAIR_STATE_NOMINATED )
-                    {
-                        pIceCandidatePair->state = ICE_CANDIDATE_PAIR_STATE_SUCCEEDED;
-                        retStatus = ICE_RESULT_CANDIDATE_PAIR_READY;
-                    }
-                    else
-                    {
-                        pIceCandidatePair->state = ICE_CANDIDATE_PAIR_STATE_VALID;
-                        retStatus = ICE_RESULT_START_NOMINATION;
-                    }
-                }
-                else
-                {
-                    pIceCandidatePair->connectivityChecks |= 1 << 1;
+        if( ( pLastLocalAddress == NULL ) ||
+            ( Ice_IsSameIpAddress( ( StunAttributeAddress_t * ) &( pLastLocalAddress->ipAddress ),
+                                   ( StunAttributeAddress_t * ) &( pPackets[ i ].localAddress.ipAddress ),
+                                   true ) == false ) )
+        {
+            pLastLocalAddress = &( pPackets[ i ].localAddress );
+            pLocalCandidate = Ice_FindCandidateFromIp( pIceAgent,
+                                                       pLastLocalAddress,
+                                                       ICE_SOCKET_PROTOCOL_UDP,
+                                                       false );
+        }
 
-                    if( &pStunAttributeAddress != NULL )
-                    {
-                        if( ( pIceCandidatePair->local->iceCandidateType == ICE_CANDIDATE_TYPE_SERVER_REFLEXIVE ) &&
-                            ( pIceCandidatePair->remote->iceCandidateType == ICE_CANDIDATE_TYPE_SERVER_REFLEXIVE ) &&
-                            ( Ice_IsSameIpAddress( &pStunAttributeAddress,
-                                                   &pIceCandidatePair->local->ipAddress.ipAddress,
-                                                   false ) == 0 ) )
-                        {
-                            printf( "Local Candidate IP address does not match with XOR mapped address in binding response.\n" );
-
-                            IceIPAddress_t pAddr;
-                            pAddr.ipAddress = pStunAttributeAddress;
-                            pAddr.isPointToPoint = 0;
-
-                            retStatus = Ice_CheckPeerReflexiveCandidate( pIceAgent,
-                                                                         pAddr,
-                                                                         pIceCandidatePair->local->priority,
-                                                                         pIceCandidatePair );
-                        }
-                    }
-                    else
-                    {
-                        printf( "No mapped address attribute found in STUN response. Dropping Packet.\n" );
-                    }
+        pResult->result = Ice_ClassifyStunPacket( pIceAgent,
+                                                  pPackets[ i ].pBuffer,
+                                                  pPackets[ i ].bufferLength );
 
-                }
-            }
+        if( ( pResult->result == ICE_RESULT_OK ) && ( pLocalCandidate == NULL ) )
+        {
+            pResult->result = ICE_RESULT_LOCAL_CANDIDATE_NOT_FOUND;
         }
-        break;
-        case STUN_MESSAGE_TYPE_BINDING_INDICATION:
-            printf( "Received STUN binding indication.\n" );
-            break;
-        default:
-            printf( "STUN packet received is neither a Binding Request nor a Response.\n" );
-            break;
+
+        if( pResult->result == ICE_RESULT_OK )
+        {
+            memcpy( pResult->transactionId,
+                    pPackets[ i ].pBuffer + STUN_HEADER_TRANSACTION_ID_OFFSET,
+                    STUN_HEADER_TRANSACTION_ID_LENGTH );
+
+            pResult->result = Ice_RouteReceivedStunPacket( pIceAgent,
+                                                           pPackets[ i ].pBuffer,
+                                                           pPackets[ i ].bufferLength,
+                                                           pLocalCandidate,
+                                                           &( pPackets[ i ].srcAddress ),
+                                                           &( pResult->pIceCandidatePair ) );
+        }
+
+        pResult->outboundBufferCount = pIceAgent->outboundReadyCount - readyCount;
+
+        if( pIceAgent->statsClock != NULL )
+        {
+            Ice_HistogramRecord( &( pIceAgent->stats.handlerTime ),
+                                 pIceAgent->statsClock() - startTime );
         }
     }
-    return retStatus;
+
+    return i;
 }
 
 /*------------------------------------------------------------------------------------------------------------------*/
@@ -976,15 +3568,19 @@ IceResult_t Ice_HandleServerReflexiveCandidateResponse( IceAgent_t * pIceAgent,
 IceResult_t Ice_InsertLocalCandidate( IceAgent_t * pIceAgent,
                                       IceCandidate_t localCandidate )
 {
-    int i;
     IceResult_t retStatus = ICE_RESULT_OK;
     int localCandidateCount = Ice_GetValidLocalCandidateCount( pIceAgent );
 
-    retStatus = ( localCandidateCount == ICE_MAX_LOCAL_CANDIDATE_COUNT ) ? ICE_RESULT_MAX_CANDIDATE_THRESHOLD : ICE_RESULT_OK;
+    retStatus = ( ( uint32_t ) localCandidateCount == pIceAgent->maxLocalCandidates ) ? ICE_RESULT_MAX_CANDIDATE_THRESHOLD : ICE_RESULT_OK;
 
     if( retStatus == ICE_RESULT_OK )
     {
         pIceAgent->localCandidates[ localCandidateCount ] = localCandidate;
+        pIceAgent->localCandidateCount = localCandidateCount + 1;
+
+        retStatus = Ice_HashIndexInsert( &( pIceAgent->localCandidateIndex ),
+                                         Ice_HashAddress( &( localCandidate.ipAddress.ipAddress ), localCandidate.remoteProtocol, pIceAgent->hashSeed ),
+                                         ( uint32_t ) localCandidateCount );
     }
 
     return retStatus;
@@ -996,66 +3592,46 @@ IceResult_t Ice_InsertLocalCandidate( IceAgent_t * pIceAgent,
 IceResult_t Ice_InsertRemoteCandidate( IceAgent_t * pIceAgent,
                                        IceCandidate_t remoteCandidate )
 {
-    int i;
     IceResult_t retStatus = ICE_RESULT_OK;
     int remoteCandidateCount = Ice_GetValidRemoteCandidateCount( pIceAgent );
 
-    retStatus = ( remoteCandidateCount == ICE_MAX_REMOTE_CANDIDATE_COUNT ) ? ICE_RESULT_MAX_CANDIDATE_THRESHOLD : ICE_RESULT_OK;
+    retStatus = ( ( uint32_t ) remoteCandidateCount == pIceAgent->maxRemoteCandidates ) ? ICE_RESULT_MAX_CANDIDATE_THRESHOLD : ICE_RESULT_OK;
 
     if( retStatus == ICE_RESULT_OK )
     {
         pIceAgent->remoteCandidates[ remoteCandidateCount ] = remoteCandidate;
+        pIceAgent->remoteCandidateCount = remoteCandidateCount + 1;
+
+        retStatus = Ice_HashIndexInsert( &( pIceAgent->remoteCandidateIndex ),
+                                         Ice_HashAddress( &( remoteCandidate.ipAddress.ipAddress ), remoteCandidate.remoteProtocol, pIceAgent->hashSeed ),
+                                         ( uint32_t ) remoteCandidateCount );
     }
 
     return retStatus;
 }
 /*------------------------------------------------------------------------------------------------------------------*/
 
-/* Ice_GetValidLocalCandidateCount - Get valid Local Candidate count */
+/* Ice_GetValidLocalCandidateCount - Get valid Local Candidate count, maintained on every insert. Slots are filled in order, so this is also the next free slot. */
 
 int Ice_GetValidLocalCandidateCount( IceAgent_t * pIceAgent )
 {
-    int i;
-
-    for( i = 0; i < ICE_MAX_LOCAL_CANDIDATE_COUNT; i++ )
-    {
-        if( pIceAgent->localCandidates[ i ].state == ICE_CANDIDATE_STATE_INVALID ) {
-            break;
-        }
-    }
-    return( i );
+    return( ( int ) pIceAgent->localCandidateCount );
 }
 /*------------------------------------------------------------------------------------------------------------------*/
 
-/* Ice_GetValidRemoteCandidateCount - Get valid Remote Candidate count */
+/* Ice_GetValidRemoteCandidateCount - Get valid Remote Candidate count, maintained on every insert. Slots are filled in order, so this is also the next free slot. */
 
 int Ice_GetValidRemoteCandidateCount( IceAgent_t * pIceAgent )
 {
-    int i;
-
-    for( i = 0; i < ICE_MAX_REMOTE_CANDIDATE_COUNT; i++ )
-    {
-        if( pIceAgent->remoteCandidates[ i ].state == ICE_CANDIDATE_STATE_INVALID ) {
-            break;
-        }
-    }
-    return( i );
+    return( ( int ) pIceAgent->remoteCandidateCount );
 }
 /*------------------------------------------------------------------------------------------------------------------*/
 
-/* Ice_GetValidCandidatePairCount - Get valid Candidate Pair Count */
+/* Ice_GetValidCandidatePairCount - Get valid Candidate Pair Count, maintained on every insert. */
 
 int Ice_GetValidCandidatePairCount( IceAgent_t * pIceAgent )
 {
-    int i;
-
-    for( i = 0; i < ICE_MAX_CANDIDATE_PAIR_COUNT; i++ )
-    {
-        if( pIceAgent->iceCandidatePairs[ i ].state == ICE_CANDIDATE_PAIR_STATE_INVALID ) {
-            break;
-        }
-    }
-    return( i );
+    return( ( int ) pIceAgent->iceCandidatePairCount );
 }
 /*------------------------------------------------------------------------------------------------------------------*/
 
@@ -1106,149 +3682,513 @@ uint64_t Ice_ComputeCandidatePairPriority( IceCandidatePair_t * pIceCandidatePai
 }
 /*------------------------------------------------------------------------------------------------------------------*/
 
-/* Ice_CreateTransactionIdStore - Creates the Transaction ID Store. */
+/* Ice_CreateTransactionIdStore - Creates the Transaction ID Store over maxIdCount transaction slots and
+ * Ice_HashIndexGetBucketCount( maxIdCount ) hash buckets provided by the caller. */
 
 IceResult_t Ice_CreateTransactionIdStore( uint32_t maxIdCount,
+                                          uint64_t transactionTimeout,
+                                          uint32_t hashSeed,
+                                          IceTransaction_t * pTransactions,
+                                          IceHashBucket_t * pBuckets,
                                           TransactionIdStore_t * pTransactionIdStore )
 {
     IceResult_t retStatus = ICE_RESULT_OK;
+    uint32_t i;
 
-    if( ( maxIdCount > MAX_STORED_TRANSACTION_ID_COUNT ) || ( maxIdCount < 0 ) )
+    if( ( maxIdCount > MAX_STORED_TRANSACTION_ID_COUNT ) ||
+        ( maxIdCount == 0 ) ||
+        ( pTransactions == NULL ) ||
+        ( pBuckets == NULL ) ||
+        ( pTransactionIdStore == NULL ) )
     {
         retStatus = ICE_RESULT_BAD_PARAM;
     }
 
     if( retStatus == ICE_RESULT_OK )
     {
-        pTransactionIdStore->transactionIds = ( uint8_t * )( pTransactionIdStore + 1 );
+        pTransactionIdStore->pTransactions = pTransactions;
         pTransactionIdStore->maxTransactionIdsCount = maxIdCount;
+        pTransactionIdStore->transactionIdCount = 0;
+        pTransactionIdStore->oldestTransactionIndex = ICE_TRANSACTION_INVALID_INDEX;
+        pTransactionIdStore->newestTransactionIndex = ICE_TRANSACTION_INVALID_INDEX;
+        pTransactionIdStore->transactionTimeout = transactionTimeout;
+        pTransactionIdStore->hashSeed = hashSeed;
+        pTransactionIdStore->pTimerWheel = NULL;
+        pTransactionIdStore->pTimerContext = NULL;
+        pTransactionIdStore->initialRto = ICE_DEFAULT_INITIAL_RTO_MS;
+        pTransactionIdStore->pSharedIndex = NULL;
+        pTransactionIdStore->sharedEntry = 0;
+
+        /* Chain every slot into the free list. */
+        for( i = 0; i < maxIdCount; i++ )
+        {
+            pTransactions[ i ].purpose = ICE_TRANSACTION_PURPOSE_NONE;
+            Ice_TimerInit( &( pTransactions[ i ].timer ),
+                           NULL );
+            pTransactions[ i ].next = ( i + 1 < maxIdCount ) ? ( i + 1 ) : ICE_TRANSACTION_INVALID_INDEX;
+        }
+        pTransactionIdStore->freeTransactionIndex = 0;
+
+        Ice_HashIndexInit( &( pTransactionIdStore->transactionIndex ),
+                           pBuckets,
+                           Ice_HashIndexGetBucketCount( maxIdCount ) );
     }
 
     return retStatus;
 }
 /*------------------------------------------------------------------------------------------------------------------*/
 
-/* Ice_TransactionIdStoreInsert - Inserts the Transaction in the IceAgent Transaction ID Store. */
+/* Ice_TransactionIdStoreUnlink - Removes a transaction slot from the hash index and the insertion order list, and frees it. */
 
-void Ice_TransactionIdStoreInsert( TransactionIdStore_t * pTransactionIdStore,
-                                   uint8_t * transactionId )
+static void Ice_TransactionIdStoreUnlink( TransactionIdStore_t * pTransactionIdStore,
+                                          uint32_t transactionIndex )
+{
+    IceTransaction_t * pTransaction = &( pTransactionIdStore->pTransactions[ transactionIndex ] );
+
+    if( pTransactionIdStore->pTimerWheel != NULL )
+    {
+        Ice_TimerWheelCancel( pTransactionIdStore->pTimerWheel,
+                              &( pTransaction->timer ) );
+    }
+
+    Ice_HashIndexRemove( &( pTransactionIdStore->transactionIndex ),
+                         pTransaction->hash,
+                         transactionIndex );
+
+    if( pTransactionIdStore->pSharedIndex != NULL )
+    {
+        Ice_HashIndexRemove( pTransactionIdStore->pSharedIndex,
+                             pTransaction->hash,
+                             pTransactionIdStore->sharedEntry );
+    }
+
+    if( pTransaction->prev != ICE_TRANSACTION_INVALID_INDEX )
+    {
+        pTransactionIdStore->pTransactions[ pTransaction->prev ].next = pTransaction->next;
+    }
+    else
+    {
+        pTransactionIdStore->oldestTransactionIndex = pTransaction->next;
+    }
+
+    if( pTransaction->next != ICE_TRANSACTION_INVALID_INDEX )
+    {
+        pTransactionIdStore->pTransactions[ pTransaction->next ].prev = pTransaction->prev;
+    }
+    else
+    {
+        pTransactionIdStore->newestTransactionIndex = pTransaction->prev;
+    }
+
+    pTransaction->purpose = ICE_TRANSACTION_PURPOSE_NONE;
+    pTransaction->pIceCandidatePair = NULL;
+    pTransaction->pLocalCandidate = NULL;
+    pTransaction->next = pTransactionIdStore->freeTransactionIndex;
+    pTransactionIdStore->freeTransactionIndex = transactionIndex;
+    pTransactionIdStore->transactionIdCount--;
+}
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_TransactionIdStoreInsert - Inserts the Transaction in the IceAgent Transaction ID Store in O(1), together with
+ * its purpose, owner and send time. When the store is full, the oldest transaction is dropped to make room.
+ * A store sharing its IDs indexes the transaction under its sharedEntry in the shared index too; when either index
+ * is full the transaction is not stored.
+ * With a timer wheel, the first retransmission ( or the timeout ) of the transaction is scheduled as well. */
+
+IceResult_t Ice_TransactionIdStoreInsert( TransactionIdStore_t * pTransactionIdStore,
+                                          uint8_t * transactionId,
+                                          IceTransactionPurpose_t purpose,
+                                          IceCandidatePair_t * pIceCandidatePair,
+                                          IceCandidate_t * pLocalCandidate,
+                                          uint64_t sendTime )
 {
-    uint8_t * storeLocation = NULL;
-    uint32_t transactionIDCount;
+    IceResult_t retStatus = ICE_RESULT_OK;
+    IceTransaction_t * pTransaction;
+    uint32_t transactionIndex;
+
+    if( ( pTransactionIdStore == NULL ) ||
+        ( transactionId == NULL ) ||
+        ( pTransactionIdStore->pTransactions == NULL ) )
+    {
+        retStatus = ICE_RESULT_BAD_PARAM;
+    }
 
-    if( pTransactionIdStore != NULL )
+    if( retStatus == ICE_RESULT_OK )
     {
-        storeLocation = pTransactionIdStore->transactionIds + ( ( pTransactionIdStore->nextTransactionIdIndex % pTransactionIdStore->maxTransactionIdsCount ) * STUN_HEADER_TRANSACTION_ID_LENGTH );
-        memcpy( storeLocation,
+        if( pTransactionIdStore->freeTransactionIndex == ICE_TRANSACTION_INVALID_INDEX )
+        {
+            Ice_TransactionIdStoreUnlink( pTransactionIdStore,
+                                          pTransactionIdStore->oldestTransactionIndex );
+        }
+
+        transactionIndex = pTransactionIdStore->freeTransactionIndex;
+        pTransaction = &( pTransactionIdStore->pTransactions[ transactionIndex ] );
+        pTransactionIdStore->freeTransactionIndex = pTransaction->next;
+
+        memcpy( pTransaction->transactionId,
                 transactionId,
                 STUN_HEADER_TRANSACTION_ID_LENGTH );
+        pTransaction->purpose = purpose;
+        pTransaction->pIceCandidatePair = pIceCandidatePair;
+        pTransaction->pLocalCandidate = pLocalCandidate;
+        pTransaction->sendTime = sendTime;
+        pTransaction->deadline = sendTime + pTransactionIdStore->transactionTimeout;
+        pTransaction->priority = 0;
+        pTransaction->isControlling = 0;
+        pTransaction->requestCount = 1;
+        pTransaction->hash = Ice_HashBytes( transactionId,
+                                            STUN_HEADER_TRANSACTION_ID_LENGTH,
+                                            pTransactionIdStore->hashSeed );
+
+        retStatus = Ice_HashIndexInsert( &( pTransactionIdStore->transactionIndex ),
+                                         pTransaction->hash,
+                                         transactionIndex );
+
+        if( ( retStatus == ICE_RESULT_OK ) &&
+            ( pTransactionIdStore->pSharedIndex != NULL ) )
+        {
+            retStatus = Ice_HashIndexInsert( pTransactionIdStore->pSharedIndex,
+                                             pTransaction->hash,
+                                             pTransactionIdStore->sharedEntry );
 
-        pTransactionIdStore->nextTransactionIdIndex = ( pTransactionIdStore->nextTransactionIdIndex + 1 ) % pTransactionIdStore->maxTransactionIdsCount;
+            if( retStatus != ICE_RESULT_OK )
+            {
+                Ice_HashIndexRemove( &( pTransactionIdStore->transactionIndex ),
+                                     pTransaction->hash,
+                                     transactionIndex );
+            }
+        }
 
-        if( pTransactionIdStore->nextTransactionIdIndex == pTransactionIdStore->earliestTransactionIdIndex ) {
-            pTransactionIdStore->earliestTransactionIdIndex =
-                ( pTransactionIdStore->earliestTransactionIdIndex + 1 ) % pTransactionIdStore->maxTransactionIdsCount;
-            return;
+        if( retStatus != ICE_RESULT_OK )
+        {
+            /* Not indexed, give the slot back rather than keep a transaction no response can find. */
+            pTransaction->purpose = ICE_TRANSACTION_PURPOSE_NONE;
+            pTransaction->pIceCandidatePair = NULL;
+            pTransaction->pLocalCandidate = NULL;
+            pTransaction->next = pTransactionIdStore->freeTransactionIndex;
+            pTransactionIdStore->freeTransactionIndex = transactionIndex;
         }
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        /* Append to the newest end of the insertion order list. */
+        pTransaction->prev = pTransactionIdStore->newestTransactionIndex;
+        pTransaction->next = ICE_TRANSACTION_INVALID_INDEX;
 
-        transactionIDCount = ( ( pTransactionIdStore->transactionIdCount + 1 ) > ( pTransactionIdStore->maxTransactionIdsCount ) ) ? pTransactionIdStore->maxTransactionIdsCount : ( pTransactionIdStore->transactionIdCount + 1 );
+        if( pTransactionIdStore->newestTransactionIndex != ICE_TRANSACTION_INVALID_INDEX )
+        {
+            pTransactionIdStore->pTransactions[ pTransactionIdStore->newestTransactionIndex ].next = transactionIndex;
+        }
+        else
+        {
+            pTransactionIdStore->oldestTransactionIndex = transactionIndex;
+        }
+        pTransactionIdStore->newestTransactionIndex = transactionIndex;
+        pTransactionIdStore->transactionIdCount++;
 
-        pTransactionIdStore->transactionIdCount = transactionIDCount;
+        if( pTransactionIdStore->pTimerWheel != NULL )
+        {
+            Ice_ScheduleTransactionTimer( pTransactionIdStore,
+                                          pTransaction );
+        }
     }
+
+    return retStatus;
 }
 /*------------------------------------------------------------------------------------------------------------------*/
 
-/* Ice_TransactionIdStoreHasId - Checks if the transaction is present in the Transaction ID Store. */
+/* Ice_TransactionIdStoreFind - Looks up a transaction by its ID in O(1). Returns NULL if the ID is not outstanding. */
 
-bool Ice_TransactionIdStoreHasId( TransactionIdStore_t * pTransactionIdStore,
-                                  uint8_t * transactionId )
+IceTransaction_t * Ice_TransactionIdStoreFind( TransactionIdStore_t * pTransactionIdStore,
+                                               uint8_t * transactionId )
 {
-    bool idFound = false;
-    int i, j;
+    IceTransaction_t * pTransaction = NULL;
+    uint32_t hash, transactionIndex;
+    uint32_t cursor = ICE_HASH_INDEX_CURSOR_START;
 
-    if( pTransactionIdStore != NULL )
+    if( ( pTransactionIdStore != NULL ) &&
+        ( transactionId != NULL ) &&
+        ( pTransactionIdStore->transactionIdCount > 0 ) )
     {
-        for( i = pTransactionIdStore->earliestTransactionIdIndex, j = 0; j < pTransactionIdStore->maxTransactionIdsCount && !idFound; ++j ) {
-            if( memcmp( transactionId,
-                        pTransactionIdStore->transactionIds + i * STUN_HEADER_TRANSACTION_ID_LENGTH,
-                        STUN_HEADER_TRANSACTION_ID_LENGTH ) == 0 ) {
-                idFound = true;
+        hash = Ice_HashBytes( transactionId,
+                              STUN_HEADER_TRANSACTION_ID_LENGTH,
+                              pTransactionIdStore->hashSeed );
+
+        while( ( pTransaction == NULL ) &&
+               ( ( transactionIndex = Ice_HashIndexFindNext( &( pTransactionIdStore->transactionIndex ), hash, &cursor ) ) != ICE_HASH_INDEX_NOT_FOUND ) )
+        {
+            if( memcmp( pTransactionIdStore->pTransactions[ transactionIndex ].transactionId,
+                        transactionId,
+                        STUN_HEADER_TRANSACTION_ID_LENGTH ) == 0 )
+            {
+                pTransaction = &( pTransactionIdStore->pTransactions[ transactionIndex ] );
             }
-            i = ( i + 1 ) % pTransactionIdStore->maxTransactionIdsCount;
         }
     }
-    return idFound;
+
+    return pTransaction;
+}
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_TransactionIdStoreHasId - Checks if the transaction is present in the Transaction ID Store. */
+
+bool Ice_TransactionIdStoreHasId( TransactionIdStore_t * pTransactionIdStore,
+                                  uint8_t * transactionId )
+{
+    return( Ice_TransactionIdStoreFind( pTransactionIdStore,
+                                        transactionId ) != NULL );
 }
 /*------------------------------------------------------------------------------------------------------------------*/
 
-/* Ice_TransactionIdStoreRemove - Inserts the Transaction in the IceAgent Transaction ID Store. */
+/* Ice_TransactionIdStoreRemove - Removes the Transaction from the IceAgent Transaction ID Store in O(1). */
 
 void Ice_TransactionIdStoreRemove( TransactionIdStore_t * pTransactionIdStore,
                                    uint8_t * transactionId )
 {
-    uint32_t i, j;
+    IceTransaction_t * pTransaction = Ice_TransactionIdStoreFind( pTransactionIdStore,
+                                                                  transactionId );
 
-    if( pTransactionIdStore != NULL )
+    if( pTransaction != NULL )
     {
-        for( i = pTransactionIdStore->earliestTransactionIdIndex, j = 0; j < pTransactionIdStore->maxTransactionIdsCount; ++j )
-        {
-            if( memcmp( transactionId,
-                        pTransactionIdStore->transactionIds + i * STUN_HEADER_TRANSACTION_ID_LENGTH,
-                        STUN_HEADER_TRANSACTION_ID_LENGTH ) == 0 )
-            {
-                memset( pTransactionIdStore->transactionIds + i * STUN_HEADER_TRANSACTION_ID_LENGTH,
-                        0x00,
-                        STUN_HEADER_TRANSACTION_ID_LENGTH );
-                return;
-            }
+        Ice_TransactionIdStoreUnlink( pTransactionIdStore,
+                                      ( uint32_t )( pTransaction - pTransactionIdStore->pTransactions ) );
+    }
+}
+/*------------------------------------------------------------------------------------------------------------------*/
 
-            i = ( i + 1 ) % pTransactionIdStore->maxTransactionIdsCount;
+/* Ice_TransactionIdStoreRemovePair - Removes every transaction of the given purpose outstanding on a candidate pair,
+ * cancelling its timer. Returns the number removed. */
+
+uint32_t Ice_TransactionIdStoreRemovePair( TransactionIdStore_t * pTransactionIdStore,
+                                           const IceCandidatePair_t * pIceCandidatePair,
+                                           IceTransactionPurpose_t purpose )
+{
+    uint32_t removedCount = 0;
+    uint32_t transactionIndex = ICE_TRANSACTION_INVALID_INDEX;
+    uint32_t nextIndex;
+
+    if( ( pTransactionIdStore != NULL ) &&
+        ( pIceCandidatePair != NULL ) )
+    {
+        transactionIndex = pTransactionIdStore->oldestTransactionIndex;
+    }
+
+    while( transactionIndex != ICE_TRANSACTION_INVALID_INDEX )
+    {
+        nextIndex = pTransactionIdStore->pTransactions[ transactionIndex ].next;
+
+        if( ( pTransactionIdStore->pTransactions[ transactionIndex ].pIceCandidatePair == pIceCandidatePair ) &&
+            ( pTransactionIdStore->pTransactions[ transactionIndex ].purpose == purpose ) )
+        {
+            Ice_TransactionIdStoreUnlink( pTransactionIdStore,
+                                          transactionIndex );
+            removedCount++;
         }
+
+        transactionIndex = nextIndex;
     }
+
+    return removedCount;
 }
 /*------------------------------------------------------------------------------------------------------------------*/
 
-/* Ice_FindCandidateFromIp - This API is called internally to search for a candidate with a given IP. */
+/* Ice_TransactionIdStoreClear - Removes every outstanding transaction, cancelling its timer, in time proportional to their
+ * number. */
 
-IceCandidate_t Ice_FindCandidateFromIp( IceAgent_t * pIceAgent,
-                                          IceIPAddress_t pIpAddress,
-                                          bool isRemote )
+void Ice_TransactionIdStoreClear( TransactionIdStore_t * pTransactionIdStore )
 {
-    IceCandidate_t iceCandidate;
-    int candidateCount, i;
-    IceCandidate_t candidateList[ ICE_MAX_LOCAL_CANDIDATE_COUNT ];
+    while( ( pTransactionIdStore != NULL ) &&
+           ( pTransactionIdStore->oldestTransactionIndex != ICE_TRANSACTION_INVALID_INDEX ) )
+    {
+        Ice_TransactionIdStoreUnlink( pTransactionIdStore,
+                                      pTransactionIdStore->oldestTransactionIndex );
+    }
+}
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_TransactionIdStoreExpire - Ages out every transaction whose deadline has passed. Deadlines follow insertion
+ * order, so only the expired entries at the oldest end of the list are visited. Returns the number removed.
+ * A store attached to a timer wheel is left alone, its transactions expire through Ice_HandleExpiredTimers. */
+
+uint32_t Ice_TransactionIdStoreExpire( TransactionIdStore_t * pTransactionIdStore,
+                                       uint64_t currentTime )
+{
+    uint32_t expiredCount = 0;
+
+    while( ( pTransactionIdStore != NULL ) &&
+           ( pTransactionIdStore->pTimerWheel == NULL ) &&
+           ( pTransactionIdStore->oldestTransactionIndex != ICE_TRANSACTION_INVALID_INDEX ) &&
+           ( pTransactionIdStore->pTransactions[ pTransactionIdStore->oldestTransactionIndex ].deadline <= currentTime ) )
+    {
+        Ice_TransactionIdStoreUnlink( pTransactionIdStore,
+                                      pTransactionIdStore->oldestTransactionIndex );
+        expiredCount++;
+    }
+
+    return expiredCount;
+}
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_TransactionIdStoreShareIndex - Makes the store index its transaction IDs in pSharedIndex as well, under
+ * sharedEntry and hashed with hashSeed, so the owner of the shared index can tell which store an ID belongs to.
+ * Outstanding transactions are moved over, at most maxTransactionIdsCount of them. NULL stops sharing. */
+
+IceResult_t Ice_TransactionIdStoreShareIndex( TransactionIdStore_t * pTransactionIdStore,
+                                              IceHashIndex_t * pSharedIndex,
+                                              uint32_t hashSeed,
+                                              uint32_t sharedEntry )
+{
+    IceResult_t retStatus = ICE_RESULT_OK;
+    IceTransaction_t * pTransaction;
+    uint32_t transactionIndex;
+
+    if( pTransactionIdStore == NULL )
+    {
+        retStatus = ICE_RESULT_BAD_PARAM;
+    }
 
-    if( isRemote == false )
+    if( retStatus == ICE_RESULT_OK )
     {
-        candidateCount = Ice_GetValidLocalCandidateCount( pIceAgent );
-        for( i = 0; i < candidateCount; i++ )
+        for( transactionIndex = pTransactionIdStore->oldestTransactionIndex;
+             transactionIndex != ICE_TRANSACTION_INVALID_INDEX;
+             transactionIndex = pTransaction->next )
+        {
+            pTransaction = &( pTransactionIdStore->pTransactions[ transactionIndex ] );
+
+            if( pTransactionIdStore->pSharedIndex != NULL )
+            {
+                Ice_HashIndexRemove( pTransactionIdStore->pSharedIndex,
+                                     pTransaction->hash,
+                                     pTransactionIdStore->sharedEntry );
+            }
+
+            /* Both indexes use the same hash, re-key the store when the seed changes. */
+            if( ( pSharedIndex != NULL ) &&
+                ( hashSeed != pTransactionIdStore->hashSeed ) )
+            {
+                Ice_HashIndexRemove( &( pTransactionIdStore->transactionIndex ),
+                                     pTransaction->hash,
+                                     transactionIndex );
+                pTransaction->hash = Ice_HashBytes( pTransaction->transactionId,
+                                                    STUN_HEADER_TRANSACTION_ID_LENGTH,
+                                                    hashSeed );
+                ( void ) Ice_HashIndexInsert( &( pTransactionIdStore->transactionIndex ),
+                                              pTransaction->hash,
+                                              transactionIndex );
+            }
+
+            if( ( pSharedIndex != NULL ) &&
+                ( retStatus == ICE_RESULT_OK ) )
+            {
+                retStatus = Ice_HashIndexInsert( pSharedIndex,
+                                                 pTransaction->hash,
+                                                 sharedEntry );
+            }
+        }
+
+        if( pSharedIndex != NULL )
         {
-            candidateList[i] = pIceAgent->localCandidates[i];
+            pTransactionIdStore->hashSeed = hashSeed;
         }
+
+        pTransactionIdStore->pSharedIndex = pSharedIndex;
+        pTransactionIdStore->sharedEntry = sharedEntry;
     }
-    else
+
+    return retStatus;
+}
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_FindCandidateFromIp - This API is called internally to search for a candidate with a given transport address.
+ * Resolves through the agent's address index in constant time. Returns NULL if no candidate matches. */
+
+IceCandidate_t * Ice_FindCandidateFromIp( IceAgent_t * pIceAgent,
+                                          const IceIPAddress_t * pIpAddress,
+                                          IceSocketProtocol_t protocol,
+                                          bool isRemote )
+{
+    IceCandidate_t * pIceCandidate = NULL;
+    IceCandidate_t * pCandidates;
+    const IceHashIndex_t * pHashIndex;
+    uint32_t hash, candidateIndex;
+    uint32_t cursor = ICE_HASH_INDEX_CURSOR_START;
+
+    if( ( pIceAgent != NULL ) && ( pIpAddress != NULL ) )
     {
-        candidateCount = Ice_GetValidRemoteCandidateCount( pIceAgent );
-        for( i = 0; i < candidateCount; i++ )
+        pCandidates = isRemote ? pIceAgent->remoteCandidates : pIceAgent->localCandidates;
+        pHashIndex = isRemote ? &( pIceAgent->remoteCandidateIndex ) : &( pIceAgent->localCandidateIndex );
+        hash = Ice_HashAddress( &( pIpAddress->ipAddress ), protocol, pIceAgent->hashSeed );
+
+        while( ( pIceCandidate == NULL ) &&
+               ( ( candidateIndex = Ice_HashIndexFindNext( pHashIndex, hash, &cursor ) ) != ICE_HASH_INDEX_NOT_FOUND ) )
         {
-            candidateList[i] = pIceAgent->remoteCandidates[i];
+            if( ( pCandidates[ candidateIndex ].remoteProtocol == protocol ) &&
+                Ice_IsSameIpAddress( &( pCandidates[ candidateIndex ].ipAddress.ipAddress ),
+                                     ( StunAttributeAddress_t * ) &( pIpAddress->ipAddress ),
+                                     true ) )
+            {
+                pIceCandidate = &( pCandidates[ candidateIndex ] );
+            }
         }
     }
 
-    StunAttributeAddress_t pIceIpAdress = pIpAddress.ipAddress;
-    uint32_t addrLen = IS_IPV4_ADDR( pIceIpAdress ) ? STUN_IPV4_ADDRESS_SIZE : STUN_IPV6_ADDRESS_SIZE;
-    for( i = 0; i < candidateCount; i++ )
+    return pIceCandidate;
+}
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_HashCandidatePair - Key of the candidate pair index: the local candidate slot and the remote transport address. */
+
+uint32_t Ice_HashCandidatePair( IceAgent_t * pIceAgent,
+                                const IceCandidate_t * pLocalCandidate,
+                                const IceIPAddress_t * pRemoteAddress )
+{
+    uint32_t localCandidateIndex = ( uint32_t ) ( pLocalCandidate - pIceAgent->localCandidates );
+
+    return Ice_HashAddress( &( pRemoteAddress->ipAddress ),
+                            ICE_SOCKET_PROTOCOL_UDP,
+                            pIceAgent->hashSeed ^ ( ( localCandidateIndex + 1 ) * 0x9E3779B9U ) );
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_FindCandidatePair - This API is called internally to find the pair formed by a local candidate and a remote transport address.
+ * Resolves through the agent's candidate pair index in constant time. Returns NULL if no pair matches. */
+
+IceCandidatePair_t * Ice_FindCandidatePair( IceAgent_t * pIceAgent,
+                                            const IceCandidate_t * pLocalCandidate,
+                                            const IceIPAddress_t * pRemoteAddress )
+{
+    IceCandidatePair_t * pIceCandidatePair = NULL;
+    IceCandidatePair_t * pCandidatePair;
+    uint32_t hash, pairIndex;
+    uint32_t cursor = ICE_HASH_INDEX_CURSOR_START;
+
+    if( ( pIceAgent != NULL ) && ( pLocalCandidate != NULL ) && ( pRemoteAddress != NULL ) )
     {
-        if( ( pIceIpAdress.family == candidateList[i].ipAddress.ipAddress.family ) && ( memcmp( candidateList[i].ipAddress.ipAddress.address,
-                                                                                                 pIceIpAdress.address,
-                                                                                                 addrLen ) == 0 ) &&
-            ( pIceIpAdress.port == candidateList[i].ipAddress.ipAddress.port ) )
+        hash = Ice_HashCandidatePair( pIceAgent,
+                                      pLocalCandidate,
+                                      pRemoteAddress );
+
+        while( ( pIceCandidatePair == NULL ) &&
+               ( ( pairIndex = Ice_HashIndexFindNext( &( pIceAgent->candidatePairIndex ), hash, &cursor ) ) != ICE_HASH_INDEX_NOT_FOUND ) )
         {
-            iceCandidate = candidateList[i];
+            pCandidatePair = &( pIceAgent->iceCandidatePairs[ pairIndex ] );
+
+            if( ( pCandidatePair->local == pLocalCandidate ) &&
+                ( pCandidatePair->remote->remoteProtocol == ICE_SOCKET_PROTOCOL_UDP ) &&
+                Ice_IsSameIpAddress( &( pCandidatePair->remote->ipAddress.ipAddress ),
+                                     ( StunAttributeAddress_t * ) &( pRemoteAddress->ipAddress ),
+                                     true ) )
+            {
+                pIceCandidatePair = pCandidatePair;
+            }
         }
     }
-    return iceCandidate;
+
+    return pIceCandidatePair;
 }
+
 /*------------------------------------------------------------------------------------------------------------------*/
 
 /* Ice_IsSameIpAddress - This API is called internally to check if two IPAddress are same. */
@@ -0,0 +1,367 @@
+#include "ice_connection_table.h"
+#include "ice_hash.h"
+#include "ice_random.h"
+
+/* Standard defines. */
+#include <stdlib.h>
+#include <string.h>
+
+/* Memory ordering primitives of the sequence lock. */
+#if defined( __GNUC__ ) || defined( __clang__ )
+    #define ICE_LOAD_RELAXED( pValue )             __atomic_load_n( pValue, __ATOMIC_RELAXED )
+    #define ICE_LOAD_ACQUIRE( pValue )             __atomic_load_n( pValue, __ATOMIC_ACQUIRE )
+    #define ICE_STORE_RELAXED( pValue, value )     __atomic_store_n( pValue, value, __ATOMIC_RELAXED )
+    #define ICE_STORE_RELEASE( pValue, value )     __atomic_store_n( pValue, value, __ATOMIC_RELEASE )
+    #define ICE_EXCHANGE_ACQUIRE( pValue, value )  __atomic_exchange_n( pValue, value, __ATOMIC_ACQUIRE )
+    #define ICE_FENCE_ACQUIRE()                    __atomic_thread_fence( __ATOMIC_ACQUIRE )
+    #define ICE_FENCE_RELEASE()                    __atomic_thread_fence( __ATOMIC_RELEASE )
+#else
+    #error "ice_connection_table.c needs the GCC / Clang __atomic builtins."
+#endif
+
+/* Ice_ConnectionHash - Hashes the ( local address, remote address ) key of a connection. */
+
+static uint32_t Ice_ConnectionHash( const IceConnectionTable_t * pConnectionTable,
+                                    const StunAttributeAddress_t * pLocalAddress,
+                                    const StunAttributeAddress_t * pRemoteAddress )
+{
+    return Ice_HashAddress( pRemoteAddress,
+                            0,
+                            Ice_HashAddress( pLocalAddress,
+                                             0,
+                                             pConnectionTable->hashSeed ) );
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_IsSameAddress - Compares family, port and address of two transport addresses. */
+
+static bool Ice_IsSameAddress( const StunAttributeAddress_t * pAddress1,
+                               const StunAttributeAddress_t * pAddress2 )
+{
+    return ( pAddress1->family == pAddress2->family ) &&
+           ( pAddress1->port == pAddress2->port ) &&
+           ( memcmp( pAddress1->address,
+                     pAddress2->address,
+                     IS_IPV4_ADDR( *pAddress1 ) ? STUN_IPV4_ADDRESS_SIZE : STUN_IPV6_ADDRESS_SIZE ) == 0 );
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_ConnectionTableFindEntry - Returns the slot of a connection, or ICE_HASH_INDEX_NOT_FOUND. Writer side only. */
+
+static uint32_t Ice_ConnectionTableFindEntry( const IceConnectionTable_t * pConnectionTable,
+                                              uint32_t hash,
+                                              const StunAttributeAddress_t * pLocalAddress,
+                                              const StunAttributeAddress_t * pRemoteAddress )
+{
+    uint32_t slot = hash & pConnectionTable->entryMask;
+    uint32_t entryIndex = ICE_HASH_INDEX_NOT_FOUND;
+    const IceConnectionEntry_t * pEntry;
+
+    while( pConnectionTable->pEntries[ slot ].isUsed != 0 )
+    {
+        pEntry = &( pConnectionTable->pEntries[ slot ] );
+
+        if( ( pEntry->hash == hash ) &&
+            Ice_IsSameAddress( &( pEntry->localAddress ), pLocalAddress ) &&
+            Ice_IsSameAddress( &( pEntry->remoteAddress ), pRemoteAddress ) )
+        {
+            entryIndex = slot;
+            break;
+        }
+
+        slot = ( slot + 1 ) & pConnectionTable->entryMask;
+    }
+
+    return entryIndex;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_ConnectionTableBeginWrite / Ice_ConnectionTableEndWrite - Take the writer lock and make the sequence odd while
+ * the entries change, so that concurrent readers retry. */
+
+static void Ice_ConnectionTableBeginWrite( IceConnectionTable_t * pConnectionTable )
+{
+    while( ICE_EXCHANGE_ACQUIRE( &( pConnectionTable->writerLock ), 1 ) != 0 )
+    {
+    }
+
+    ICE_STORE_RELAXED( &( pConnectionTable->sequence ), pConnectionTable->sequence + 1 );
+    ICE_FENCE_RELEASE();
+}
+
+static void Ice_ConnectionTableEndWrite( IceConnectionTable_t * pConnectionTable )
+{
+    ICE_STORE_RELEASE( &( pConnectionTable->sequence ), pConnectionTable->sequence + 1 );
+    ICE_STORE_RELEASE( &( pConnectionTable->writerLock ), 0 );
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_GetConnectionTableMemorySize - Returns the size of the memory block the application hands to Ice_CreateConnectionTable. */
+
+IceResult_t Ice_GetConnectionTableMemorySize( uint32_t maxConnectionCount,
+                                              size_t * pTableMemorySize )
+{
+    IceResult_t retStatus = ICE_RESULT_OK;
+
+    if( ( pTableMemorySize == NULL ) ||
+        ( maxConnectionCount == 0 ) ||
+        ( maxConnectionCount > ICE_MAX_MANAGED_AGENT_COUNT ) )
+    {
+        retStatus = ICE_RESULT_BAD_PARAM;
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        *pTableMemorySize = ICE_AGENT_MEMORY_ALIGN( sizeof( IceConnectionEntry_t ) * Ice_HashIndexGetBucketCount( maxConnectionCount ) );
+    }
+
+    return retStatus;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_CreateConnectionTable - Creates an empty table for up to maxConnectionCount connections over the application
+ * provided memory block, at least the size returned by Ice_GetConnectionTableMemorySize. */
+
+IceResult_t Ice_CreateConnectionTable( IceConnectionTable_t * pConnectionTable,
+                                       uint32_t maxConnectionCount,
+                                       uint8_t * pTableMemory,
+                                       size_t tableMemorySize )
+{
+    IceResult_t retStatus = ICE_RESULT_OK;
+    size_t requiredMemorySize = 0;
+
+    if( ( pConnectionTable == NULL ) ||
+        ( pTableMemory == NULL ) )
+    {
+        retStatus = ICE_RESULT_BAD_PARAM;
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        retStatus = Ice_GetConnectionTableMemorySize( maxConnectionCount,
+                                                      &requiredMemorySize );
+    }
+
+    if( ( retStatus == ICE_RESULT_OK ) && ( tableMemorySize < requiredMemorySize ) )
+    {
+        retStatus = ICE_RESULT_OUT_OF_MEMORY;
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        memset( pTableMemory, 0, requiredMemorySize );
+
+        pConnectionTable->pEntries = ( IceConnectionEntry_t * ) pTableMemory;
+        pConnectionTable->entryMask = Ice_HashIndexGetBucketCount( maxConnectionCount ) - 1;
+        pConnectionTable->maxConnectionCount = maxConnectionCount;
+        pConnectionTable->connectionCount = 0;
+        retStatus = Ice_RandomGetEntropy( ( uint8_t * ) &( pConnectionTable->hashSeed ),
+                                          sizeof( pConnectionTable->hashSeed ) );
+        pConnectionTable->sequence = 0;
+        pConnectionTable->writerLock = 0;
+    }
+
+    return retStatus;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_ConnectionTableInsert - Maps a connection to its agent and candidate pair, replacing the previous mapping of the
+ * connection if any. */
+
+IceResult_t Ice_ConnectionTableInsert( IceConnectionTable_t * pConnectionTable,
+                                       const StunAttributeAddress_t * pLocalAddress,
+                                       const StunAttributeAddress_t * pRemoteAddress,
+                                       IceAgent_t * pIceAgent,
+                                       IceCandidatePair_t * pIceCandidatePair )
+{
+    IceResult_t retStatus = ICE_RESULT_OK;
+    IceConnectionEntry_t * pEntry;
+    uint32_t hash, slot;
+
+    if( ( pConnectionTable == NULL ) ||
+        ( pLocalAddress == NULL ) ||
+        ( pRemoteAddress == NULL ) )
+    {
+        retStatus = ICE_RESULT_BAD_PARAM;
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        hash = Ice_ConnectionHash( pConnectionTable,
+                                   pLocalAddress,
+                                   pRemoteAddress );
+
+        Ice_ConnectionTableBeginWrite( pConnectionTable );
+
+        slot = Ice_ConnectionTableFindEntry( pConnectionTable,
+                                             hash,
+                                             pLocalAddress,
+                                             pRemoteAddress );
+
+        if( slot == ICE_HASH_INDEX_NOT_FOUND )
+        {
+            if( pConnectionTable->connectionCount >= pConnectionTable->maxConnectionCount )
+            {
+                retStatus = ICE_RESULT_OUT_OF_MEMORY;
+            }
+            else
+            {
+                slot = hash & pConnectionTable->entryMask;
+
+                while( pConnectionTable->pEntries[ slot ].isUsed != 0 )
+                {
+                    slot = ( slot + 1 ) & pConnectionTable->entryMask;
+                }
+
+                pEntry = &( pConnectionTable->pEntries[ slot ] );
+                pEntry->localAddress = *pLocalAddress;
+                pEntry->remoteAddress = *pRemoteAddress;
+                pEntry->hash = hash;
+                pEntry->isUsed = 1;
+                pConnectionTable->connectionCount++;
+            }
+        }
+
+        if( retStatus == ICE_RESULT_OK )
+        {
+            pConnectionTable->pEntries[ slot ].pIceAgent = pIceAgent;
+            pConnectionTable->pEntries[ slot ].pIceCandidatePair = pIceCandidatePair;
+        }
+
+        Ice_ConnectionTableEndWrite( pConnectionTable );
+    }
+
+    return retStatus;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_ConnectionTableRemove - Removes the mapping of a connection, if any. Uses backward-shift deletion like
+ * Ice_HashIndexRemove, readers caught in the middle retry. */
+
+void Ice_ConnectionTableRemove( IceConnectionTable_t * pConnectionTable,
+                                const StunAttributeAddress_t * pLocalAddress,
+                                const StunAttributeAddress_t * pRemoteAddress )
+{
+    uint32_t slot, nextSlot, homeSlot;
+
+    if( ( pConnectionTable != NULL ) &&
+        ( pLocalAddress != NULL ) &&
+        ( pRemoteAddress != NULL ) )
+    {
+        Ice_ConnectionTableBeginWrite( pConnectionTable );
+
+        slot = Ice_ConnectionTableFindEntry( pConnectionTable,
+                                             Ice_ConnectionHash( pConnectionTable, pLocalAddress, pRemoteAddress ),
+                                             pLocalAddress,
+                                             pRemoteAddress );
+
+        if( slot != ICE_HASH_INDEX_NOT_FOUND )
+        {
+            nextSlot = ( slot + 1 ) & pConnectionTable->entryMask;
+
+            while( pConnectionTable->pEntries[ nextSlot ].isUsed != 0 )
+            {
+                homeSlot = pConnectionTable->pEntries[ nextSlot ].hash & pConnectionTable->entryMask;
+
+                /* Move the entry back into the hole unless its home slot lies cyclically in ( slot, nextSlot ]. */
+                if( ( ( nextSlot - homeSlot ) & pConnectionTable->entryMask ) >= ( ( nextSlot - slot ) & pConnectionTable->entryMask ) )
+                {
+                    pConnectionTable->pEntries[ slot ] = pConnectionTable->pEntries[ nextSlot ];
+                    slot = nextSlot;
+                }
+
+                nextSlot = ( nextSlot + 1 ) & pConnectionTable->entryMask;
+            }
+
+            memset( &( pConnectionTable->pEntries[ slot ] ), 0, sizeof( IceConnectionEntry_t ) );
+            pConnectionTable->connectionCount--;
+        }
+
+        Ice_ConnectionTableEndWrite( pConnectionTable );
+    }
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_ConnectionTableLookup - The application calls this API for every datagram received once connected, with the
+ * local address it was received on and its source address. Returns the candidate pair of the connection and its agent
+ * in ppIceAgent, or NULL. Safe to call from any number of threads while another thread inserts or removes: it takes
+ * no lock, copies the probed entries and starts over if a writer ran meanwhile. */
+
+IceCandidatePair_t * Ice_ConnectionTableLookup( const IceConnectionTable_t * pConnectionTable,
+                                                const StunAttributeAddress_t * pLocalAddress,
+                                                const StunAttributeAddress_t * pRemoteAddress,
+                                                IceAgent_t ** ppIceAgent )
+{
+    IceCandidatePair_t * pIceCandidatePair = NULL;
+    IceAgent_t * pIceAgent = NULL;
+    IceConnectionEntry_t entry;
+    uint32_t hash, slot, probeCount, sequence;
+    bool isStable = false;
+
+    if( ( pConnectionTable != NULL ) &&
+        ( pLocalAddress != NULL ) &&
+        ( pRemoteAddress != NULL ) )
+    {
+        hash = Ice_ConnectionHash( pConnectionTable,
+                                   pLocalAddress,
+                                   pRemoteAddress );
+
+        while( !isStable )
+        {
+            sequence = ICE_LOAD_ACQUIRE( &( pConnectionTable->sequence ) );
+            pIceCandidatePair = NULL;
+            pIceAgent = NULL;
+
+            if( ( sequence & 1 ) != 0 )
+            {
+                continue;
+            }
+
+            slot = hash & pConnectionTable->entryMask;
+
+            /* Bounded, entries seen during a concurrent write may not hold together. */
+            for( probeCount = 0; probeCount <= pConnectionTable->entryMask; probeCount++ )
+            {
+                memcpy( &entry,
+                        &( pConnectionTable->pEntries[ slot ] ),
+                        sizeof( IceConnectionEntry_t ) );
+
+                if( entry.isUsed == 0 )
+                {
+                    break;
+                }
+
+                if( ( entry.hash == hash ) &&
+                    Ice_IsSameAddress( &( entry.localAddress ), pLocalAddress ) &&
+                    Ice_IsSameAddress( &( entry.remoteAddress ), pRemoteAddress ) )
+                {
+                    pIceCandidatePair = entry.pIceCandidatePair;
+                    pIceAgent = entry.pIceAgent;
+                    break;
+                }
+
+                slot = ( slot + 1 ) & pConnectionTable->entryMask;
+            }
+
+            ICE_FENCE_ACQUIRE();
+            isStable = ( ICE_LOAD_RELAXED( &( pConnectionTable->sequence ) ) == sequence );
+        }
+    }
+
+    if( ppIceAgent != NULL )
+    {
+        *ppIceAgent = pIceAgent;
+    }
+
+    return pIceCandidatePair;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
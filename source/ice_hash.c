@@ -0,0 +1,215 @@
+#include "ice_hash.h"
+
+/* Standard defines. */
+#include <string.h>
+
+/* Ice_HashIndexGetBucketCount - Returns the bucket count (power of two, load factor <= 0.5) for a maximum number of entries. */
+
+uint32_t Ice_HashIndexGetBucketCount( uint32_t maxEntries )
+{
+    uint32_t bucketCount = 2;
+
+    while( bucketCount < ( maxEntries << 1 ) )
+    {
+        bucketCount <<= 1;
+    }
+
+    return bucketCount;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_HashIndexInit - Initializes an empty index over the given buckets. bucketCount must be a power of two. */
+
+void Ice_HashIndexInit( IceHashIndex_t * pHashIndex,
+                        IceHashBucket_t * pBuckets,
+                        uint32_t bucketCount )
+{
+    memset( pBuckets, 0, sizeof( IceHashBucket_t ) * bucketCount );
+
+    pHashIndex->pBuckets = pBuckets;
+    pHashIndex->bucketMask = bucketCount - 1;
+    pHashIndex->entryCount = 0;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_HashIndexInsert - Adds an entry slot under the given hash. Duplicate keys are allowed. */
+
+IceResult_t Ice_HashIndexInsert( IceHashIndex_t * pHashIndex,
+                                 uint32_t hash,
+                                 uint32_t entryIndex )
+{
+    IceResult_t retStatus = ICE_RESULT_OK;
+    uint32_t bucket = hash & pHashIndex->bucketMask;
+
+    /* Keep at least one empty bucket so that probing always terminates. */
+    if( pHashIndex->entryCount >= pHashIndex->bucketMask )
+    {
+        retStatus = ICE_RESULT_OUT_OF_MEMORY;
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        while( pHashIndex->pBuckets[ bucket ].entry != 0 )
+        {
+            bucket = ( bucket + 1 ) & pHashIndex->bucketMask;
+        }
+
+        pHashIndex->pBuckets[ bucket ].hash = hash;
+        pHashIndex->pBuckets[ bucket ].entry = entryIndex + 1;
+        pHashIndex->entryCount++;
+    }
+
+    return retStatus;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_HashIndexFindNext - Returns the next entry slot stored under the given hash, or ICE_HASH_INDEX_NOT_FOUND.
+ * *pCursor must be set to ICE_HASH_INDEX_CURSOR_START before the first call. */
+
+uint32_t Ice_HashIndexFindNext( const IceHashIndex_t * pHashIndex,
+                                uint32_t hash,
+                                uint32_t * pCursor )
+{
+    uint32_t entryIndex = ICE_HASH_INDEX_NOT_FOUND;
+    uint32_t bucket;
+
+    bucket = ( *pCursor == ICE_HASH_INDEX_CURSOR_START ) ? ( hash & pHashIndex->bucketMask ) :
+                                                          ( ( *pCursor + 1 ) & pHashIndex->bucketMask );
+
+    while( pHashIndex->pBuckets[ bucket ].entry != 0 )
+    {
+        if( pHashIndex->pBuckets[ bucket ].hash == hash )
+        {
+            entryIndex = pHashIndex->pBuckets[ bucket ].entry - 1;
+            break;
+        }
+
+        bucket = ( bucket + 1 ) & pHashIndex->bucketMask;
+    }
+
+    *pCursor = bucket;
+
+    return entryIndex;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_HashIndexRemove - Removes an entry slot stored under the given hash. Uses backward-shift deletion,
+ * so no tombstones accumulate and lookups stay as short as right after insertion. */
+
+void Ice_HashIndexRemove( IceHashIndex_t * pHashIndex,
+                          uint32_t hash,
+                          uint32_t entryIndex )
+{
+    uint32_t bucket = hash & pHashIndex->bucketMask;
+    uint32_t nextBucket, homeBucket;
+    bool isFound = false;
+
+    while( pHashIndex->pBuckets[ bucket ].entry != 0 )
+    {
+        if( ( pHashIndex->pBuckets[ bucket ].hash == hash ) &&
+            ( pHashIndex->pBuckets[ bucket ].entry == entryIndex + 1 ) )
+        {
+            isFound = true;
+            break;
+        }
+
+        bucket = ( bucket + 1 ) & pHashIndex->bucketMask;
+    }
+
+    if( isFound )
+    {
+        nextBucket = ( bucket + 1 ) & pHashIndex->bucketMask;
+
+        while( pHashIndex->pBuckets[ nextBucket ].entry != 0 )
+        {
+            homeBucket = pHashIndex->pBuckets[ nextBucket ].hash & pHashIndex->bucketMask;
+
+            /* Move the entry back into the hole unless its home bucket lies cyclically in ( bucket, nextBucket ]. */
+            if( ( ( nextBucket - homeBucket ) & pHashIndex->bucketMask ) >= ( ( nextBucket - bucket ) & pHashIndex->bucketMask ) )
+            {
+                pHashIndex->pBuckets[ bucket ] = pHashIndex->pBuckets[ nextBucket ];
+                bucket = nextBucket;
+            }
+
+            nextBucket = ( nextBucket + 1 ) & pHashIndex->bucketMask;
+        }
+
+        pHashIndex->pBuckets[ bucket ].hash = 0;
+        pHashIndex->pBuckets[ bucket ].entry = 0;
+        pHashIndex->entryCount--;
+    }
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_HashIndexClearRun - Empties the run of occupied buckets starting at the home bucket of hash, without moving any
+ * entry back. Only meant for emptying a whole index: every run starts at the home bucket of one of its entries, so
+ * calling it with the hash of every entry leaves the index empty, in time proportional to the entries. */
+
+void Ice_HashIndexClearRun( IceHashIndex_t * pHashIndex,
+                            uint32_t hash )
+{
+    uint32_t bucket = hash & pHashIndex->bucketMask;
+
+    while( pHashIndex->pBuckets[ bucket ].entry != 0 )
+    {
+        pHashIndex->pBuckets[ bucket ].hash = 0;
+        pHashIndex->pBuckets[ bucket ].entry = 0;
+        pHashIndex->entryCount--;
+        bucket = ( bucket + 1 ) & pHashIndex->bucketMask;
+    }
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_HashBytes - Seeded FNV-1a over a byte string with a final avalanche step. */
+
+uint32_t Ice_HashBytes( const uint8_t * pData,
+                        size_t dataLength,
+                        uint32_t seed )
+{
+    uint32_t hash = 2166136261U ^ seed;
+    size_t i;
+
+    for( i = 0; i < dataLength; i++ )
+    {
+        hash ^= pData[ i ];
+        hash *= 16777619U;
+    }
+
+    hash ^= hash >> 16;
+    hash *= 0x85EBCA6BU;
+    hash ^= hash >> 13;
+    hash *= 0xC2B2AE35U;
+    hash ^= hash >> 16;
+
+    return hash;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_HashAddress - Hashes a transport address key: ( family, address, port, protocol ). */
+
+uint32_t Ice_HashAddress( const StunAttributeAddress_t * pAddress,
+                          uint32_t protocol,
+                          uint32_t seed )
+{
+    uint8_t key[ STUN_IPV6_ADDRESS_SIZE + 6 ];
+    uint32_t addrLen = IS_IPV4_ADDR( *pAddress ) ? STUN_IPV4_ADDRESS_SIZE : STUN_IPV6_ADDRESS_SIZE;
+
+    memcpy( key, pAddress->address, addrLen );
+    key[ addrLen ] = ( uint8_t ) pAddress->family;
+    key[ addrLen + 1 ] = ( uint8_t ) protocol;
+    key[ addrLen + 2 ] = ( uint8_t ) ( pAddress->port >> 8 );
+    key[ addrLen + 3 ] = ( uint8_t ) pAddress->port;
+
+    return Ice_HashBytes( key,
+                          addrLen + 4,
+                          seed );
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
@@ -0,0 +1,479 @@
+#include "ice_hmac_sha1.h"
+
+/* Standard defines. */
+#include <string.h>
+
+#if !defined( ICE_SHA1_DISABLE_HARDWARE ) && defined( __x86_64__ ) && ( defined( __GNUC__ ) || defined( __clang__ ) )
+    #define ICE_SHA1_X86_SHANI
+    #include <immintrin.h>
+#endif
+
+#define ICE_SHA1_ROTL( value, bits )    ( ( ( value ) << ( bits ) ) | ( ( value ) >> ( 32 - ( bits ) ) ) )
+
+typedef void ( * IceSha1CompressFunction_t )( uint32_t * pState,
+                                              const uint8_t * pBlocks,
+                                              size_t blockCount );
+
+static void Ice_Sha1CompressResolve( uint32_t * pState,
+                                     const uint8_t * pBlocks,
+                                     size_t blockCount );
+
+static IceSha1CompressFunction_t sha1CompressFunction = Ice_Sha1CompressResolve;
+static const char * pSha1ImplementationName = "unresolved";
+
+static const uint32_t sha1InitialState[ 5 ] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_Sha1CompressPortable - FIPS 180-4 SHA-1 compression of consecutive 64 byte blocks, with a 16 word message schedule window. */
+
+static void Ice_Sha1CompressPortable( uint32_t * pState,
+                                      const uint8_t * pBlocks,
+                                      size_t blockCount )
+{
+    uint32_t w[ 16 ];
+    uint32_t a, b, c, d, e, f, k, temp;
+    int i;
+
+    while( blockCount > 0 )
+    {
+        for( i = 0; i < 16; i++ )
+        {
+            w[ i ] = ( ( uint32_t ) pBlocks[ 4 * i ] << 24 ) | ( ( uint32_t ) pBlocks[ 4 * i + 1 ] << 16 ) |
+                     ( ( uint32_t ) pBlocks[ 4 * i + 2 ] << 8 ) | ( uint32_t ) pBlocks[ 4 * i + 3 ];
+        }
+
+        a = pState[ 0 ];
+        b = pState[ 1 ];
+        c = pState[ 2 ];
+        d = pState[ 3 ];
+        e = pState[ 4 ];
+
+        for( i = 0; i < 80; i++ )
+        {
+            if( i >= 16 )
+            {
+                temp = w[ ( i + 13 ) & 15 ] ^ w[ ( i + 8 ) & 15 ] ^ w[ ( i + 2 ) & 15 ] ^ w[ i & 15 ];
+                w[ i & 15 ] = ICE_SHA1_ROTL( temp, 1 );
+            }
+
+            if( i < 20 )
+            {
+                f = ( b & c ) | ( ~b & d );
+                k = 0x5A827999;
+            }
+            else if( i < 40 )
+            {
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1;
+            }
+            else if( i < 60 )
+            {
+                f = ( b & c ) | ( b & d ) | ( c & d );
+                k = 0x8F1BBCDC;
+            }
+            else
+            {
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6;
+            }
+
+            temp = ICE_SHA1_ROTL( a, 5 ) + f + e + k + w[ i & 15 ];
+            e = d;
+            d = c;
+            c = ICE_SHA1_ROTL( b, 30 );
+            b = a;
+            a = temp;
+        }
+
+        pState[ 0 ] += a;
+        pState[ 1 ] += b;
+        pState[ 2 ] += c;
+        pState[ 3 ] += d;
+        pState[ 4 ] += e;
+
+        pBlocks += ICE_SHA1_BLOCK_LENGTH;
+        blockCount--;
+    }
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+#if defined( ICE_SHA1_X86_SHANI )
+
+/* Ice_Sha1CompressShaNi - SHA-1 compression with the x86 SHA extensions. Each group of four rounds is one SHA1RNDS4,
+ * the message schedule is extended four words at a time with SHA1MSG1 / SHA1MSG2. */
+
+__attribute__( ( target( "sha,sse4.1" ) ) )
+static void Ice_Sha1CompressShaNi( uint32_t * pState,
+                                   const uint8_t * pBlocks,
+                                   size_t blockCount )
+{
+    const __m128i byteSwapMask = _mm_set_epi64x( 0x0001020304050607LL, 0x08090A0B0C0D0E0FLL );
+    __m128i abcd, abcdSave, e0, e0Save, e1;
+    __m128i msg0, msg1, msg2, msg3;
+
+    abcd = _mm_shuffle_epi32( _mm_loadu_si128( ( const __m128i * ) pState ), 0x1B );
+    e0 = _mm_set_epi32( ( int ) pState[ 4 ], 0, 0, 0 );
+
+    while( blockCount > 0 )
+    {
+        abcdSave = abcd;
+        e0Save = e0;
+
+        /* Rounds 0-3. */
+        msg0 = _mm_shuffle_epi8( _mm_loadu_si128( ( const __m128i * ) ( pBlocks + 0 ) ), byteSwapMask );
+        e0 = _mm_add_epi32( e0, msg0 );
+        e1 = abcd;
+        abcd = _mm_sha1rnds4_epu32( abcd, e0, 0 );
+
+        /* Rounds 4-7. */
+        msg1 = _mm_shuffle_epi8( _mm_loadu_si128( ( const __m128i * ) ( pBlocks + 16 ) ), byteSwapMask );
+        e1 = _mm_sha1nexte_epu32( e1, msg1 );
+        e0 = abcd;
+        abcd = _mm_sha1rnds4_epu32( abcd, e1, 0 );
+        msg0 = _mm_sha1msg1_epu32( msg0, msg1 );
+
+        /* Rounds 8-11. */
+        msg2 = _mm_shuffle_epi8( _mm_loadu_si128( ( const __m128i * ) ( pBlocks + 32 ) ), byteSwapMask );
+        e0 = _mm_sha1nexte_epu32( e0, msg2 );
+        e1 = abcd;
+        abcd = _mm_sha1rnds4_epu32( abcd, e0, 0 );
+        msg1 = _mm_sha1msg1_epu32( msg1, msg2 );
+        msg0 = _mm_xor_si128( msg0, msg2 );
+
+        /* Rounds 12-15. */
+        msg3 = _mm_shuffle_epi8( _mm_loadu_si128( ( const __m128i * ) ( pBlocks + 48 ) ), byteSwapMask );
+        e1 = _mm_sha1nexte_epu32( e1, msg3 );
+        e0 = abcd;
+        msg0 = _mm_sha1msg2_epu32( msg0, msg3 );
+        abcd = _mm_sha1rnds4_epu32( abcd, e1, 0 );
+        msg2 = _mm_sha1msg1_epu32( msg2, msg3 );
+        msg1 = _mm_xor_si128( msg1, msg3 );
+
+        /* Rounds 16-19. */
+        e0 = _mm_sha1nexte_epu32( e0, msg0 );
+        e1 = abcd;
+        msg1 = _mm_sha1msg2_epu32( msg1, msg0 );
+        abcd = _mm_sha1rnds4_epu32( abcd, e0, 0 );
+        msg3 = _mm_sha1msg1_epu32( msg3, msg0 );
+        msg2 = _mm_xor_si128( msg2, msg0 );
+
+        /* Rounds 20-23. */
+        e1 = _mm_sha1nexte_epu32( e1, msg1 );
+        e0 = abcd;
+        msg2 = _mm_sha1msg2_epu32( msg2, msg1 );
+        abcd = _mm_sha1rnds4_epu32( abcd, e1, 1 );
+        msg0 = _mm_sha1msg1_epu32( msg0, msg1 );
+        msg3 = _mm_xor_si128( msg3, msg1 );
+
+        /* Rounds 24-27. */
+        e0 = _mm_sha1nexte_epu32( e0, msg2 );
+        e1 = abcd;
+        msg3 = _mm_sha1msg2_epu32( msg3, msg2 );
+        abcd = _mm_sha1rnds4_epu32( abcd, e0, 1 );
+        msg1 = _mm_sha1msg1_epu32( msg1, msg2 );
+        msg0 = _mm_xor_si128( msg0, msg2 );
+
+        /* Rounds 28-31. */
+        e1 = _mm_sha1nexte_epu32( e1, msg3 );
+        e0 = abcd;
+        msg0 = _mm_sha1msg2_epu32( msg0, msg3 );
+        abcd = _mm_sha1rnds4_epu32( abcd, e1, 1 );
+        msg2 = _mm_sha1msg1_epu32( msg2, msg3 );
+        msg1 = _mm_xor_si128( msg1, msg3 );
+
+        /* Rounds 32-35. */
+        e0 = _mm_sha1nexte_epu32( e0, msg0 );
+        e1 = abcd;
+        msg1 = _mm_sha1msg2_epu32( msg1, msg0 );
+        abcd = _mm_sha1rnds4_epu32( abcd, e0, 1 );
+        msg3 = _mm_sha1msg1_epu32( msg3, msg0 );
+        msg2 = _mm_xor_si128( msg2, msg0 );
+
+        /* Rounds 36-39. */
+        e1 = _mm_sha1nexte_epu32( e1, msg1 );
+        e0 = abcd;
+        msg2 = _mm_sha1msg2_epu32( msg2, msg1 );
+        abcd = _mm_sha1rnds4_epu32( abcd, e1, 1 );
+        msg0 = _mm_sha1msg1_epu32( msg0, msg1 );
+        msg3 = _mm_xor_si128( msg3, msg1 );
+
+        /* Rounds 40-43. */
+        e0 = _mm_sha1nexte_epu32( e0, msg2 );
+        e1 = abcd;
+        msg3 = _mm_sha1msg2_epu32( msg3, msg2 );
+        abcd = _mm_sha1rnds4_epu32( abcd, e0, 2 );
+        msg1 = _mm_sha1msg1_epu32( msg1, msg2 );
+        msg0 = _mm_xor_si128( msg0, msg2 );
+
+        /* Rounds 44-47. */
+        e1 = _mm_sha1nexte_epu32( e1, msg3 );
+        e0 = abcd;
+        msg0 = _mm_sha1msg2_epu32( msg0, msg3 );
+        abcd = _mm_sha1rnds4_epu32( abcd, e1, 2 );
+        msg2 = _mm_sha1msg1_epu32( msg2, msg3 );
+        msg1 = _mm_xor_si128( msg1, msg3 );
+
+        /* Rounds 48-51. */
+        e0 = _mm_sha1nexte_epu32( e0, msg0 );
+        e1 = abcd;
+        msg1 = _mm_sha1msg2_epu32( msg1, msg0 );
+        abcd = _mm_sha1rnds4_epu32( abcd, e0, 2 );
+        msg3 = _mm_sha1msg1_epu32( msg3, msg0 );
+        msg2 = _mm_xor_si128( msg2, msg0 );
+
+        /* Rounds 52-55. */
+        e1 = _mm_sha1nexte_epu32( e1, msg1 );
+        e0 = abcd;
+        msg2 = _mm_sha1msg2_epu32( msg2, msg1 );
+        abcd = _mm_sha1rnds4_epu32( abcd, e1, 2 );
+        msg0 = _mm_sha1msg1_epu32( msg0, msg1 );
+        msg3 = _mm_xor_si128( msg3, msg1 );
+
+        /* Rounds 56-59. */
+        e0 = _mm_sha1nexte_epu32( e0, msg2 );
+        e1 = abcd;
+        msg3 = _mm_sha1msg2_epu32( msg3, msg2 );
+        abcd = _mm_sha1rnds4_epu32( abcd, e0, 2 );
+        msg1 = _mm_sha1msg1_epu32( msg1, msg2 );
+        msg0 = _mm_xor_si128( msg0, msg2 );
+
+        /* Rounds 60-63. */
+        e1 = _mm_sha1nexte_epu32( e1, msg3 );
+        e0 = abcd;
+        msg0 = _mm_sha1msg2_epu32( msg0, msg3 );
+        abcd = _mm_sha1rnds4_epu32( abcd, e1, 3 );
+        msg2 = _mm_sha1msg1_epu32( msg2, msg3 );
+        msg1 = _mm_xor_si128( msg1, msg3 );
+
+        /* Rounds 64-67. */
+        e0 = _mm_sha1nexte_epu32( e0, msg0 );
+        e1 = abcd;
+        msg1 = _mm_sha1msg2_epu32( msg1, msg0 );
+        abcd = _mm_sha1rnds4_epu32( abcd, e0, 3 );
+        msg3 = _mm_sha1msg1_epu32( msg3, msg0 );
+        msg2 = _mm_xor_si128( msg2, msg0 );
+
+        /* Rounds 68-71. */
+        e1 = _mm_sha1nexte_epu32( e1, msg1 );
+        e0 = abcd;
+        msg2 = _mm_sha1msg2_epu32( msg2, msg1 );
+        abcd = _mm_sha1rnds4_epu32( abcd, e1, 3 );
+        msg3 = _mm_xor_si128( msg3, msg1 );
+
+        /* Rounds 72-75. */
+        e0 = _mm_sha1nexte_epu32( e0, msg2 );
+        e1 = abcd;
+        msg3 = _mm_sha1msg2_epu32( msg3, msg2 );
+        abcd = _mm_sha1rnds4_epu32( abcd, e0, 3 );
+
+        /* Rounds 76-79. */
+        e1 = _mm_sha1nexte_epu32( e1, msg3 );
+        e0 = abcd;
+        abcd = _mm_sha1rnds4_epu32( abcd, e1, 3 );
+
+        e0 = _mm_sha1nexte_epu32( e0, e0Save );
+        abcd = _mm_add_epi32( abcd, abcdSave );
+
+        pBlocks += ICE_SHA1_BLOCK_LENGTH;
+        blockCount--;
+    }
+
+    _mm_storeu_si128( ( __m128i * ) pState, _mm_shuffle_epi32( abcd, 0x1B ) );
+    pState[ 4 ] = ( uint32_t ) _mm_extract_epi32( e0, 3 );
+}
+
+#endif /* ICE_SHA1_X86_SHANI */
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_Sha1CompressResolve - Initial target of the dispatch pointer: picks the compression for the running CPU on first use.
+ * Concurrent first calls all pick the same implementation, so the unsynchronised store is benign. */
+
+static void Ice_Sha1CompressResolve( uint32_t * pState,
+                                     const uint8_t * pBlocks,
+                                     size_t blockCount )
+{
+    IceSha1CompressFunction_t selectedFunction = Ice_Sha1CompressPortable;
+    const char * pSelectedName = "portable";
+
+    #if defined( ICE_SHA1_X86_SHANI )
+        __builtin_cpu_init();
+
+        if( __builtin_cpu_supports( "sha" ) && __builtin_cpu_supports( "sse4.1" ) )
+        {
+            selectedFunction = Ice_Sha1CompressShaNi;
+            pSelectedName = "sha-ni";
+        }
+    #endif
+
+    pSha1ImplementationName = pSelectedName;
+    sha1CompressFunction = selectedFunction;
+
+    selectedFunction( pState,
+                      pBlocks,
+                      blockCount );
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_Sha1Finish - Compresses pData and the final padding into pState and writes the digest.
+ * prefixLength is the number of bytes already compressed into pState, it counts towards the encoded message length. */
+
+static void Ice_Sha1Finish( uint32_t * pState,
+                            const uint8_t * pData,
+                            size_t dataLength,
+                            uint64_t prefixLength,
+                            uint8_t * pDigest )
+{
+    uint8_t lastBlocks[ 2 * ICE_SHA1_BLOCK_LENGTH ];
+    size_t fullBlockCount = dataLength / ICE_SHA1_BLOCK_LENGTH;
+    size_t tailLength = dataLength % ICE_SHA1_BLOCK_LENGTH;
+    size_t lastBlocksLength = ( tailLength < ICE_SHA1_BLOCK_LENGTH - 8 ) ? ICE_SHA1_BLOCK_LENGTH : 2 * ICE_SHA1_BLOCK_LENGTH;
+    uint64_t bitLength = ( prefixLength + dataLength ) * 8;
+    int i;
+
+    if( fullBlockCount > 0 )
+    {
+        sha1CompressFunction( pState,
+                              pData,
+                              fullBlockCount );
+    }
+
+    memcpy( lastBlocks, pData + ( fullBlockCount * ICE_SHA1_BLOCK_LENGTH ), tailLength );
+    lastBlocks[ tailLength ] = 0x80;
+    memset( &( lastBlocks[ tailLength + 1 ] ), 0, lastBlocksLength - tailLength - 1 );
+
+    for( i = 0; i < 8; i++ )
+    {
+        lastBlocks[ lastBlocksLength - 1 - i ] = ( uint8_t ) ( bitLength >> ( 8 * i ) );
+    }
+
+    sha1CompressFunction( pState,
+                          lastBlocks,
+                          lastBlocksLength / ICE_SHA1_BLOCK_LENGTH );
+
+    for( i = 0; i < 5; i++ )
+    {
+        pDigest[ 4 * i ] = ( uint8_t ) ( pState[ i ] >> 24 );
+        pDigest[ 4 * i + 1 ] = ( uint8_t ) ( pState[ i ] >> 16 );
+        pDigest[ 4 * i + 2 ] = ( uint8_t ) ( pState[ i ] >> 8 );
+        pDigest[ 4 * i + 3 ] = ( uint8_t ) pState[ i ];
+    }
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_Sha1 - Computes the SHA-1 digest of a buffer. */
+
+void Ice_Sha1( const uint8_t * pData,
+               size_t dataLength,
+               uint8_t * pDigest )
+{
+    uint32_t state[ 5 ];
+
+    memcpy( state, sha1InitialState, sizeof( state ) );
+
+    Ice_Sha1Finish( state,
+                    pData,
+                    dataLength,
+                    0,
+                    pDigest );
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_HmacSha1SetKey - Precomputes the inner and outer SHA-1 states of an HMAC key. Keys longer than a block are hashed first. */
+
+void Ice_HmacSha1SetKey( IceHmacSha1Key_t * pHmacKey,
+                         const uint8_t * pKey,
+                         size_t keyLength )
+{
+    uint8_t keyBlock[ ICE_SHA1_BLOCK_LENGTH ] = { 0 };
+    uint8_t padBlock[ ICE_SHA1_BLOCK_LENGTH ];
+    int i;
+
+    if( keyLength > ICE_SHA1_BLOCK_LENGTH )
+    {
+        Ice_Sha1( pKey,
+                  keyLength,
+                  keyBlock );
+    }
+    else if( keyLength > 0 )
+    {
+        memcpy( keyBlock, pKey, keyLength );
+    }
+
+    for( i = 0; i < ICE_SHA1_BLOCK_LENGTH; i++ )
+    {
+        padBlock[ i ] = keyBlock[ i ] ^ 0x36;
+    }
+
+    memcpy( pHmacKey->innerState, sha1InitialState, sizeof( pHmacKey->innerState ) );
+    sha1CompressFunction( pHmacKey->innerState,
+                          padBlock,
+                          1 );
+
+    for( i = 0; i < ICE_SHA1_BLOCK_LENGTH; i++ )
+    {
+        padBlock[ i ] = keyBlock[ i ] ^ 0x5C;
+    }
+
+    memcpy( pHmacKey->outerState, sha1InitialState, sizeof( pHmacKey->outerState ) );
+    sha1CompressFunction( pHmacKey->outerState,
+                          padBlock,
+                          1 );
+
+    memset( keyBlock, 0, sizeof( keyBlock ) );
+    memset( padBlock, 0, sizeof( padBlock ) );
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_HmacSha1 - Computes the 20 byte HMAC-SHA1 of a buffer from a precomputed key state. */
+
+void Ice_HmacSha1( const IceHmacSha1Key_t * pHmacKey,
+                   const uint8_t * pData,
+                   size_t dataLength,
+                   uint8_t * pMac )
+{
+    uint32_t state[ 5 ];
+    uint8_t innerDigest[ ICE_SHA1_DIGEST_LENGTH ];
+
+    memcpy( state, pHmacKey->innerState, sizeof( state ) );
+    Ice_Sha1Finish( state,
+                    pData,
+                    dataLength,
+                    ICE_SHA1_BLOCK_LENGTH,
+                    innerDigest );
+
+    memcpy( state, pHmacKey->outerState, sizeof( state ) );
+    Ice_Sha1Finish( state,
+                    innerDigest,
+                    ICE_SHA1_DIGEST_LENGTH,
+                    ICE_SHA1_BLOCK_LENGTH,
+                    pMac );
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_GetSha1ImplementationName - Returns the name of the SHA-1 compression in use, resolving it if needed. */
+
+const char * Ice_GetSha1ImplementationName( void )
+{
+    uint32_t state[ 5 ];
+    uint8_t block[ ICE_SHA1_BLOCK_LENGTH ] = { 0 };
+
+    if( sha1CompressFunction == Ice_Sha1CompressResolve )
+    {
+        memcpy( state, sha1InitialState, sizeof( state ) );
+        Ice_Sha1CompressResolve( state,
+                                 block,
+                                 1 );
+    }
+
+    return pSha1ImplementationName;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
@@ -0,0 +1,232 @@
+#include "ice_lite.h"
+#include "ice_api.h"
+#include "ice_hmac_sha1.h"
+
+/* Standard defines. */
+#include <string.h>
+
+/* Ice_LiteIsSameAddress - Compares family, port and address of two transport addresses. */
+
+static bool Ice_LiteIsSameAddress( const StunAttributeAddress_t * pAddress1,
+                                   const StunAttributeAddress_t * pAddress2 )
+{
+    return ( pAddress1->family == pAddress2->family ) &&
+           ( pAddress1->port == pAddress2->port ) &&
+           ( memcmp( pAddress1->address,
+                     pAddress2->address,
+                     IS_IPV4_ADDR( *pAddress1 ) ? STUN_IPV4_ADDRESS_SIZE : STUN_IPV6_ADDRESS_SIZE ) == 0 );
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_CreateLiteAgent - Creates an ICE-lite agent with its local credentials. Only the MESSAGE-INTEGRITY key derived
+ * from the password is kept. */
+
+IceResult_t Ice_CreateLiteAgent( IceLiteAgent_t * pLiteAgent,
+                                 const char * pLocalUsername,
+                                 const char * pLocalPassword )
+{
+    IceResult_t retStatus = ICE_RESULT_OK;
+
+    if( ( pLiteAgent == NULL ) ||
+        ( pLocalUsername == NULL ) ||
+        ( pLocalPassword == NULL ) ||
+        ( strlen( pLocalUsername ) > MAX_ICE_CONFIG_USER_NAME_LEN ) ||
+        ( strlen( pLocalPassword ) > MAX_ICE_CONFIG_CREDENTIAL_LEN ) )
+    {
+        retStatus = ICE_RESULT_BAD_PARAM;
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        memset( pLiteAgent, 0, sizeof( IceLiteAgent_t ) );
+
+        pLiteAgent->localUsernameLength = strlen( pLocalUsername );
+        memcpy( pLiteAgent->localUsername,
+                pLocalUsername,
+                pLiteAgent->localUsernameLength );
+        Ice_HmacSha1SetKey( &( pLiteAgent->localPasswordKey ),
+                            ( const uint8_t * ) pLocalPassword,
+                            strlen( pLocalPassword ) );
+    }
+
+    return retStatus;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_LiteAddHostCandidate - Adds a host candidate, a local transport address the lite agent answers checks on. */
+
+IceResult_t Ice_LiteAddHostCandidate( IceLiteAgent_t * pLiteAgent,
+                                      const IceIPAddress_t * pIpAddress )
+{
+    IceResult_t retStatus = ICE_RESULT_OK;
+
+    if( ( pLiteAgent == NULL ) ||
+        ( pIpAddress == NULL ) )
+    {
+        retStatus = ICE_RESULT_BAD_PARAM;
+    }
+    else if( pLiteAgent->hostCandidateCount >= ICE_LITE_MAX_HOST_CANDIDATES )
+    {
+        retStatus = ICE_RESULT_MAX_CANDIDATE_THRESHOLD;
+    }
+    else
+    {
+        pLiteAgent->hostCandidates[ pLiteAgent->hostCandidateCount ] = *pIpAddress;
+        pLiteAgent->hostCandidateCount++;
+    }
+
+    return retStatus;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_LiteHandleBindingRequest - The application calls this API for every binding request received on one of the host
+ * candidates of the lite agent, with the local address it was received on and its source address. The request is
+ * validated as by Ice_ClassifyStunPacket, its USERNAME must start with the local username, and the authenticated
+ * success response, with the source address in XOR-MAPPED-ADDRESS, is written to pResponseBuffer, at least
+ * ICE_LITE_MAX_RESPONSE_LENGTH bytes. Returns ICE_RESULT_USE_CANDIDATE_FLAG when the request nominated its pair,
+ * which becomes the selected pair. Nothing else is remembered, checks are answered however many arrive. */
+
+IceResult_t Ice_LiteHandleBindingRequest( IceLiteAgent_t * pLiteAgent,
+                                          uint8_t * pStunMessageBuffer,
+                                          size_t stunMessageBufferLength,
+                                          const IceIPAddress_t * pLocalAddress,
+                                          const IceIPAddress_t * pSrcAddress,
+                                          uint8_t * pResponseBuffer,
+                                          size_t responseBufferLength,
+                                          size_t * pResponseLength )
+{
+    IceResult_t retStatus = ICE_RESULT_OK;
+    const StunAttributeAddress_t * pMappedAddress;
+    uint16_t attributeType, attributeLength;
+    size_t offset = STUN_HEADER_LENGTH, addressLength, i;
+    bool hasUsername = false, isNomination = false, isLocal = false;
+
+    if( ( pLiteAgent == NULL ) ||
+        ( pStunMessageBuffer == NULL ) ||
+        ( pLocalAddress == NULL ) ||
+        ( pSrcAddress == NULL ) ||
+        ( pResponseBuffer == NULL ) ||
+        ( pResponseLength == NULL ) ||
+        ( responseBufferLength < ICE_LITE_MAX_RESPONSE_LENGTH ) )
+    {
+        retStatus = ICE_RESULT_BAD_PARAM;
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        retStatus = Ice_ValidateStunPacket( &( pLiteAgent->rejectCounters ),
+                                            &( pLiteAgent->localPasswordKey ),
+                                            &( pLiteAgent->localPasswordKey ),
+                                            pStunMessageBuffer,
+                                            stunMessageBufferLength,
+                                            true );
+    }
+
+    /* A lite agent sends no requests, so it expects no responses. */
+    if( ( retStatus == ICE_RESULT_OK ) &&
+        ( ( ( pStunMessageBuffer[ 0 ] << 8 ) | pStunMessageBuffer[ 1 ] ) != STUN_MESSAGE_TYPE_BINDING_REQUEST ) )
+    {
+        retStatus = ICE_RESULT_NOT_STUN_PACKET;
+    }
+
+    for( i = 0; ( retStatus == ICE_RESULT_OK ) && ( i < pLiteAgent->hostCandidateCount ); i++ )
+    {
+        isLocal = isLocal || Ice_LiteIsSameAddress( &( pLiteAgent->hostCandidates[ i ].ipAddress ),
+                                                    &( pLocalAddress->ipAddress ) );
+    }
+
+    if( ( retStatus == ICE_RESULT_OK ) && !isLocal )
+    {
+        retStatus = ICE_RESULT_LOCAL_CANDIDATE_NOT_FOUND;
+    }
+
+    /* The attributes already tile the message, look for USERNAME and USE-CANDIDATE. Only the attributes before
+     * MESSAGE-INTEGRITY are authenticated, the walk stops there. */
+    while( ( retStatus == ICE_RESULT_OK ) && ( offset < stunMessageBufferLength ) )
+    {
+        attributeType = ( uint16_t ) ( ( pStunMessageBuffer[ offset ] << 8 ) | pStunMessageBuffer[ offset + 1 ] );
+        attributeLength = ( uint16_t ) ( ( pStunMessageBuffer[ offset + 2 ] << 8 ) | pStunMessageBuffer[ offset + 3 ] );
+
+        if( attributeType == STUN_ATTRIBUTE_TYPE_MESSAGE_INTEGRITY )
+        {
+            break;
+        }
+        else if( ( attributeType == STUN_ATTRIBUTE_TYPE_USERNAME ) && !hasUsername )
+        {
+            /* "<local username>:<remote username>" */
+            hasUsername = ( attributeLength > pLiteAgent->localUsernameLength ) &&
+                          ( memcmp( pStunMessageBuffer + offset + STUN_ATTRIBUTE_HEADER_LENGTH,
+                                    pLiteAgent->localUsername,
+                                    pLiteAgent->localUsernameLength ) == 0 ) &&
+                          ( pStunMessageBuffer[ offset + STUN_ATTRIBUTE_HEADER_LENGTH + pLiteAgent->localUsernameLength ] == ':' );
+
+            if( !hasUsername )
+            {
+                break;
+            }
+        }
+        else if( attributeType == STUN_ATTRIBUTE_TYPE_USE_CANDIDATE )
+        {
+            isNomination = true;
+        }
+
+        offset += STUN_ATTRIBUTE_HEADER_LENGTH + ( ( ( size_t ) attributeLength + 3 ) & ~( ( size_t ) 3 ) );
+    }
+
+    if( ( retStatus == ICE_RESULT_OK ) && !hasUsername )
+    {
+        pLiteAgent->rejectCounters.badUsername++;
+        retStatus = ICE_RESULT_INTEGRITY_MISMATCH;
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        /* Binding success response with the transaction ID of the request. */
+        pResponseBuffer[ 0 ] = ( uint8_t ) ( STUN_MESSAGE_TYPE_BINDING_SUCCESS_RESPONSE >> 8 );
+        pResponseBuffer[ 1 ] = ( uint8_t ) STUN_MESSAGE_TYPE_BINDING_SUCCESS_RESPONSE;
+        memcpy( pResponseBuffer + STUN_HEADER_MAGIC_COOKIE_OFFSET,
+                pStunMessageBuffer + STUN_HEADER_MAGIC_COOKIE_OFFSET,
+                STUN_HEADER_LENGTH - STUN_HEADER_MAGIC_COOKIE_OFFSET );
+
+        /* XOR-MAPPED-ADDRESS: the port is XORed with the top of the magic cookie, the address with the cookie
+         * followed by the transaction ID, both found right after the header length. */
+        pMappedAddress = &( pSrcAddress->ipAddress );
+        addressLength = IS_IPV4_ADDR( *pMappedAddress ) ? STUN_IPV4_ADDRESS_SIZE : STUN_IPV6_ADDRESS_SIZE;
+        offset = STUN_HEADER_LENGTH;
+
+        pResponseBuffer[ offset ] = ( uint8_t ) ( STUN_ATTRIBUTE_TYPE_XOR_MAPPED_ADDRESS >> 8 );
+        pResponseBuffer[ offset + 1 ] = ( uint8_t ) STUN_ATTRIBUTE_TYPE_XOR_MAPPED_ADDRESS;
+        pResponseBuffer[ offset + 2 ] = 0;
+        pResponseBuffer[ offset + 3 ] = ( uint8_t ) ( 4 + addressLength );
+        pResponseBuffer[ offset + 4 ] = 0;
+        pResponseBuffer[ offset + 5 ] = ( uint8_t ) pMappedAddress->family;
+        pResponseBuffer[ offset + 6 ] = ( uint8_t ) ( pMappedAddress->port >> 8 ) ^ pResponseBuffer[ STUN_HEADER_MAGIC_COOKIE_OFFSET ];
+        pResponseBuffer[ offset + 7 ] = ( uint8_t ) pMappedAddress->port ^ pResponseBuffer[ STUN_HEADER_MAGIC_COOKIE_OFFSET + 1 ];
+
+        for( i = 0; i < addressLength; i++ )
+        {
+            pResponseBuffer[ offset + 8 + i ] = pMappedAddress->address[ i ] ^ pResponseBuffer[ STUN_HEADER_MAGIC_COOKIE_OFFSET + i ];
+        }
+
+        offset += STUN_ATTRIBUTE_HEADER_LENGTH + 4 + addressLength;
+
+        *pResponseLength = Ice_AppendIntegrityAndFingerprint( &( pLiteAgent->localPasswordKey ),
+                                                              pResponseBuffer,
+                                                              offset );
+
+        if( isNomination )
+        {
+            pLiteAgent->selectedLocalAddress = *pLocalAddress;
+            pLiteAgent->selectedRemoteAddress = *pSrcAddress;
+            pLiteAgent->isSelected = 1;
+            retStatus = ICE_RESULT_USE_CANDIDATE_FLAG;
+        }
+    }
+
+    return retStatus;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
@@ -0,0 +1,263 @@
+#include "ice_log.h"
+
+/* Standard defines. */
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Memory ordering of the log ring indices. */
+#if defined( __GNUC__ ) || defined( __clang__ )
+    #define ICE_LOAD_ACQUIRE( pValue )            __atomic_load_n( pValue, __ATOMIC_ACQUIRE )
+    #define ICE_STORE_RELEASE( pValue, value )    __atomic_store_n( pValue, value, __ATOMIC_RELEASE )
+#else
+    #error "ice_log.c needs the GCC / Clang __atomic builtins."
+#endif
+
+static IceLogger_t globalLogger = { NULL, NULL, ICE_LOG_LEVEL_NONE };
+
+/* Ring of the calling thread for Ice_LogRingCallback, so that one logger shared by several threads never has two
+ * producers on a ring. */
+static __thread IceLogRing_t * pThreadLogRing = NULL;
+
+/* Ice_GetLogger - The agent's own logger when it has one, the global logger otherwise. */
+
+static const IceLogger_t * Ice_GetLogger( const IceAgent_t * pIceAgent )
+{
+    return ( ( pIceAgent != NULL ) && ( pIceAgent->logger.callback != NULL ) ) ? &( pIceAgent->logger ) : &globalLogger;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_SetLogCallback - Sets the logger of the agents that have none of their own. NULL turns it off. */
+
+void Ice_SetLogCallback( IceLogCallback_t callback,
+                         void * pUserData,
+                         uint32_t level )
+{
+    globalLogger.callback = callback;
+    globalLogger.pUserData = pUserData;
+    globalLogger.level = level;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_SetAgentLogCallback - Sets the logger of one agent, e.g. to raise its level while debugging a session.
+ * NULL hands the agent back to the global logger. */
+
+IceResult_t Ice_SetAgentLogCallback( IceAgent_t * pIceAgent,
+                                     IceLogCallback_t callback,
+                                     void * pUserData,
+                                     uint32_t level )
+{
+    IceResult_t retStatus = ICE_RESULT_OK;
+
+    if( pIceAgent == NULL )
+    {
+        retStatus = ICE_RESULT_BAD_PARAM;
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        pIceAgent->logger.callback = callback;
+        pIceAgent->logger.pUserData = pUserData;
+        pIceAgent->logger.level = level;
+    }
+
+    return retStatus;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_LogIsEnabled - Whether a message of the given level of this agent reaches a callback. */
+
+bool Ice_LogIsEnabled( const IceAgent_t * pIceAgent,
+                       uint32_t level )
+{
+    const IceLogger_t * pLogger = Ice_GetLogger( pIceAgent );
+
+    return ( pLogger->callback != NULL ) && ( level <= pLogger->level );
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_LogWrite - Formats a message on the stack and hands it to the agent's logger. Called through the ICE_LOG_*
+ * macros, which check Ice_LogIsEnabled first. */
+
+void Ice_LogWrite( const IceAgent_t * pIceAgent,
+                   uint32_t level,
+                   const char * pFormat,
+                   ... )
+{
+    const IceLogger_t * pLogger = Ice_GetLogger( pIceAgent );
+    char message[ ICE_LOG_MESSAGE_LENGTH ];
+    va_list arguments;
+    int length;
+
+    if( ( pLogger->callback != NULL ) && ( level <= pLogger->level ) )
+    {
+        va_start( arguments, pFormat );
+        length = vsnprintf( message,
+                            sizeof( message ),
+                            pFormat,
+                            arguments );
+        va_end( arguments );
+
+        if( length >= 0 )
+        {
+            pLogger->callback( pLogger->pUserData,
+                               level,
+                               message,
+                               ( ( size_t ) length < sizeof( message ) ) ? ( size_t ) length : sizeof( message ) - 1 );
+        }
+    }
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_GetLogRingMemorySize - Bytes of the caller provided memory block holding recordCount records. */
+
+IceResult_t Ice_GetLogRingMemorySize( uint32_t recordCount,
+                                      size_t * pRingMemorySize )
+{
+    IceResult_t retStatus = ICE_RESULT_OK;
+
+    if( ( pRingMemorySize == NULL ) ||
+        ( recordCount == 0 ) ||
+        ( ( recordCount & ( recordCount - 1 ) ) != 0 ) )
+    {
+        retStatus = ICE_RESULT_BAD_PARAM;
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        *pRingMemorySize = sizeof( IceLogRecord_t ) * recordCount;
+    }
+
+    return retStatus;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_CreateLogRing - Sets up an empty log ring in pRingMemory. */
+
+IceResult_t Ice_CreateLogRing( IceLogRing_t * pLogRing,
+                               uint32_t recordCount,
+                               uint8_t * pRingMemory,
+                               size_t ringMemorySize )
+{
+    IceResult_t retStatus = ICE_RESULT_OK;
+    size_t requiredMemorySize = 0;
+
+    if( ( pLogRing == NULL ) ||
+        ( pRingMemory == NULL ) ||
+        ( ( ( uintptr_t ) pRingMemory % ICE_AGENT_MEMORY_ALIGNMENT ) != 0 ) )
+    {
+        retStatus = ICE_RESULT_BAD_PARAM;
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        retStatus = Ice_GetLogRingMemorySize( recordCount,
+                                              &requiredMemorySize );
+    }
+
+    if( ( retStatus == ICE_RESULT_OK ) && ( ringMemorySize < requiredMemorySize ) )
+    {
+        retStatus = ICE_RESULT_OUT_OF_MEMORY;
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        pLogRing->pRecords = ( IceLogRecord_t * ) pRingMemory;
+        pLogRing->recordMask = recordCount - 1;
+        pLogRing->head = 0;
+        pLogRing->tail = 0;
+        pLogRing->droppedCount = 0;
+    }
+
+    return retStatus;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_LogRingAttachThread - Makes pLogRing the ring the calling thread logs into, NULL detaches it. A ring must be
+ * attached to one thread only. */
+
+void Ice_LogRingAttachThread( IceLogRing_t * pLogRing )
+{
+    pThreadLogRing = pLogRing;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_LogRingCallback - IceLogCallback_t appending the message to the ring attached to the calling thread, messages of
+ * threads without a ring are discarded. Never blocks: when the consumer has fallen behind the message is dropped and
+ * counted. */
+
+void Ice_LogRingCallback( void * pUserData,
+                          uint32_t level,
+                          const char * pMessage,
+                          size_t messageLength )
+{
+    IceLogRing_t * pLogRing = pThreadLogRing;
+    IceLogRecord_t * pLogRecord;
+    uint32_t head;
+
+    ( void ) pUserData;
+
+    if( pLogRing != NULL )
+    {
+        head = pLogRing->head;
+
+        if( head - ICE_LOAD_ACQUIRE( &( pLogRing->tail ) ) > pLogRing->recordMask )
+        {
+            pLogRing->droppedCount++;
+        }
+        else
+        {
+            if( messageLength >= ICE_LOG_MESSAGE_LENGTH )
+            {
+                messageLength = ICE_LOG_MESSAGE_LENGTH - 1;
+            }
+
+            pLogRecord = &( pLogRing->pRecords[ head & pLogRing->recordMask ] );
+            pLogRecord->level = level;
+            pLogRecord->messageLength = ( uint32_t ) messageLength;
+            memcpy( pLogRecord->message,
+                    pMessage,
+                    messageLength );
+            pLogRecord->message[ messageLength ] = '\0';
+
+            ICE_STORE_RELEASE( &( pLogRing->head ), head + 1 );
+        }
+    }
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_LogRingRead - Called by the draining thread: copies the oldest record into pLogRecord and frees its slot.
+ * Returns false when the ring is empty. */
+
+bool Ice_LogRingRead( IceLogRing_t * pLogRing,
+                      IceLogRecord_t * pLogRecord )
+{
+    bool isRead = false;
+    uint32_t tail;
+
+    if( ( pLogRing != NULL ) && ( pLogRecord != NULL ) )
+    {
+        tail = pLogRing->tail;
+
+        if( tail != ICE_LOAD_ACQUIRE( &( pLogRing->head ) ) )
+        {
+            memcpy( pLogRecord,
+                    &( pLogRing->pRecords[ tail & pLogRing->recordMask ] ),
+                    sizeof( IceLogRecord_t ) );
+            ICE_STORE_RELEASE( &( pLogRing->tail ), tail + 1 );
+            isRead = true;
+        }
+    }
+
+    return isRead;
+}
@@ -0,0 +1,298 @@
+#include "ice_random.h"
+
+/* Standard defines. */
+#include <errno.h>
+#include <string.h>
+
+#if defined( __linux__ )
+    #include <sys/random.h>
+#elif defined( __APPLE__ ) || defined( __FreeBSD__ ) || defined( __OpenBSD__ ) || defined( __NetBSD__ )
+    #include <unistd.h>
+#else
+    #error "ice_random.c needs getrandom() or getentropy() to seed its generator."
+#endif
+
+#define ICE_ROTATE_LEFT_32( value, count )    ( ( ( value ) << ( count ) ) | ( ( value ) >> ( 32 - ( count ) ) ) )
+
+#define ICE_CHACHA20_QUARTER_ROUND( a, b, c, d )                                     \
+    do                                                                               \
+    {                                                                                \
+        a += b; d ^= a; d = ICE_ROTATE_LEFT_32( d, 16 );                             \
+        c += d; b ^= c; b = ICE_ROTATE_LEFT_32( b, 12 );                             \
+        a += b; d ^= a; d = ICE_ROTATE_LEFT_32( d, 8 );                              \
+        c += d; b ^= c; b = ICE_ROTATE_LEFT_32( b, 7 );                              \
+    } while( 0 )
+
+/* Per-thread generator of Ice_RandomFillThreadLocal, seeded on first use. */
+static __thread IceRandom_t threadRandom;
+static __thread bool threadRandomSeeded = false;
+
+/* Ice_ChaCha20Block - Writes the key stream block number blockCounter of key into pBlock. */
+
+static void Ice_ChaCha20Block( const uint32_t * pKey,
+                               uint64_t blockCounter,
+                               uint8_t * pBlock )
+{
+    uint32_t input[ 16 ];
+    uint32_t x[ 16 ];
+    int i;
+
+    /* "expand 32-byte k", key, 32-bit counter and 96-bit nonce; the nonce's first word extends the counter. */
+    input[ 0 ] = 0x61707865U;
+    input[ 1 ] = 0x3320646EU;
+    input[ 2 ] = 0x79622D32U;
+    input[ 3 ] = 0x6B206574U;
+    memcpy( &( input[ 4 ] ), pKey, ICE_RANDOM_SEED_LENGTH );
+    input[ 12 ] = ( uint32_t ) blockCounter;
+    input[ 13 ] = ( uint32_t ) ( blockCounter >> 32 );
+    input[ 14 ] = 0;
+    input[ 15 ] = 0;
+
+    memcpy( x, input, sizeof( x ) );
+
+    for( i = 0; i < 10; i++ )
+    {
+        ICE_CHACHA20_QUARTER_ROUND( x[ 0 ], x[ 4 ], x[ 8 ], x[ 12 ] );
+        ICE_CHACHA20_QUARTER_ROUND( x[ 1 ], x[ 5 ], x[ 9 ], x[ 13 ] );
+        ICE_CHACHA20_QUARTER_ROUND( x[ 2 ], x[ 6 ], x[ 10 ], x[ 14 ] );
+        ICE_CHACHA20_QUARTER_ROUND( x[ 3 ], x[ 7 ], x[ 11 ], x[ 15 ] );
+        ICE_CHACHA20_QUARTER_ROUND( x[ 0 ], x[ 5 ], x[ 10 ], x[ 15 ] );
+        ICE_CHACHA20_QUARTER_ROUND( x[ 1 ], x[ 6 ], x[ 11 ], x[ 12 ] );
+        ICE_CHACHA20_QUARTER_ROUND( x[ 2 ], x[ 7 ], x[ 8 ], x[ 13 ] );
+        ICE_CHACHA20_QUARTER_ROUND( x[ 3 ], x[ 4 ], x[ 9 ], x[ 14 ] );
+    }
+
+    for( i = 0; i < 16; i++ )
+    {
+        x[ i ] += input[ i ];
+        pBlock[ 4 * i ] = ( uint8_t ) x[ i ];
+        pBlock[ 4 * i + 1 ] = ( uint8_t ) ( x[ i ] >> 8 );
+        pBlock[ 4 * i + 2 ] = ( uint8_t ) ( x[ i ] >> 16 );
+        pBlock[ 4 * i + 3 ] = ( uint8_t ) ( x[ i ] >> 24 );
+    }
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_RandomGetEntropy - Reads length bytes from the system's random source. Meant for seeding, each call is a system call. */
+
+IceResult_t Ice_RandomGetEntropy( uint8_t * pBuffer,
+                                  size_t length )
+{
+    IceResult_t retStatus = ICE_RESULT_OK;
+    size_t filled = 0;
+
+    if( pBuffer == NULL )
+    {
+        retStatus = ICE_RESULT_BAD_PARAM;
+    }
+
+    while( ( retStatus == ICE_RESULT_OK ) && ( filled < length ) )
+    {
+        #if defined( __linux__ )
+            ssize_t readLength = getrandom( pBuffer + filled, length - filled, 0 );
+
+            if( readLength > 0 )
+            {
+                filled += ( size_t ) readLength;
+            }
+            else if( ( readLength < 0 ) && ( errno != EINTR ) )
+            {
+                retStatus = ICE_RESULT_RANDOM_SOURCE_ERROR;
+            }
+        #else
+            /* getentropy() returns at most 256 bytes per call. */
+            size_t readLength = ( length - filled < 256 ) ? ( length - filled ) : 256;
+
+            if( getentropy( pBuffer + filled, readLength ) == 0 )
+            {
+                filled += readLength;
+            }
+            else
+            {
+                retStatus = ICE_RESULT_RANDOM_SOURCE_ERROR;
+            }
+        #endif
+    }
+
+    return retStatus;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_RandomInit - Initializes pRandom to draw from source, or, when source is NULL, from ChaCha20 under a system seed. */
+
+IceResult_t Ice_RandomInit( IceRandom_t * pRandom,
+                            IceRandomSource_t source,
+                            void * pSourceData )
+{
+    IceResult_t retStatus = ICE_RESULT_OK;
+    uint8_t seed[ ICE_RANDOM_SEED_LENGTH ];
+
+    if( pRandom == NULL )
+    {
+        retStatus = ICE_RESULT_BAD_PARAM;
+    }
+
+    if( ( retStatus == ICE_RESULT_OK ) && ( source == NULL ) )
+    {
+        retStatus = Ice_RandomGetEntropy( seed,
+                                          sizeof( seed ) );
+
+        if( retStatus == ICE_RESULT_OK )
+        {
+            Ice_RandomInitFromSeed( pRandom,
+                                    seed );
+        }
+
+        memset( seed, 0, sizeof( seed ) );
+    }
+    else if( retStatus == ICE_RESULT_OK )
+    {
+        memset( pRandom, 0, sizeof( IceRandom_t ) );
+        pRandom->source = source;
+        pRandom->pSourceData = pSourceData;
+    }
+
+    return retStatus;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_RandomInitFromSeed - Initializes pRandom to the ChaCha20 key stream of a 32-byte seed, e.g. for reproducible tests. */
+
+void Ice_RandomInitFromSeed( IceRandom_t * pRandom,
+                             const uint8_t * pSeed )
+{
+    int i;
+
+    for( i = 0; i < ICE_RANDOM_SEED_LENGTH / 4; i++ )
+    {
+        pRandom->key[ i ] = ( ( uint32_t ) pSeed[ 4 * i ] ) |
+                            ( ( uint32_t ) pSeed[ 4 * i + 1 ] << 8 ) |
+                            ( ( uint32_t ) pSeed[ 4 * i + 2 ] << 16 ) |
+                            ( ( uint32_t ) pSeed[ 4 * i + 3 ] << 24 );
+    }
+
+    pRandom->blockCounter = 0;
+    pRandom->blockOffset = ICE_RANDOM_BLOCK_LENGTH;
+    pRandom->source = NULL;
+    pRandom->pSourceData = NULL;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_RandomFill - Fills pBuffer with length random bytes. Bytes left over from the current block are used first,
+ * whole blocks are generated straight into pBuffer. */
+
+void Ice_RandomFill( IceRandom_t * pRandom,
+                     uint8_t * pBuffer,
+                     size_t length )
+{
+    size_t copyLength;
+
+    if( pRandom->source != NULL )
+    {
+        pRandom->source( pRandom->pSourceData,
+                         pBuffer,
+                         length );
+    }
+    else
+    {
+        while( length > 0 )
+        {
+            if( pRandom->blockOffset < ICE_RANDOM_BLOCK_LENGTH )
+            {
+                copyLength = ICE_RANDOM_BLOCK_LENGTH - pRandom->blockOffset;
+                copyLength = ( copyLength < length ) ? copyLength : length;
+
+                memcpy( pBuffer,
+                        &( pRandom->block[ pRandom->blockOffset ] ),
+                        copyLength );
+                /* Handed-out key stream is not kept around. */
+                memset( &( pRandom->block[ pRandom->blockOffset ] ), 0, copyLength );
+
+                pRandom->blockOffset += ( uint32_t ) copyLength;
+                pBuffer += copyLength;
+                length -= copyLength;
+            }
+            else if( length >= ICE_RANDOM_BLOCK_LENGTH )
+            {
+                Ice_ChaCha20Block( pRandom->key,
+                                   pRandom->blockCounter++,
+                                   pBuffer );
+                pBuffer += ICE_RANDOM_BLOCK_LENGTH;
+                length -= ICE_RANDOM_BLOCK_LENGTH;
+            }
+            else
+            {
+                Ice_ChaCha20Block( pRandom->key,
+                                   pRandom->blockCounter++,
+                                   pRandom->block );
+                pRandom->blockOffset = 0;
+            }
+        }
+    }
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_RandomUint32 - A uniformly distributed 32-bit value. */
+
+uint32_t Ice_RandomUint32( IceRandom_t * pRandom )
+{
+    uint32_t value;
+
+    Ice_RandomFill( pRandom,
+                    ( uint8_t * ) &value,
+                    sizeof( value ) );
+
+    return value;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_RandomUint64 - A uniformly distributed 64-bit value. */
+
+uint64_t Ice_RandomUint64( IceRandom_t * pRandom )
+{
+    uint64_t value;
+
+    Ice_RandomFill( pRandom,
+                    ( uint8_t * ) &value,
+                    sizeof( value ) );
+
+    return value;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_RandomFillThreadLocal - Fills pBuffer from a generator private to the calling thread, for callers without an agent. */
+
+IceResult_t Ice_RandomFillThreadLocal( uint8_t * pBuffer,
+                                       size_t length )
+{
+    IceResult_t retStatus = ICE_RESULT_OK;
+
+    if( pBuffer == NULL )
+    {
+        retStatus = ICE_RESULT_BAD_PARAM;
+    }
+
+    if( ( retStatus == ICE_RESULT_OK ) && !threadRandomSeeded )
+    {
+        retStatus = Ice_RandomInit( &threadRandom,
+                                    NULL,
+                                    NULL );
+        threadRandomSeeded = ( retStatus == ICE_RESULT_OK );
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        Ice_RandomFill( &threadRandom,
+                        pBuffer,
+                        length );
+    }
+
+    return retStatus;
+}
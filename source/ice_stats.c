@@ -0,0 +1,172 @@
+#include "ice_stats.h"
+
+/* Standard defines. */
+#include <stdlib.h>
+#include <string.h>
+
+/* Ice_HistogramBucket - Bucket of a value: 0 for 0, otherwise its bit length, capped to the last bucket. */
+
+static uint32_t Ice_HistogramBucket( uint64_t value )
+{
+    uint32_t bucket = 0;
+
+#if defined( __GNUC__ ) || defined( __clang__ )
+    if( value != 0 )
+    {
+        bucket = 64 - ( uint32_t ) __builtin_clzll( value );
+    }
+#else
+    while( value != 0 )
+    {
+        value >>= 1;
+        bucket++;
+    }
+#endif
+
+    return ( bucket < ICE_HISTOGRAM_BUCKET_COUNT ) ? bucket : ( ICE_HISTOGRAM_BUCKET_COUNT - 1 );
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_HistogramRecord - Counts one value. */
+
+void Ice_HistogramRecord( IceHistogram_t * pHistogram,
+                          uint64_t value )
+{
+    pHistogram->buckets[ Ice_HistogramBucket( value ) ]++;
+    pHistogram->count++;
+    pHistogram->sum += value;
+
+    if( value > pHistogram->max )
+    {
+        pHistogram->max = value;
+    }
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_HistogramMerge - Adds the values counted by pHistogram to pTotal. */
+
+void Ice_HistogramMerge( IceHistogram_t * pTotal,
+                         const IceHistogram_t * pHistogram )
+{
+    uint32_t i;
+
+    for( i = 0; i < ICE_HISTOGRAM_BUCKET_COUNT; i++ )
+    {
+        pTotal->buckets[ i ] += pHistogram->buckets[ i ];
+    }
+
+    pTotal->count += pHistogram->count;
+    pTotal->sum += pHistogram->sum;
+
+    if( pHistogram->max > pTotal->max )
+    {
+        pTotal->max = pHistogram->max;
+    }
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_HistogramPercentile - Walks the buckets up to the one holding the requested rank. The last bucket has no upper
+ * bound, the largest value recorded is returned instead, as it is for any bucket bound above it. */
+
+uint64_t Ice_HistogramPercentile( const IceHistogram_t * pHistogram,
+                                  uint32_t percentile )
+{
+    uint64_t bound = 0;
+    uint64_t rank, seen = 0;
+    uint32_t i;
+
+    if( ( pHistogram != NULL ) && ( pHistogram->count > 0 ) )
+    {
+        rank = ( pHistogram->count * ( ( percentile < 100 ) ? percentile : 100 ) + 99 ) / 100;
+        rank = ( rank == 0 ) ? 1 : rank;
+
+        for( i = 0; i < ICE_HISTOGRAM_BUCKET_COUNT; i++ )
+        {
+            seen += pHistogram->buckets[ i ];
+
+            if( seen >= rank )
+            {
+                bound = ( i == 0 ) ? 0 : ( ( ( uint64_t ) 1 << i ) - 1 );
+                break;
+            }
+        }
+
+        if( ( i >= ICE_HISTOGRAM_BUCKET_COUNT - 1 ) || ( bound > pHistogram->max ) )
+        {
+            bound = pHistogram->max;
+        }
+    }
+
+    return bound;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_GetAgentStats - Copies the counters and histograms of an agent. Called from the thread driving the agent,
+ * the copy can then be handed to any other thread. */
+
+IceResult_t Ice_GetAgentStats( const IceAgent_t * pIceAgent,
+                               IceAgentStats_t * pStats )
+{
+    IceResult_t retStatus = ICE_RESULT_OK;
+
+    if( ( pIceAgent == NULL ) ||
+        ( pStats == NULL ) )
+    {
+        retStatus = ICE_RESULT_BAD_PARAM;
+    }
+
+    if( retStatus == ICE_RESULT_OK )
+    {
+        memcpy( pStats,
+                &( pIceAgent->stats ),
+                sizeof( IceAgentStats_t ) );
+    }
+
+    return retStatus;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_AccumulateAgentStats - Adds the counters and histograms of pStats to pTotal, e.g. to aggregate the snapshots of
+ * the agents of a thread, or of several threads. pTotal starts out zeroed. */
+
+void Ice_AccumulateAgentStats( IceAgentStats_t * pTotal,
+                               const IceAgentStats_t * pStats )
+{
+    uint32_t i;
+
+    if( ( pTotal != NULL ) && ( pStats != NULL ) )
+    {
+        pTotal->rejectCounters.notStun += pStats->rejectCounters.notStun;
+        pTotal->rejectCounters.badMagicCookie += pStats->rejectCounters.badMagicCookie;
+        pTotal->rejectCounters.badLength += pStats->rejectCounters.badLength;
+        pTotal->rejectCounters.badFingerprint += pStats->rejectCounters.badFingerprint;
+        pTotal->rejectCounters.missingIntegrity += pStats->rejectCounters.missingIntegrity;
+        pTotal->rejectCounters.badIntegrity += pStats->rejectCounters.badIntegrity;
+        pTotal->rejectCounters.badUsername += pStats->rejectCounters.badUsername;
+        pTotal->packetsAccepted += pStats->packetsAccepted;
+        pTotal->requestsSent += pStats->requestsSent;
+        pTotal->responsesSent += pStats->responsesSent;
+        pTotal->retransmissions += pStats->retransmissions;
+        pTotal->transactionTimeouts += pStats->transactionTimeouts;
+        pTotal->peerReflexiveCandidates += pStats->peerReflexiveCandidates;
+
+        for( i = 0; i < ICE_CANDIDATE_PAIR_STATE_COUNT; i++ )
+        {
+            pTotal->pairStateTransitions[ i ] += pStats->pairStateTransitions[ i ];
+        }
+
+        Ice_HistogramMerge( &( pTotal->gatheringTime ),
+                            &( pStats->gatheringTime ) );
+        Ice_HistogramMerge( &( pTotal->timeToConnect ),
+                            &( pStats->timeToConnect ) );
+        Ice_HistogramMerge( &( pTotal->pairRtt ),
+                            &( pStats->pairRtt ) );
+        Ice_HistogramMerge( &( pTotal->handlerTime ),
+                            &( pStats->handlerTime ) );
+    }
+}
@@ -0,0 +1,372 @@
+#include "ice_timer_wheel.h"
+
+#define ICE_TIMER_WHEEL_SLOT_MASK    ( ( uint64_t ) ICE_TIMER_WHEEL_SLOTS - 1 )
+#define ICE_TIMER_WHEEL_SPAN         ( ( uint64_t ) 1 << ( ICE_TIMER_WHEEL_SLOT_BITS * ICE_TIMER_WHEEL_LEVELS ) )
+
+/* Ice_TimerWheelLowestSlot - Index of the lowest set bit of a non-zero occupancy bitmap. */
+
+static uint32_t Ice_TimerWheelLowestSlot( uint64_t occupancy )
+{
+#if defined( __GNUC__ ) || defined( __clang__ )
+    return ( uint32_t ) __builtin_ctzll( occupancy );
+#else
+    uint32_t index = 0;
+
+    while( ( occupancy & 1 ) == 0 )
+    {
+        occupancy >>= 1;
+        index++;
+    }
+
+    return index;
+#endif
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_TimerListInit / Ice_TimerListAppend - Circular doubly linked timer lists around a sentinel timer. */
+
+static void Ice_TimerListInit( IceTimer_t * pSentinel )
+{
+    pSentinel->pNext = pSentinel;
+    pSentinel->pPrev = pSentinel;
+}
+
+static void Ice_TimerListAppend( IceTimer_t * pSentinel,
+                                 IceTimer_t * pTimer )
+{
+    pTimer->pNext = pSentinel;
+    pTimer->pPrev = pSentinel->pPrev;
+    pSentinel->pPrev->pNext = pTimer;
+    pSentinel->pPrev = pTimer;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_TimerWheelLink - Links a timer into the slot covering its expiry, relative to the current tick: level l holds
+ * the timers due within 64^( l + 1 ) ticks. Expiries beyond the wheel span are parked in the last level. */
+
+static void Ice_TimerWheelLink( IceTimerWheel_t * pTimerWheel,
+                                IceTimer_t * pTimer )
+{
+    uint64_t expiryTick = pTimer->expiry;
+    uint64_t delta;
+    uint32_t level = 0, index;
+
+    if( expiryTick < pTimerWheel->currentTick )
+    {
+        expiryTick = pTimerWheel->currentTick;
+    }
+
+    delta = expiryTick - pTimerWheel->currentTick;
+
+    if( delta >= ICE_TIMER_WHEEL_SPAN )
+    {
+        expiryTick = pTimerWheel->currentTick + ICE_TIMER_WHEEL_SPAN - 1;
+        delta = ICE_TIMER_WHEEL_SPAN - 1;
+    }
+
+    while( delta >= ( ( uint64_t ) 1 << ( ICE_TIMER_WHEEL_SLOT_BITS * ( level + 1 ) ) ) )
+    {
+        level++;
+    }
+
+    index = ( uint32_t ) ( ( expiryTick >> ( ICE_TIMER_WHEEL_SLOT_BITS * level ) ) & ICE_TIMER_WHEEL_SLOT_MASK );
+
+    Ice_TimerListAppend( &( pTimerWheel->slots[ level ][ index ] ),
+                         pTimer );
+    pTimerWheel->occupancy[ level ] |= ( uint64_t ) 1 << index;
+    pTimer->slot = ( uint16_t ) ( level * ICE_TIMER_WHEEL_SLOTS + index );
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_TimerWheelUnlink - Removes a scheduled timer from its slot or from the expired queue. */
+
+static void Ice_TimerWheelUnlink( IceTimerWheel_t * pTimerWheel,
+                                  IceTimer_t * pTimer )
+{
+    IceTimer_t * pSentinel;
+    uint32_t level, index;
+
+    pTimer->pPrev->pNext = pTimer->pNext;
+    pTimer->pNext->pPrev = pTimer->pPrev;
+
+    if( pTimer->slot != ICE_TIMER_WHEEL_EXPIRED_SLOT )
+    {
+        level = pTimer->slot / ICE_TIMER_WHEEL_SLOTS;
+        index = pTimer->slot % ICE_TIMER_WHEEL_SLOTS;
+        pSentinel = &( pTimerWheel->slots[ level ][ index ] );
+
+        if( pSentinel->pNext == pSentinel )
+        {
+            pTimerWheel->occupancy[ level ] &= ~( ( uint64_t ) 1 << index );
+        }
+    }
+
+    pTimer->pNext = NULL;
+    pTimer->pPrev = NULL;
+    pTimerWheel->timerCount--;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_TimerWheelCascade - At a tick that starts a new span of level 1 and up, moves the timers of the slots of those
+ * levels covering the span down to the levels matching their remaining time, highest level first. */
+
+static void Ice_TimerWheelCascade( IceTimerWheel_t * pTimerWheel,
+                                   uint64_t tick )
+{
+    IceTimer_t pending;
+    IceTimer_t * pTimer;
+    uint32_t level = 1, index;
+
+    while( ( level + 1 < ICE_TIMER_WHEEL_LEVELS ) &&
+           ( ( tick & ( ( ( uint64_t ) 1 << ( ICE_TIMER_WHEEL_SLOT_BITS * ( level + 1 ) ) ) - 1 ) ) == 0 ) )
+    {
+        level++;
+    }
+
+    for( ; level > 0; level-- )
+    {
+        index = ( uint32_t ) ( ( tick >> ( ICE_TIMER_WHEEL_SLOT_BITS * level ) ) & ICE_TIMER_WHEEL_SLOT_MASK );
+
+        if( pTimerWheel->occupancy[ level ] & ( ( uint64_t ) 1 << index ) )
+        {
+            /* Detach the whole slot first, a timer parked beyond the wheel span is linked back into this level. */
+            Ice_TimerListInit( &pending );
+            pending.pNext = pTimerWheel->slots[ level ][ index ].pNext;
+            pending.pPrev = pTimerWheel->slots[ level ][ index ].pPrev;
+            pending.pNext->pPrev = &pending;
+            pending.pPrev->pNext = &pending;
+            Ice_TimerListInit( &( pTimerWheel->slots[ level ][ index ] ) );
+            pTimerWheel->occupancy[ level ] &= ~( ( uint64_t ) 1 << index );
+
+            while( pending.pNext != &pending )
+            {
+                pTimer = pending.pNext;
+                pending.pNext = pTimer->pNext;
+                pTimer->pNext->pPrev = &pending;
+
+                Ice_TimerWheelLink( pTimerWheel,
+                                    pTimer );
+            }
+        }
+    }
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_TimerWheelInit - Initializes an empty wheel whose first tick is currentTime. */
+
+void Ice_TimerWheelInit( IceTimerWheel_t * pTimerWheel,
+                         uint64_t currentTime )
+{
+    uint32_t level, index;
+
+    for( level = 0; level < ICE_TIMER_WHEEL_LEVELS; level++ )
+    {
+        for( index = 0; index < ICE_TIMER_WHEEL_SLOTS; index++ )
+        {
+            Ice_TimerListInit( &( pTimerWheel->slots[ level ][ index ] ) );
+        }
+
+        pTimerWheel->occupancy[ level ] = 0;
+    }
+
+    Ice_TimerListInit( &( pTimerWheel->expired ) );
+    pTimerWheel->currentTick = currentTime;
+    pTimerWheel->timerCount = 0;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_TimerInit - Initializes an unscheduled timer owned by pContext. */
+
+void Ice_TimerInit( IceTimer_t * pTimer,
+                    void * pContext )
+{
+    pTimer->pNext = NULL;
+    pTimer->pPrev = NULL;
+    pTimer->expiry = 0;
+    pTimer->pContext = pContext;
+    pTimer->slot = 0;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_TimerIsPending - True while the timer is scheduled or expired but not popped yet. */
+
+bool Ice_TimerIsPending( const IceTimer_t * pTimer )
+{
+    return pTimer->pNext != NULL;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_TimerWheelSchedule - Schedules pTimer at expiry in O(1), cancelling its previous schedule if any. */
+
+void Ice_TimerWheelSchedule( IceTimerWheel_t * pTimerWheel,
+                             IceTimer_t * pTimer,
+                             uint64_t expiry )
+{
+    if( Ice_TimerIsPending( pTimer ) )
+    {
+        Ice_TimerWheelUnlink( pTimerWheel,
+                              pTimer );
+    }
+
+    pTimer->expiry = expiry;
+    Ice_TimerWheelLink( pTimerWheel,
+                        pTimer );
+    pTimerWheel->timerCount++;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_TimerWheelCancel - Cancels pTimer in O(1). Cancelling a timer that is not scheduled does nothing. */
+
+void Ice_TimerWheelCancel( IceTimerWheel_t * pTimerWheel,
+                           IceTimer_t * pTimer )
+{
+    if( Ice_TimerIsPending( pTimer ) )
+    {
+        Ice_TimerWheelUnlink( pTimerWheel,
+                              pTimer );
+    }
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_TimerWheelAdvance - Processes every tick up to and including currentTime: cascades the higher levels at span
+ * boundaries and queues the timers of each level 0 slot reached for Ice_TimerWheelPopExpired. Runs of empty level 0
+ * slots are skipped with the occupancy bitmap, so an idle wheel costs one step per 64 ms elapsed. */
+
+void Ice_TimerWheelAdvance( IceTimerWheel_t * pTimerWheel,
+                            uint64_t currentTime )
+{
+    IceTimer_t * pSentinel;
+    IceTimer_t * pTimer;
+    uint64_t tick, laterSlots, nextTick;
+    uint32_t index;
+
+    while( pTimerWheel->currentTick <= currentTime )
+    {
+        tick = pTimerWheel->currentTick;
+        index = ( uint32_t ) ( tick & ICE_TIMER_WHEEL_SLOT_MASK );
+
+        if( index == 0 )
+        {
+            Ice_TimerWheelCascade( pTimerWheel,
+                                   tick );
+        }
+
+        if( pTimerWheel->occupancy[ 0 ] & ( ( uint64_t ) 1 << index ) )
+        {
+            pSentinel = &( pTimerWheel->slots[ 0 ][ index ] );
+
+            for( pTimer = pSentinel->pNext; pTimer != pSentinel; pTimer = pTimer->pNext )
+            {
+                pTimer->slot = ICE_TIMER_WHEEL_EXPIRED_SLOT;
+            }
+
+            /* Splice the slot onto the end of the expired queue. */
+            pSentinel->pNext->pPrev = pTimerWheel->expired.pPrev;
+            pTimerWheel->expired.pPrev->pNext = pSentinel->pNext;
+            pSentinel->pPrev->pNext = &( pTimerWheel->expired );
+            pTimerWheel->expired.pPrev = pSentinel->pPrev;
+
+            Ice_TimerListInit( pSentinel );
+            pTimerWheel->occupancy[ 0 ] &= ~( ( uint64_t ) 1 << index );
+        }
+
+        /* Jump to the next occupied level 0 slot of this rotation, or to the next rotation's cascade. */
+        laterSlots = pTimerWheel->occupancy[ 0 ] & ~( ( ( uint64_t ) 2 << index ) - 1 );
+
+        if( laterSlots != 0 )
+        {
+            nextTick = ( tick & ~ICE_TIMER_WHEEL_SLOT_MASK ) + Ice_TimerWheelLowestSlot( laterSlots );
+        }
+        else
+        {
+            nextTick = ( tick | ICE_TIMER_WHEEL_SLOT_MASK ) + 1;
+        }
+
+        pTimerWheel->currentTick = ( nextTick <= currentTime ) ? nextTick : currentTime + 1;
+    }
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_TimerWheelPopExpired - Dequeues the oldest expired timer, NULL when none is left. */
+
+IceTimer_t * Ice_TimerWheelPopExpired( IceTimerWheel_t * pTimerWheel )
+{
+    IceTimer_t * pTimer = NULL;
+
+    if( pTimerWheel->expired.pNext != &( pTimerWheel->expired ) )
+    {
+        pTimer = pTimerWheel->expired.pNext;
+
+        Ice_TimerWheelUnlink( pTimerWheel,
+                              pTimer );
+    }
+
+    return pTimer;
+}
+
+/*------------------------------------------------------------------------------------------------------------------*/
+
+/* Ice_TimerWheelGetNextExpiry - Earliest tick at which a level 0 slot expires or a higher level slot cascades. */
+
+uint64_t Ice_TimerWheelGetNextExpiry( const IceTimerWheel_t * pTimerWheel )
+{
+    uint64_t nextExpiry = ICE_TIME_INFINITE;
+    uint64_t block, candidate, slotsFromCurrent;
+    uint32_t level, shift, index;
+
+    if( pTimerWheel->expired.pNext != &( pTimerWheel->expired ) )
+    {
+        nextExpiry = pTimerWheel->currentTick - 1;
+    }
+    else if( pTimerWheel->timerCount > 0 )
+    {
+        for( level = 0; level < ICE_TIMER_WHEEL_LEVELS; level++ )
+        {
+            if( pTimerWheel->occupancy[ level ] != 0 )
+            {
+                shift = ICE_TIMER_WHEEL_SLOT_BITS * level;
+                block = pTimerWheel->currentTick >> shift;
+                index = ( uint32_t ) ( block & ICE_TIMER_WHEEL_SLOT_MASK );
+
+                /* The current slot of a level is still ahead only at level 0, or while its cascade is pending. */
+                if( ( level == 0 ) ||
+                    ( ( pTimerWheel->currentTick & ( ( ( uint64_t ) 1 << shift ) - 1 ) ) == 0 ) )
+                {
+                    slotsFromCurrent = pTimerWheel->occupancy[ level ] & ~( ( ( uint64_t ) 1 << index ) - 1 );
+                }
+                else
+                {
+                    slotsFromCurrent = pTimerWheel->occupancy[ level ] & ~( ( ( uint64_t ) 2 << index ) - 1 );
+                }
+
+                if( slotsFromCurrent != 0 )
+                {
+                    candidate = ( ( block & ~ICE_TIMER_WHEEL_SLOT_MASK ) + Ice_TimerWheelLowestSlot( slotsFromCurrent ) ) << shift;
+                }
+                else
+                {
+                    candidate = ( ( block & ~ICE_TIMER_WHEEL_SLOT_MASK ) + ICE_TIMER_WHEEL_SLOTS +
+                                  Ice_TimerWheelLowestSlot( pTimerWheel->occupancy[ level ] ) ) << shift;
+                }
+
+                if( candidate < nextExpiry )
+                {
+                    nextExpiry = candidate;
+                }
+            }
+        }
+    }
+
+    return nextExpiry;
+}
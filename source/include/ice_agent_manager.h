@@ -0,0 +1,61 @@
+#ifndef ICE_AGENT_MANAGER_H
+#define ICE_AGENT_MANAGER_H
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    extern "C" {
+#endif
+/* *INDENT-ON* */
+
+/* Standard includes. */
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "ice_data_types.h"
+
+/************************************************************************************************************************************************/
+
+/* Registry of the agents multiplexed on the sockets of the application. Adding, removing and finding an agent
+ * take constant time and never allocate: the registry lives in a memory block sized by Ice_GetAgentManagerMemorySize.
+ * Received binding requests are routed by the local ufrag, the part of their USERNAME before the ':',
+ * and responses by the transaction ID of the request they answer. */
+
+IceResult_t Ice_GetAgentManagerMemorySize( const IceAgentManagerConfig_t * pManagerConfig,
+                                           size_t * pManagerMemorySize );
+
+IceResult_t Ice_CreateAgentManager( IceAgentManager_t * pAgentManager,
+                                    const IceAgentManagerConfig_t * pManagerConfig,
+                                    uint8_t * pManagerMemory,
+                                    size_t managerMemorySize );
+
+IceResult_t Ice_AgentManagerAddAgent( IceAgentManager_t * pAgentManager,
+                                      IceAgent_t * pIceAgent );
+
+IceResult_t Ice_AgentManagerRemoveAgent( IceAgentManager_t * pAgentManager,
+                                         IceAgent_t * pIceAgent );
+
+IceAgent_t * Ice_AgentManagerFindAgentByUsername( IceAgentManager_t * pAgentManager,
+                                                  const char * pUsername,
+                                                  size_t usernameLength );
+
+IceAgent_t * Ice_AgentManagerFindAgentByTransactionId( IceAgentManager_t * pAgentManager,
+                                                       uint8_t * pTransactionId );
+
+IceResult_t Ice_AgentManagerFindAgent( IceAgentManager_t * pAgentManager,
+                                       const uint8_t * pStunMessageBuffer,
+                                       size_t stunMessageBufferLength,
+                                       IceAgent_t ** ppIceAgent );
+
+IceResult_t Ice_AgentManagerGetStats( const IceAgentManager_t * pAgentManager,
+                                      IceAgentStats_t * pStats );
+
+/************************************************************************************************************************************************/
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    }
+#endif
+/* *INDENT-ON* */
+
+#endif /* ICE_AGENT_MANAGER_H */
@@ -16,35 +16,51 @@
 
 /************************************************************************************************************************************************/
 
+IceResult_t Ice_GetIceAgentMemorySize( const IceAgentConfig_t * pAgentConfig,
+                                       size_t * pAgentMemorySize );
+
 IceResult_t Ice_CreateIceAgent( IceAgent_t * pIceAgent,
-                                char * localUsername,
-                                char * localPassword,
-                                char * remoteUsername,
-                                char * remotePassword,
-                                char * combinedUsername,
-                                TransactionIdStore_t * pBuffer );
+                                const IceAgentConfig_t * pAgentConfig,
+                                uint8_t * pAgentMemory,
+                                size_t agentMemorySize,
+                                const char * localUsername,
+                                const char * localPassword,
+                                const char * remoteUsername,
+                                const char * remotePassword );
+
+IceResult_t Ice_SetRemoteCredentials( IceAgent_t * pIceAgent,
+                                      const char * remoteUsername,
+                                      const char * remotePassword );
+
+IceResult_t Ice_ResetAgent( IceAgent_t * pIceAgent,
+                            const char * localUsername,
+                            const char * localPassword,
+                            const char * remoteUsername,
+                            const char * remotePassword );
+
+void Ice_UpdateCurrentTime( IceAgent_t * pIceAgent,
+                            uint64_t currentTime );
 
 IceResult_t Ice_AddHostCandidate( const IceIPAddress_t ipAddr,
                                   IceAgent_t * pIceAgent,
-                                  IceCandidate_t * pCandidate );
+                                  IceCandidate_t ** ppCandidate );
 
 IceResult_t Ice_AddSrflxCandidate( const IceIPAddress_t ipAddr,
                                    IceAgent_t * pIceAgent,
-                                   IceCandidate_t * pCandidate,
+                                   IceCandidate_t ** ppCandidate,
                                    uint8_t * pStunMessageBuffer,
                                    uint8_t * pTransactionIdBuffer );
 
 IceResult_t Ice_AddRemoteCandidate( IceAgent_t * pIceAgent,
                                     IceCandidateType_t iceCandidateType,
-                                    IceCandidate_t * pCandidate,
+                                    IceCandidate_t ** ppCandidate,
                                     const IceIPAddress_t ipAddr,
                                     IceSocketProtocol_t remoteProtocol,
                                     const uint32_t priority );
 
 IceResult_t Ice_CheckPeerReflexiveCandidate( IceAgent_t * pIceAgent,
                                              IceIPAddress_t pIpAddr,
-                                             uint32_t priority,
-                                             IceCandidatePair_t * pIceCandidatePair );
+                                             uint32_t priority );
 
 IceResult_t Ice_CreateCandidatePair( IceAgent_t * pIceAgent,
                                      IceCandidate_t * pLocalCandidate,
@@ -57,13 +73,13 @@ IceResult_t Ice_UpdateSrflxCandidateAddress( IceAgent_t * pIceAgent,
 IceResult_t Ice_InitializeStunPacket( StunContext_t * pStunCxt,
                                       uint8_t * transactionId,
                                       uint8_t * pStunMessageBuffer,
+                                      size_t stunMessageBufferLength,
                                       StunHeader_t * pStunHeader,
                                       uint8_t isGenerateTransactionID,
                                       uint8_t isStunBindingRequest );
 
 IceResult_t Ice_PackageStunPacket( StunContext_t * pStunCxt,
-                                   uint8_t * password,
-                                   uint32_t passwordLen );
+                                   const IceHmacSha1Key_t * pIntegrityKey );
 
 IceResult_t Ice_CreateRequestForSrflxCandidate( IceAgent_t * pIceAgent,
                                                 uint8_t * pStunMessageBuffer,
@@ -74,10 +90,48 @@ IceResult_t Ice_CreateRequestForNominatingValidCandidatePair( IceAgent_t * pIceA
                                                               IceCandidatePair_t * pIceCandidatePair,
                                                               uint8_t * pTransactionIdBuffer );
 
+IceCandidatePair_t * Ice_SelectPairToNominate( IceAgent_t * pIceAgent );
+
+IceResult_t Ice_GetCandidatePairRtt( const IceCandidatePair_t * pIceCandidatePair,
+                                     uint32_t * pSmoothedRtt,
+                                     uint32_t * pRttVariation );
+
 IceResult_t Ice_CreateRequestForConnectivityCheck( IceAgent_t * pIceAgent,
                                                    uint8_t * pStunMessageBuffer,
                                                    uint8_t * pTransactionIdBuffer );
 
+void Ice_InvalidateRequestTemplates( IceAgent_t * pIceAgent );
+
+IceResult_t Ice_CreateConnectivityChecks( IceAgent_t * pIceAgent,
+                                          uint8_t * pPacketArena,
+                                          size_t packetArenaSize,
+                                          IceOutboundPacket_t * pPackets,
+                                          uint32_t maxPacketCount,
+                                          uint32_t * pPacketCount );
+
+IceResult_t Ice_Tick( IceAgent_t * pIceAgent,
+                      uint64_t currentTime,
+                      uint8_t * pPacketArena,
+                      size_t packetArenaSize,
+                      IceOutboundPacket_t * pPackets,
+                      uint32_t maxPacketCount,
+                      uint32_t * pPacketCount,
+                      uint64_t * pNextDeadline );
+
+IceResult_t Ice_SetTimerWheel( IceAgent_t * pIceAgent,
+                               IceTimerWheel_t * pTimerWheel );
+
+IceResult_t Ice_SetConnectionTable( IceAgent_t * pIceAgent,
+                                    IceConnectionTable_t * pConnectionTable );
+
+IceResult_t Ice_HandleExpiredTimers( IceTimerWheel_t * pTimerWheel,
+                                     uint64_t currentTime,
+                                     uint8_t * pPacketArena,
+                                     size_t packetArenaSize,
+                                     IceOutboundPacket_t * pPackets,
+                                     uint32_t maxPacketCount,
+                                     uint32_t * pPacketCount );
+
 IceResult_t Ice_CreateResponseForRequest( IceAgent_t * pIceAgent,
                                           uint8_t * pStunMessageBuffer,
                                           IceIPAddress_t * pSrcAddr,
@@ -85,18 +139,50 @@ IceResult_t Ice_CreateResponseForRequest( IceAgent_t * pIceAgent,
 
 IceResult_t Ice_DeserializeStunPacket( StunContext_t * pStunCxt,
                                        StunHeader_t * pStunHeader,
-                                       StunAttribute_t * pStunAttribute,
-                                       StunAttributeAddress_t * pStunAttributeAddress,
-                                       uint32_t priority );
+                                       IceStunAttributeTable_t * pAttributeTable );
 
 IceResult_t Ice_HandleStunResponse( IceAgent_t * pIceAgent,
                                     uint8_t * pStunMessageBuffer,
-                                    uint8_t pStunMessageBufferLength,
+                                    size_t pStunMessageBufferLength,
                                     uint8_t * pTransactionIdBuffer,
                                     IceCandidate_t * pLocalCandidate,
                                     IceIPAddress_t pSrcAddr,
                                     IceCandidatePair_t * pIceCandidatePair );
 
+IceResult_t Ice_ClassifyStunPacket( IceAgent_t * pIceAgent,
+                                    uint8_t * pStunMessageBuffer,
+                                    size_t stunMessageBufferLength );
+
+IceResult_t Ice_HandleReceivedStunPacket( IceAgent_t * pIceAgent,
+                                          uint8_t * pStunMessageBuffer,
+                                          size_t stunMessageBufferLength,
+                                          const IceIPAddress_t * pLocalAddress,
+                                          const IceIPAddress_t * pSrcAddress,
+                                          IceCandidatePair_t ** ppIceCandidatePair );
+
+uint32_t Ice_HandleStunPackets( IceAgent_t * pIceAgent,
+                                const IceReceivedPacket_t * pPackets,
+                                IcePacketResult_t * pResults,
+                                uint32_t packetCount );
+
+IceOutboundBuffer_t * Ice_GetOutboundBuffer( IceAgent_t * pIceAgent );
+
+IceResult_t Ice_ReleaseOutboundBuffer( IceAgent_t * pIceAgent,
+                                       IceOutboundBuffer_t * pOutboundBuffer );
+
+IceCandidatePair_t * Ice_CheckListPopNextWaitingPair( IceAgent_t * pIceAgent );
+
+IceResult_t Ice_CheckListPush( IceAgent_t * pIceAgent,
+                               IceCandidatePair_t * pIceCandidatePair );
+
+void Ice_CheckListUpdatePriority( IceAgent_t * pIceAgent,
+                                  IceCandidatePair_t * pIceCandidatePair );
+
+void Ice_CheckListRemove( IceAgent_t * pIceAgent,
+                          IceCandidatePair_t * pIceCandidatePair );
+
+void Ice_CheckListRebuild( IceAgent_t * pIceAgent );
+
 IceResult_t Ice_HandleServerReflexiveCandidateResponse( IceAgent_t * pIceAgent,
                                                         StunAttributeAddress_t * pStunMappedAddress,
                                                         IceCandidate_t * pLocalCandidate );
@@ -105,29 +191,87 @@ IceResult_t Ice_HandleServerReflexiveCandidateResponse( IceAgent_t * pIceAgent,
 
 /* These APIs are intended for internal use by the ICE library. */
 
-bool Ice_IsSameIpAddress( StunAttributeAddress_t * pAddr1,
-                          StunAttributeAddress_t * pAddr2,
-                          bool checkPort );
+size_t Ice_LayoutIceAgentMemory( const IceAgentConfig_t * pAgentConfig,
+                                 uint8_t * pAgentMemory,
+                                 IceAgent_t * pIceAgent );
+
+size_t Ice_GetStunMessageLength( const uint8_t * pStunMessageBuffer );
+
+size_t Ice_AppendIntegrityAndFingerprint( const IceHmacSha1Key_t * pIntegrityKey,
+                                          uint8_t * pStunMessageBuffer,
+                                          size_t messageLength );
+
+IceResult_t Ice_ValidateStunPacket( IceRejectCounters_t * pRejectCounters,
+                                    const IceHmacSha1Key_t * pRequestKey,
+                                    const IceHmacSha1Key_t * pResponseKey,
+                                    uint8_t * pStunMessageBuffer,
+                                    size_t stunMessageBufferLength,
+                                    bool isResponseIntegrityRequired );
+
+uint32_t Ice_GetStunAttributeUint32( const IceStunAttributeTable_t * pAttributeTable,
+                                     IceStunAttributeIndex_t attributeIndex );
+
+uint64_t Ice_GetStunAttributeUint64( const IceStunAttributeTable_t * pAttributeTable,
+                                     IceStunAttributeIndex_t attributeIndex );
+
+IceResult_t Ice_GetStunAttributeAddress( StunContext_t * pStunCxt,
+                                         const IceStunAttributeTable_t * pAttributeTable,
+                                         IceStunAttributeIndex_t attributeIndex,
+                                         StunAttributeAddress_t * pStunAttributeAddress );
 
 bool Ice_IsSameIpAddress( StunAttributeAddress_t * pAddr1,
                           StunAttributeAddress_t * pAddr2,
                           bool checkPort );
 
-IceCandidate_t Ice_FindCandidateFromIp( IceAgent_t * pIceAgent,
-                                        IceIPAddress_t pIpAddress,
-                                        bool isRemote );
+IceCandidate_t * Ice_FindCandidateFromIp( IceAgent_t * pIceAgent,
+                                          const IceIPAddress_t * pIpAddress,
+                                          IceSocketProtocol_t protocol,
+                                          bool isRemote );
 
-void Ice_TransactionIdStoreRemove( TransactionIdStore_t * pTransactionIdStore,
-                                   uint8_t * transactionId );
+uint32_t Ice_HashCandidatePair( IceAgent_t * pIceAgent,
+                                const IceCandidate_t * pLocalCandidate,
+                                const IceIPAddress_t * pRemoteAddress );
+
+IceCandidatePair_t * Ice_FindCandidatePair( IceAgent_t * pIceAgent,
+                                            const IceCandidate_t * pLocalCandidate,
+                                            const IceIPAddress_t * pRemoteAddress );
+
+IceResult_t Ice_CreateTransactionIdStore( uint32_t maxIdCount,
+                                          uint64_t transactionTimeout,
+                                          uint32_t hashSeed,
+                                          IceTransaction_t * pTransactions,
+                                          IceHashBucket_t * pBuckets,
+                                          TransactionIdStore_t * pTransactionIdStore );
+
+IceResult_t Ice_TransactionIdStoreInsert( TransactionIdStore_t * pTransactionIdStore,
+                                          uint8_t * transactionId,
+                                          IceTransactionPurpose_t purpose,
+                                          IceCandidatePair_t * pIceCandidatePair,
+                                          IceCandidate_t * pLocalCandidate,
+                                          uint64_t sendTime );
+
+IceTransaction_t * Ice_TransactionIdStoreFind( TransactionIdStore_t * pTransactionIdStore,
+                                               uint8_t * transactionId );
 
 bool Ice_TransactionIdStoreHasId( TransactionIdStore_t * pTransactionIdStore,
                                   uint8_t * transactionId );
 
-void Ice_TransactionIdStoreInsert( TransactionIdStore_t * pTransactionIdStore,
+void Ice_TransactionIdStoreRemove( TransactionIdStore_t * pTransactionIdStore,
                                    uint8_t * transactionId );
 
-IceResult_t Ice_CreateTransactionIdStore( uint32_t maxIdCount,
-                                          TransactionIdStore_t * pTransactionIdStore );
+uint32_t Ice_TransactionIdStoreRemovePair( TransactionIdStore_t * pTransactionIdStore,
+                                           const IceCandidatePair_t * pIceCandidatePair,
+                                           IceTransactionPurpose_t purpose );
+
+void Ice_TransactionIdStoreClear( TransactionIdStore_t * pTransactionIdStore );
+
+uint32_t Ice_TransactionIdStoreExpire( TransactionIdStore_t * pTransactionIdStore,
+                                       uint64_t currentTime );
+
+IceResult_t Ice_TransactionIdStoreShareIndex( TransactionIdStore_t * pTransactionIdStore,
+                                              IceHashIndex_t * pSharedIndex,
+                                              uint32_t hashSeed,
+                                              uint32_t sharedEntry );
 
 uint64_t Ice_ComputeCandidatePairPriority( IceCandidatePair_t * pIceCandidatePair,
                                            uint32_t isLocalControlling );
@@ -0,0 +1,57 @@
+#ifndef ICE_CONNECTION_TABLE_H
+#define ICE_CONNECTION_TABLE_H
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    extern "C" {
+#endif
+/* *INDENT-ON* */
+
+/* Standard includes. */
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "ice_data_types.h"
+
+/************************************************************************************************************************************************/
+
+/* Connection table mapping the ( local address, remote address ) of a received datagram to the agent and the
+ * nominated candidate pair it belongs to, filled by the agents attached with Ice_SetConnectionTable.
+ * Lookups are lock-free: readers never write to the table and retry when a writer changed it meanwhile
+ * ( sequence lock ). Writers exclude each other with a spin lock, they are rare: one per nomination or failure.
+ * The agent and pair pointers returned stay valid as long as the application keeps the agent alive, an agent
+ * must be detached before it is destroyed. */
+
+IceResult_t Ice_GetConnectionTableMemorySize( uint32_t maxConnectionCount,
+                                              size_t * pTableMemorySize );
+
+IceResult_t Ice_CreateConnectionTable( IceConnectionTable_t * pConnectionTable,
+                                       uint32_t maxConnectionCount,
+                                       uint8_t * pTableMemory,
+                                       size_t tableMemorySize );
+
+IceResult_t Ice_ConnectionTableInsert( IceConnectionTable_t * pConnectionTable,
+                                       const StunAttributeAddress_t * pLocalAddress,
+                                       const StunAttributeAddress_t * pRemoteAddress,
+                                       IceAgent_t * pIceAgent,
+                                       IceCandidatePair_t * pIceCandidatePair );
+
+void Ice_ConnectionTableRemove( IceConnectionTable_t * pConnectionTable,
+                                const StunAttributeAddress_t * pLocalAddress,
+                                const StunAttributeAddress_t * pRemoteAddress );
+
+IceCandidatePair_t * Ice_ConnectionTableLookup( const IceConnectionTable_t * pConnectionTable,
+                                                const StunAttributeAddress_t * pLocalAddress,
+                                                const StunAttributeAddress_t * pRemoteAddress,
+                                                IceAgent_t ** ppIceAgent );
+
+/************************************************************************************************************************************************/
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    }
+#endif
+/* *INDENT-ON* */
+
+#endif /* ICE_CONNECTION_TABLE_H */
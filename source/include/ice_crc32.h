@@ -0,0 +1,50 @@
+#ifndef ICE_CRC32_H
+#define ICE_CRC32_H
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    extern "C" {
+#endif
+/* *INDENT-ON* */
+
+/* Standard includes. */
+#include <stdint.h>
+#include <stddef.h>
+
+/************************************************************************************************************************************************/
+
+/* CRC-32/ISO-HDLC ( reflected polynomial 0xEDB88320, initial value and final XOR 0xFFFFFFFF ), the checksum of the
+ * STUN FINGERPRINT attribute. The crc argument chains calls over consecutive buffers, start with 0.
+ *
+ * Ice_Crc32 dispatches to the fastest implementation available on the running CPU ( PCLMULQDQ folding on x86-64,
+ * the CRC32 instructions on ARMv8 ), falling back to the portable slice-by-8 table implementation.
+ * Define ICE_CRC32_DISABLE_HARDWARE to build the portable implementation only. */
+
+typedef uint32_t ( * IceCrc32Function_t )( uint32_t crc,
+                                           const uint8_t * pBuffer,
+                                           size_t bufferLength );
+
+uint32_t Ice_Crc32( uint32_t crc,
+                    const uint8_t * pBuffer,
+                    size_t bufferLength );
+
+uint32_t Ice_Crc32Portable( uint32_t crc,
+                            const uint8_t * pBuffer,
+                            size_t bufferLength );
+
+/* Replaces the implementation used by Ice_Crc32, e.g. with a platform CRC engine. NULL restores the built-in selection.
+ * Intended to be called once at start up, before any agent is in use. */
+void Ice_SetCrc32Function( IceCrc32Function_t crc32Function );
+
+/* Name of the implementation Ice_Crc32 dispatches to. */
+const char * Ice_GetCrc32ImplementationName( void );
+
+/************************************************************************************************************************************************/
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    }
+#endif
+/* *INDENT-ON* */
+
+#endif /* ICE_CRC32_H */
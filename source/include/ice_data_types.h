@@ -11,12 +11,56 @@
 #define ICE_CONNECTIVITY_SUCCESS_FLAG                           15
 
 #define DEFAULT_MAX_STORED_TRANSACTION_ID_COUNT                 20
-#define MAX_STORED_TRANSACTION_ID_COUNT                         100
+#define MAX_STORED_TRANSACTION_ID_COUNT                         1024
+
+/**
+ * Time after which an unanswered transaction ID is aged out of the store, in milliseconds.
+ * Matches the RFC 5389 default give-up time ( Rc = 7, Rm = 16, RTO = 500 ms ).
+ */
+#define ICE_DEFAULT_TRANSACTION_TIMEOUT_MS                      39500
+
+/**
+ * Default pacing interval Ta between two connectivity checks of an agent, in milliseconds ( RFC 8445 section 14.2 ).
+ */
+#define ICE_DEFAULT_CHECK_PACING_INTERVAL_MS                    50
+
+/**
+ * Deadline returned by Ice_Tick when the agent has nothing scheduled.
+ */
+#define ICE_TIME_INFINITE                                       UINT64_MAX
+
+/**
+ * STUN retransmission defaults ( RFC 5389 section 7.2.1 ): initial RTO, number of requests sent ( Rc )
+ * and the multiple of the initial RTO waited for a response to the last request ( Rm ).
+ */
+#define ICE_DEFAULT_INITIAL_RTO_MS                              500
+#define ICE_DEFAULT_MAX_REQUEST_COUNT                           7
+#define ICE_FINAL_RESPONSE_WAIT_MULTIPLIER                      16
+
+/**
+ * Largest round trip time folded into a pair's smoothed RTT, in milliseconds. Longer samples are clamped, so the RTT
+ * in microseconds always fits 32 bits.
+ */
+#define ICE_MAX_RTT_SAMPLE_MS                                   ( 1000 * 1000 )
+
+/**
+ * Hierarchical timer wheel geometry: ICE_TIMER_WHEEL_LEVELS levels of ICE_TIMER_WHEEL_SLOTS slots with 1 ms ticks,
+ * spanning 2^24 ms ( about 4.6 hours ) of look-ahead. Later timers are parked in the last level and cascaded again.
+ */
+#define ICE_TIMER_WHEEL_LEVELS                                  4
+#define ICE_TIMER_WHEEL_SLOT_BITS                               6
+#define ICE_TIMER_WHEEL_SLOTS                                   ( 1 << ICE_TIMER_WHEEL_SLOT_BITS )
+
+/**
+ * Marks the end of a transaction list in the transaction ID store.
+ */
+#define ICE_TRANSACTION_INVALID_INDEX                           UINT32_MAX
 
 #define ICE_MAX_LOCAL_CANDIDATE_COUNT                       100
 #define ICE_MAX_REMOTE_CANDIDATE_COUNT                      100
 #define ICE_MAX_CANDIDATE_PAIR_COUNT                        1024
 #define MAX_ICE_SERVERS_COUNT                               21
+#define ICE_MAX_MANAGED_AGENT_COUNT                         65536
 
 /* ICE candidate priorities */
 #define ICE_PRIORITY_HOST_CANDIDATE_TYPE_PREFERENCE             126
@@ -47,6 +91,89 @@
 
 #define ICE_STUN_MESSAGE_BUFFER_SIZE                            1024
 
+/**
+ * Recommended stunMessageBufferSize: the IPv4 minimum reassembly size of RFC 791, which a STUN message sent
+ * without knowing the path MTU should not exceed ( RFC 5389 section 7.1 ).
+ */
+#define ICE_OUTBOUND_BUFFER_SIZE                                576
+
+/**
+ * Maximum number of outbound STUN messages produced while handling one received packet
+ * ( a response plus a triggered check ).
+ */
+#define ICE_MAX_OUTBOUND_MESSAGES_PER_PACKET                    2
+
+/**
+ * Buckets of an IceHistogram_t: bucket 0 counts zero values, bucket b values in [ 2^(b-1), 2^b ),
+ * the last bucket every value from 2^(ICE_HISTOGRAM_BUCKET_COUNT-2) up.
+ */
+#define ICE_HISTOGRAM_BUCKET_COUNT                              32
+
+/**
+ * Check list position of a candidate pair that is not queued for a connectivity check.
+ */
+#define ICE_CHECK_LIST_INVALID_INDEX                            UINT32_MAX
+
+/**
+ * Hash index lookup results.
+ */
+#define ICE_HASH_INDEX_NOT_FOUND                                UINT32_MAX
+#define ICE_HASH_INDEX_CURSOR_START                             UINT32_MAX
+
+/**
+ * MESSAGE-INTEGRITY and FINGERPRINT attributes ending every authenticated STUN message.
+ */
+#define ICE_STUN_MESSAGE_TRAILER_LENGTH                         ( STUN_ATTRIBUTE_HEADER_LENGTH + STUN_HMAC_VALUE_LENGTH + \
+                                                                  STUN_ATTRIBUTE_HEADER_LENGTH + 4 )
+
+/**
+ * ICE-lite agent: host candidates it answers checks on, and the largest binding response it builds
+ * ( XOR-MAPPED-ADDRESS of an IPv6 source, MESSAGE-INTEGRITY and FINGERPRINT ).
+ */
+#define ICE_LITE_MAX_HOST_CANDIDATES                            8
+#define ICE_LITE_MAX_RESPONSE_LENGTH                            ( STUN_HEADER_LENGTH + STUN_ATTRIBUTE_HEADER_LENGTH + 4 + STUN_IPV6_ADDRESS_SIZE + \
+                                                                  ICE_STUN_MESSAGE_TRAILER_LENGTH )
+
+/**
+ * Log levels, most severe first. A logger passes the messages at or below its level.
+ */
+#define ICE_LOG_LEVEL_NONE                                      0
+#define ICE_LOG_LEVEL_ERROR                                     1
+#define ICE_LOG_LEVEL_WARN                                      2
+#define ICE_LOG_LEVEL_INFO                                      3
+#define ICE_LOG_LEVEL_DEBUG                                     4
+
+/**
+ * Longest log message kept by a log ring record, including the terminating NUL. Longer messages are truncated.
+ */
+#define ICE_LOG_MESSAGE_LENGTH                                  120
+
+/**
+ * Progress of an agent towards its first usable pair, timed into the timeToConnect histogram.
+ */
+#define ICE_CONNECT_PHASE_IDLE                                  0
+#define ICE_CONNECT_PHASE_CHECKING                              1
+#define ICE_CONNECT_PHASE_CONNECTED                             2
+
+/**
+ * Class bit of the STUN message type set in success and error responses.
+ */
+#define ICE_STUN_MESSAGE_CLASS_RESPONSE_BIT                     0x0100
+
+/**
+ * Alignment of every array carved out of the memory block handed to Ice_CreateIceAgent.
+ */
+#define ICE_AGENT_MEMORY_ALIGNMENT                              8
+#define ICE_AGENT_MEMORY_ALIGN( size )                          ( ( ( size_t ) ( size ) + ( ICE_AGENT_MEMORY_ALIGNMENT - 1 ) ) & ~( ( size_t ) ( ICE_AGENT_MEMORY_ALIGNMENT - 1 ) ) )
+
+/**
+ * Largest pre-encoded binding request prefix: header, USERNAME ( combinedUserName, padded ), PRIORITY and ICE-CONTROLLING / ICE-CONTROLLED.
+ */
+#define ICE_REQUEST_TEMPLATE_MAX_LENGTH                         ( STUN_HEADER_LENGTH + \
+                                                                  STUN_ATTRIBUTE_HEADER_LENGTH + ICE_AGENT_MEMORY_ALIGN( ( MAX_ICE_CONFIG_USER_NAME_LEN + 1 ) << 1 ) + \
+                                                                  STUN_ATTRIBUTE_HEADER_LENGTH + 4 + \
+                                                                  STUN_ATTRIBUTE_HEADER_LENGTH + 8 )
+
 typedef enum {
     ICE_CANDIDATE_TYPE_HOST,
     ICE_CANDIDATE_TYPE_PEER_REFLEXIVE,
@@ -66,9 +193,20 @@ typedef enum {
     ICE_CANDIDATE_PAIR_STATE_WAITING,
     ICE_CANDIDATE_PAIR_STATE_VALID,
     ICE_CANDIDATE_PAIR_STATE_NOMINATED,
-    ICE_CANDIDATE_PAIR_STATE_SUCCEEDED
+    ICE_CANDIDATE_PAIR_STATE_SUCCEEDED,
+    ICE_CANDIDATE_PAIR_STATE_FAILED,
+    ICE_CANDIDATE_PAIR_STATE_COUNT
 } IceCandidatePairState_t;
 
+/**
+ * How Ice_SelectPairToNominate picks among the valid pairs: the highest priority one ( RFC 8445 ), or the one with the
+ * lowest smoothed RTT among those whose priority is within nominationPriorityWindow of the highest.
+ */
+typedef enum {
+    ICE_NOMINATION_POLICY_PRIORITY,
+    ICE_NOMINATION_POLICY_LOWEST_RTT
+} IceNominationPolicy_t;
+
 typedef enum {
     ICE_SOCKET_PROTOCOL_NONE,
     ICE_SOCKET_PROTOCOL_TCP,
@@ -90,7 +228,19 @@ typedef enum IceResult
     ICE_RESULT_MAX_CANDIDATE_THRESHOLD,
     ICE_RESULT_MAX_CANDIDATE_PAIR_THRESHOLD,
     ICE_RESULT_OUT_OF_MEMORY,
-    ICE_RESULT_SPRINT_ERROR
+    ICE_RESULT_SPRINT_ERROR,
+    ICE_RESULT_LOCAL_CANDIDATE_NOT_FOUND,
+    ICE_RESULT_TRANSACTION_NOT_FOUND,
+    ICE_RESULT_NOT_STUN_PACKET,
+    ICE_RESULT_MALFORMED_STUN_PACKET,
+    ICE_RESULT_FINGERPRINT_MISMATCH,
+    ICE_RESULT_INTEGRITY_MISSING,
+    ICE_RESULT_INTEGRITY_MISMATCH,
+    ICE_RESULT_AGENT_NOT_FOUND,
+    ICE_RESULT_DUPLICATE_USERNAME,
+    ICE_RESULT_NO_RTT_SAMPLE,
+    ICE_RESULT_RANDOM_SOURCE_ERROR,
+    ICE_RESULT_FINGERPRINT_MISSING
 } IceResult_t;
 
 /* ICE component structures */
@@ -101,13 +251,202 @@ typedef struct IceIPAddress
     uint32_t isPointToPoint;
 } IceIPAddress_t;
 
+typedef struct IceHashBucket
+{
+    uint32_t hash;
+    uint32_t entry; // slot index of the entry + 1, 0 marks an empty bucket
+} IceHashBucket_t;
+
+typedef struct IceHashIndex
+{
+    IceHashBucket_t * pBuckets;
+    uint32_t bucketMask;
+    uint32_t entryCount;
+} IceHashIndex_t;
+
+/**
+ * HMAC-SHA1 key state: the SHA-1 chaining values after the ( key XOR ipad ) and ( key XOR opad ) blocks,
+ * so that computing a MAC only compresses the message blocks and the outer digest block.
+ */
+typedef struct IceHmacSha1Key
+{
+    uint32_t innerState[ 5 ];
+    uint32_t outerState[ 5 ];
+} IceHmacSha1Key_t;
+
+/**
+ * Timer linked into an IceTimerWheel_t slot. Embedded in the object it times, pContext identifies the owner
+ * when the timer is handed back by Ice_TimerWheelPopExpired. The slot sentinels are timers as well.
+ */
+typedef struct IceTimer
+{
+    struct IceTimer * pNext; // NULL while the timer is not scheduled
+    struct IceTimer * pPrev;
+    uint64_t expiry; // in milliseconds
+    void * pContext;
+    uint16_t slot; // level * ICE_TIMER_WHEEL_SLOTS + slot index, ICE_TIMER_WHEEL_EXPIRED_SLOT once expired
+} IceTimer_t;
+
+#define ICE_TIMER_WHEEL_EXPIRED_SLOT                            ( ICE_TIMER_WHEEL_LEVELS * ICE_TIMER_WHEEL_SLOTS )
+
+/**
+ * Hierarchical timer wheel, shared by all the agents driven from one thread. Level l slot i holds the timers
+ * due in the i-th 64^l ms span of the current rotation of that level, the occupancy bitmaps let Advance skip empty slots.
+ */
+typedef struct IceTimerWheel
+{
+    IceTimer_t slots[ ICE_TIMER_WHEEL_LEVELS ][ ICE_TIMER_WHEEL_SLOTS ];
+    IceTimer_t expired; // timers past their expiry, not yet popped
+    uint64_t occupancy[ ICE_TIMER_WHEEL_LEVELS ];
+    uint64_t currentTick; // first tick not yet processed, in milliseconds
+    uint32_t timerCount;
+} IceTimerWheel_t;
+
+typedef enum IceTransactionPurpose
+{
+    ICE_TRANSACTION_PURPOSE_NONE,
+    ICE_TRANSACTION_PURPOSE_SRFLX_REQUEST,
+    ICE_TRANSACTION_PURPOSE_CONNECTIVITY_CHECK,
+    ICE_TRANSACTION_PURPOSE_NOMINATION
+} IceTransactionPurpose_t;
+
+/**
+ * Attributes of a received STUN message the agent acts on, in the order of IceStunAttributeTable_t's slots.
+ */
+typedef enum IceStunAttributeIndex
+{
+    ICE_STUN_ATTRIBUTE_INDEX_XOR_MAPPED_ADDRESS,
+    ICE_STUN_ATTRIBUTE_INDEX_PRIORITY,
+    ICE_STUN_ATTRIBUTE_INDEX_USE_CANDIDATE,
+    ICE_STUN_ATTRIBUTE_INDEX_ICE_CONTROLLED,
+    ICE_STUN_ATTRIBUTE_INDEX_ICE_CONTROLLING,
+    ICE_STUN_ATTRIBUTE_INDEX_USERNAME,
+    ICE_STUN_ATTRIBUTE_INDEX_MESSAGE_INTEGRITY,
+    ICE_STUN_ATTRIBUTE_INDEX_FINGERPRINT,
+    ICE_STUN_ATTRIBUTE_INDEX_COUNT
+} IceStunAttributeIndex_t;
+
+#define ICE_STUN_ATTRIBUTE_FLAG( index )                        ( ( uint32_t ) 1 << ( index ) )
+
+/**
+ * Filled by a single walk of Ice_DeserializeStunPacket. For every attribute present ( bit set in flags ),
+ * valueOffsets holds the offset of its value from the start of the message and valueLengths its length,
+ * so handlers read the values straight from the received buffer.
+ */
+typedef struct IceStunAttributeTable
+{
+    const uint8_t * pMessage;
+    uint16_t messageType;
+    uint32_t flags;
+    uint16_t valueOffsets[ ICE_STUN_ATTRIBUTE_INDEX_COUNT ];
+    uint16_t valueLengths[ ICE_STUN_ATTRIBUTE_INDEX_COUNT ];
+} IceStunAttributeTable_t;
+
+/**
+ * Binding request prefix shared by every check the agent sends in one role, built on first use.
+ * A request is the template with its transaction ID and the PRIORITY value at priorityOffset
+ * patched in, followed by MESSAGE-INTEGRITY and FINGERPRINT.
+ */
+typedef struct IceRequestTemplate
+{
+    uint8_t buffer[ ICE_REQUEST_TEMPLATE_MAX_LENGTH ];
+    uint16_t length; // 0 while the template is not built
+    uint16_t priorityOffset;
+    uint64_t tieBreaker; // tie-breaker encoded in the template
+} IceRequestTemplate_t;
+
+struct IceCandidate;
+struct IceCandidatePair;
+
+/**
+ * One received datagram handed to Ice_HandleStunPackets.
+ */
+typedef struct IceReceivedPacket
+{
+    uint8_t * pBuffer;
+    size_t bufferLength;
+    IceIPAddress_t localAddress; // local socket address the datagram arrived on
+    IceIPAddress_t srcAddress;
+} IceReceivedPacket_t;
+
+/**
+ * One outbound datagram written by Ice_CreateConnectivityChecks. The message occupies
+ * length bytes at offset of the caller's packet arena, and is sent from localAddress to destination.
+ */
+typedef struct IceOutboundPacket
+{
+    IceIPAddress_t destination;
+    IceIPAddress_t localAddress;
+    struct IceCandidatePair * pIceCandidatePair;
+    uint32_t offset;
+    uint32_t length;
+} IceOutboundPacket_t;
+
+/**
+ * One buffer of the agent's outbound pool. Once handed out by Ice_GetOutboundBuffer it holds
+ * a STUN message of length bytes to send to destination, until Ice_ReleaseOutboundBuffer.
+ */
+typedef struct IceOutboundBuffer
+{
+    uint8_t * pBuffer;
+    uint32_t length;
+    uint32_t index; // slot in the pool
+    uint32_t isInUse; // taken from the free stack, not released yet
+    IceIPAddress_t destination;
+} IceOutboundBuffer_t;
+
+/**
+ * Outcome of one packet handled by Ice_HandleStunPackets. transactionId is copied from the packet's
+ * STUN header once it passed classification. outboundBufferCount is the number
+ * of outbound STUN messages queued while handling the packet ( see Ice_GetOutboundBuffer ).
+ */
+typedef struct IcePacketResult
+{
+    IceResult_t result;
+    struct IceCandidatePair * pIceCandidatePair;
+    uint8_t transactionId[ STUN_HEADER_TRANSACTION_ID_LENGTH ];
+    uint32_t outboundBufferCount;
+} IcePacketResult_t;
+
+typedef struct IceTransaction
+{
+    uint8_t transactionId[ STUN_HEADER_TRANSACTION_ID_LENGTH ];
+    IceTransactionPurpose_t purpose;
+    struct IceCandidatePair * pIceCandidatePair; // pair the request was sent on, NULL if not pair related
+    struct IceCandidate * pLocalCandidate; // local candidate the request was sent from, if known
+    uint64_t sendTime;
+    uint64_t deadline;
+    uint32_t hash;
+    uint32_t prev; // insertion order list while in use
+    uint32_t next; // insertion order list while in use, free list otherwise
+    IceTimer_t timer; // retransmission / timeout timer, when the store has a timer wheel
+    uint32_t rto; // current retransmission timeout, in milliseconds
+    uint32_t priority; // PRIORITY of the request, repeated by its retransmissions
+    uint8_t isControlling; // role the request was sent in, repeated by its retransmissions
+    uint8_t requestCount; // number of times the request was sent
+} IceTransaction_t;
+
+/**
+ * Hash set of outstanding STUN transaction IDs. Entries stay in their slot of pTransactions,
+ * the hash index maps transaction IDs to slots and the insertion order list ages entries out
+ * by deadline from its oldest end.
+ */
 typedef struct TransactionIdStore
 {
     uint32_t maxTransactionIdsCount;
-    uint32_t nextTransactionIdIndex;
-    uint32_t earliestTransactionIdIndex;
     uint32_t transactionIdCount;
-    uint8_t * transactionIds;
+    uint32_t oldestTransactionIndex;
+    uint32_t newestTransactionIndex;
+    uint32_t freeTransactionIndex;
+    uint32_t hashSeed;
+    uint64_t transactionTimeout;
+    IceTransaction_t * pTransactions;
+    IceHashIndex_t transactionIndex;
+    IceTimerWheel_t * pTimerWheel; // when set, every transaction is timed by the wheel instead of aged out by deadline
+    void * pTimerContext; // pContext of the transaction timers
+    uint32_t initialRto; // first retransmission timeout, in milliseconds
+    IceHashIndex_t * pSharedIndex; // when set, transaction IDs are also indexed here, e.g. by an agent manager
+    uint32_t sharedEntry; // entry of the store in pSharedIndex
 } TransactionIdStore_t;
 
 typedef struct IceCandidate
@@ -127,24 +466,267 @@ typedef struct IceCandidatePair
     uint64_t priority;
     IceCandidatePairState_t state;
     uint8_t connectivityChecks; // checking for completion of 4-way handshake
+    uint32_t checkListIndex; // position in the check list heap, ICE_CHECK_LIST_INVALID_INDEX when not queued
+    uint32_t smoothedRtt; // SRTT of the checks answered on their first send, in microseconds ( RFC 6298 )
+    uint32_t rttVariation; // RTTVAR, the jitter of those round trips, in microseconds
+    uint32_t rttSampleCount;
 } IceCandidatePair_t;
 
+/**
+ * Received packets dropped by Ice_ClassifyStunPacket, by reason.
+ */
+typedef struct IceRejectCounters
+{
+    uint64_t notStun; // first byte outside the STUN range ( RFC 7983 ), e.g. DTLS or RTP on a shared port
+    uint64_t badMagicCookie;
+    uint64_t badLength; // header length does not match the datagram or attributes overrun the message
+    uint64_t badFingerprint; // FINGERPRINT not matching, or missing where MESSAGE-INTEGRITY is required
+    uint64_t missingIntegrity; // binding request, or response to a check, without MESSAGE-INTEGRITY
+    uint64_t badIntegrity;
+    uint64_t badUsername; // USERNAME not addressed to the local username ( ICE-lite )
+} IceRejectCounters_t;
+
+/**
+ * Fixed power-of-two bucket histogram, see ICE_HISTOGRAM_BUCKET_COUNT.
+ */
+typedef struct IceHistogram
+{
+    uint64_t buckets[ ICE_HISTOGRAM_BUCKET_COUNT ];
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+} IceHistogram_t;
+
+/**
+ * Receives each log message passing the level of its logger, NUL terminated, messageLength excluding the NUL.
+ */
+typedef void ( * IceLogCallback_t )( void * pUserData,
+                                     uint32_t level,
+                                     const char * pMessage,
+                                     size_t messageLength );
+
+typedef struct IceLogger
+{
+    IceLogCallback_t callback; // NULL disables the logger
+    void * pUserData;
+    uint32_t level; // ICE_LOG_LEVEL_*
+} IceLogger_t;
+
+typedef struct IceLogRecord
+{
+    uint32_t level;
+    uint32_t messageLength;
+    char message[ ICE_LOG_MESSAGE_LENGTH ];
+} IceLogRecord_t;
+
+/**
+ * Single producer, single consumer ring of log records: the one thread it is attached to with Ice_LogRingAttachThread
+ * writes through Ice_LogRingCallback without locks or I/O, a background thread drains it with Ice_LogRingRead.
+ */
+typedef struct IceLogRing
+{
+    IceLogRecord_t * pRecords;
+    uint32_t recordMask; // record count - 1, a power of two
+    uint32_t head; // next record written, advanced by the producer
+    uint32_t tail; // next record read, advanced by the consumer
+    uint64_t droppedCount; // messages lost to a full ring, written by the producer
+} IceLogRing_t;
+
+#define ICE_RANDOM_SEED_LENGTH     32
+#define ICE_RANDOM_BLOCK_LENGTH    64
+
+/* Application-provided random source, must fill all length bytes. */
+typedef void ( * IceRandomSource_t )( void * pUserData,
+                                      uint8_t * pBuffer,
+                                      size_t length );
+
+/* Random generator: the application's source when one is set, ChaCha20 keyed with a system seed otherwise. */
+typedef struct IceRandom
+{
+    uint32_t key[ ICE_RANDOM_SEED_LENGTH / 4 ];
+    uint64_t blockCounter;
+    uint8_t block[ ICE_RANDOM_BLOCK_LENGTH ]; // key stream of the last generated block
+    uint32_t blockOffset; // bytes of block already handed out
+    IceRandomSource_t source;
+    void * pSourceData;
+} IceRandom_t;
+
+/**
+ * Nanosecond clock, used to time the handling of received packets.
+ */
+typedef uint64_t ( * IceStatsClock_t )( void );
+
+/**
+ * Counters and latency histograms of an agent. They are only written by the thread driving the agent, with plain
+ * increments; other threads read them through Ice_GetAgentStats snapshots taken by that thread.
+ */
+typedef struct IceAgentStats
+{
+    IceRejectCounters_t rejectCounters;
+    uint64_t packetsAccepted; // STUN packets passing Ice_ClassifyStunPacket
+    uint64_t requestsSent; // binding requests created, retransmissions excluded
+    uint64_t responsesSent; // binding success responses created
+    uint64_t retransmissions;
+    uint64_t transactionTimeouts; // pair requests given up without a response
+    uint64_t peerReflexiveCandidates;
+    uint64_t pairStateTransitions[ ICE_CANDIDATE_PAIR_STATE_COUNT ]; // entries into each pair state
+    IceHistogram_t gatheringTime; // server reflexive request sent to its mapped address received, in milliseconds
+    IceHistogram_t timeToConnect; // first request sent to first pair nominated or succeeded, in milliseconds
+    IceHistogram_t pairRtt; // request to response of checks answered on their first send, in milliseconds
+    IceHistogram_t handlerTime; // Ice_HandleStunPackets time per packet in nanoseconds, when statsClock is set
+} IceAgentStats_t;
+
+typedef struct IceConnectionEntry
+{
+    StunAttributeAddress_t localAddress;
+    StunAttributeAddress_t remoteAddress;
+    uint32_t hash;
+    uint32_t isUsed;
+    struct IceAgent * pIceAgent;
+    IceCandidatePair_t * pIceCandidatePair;
+} IceConnectionEntry_t;
+
+/**
+ * Open-addressing map of ( local address, remote address ) to the agent and candidate pair serving the connection,
+ * for the data path. Readers never block, see Ice_ConnectionTableLookup.
+ */
+typedef struct IceConnectionTable
+{
+    IceConnectionEntry_t * pEntries;
+    uint32_t entryMask; // entry count - 1, a power of two
+    uint32_t maxConnectionCount;
+    uint32_t connectionCount;
+    uint32_t hashSeed;
+    uint32_t sequence; // odd while a writer modifies pEntries
+    uint32_t writerLock;
+} IceConnectionTable_t;
+
+/**
+ * Per-agent capacities. The candidate, candidate pair and outbound STUN buffer arrays
+ * are sized from this configuration and carved out of a memory block provided by the
+ * application, see Ice_GetIceAgentMemorySize. Each maximum must not exceed the
+ * corresponding ICE_MAX_* limit.
+ */
+typedef struct IceAgentConfig
+{
+    uint32_t maxLocalCandidates;
+    uint32_t maxRemoteCandidates;
+    uint32_t maxCandidatePairs;
+    uint32_t stunMessageBufferCount;
+    uint32_t stunMessageBufferSize;
+    uint32_t maxTransactionIdCount;
+    uint32_t checkPacingInterval; // Ta in milliseconds, 0 selects ICE_DEFAULT_CHECK_PACING_INTERVAL_MS
+    uint32_t initialRto; // in milliseconds, 0 selects ICE_DEFAULT_INITIAL_RTO_MS
+    uint32_t maxRequestCount; // sends of a request before it times out ( Rc ), 0 selects ICE_DEFAULT_MAX_REQUEST_COUNT
+    IceStatsClock_t statsClock; // optional, NULL leaves the handlerTime histogram empty
+    IceNominationPolicy_t nominationPolicy;
+    uint32_t nominationPriorityWindow; // percent below the highest valid pair priority, ICE_NOMINATION_POLICY_LOWEST_RTT only
+    IceRandomSource_t randomSource; // optional, NULL selects the built-in generator seeded by the system
+    void * pRandomSourceData;
+} IceAgentConfig_t;
+
 typedef struct IceAgent
 {
     char localUsername[MAX_ICE_CONFIG_USER_NAME_LEN + 1];
     char localPassword[MAX_ICE_CONFIG_CREDENTIAL_LEN + 1];
     char remoteUsername[MAX_ICE_CONFIG_USER_NAME_LEN + 1];
     char remotePassword[MAX_ICE_CONFIG_CREDENTIAL_LEN + 1];
-    char combinedUserName[(MAX_ICE_CONFIG_USER_NAME_LEN + 1) << 1];
-    IceCandidate_t localCandidates[ ICE_MAX_LOCAL_CANDIDATE_COUNT ];
-    IceCandidate_t remoteCandidates[ ICE_MAX_REMOTE_CANDIDATE_COUNT ];
-    IceCandidatePair_t iceCandidatePairs[ ICE_MAX_CANDIDATE_PAIR_COUNT ];
-    uint8_t stunMessageBuffers[ ICE_MAX_CANDIDATE_PAIR_COUNT ][ ICE_STUN_MESSAGE_BUFFER_SIZE ];
-    uint16_t stunMessageBufferUsedCount;
+    char combinedUserName[(MAX_ICE_CONFIG_USER_NAME_LEN + 1) << 1]; // remoteUsername ":" localUsername, USERNAME of our requests
+    size_t localUsernameLength;
+    size_t localPasswordLength;
+    size_t remoteUsernameLength;
+    size_t remotePasswordLength;
+    size_t combinedUserNameLength;
+    IceCandidate_t * localCandidates;
+    IceCandidate_t * remoteCandidates;
+    IceCandidatePair_t * iceCandidatePairs;
+    uint32_t * pCheckList; // binary max-heap of iceCandidatePairs slot indices, ordered by pair priority
+    IceHashIndex_t localCandidateIndex; // ( family, address, port, protocol ) -> localCandidates slot
+    IceHashIndex_t remoteCandidateIndex; // ( family, address, port, protocol ) -> remoteCandidates slot
+    IceHashIndex_t candidatePairIndex; // ( local candidate slot, remote address, port, protocol ) -> iceCandidatePairs slot
+    uint32_t hashSeed;
+    uint8_t * stunMessageBuffers; // stunMessageBufferCount buffers of stunMessageBufferSize bytes
+    IceOutboundBuffer_t * pOutboundBuffers; // pool of outbound buffers, one per stunMessageBuffers slot
+    uint32_t * pOutboundFreeStack; // free pool slots, the most recently released on top
+    uint32_t * pOutboundReadyQueue; // ring of pool slots holding messages not yet collected by the application
+    uint32_t outboundFreeCount;
+    uint32_t outboundReadyHead;
+    uint32_t outboundReadyCount;
+    uint32_t maxLocalCandidates;
+    uint32_t maxRemoteCandidates;
+    uint32_t maxCandidatePairs;
+    uint32_t stunMessageBufferCount;
+    uint32_t stunMessageBufferSize;
+    uint32_t localCandidateCount;
+    uint32_t remoteCandidateCount;
+    uint32_t iceCandidatePairCount;
+    uint32_t checkListCount;
     uint32_t isControlling;
     uint64_t tieBreaker;
-    TransactionIdStore_t * pStunBindingRequestTransactionIdStore;
+    IceRandom_t random; // transaction IDs, tie-breaker and hash seeds
+    IceRequestTemplate_t requestTemplates[ 2 ]; // indexed by isControlling
+    IceHmacSha1Key_t localPasswordKey; // MESSAGE-INTEGRITY key of responses to the remote agent's requests
+    IceHmacSha1Key_t remotePasswordKey; // MESSAGE-INTEGRITY key of our requests
+    uint64_t currentTime; // last time reported by the application, in milliseconds
+    uint64_t nextCheckTime; // earliest time Ice_Tick may send the next ordinary connectivity check
+    uint32_t checkPacingInterval; // Ta, in milliseconds
+    uint32_t maxRequestCount; // Rc
+    IceNominationPolicy_t nominationPolicy;
+    uint32_t nominationPriorityWindow;
+    uint64_t connectStartTime; // time the first request was sent, valid when connectPhase is not ICE_CONNECT_PHASE_IDLE
+    uint32_t connectPhase;
+    IceStatsClock_t statsClock;
+    IceAgentStats_t stats;
+    IceLogger_t logger; // when its callback is NULL, the global logger is used
+    TransactionIdStore_t stunBindingRequestTransactionIdStore;
+    IceConnectionTable_t * pConnectionTable; // when set, nominated pairs are published here
 } IceAgent_t;
 
+/**
+ * ICE-lite agent ( RFC 8445 section 2.5 ): it only answers the checks of the full agent on its host candidates and
+ * accepts its nomination, so it keeps no candidate pairs, transactions or outbound buffers.
+ */
+typedef struct IceLiteAgent
+{
+    char localUsername[MAX_ICE_CONFIG_USER_NAME_LEN + 1];
+    size_t localUsernameLength;
+    IceHmacSha1Key_t localPasswordKey; // MESSAGE-INTEGRITY key of the requests received and the responses sent
+    IceIPAddress_t hostCandidates[ ICE_LITE_MAX_HOST_CANDIDATES ];
+    uint32_t hostCandidateCount;
+    IceIPAddress_t selectedLocalAddress; // pair nominated by the full agent, valid when isSelected
+    IceIPAddress_t selectedRemoteAddress;
+    uint32_t isSelected;
+    IceRejectCounters_t rejectCounters;
+} IceLiteAgent_t;
+
+typedef struct IceAgentManagerConfig
+{
+    uint32_t maxAgentCount;
+    uint32_t maxTransactionIdCount; // largest maxTransactionIdCount of a registered agent
+} IceAgentManagerConfig_t;
+
+typedef struct IceAgentManagerEntry
+{
+    IceAgent_t * pIceAgent; // NULL while the entry is free
+    uint32_t usernameHash;
+    uint32_t nextFree; // free list of entries
+} IceAgentManagerEntry_t;
+
+/**
+ * Registry of the agents sharing the sockets of the application. Binding requests are demultiplexed by the
+ * local ufrag in their USERNAME, responses by transaction ID through the index shared by the agents' stores.
+ */
+typedef struct IceAgentManager
+{
+    IceAgentManagerEntry_t * pEntries;
+    uint32_t maxAgentCount;
+    uint32_t maxTransactionIdCount;
+    uint32_t agentCount;
+    uint32_t freeEntry;
+    uint32_t hashSeed;
+    IceHashIndex_t usernameIndex; // local username -> pEntries slot
+    IceHashIndex_t transactionIndex; // transaction ID -> pEntries slot of the agent that sent it
+} IceAgentManager_t;
+
 #endif /* ICE_DATA_TYPES_H */
 
@@ -0,0 +1,60 @@
+#ifndef ICE_HASH_H
+#define ICE_HASH_H
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    extern "C" {
+#endif
+/* *INDENT-ON* */
+
+/* Standard includes. */
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "ice_data_types.h"
+
+/************************************************************************************************************************************************/
+
+/* Open-addressing (linear probing) index over entries that live in a separate, stable array.
+ * The index only stores { hash, entry slot }, so entries never move when the index changes,
+ * and callers compare the actual keys of the entries returned by Ice_HashIndexFindNext. */
+
+uint32_t Ice_HashIndexGetBucketCount( uint32_t maxEntries );
+
+void Ice_HashIndexInit( IceHashIndex_t * pHashIndex,
+                        IceHashBucket_t * pBuckets,
+                        uint32_t bucketCount );
+
+IceResult_t Ice_HashIndexInsert( IceHashIndex_t * pHashIndex,
+                                 uint32_t hash,
+                                 uint32_t entryIndex );
+
+uint32_t Ice_HashIndexFindNext( const IceHashIndex_t * pHashIndex,
+                                uint32_t hash,
+                                uint32_t * pCursor );
+
+void Ice_HashIndexRemove( IceHashIndex_t * pHashIndex,
+                          uint32_t hash,
+                          uint32_t entryIndex );
+
+void Ice_HashIndexClearRun( IceHashIndex_t * pHashIndex,
+                            uint32_t hash );
+
+uint32_t Ice_HashBytes( const uint8_t * pData,
+                        size_t dataLength,
+                        uint32_t seed );
+
+uint32_t Ice_HashAddress( const StunAttributeAddress_t * pAddress,
+                          uint32_t protocol,
+                          uint32_t seed );
+
+/************************************************************************************************************************************************/
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    }
+#endif
+/* *INDENT-ON* */
+
+#endif /* ICE_HASH_H */
@@ -0,0 +1,51 @@
+#ifndef ICE_HMAC_SHA1_H
+#define ICE_HMAC_SHA1_H
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    extern "C" {
+#endif
+/* *INDENT-ON* */
+
+/* Standard includes. */
+#include <stdint.h>
+#include <stddef.h>
+
+#include "ice_data_types.h"
+
+/************************************************************************************************************************************************/
+
+#define ICE_SHA1_BLOCK_LENGTH     64
+#define ICE_SHA1_DIGEST_LENGTH    20
+
+/* HMAC-SHA1 ( RFC 2104 ) as used by the STUN MESSAGE-INTEGRITY attribute. Ice_HmacSha1SetKey hashes the key pads once,
+ * Ice_HmacSha1 then only compresses the message blocks and one outer block per MAC.
+ *
+ * The SHA-1 compression uses the SHA extensions ( SHA-NI ) on x86-64 CPUs that have them, picked at first use,
+ * and a portable implementation otherwise. Define ICE_SHA1_DISABLE_HARDWARE to build the portable implementation only. */
+
+void Ice_HmacSha1SetKey( IceHmacSha1Key_t * pHmacKey,
+                         const uint8_t * pKey,
+                         size_t keyLength );
+
+void Ice_HmacSha1( const IceHmacSha1Key_t * pHmacKey,
+                   const uint8_t * pData,
+                   size_t dataLength,
+                   uint8_t * pMac );
+
+void Ice_Sha1( const uint8_t * pData,
+               size_t dataLength,
+               uint8_t * pDigest );
+
+/* Name of the SHA-1 compression implementation in use. */
+const char * Ice_GetSha1ImplementationName( void );
+
+/************************************************************************************************************************************************/
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    }
+#endif
+/* *INDENT-ON* */
+
+#endif /* ICE_HMAC_SHA1_H */
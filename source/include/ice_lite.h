@@ -0,0 +1,47 @@
+#ifndef ICE_LITE_H
+#define ICE_LITE_H
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    extern "C" {
+#endif
+/* *INDENT-ON* */
+
+/* Standard includes. */
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "ice_data_types.h"
+
+/************************************************************************************************************************************************/
+
+/* ICE-lite agent ( RFC 8445 section 2.5 ), always in the controlled role. It never sends checks: each binding request
+ * of the full agent is validated and answered straight into a caller buffer, without any per-request state, and a
+ * request carrying USE-CANDIDATE selects its pair. The agent is a few KB with no memory block to provide. */
+
+IceResult_t Ice_CreateLiteAgent( IceLiteAgent_t * pLiteAgent,
+                                 const char * pLocalUsername,
+                                 const char * pLocalPassword );
+
+IceResult_t Ice_LiteAddHostCandidate( IceLiteAgent_t * pLiteAgent,
+                                      const IceIPAddress_t * pIpAddress );
+
+IceResult_t Ice_LiteHandleBindingRequest( IceLiteAgent_t * pLiteAgent,
+                                          uint8_t * pStunMessageBuffer,
+                                          size_t stunMessageBufferLength,
+                                          const IceIPAddress_t * pLocalAddress,
+                                          const IceIPAddress_t * pSrcAddress,
+                                          uint8_t * pResponseBuffer,
+                                          size_t responseBufferLength,
+                                          size_t * pResponseLength );
+
+/************************************************************************************************************************************************/
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    }
+#endif
+/* *INDENT-ON* */
+
+#endif /* ICE_LITE_H */
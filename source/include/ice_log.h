@@ -0,0 +1,113 @@
+#ifndef ICE_LOG_H
+#define ICE_LOG_H
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    extern "C" {
+#endif
+/* *INDENT-ON* */
+
+/* Standard includes. */
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "ice_data_types.h"
+
+/************************************************************************************************************************************************/
+
+/* Leveled logging. Messages are handed to the logger of their agent, or to the global logger when the agent has none,
+ * if the logger's level lets them through; nothing is formatted otherwise. Logging is off until a callback is set.
+ * ICE_LOG_LEVEL is the build-time minimum: the ICE_LOG_* macros of less severe levels compile to nothing.
+ * The global logger is meant to be set once at start-up, before agents are driven. */
+
+#ifndef ICE_LOG_LEVEL
+    #define ICE_LOG_LEVEL    ICE_LOG_LEVEL_DEBUG
+#endif
+
+#if defined( __GNUC__ ) || defined( __clang__ )
+    #define ICE_LOG_FORMAT_CHECK( formatIndex, firstArgIndex )    __attribute__( ( format( printf, formatIndex, firstArgIndex ) ) )
+#else
+    #define ICE_LOG_FORMAT_CHECK( formatIndex, firstArgIndex )
+#endif
+
+#define ICE_LOG( pIceAgent, level, ... )                            \
+    do                                                              \
+    {                                                               \
+        if( Ice_LogIsEnabled( ( pIceAgent ), ( level ) ) )          \
+        {                                                           \
+            Ice_LogWrite( ( pIceAgent ), ( level ), __VA_ARGS__ );  \
+        }                                                           \
+    } while( 0 )
+
+#if ICE_LOG_LEVEL >= ICE_LOG_LEVEL_ERROR
+    #define ICE_LOG_ERROR( pIceAgent, ... )    ICE_LOG( pIceAgent, ICE_LOG_LEVEL_ERROR, __VA_ARGS__ )
+#else
+    #define ICE_LOG_ERROR( pIceAgent, ... )    do {} while( 0 )
+#endif
+
+#if ICE_LOG_LEVEL >= ICE_LOG_LEVEL_WARN
+    #define ICE_LOG_WARN( pIceAgent, ... )     ICE_LOG( pIceAgent, ICE_LOG_LEVEL_WARN, __VA_ARGS__ )
+#else
+    #define ICE_LOG_WARN( pIceAgent, ... )     do {} while( 0 )
+#endif
+
+#if ICE_LOG_LEVEL >= ICE_LOG_LEVEL_INFO
+    #define ICE_LOG_INFO( pIceAgent, ... )     ICE_LOG( pIceAgent, ICE_LOG_LEVEL_INFO, __VA_ARGS__ )
+#else
+    #define ICE_LOG_INFO( pIceAgent, ... )     do {} while( 0 )
+#endif
+
+#if ICE_LOG_LEVEL >= ICE_LOG_LEVEL_DEBUG
+    #define ICE_LOG_DEBUG( pIceAgent, ... )    ICE_LOG( pIceAgent, ICE_LOG_LEVEL_DEBUG, __VA_ARGS__ )
+#else
+    #define ICE_LOG_DEBUG( pIceAgent, ... )    do {} while( 0 )
+#endif
+
+void Ice_SetLogCallback( IceLogCallback_t callback,
+                         void * pUserData,
+                         uint32_t level );
+
+IceResult_t Ice_SetAgentLogCallback( IceAgent_t * pIceAgent,
+                                     IceLogCallback_t callback,
+                                     void * pUserData,
+                                     uint32_t level );
+
+bool Ice_LogIsEnabled( const IceAgent_t * pIceAgent,
+                       uint32_t level );
+
+void Ice_LogWrite( const IceAgent_t * pIceAgent,
+                   uint32_t level,
+                   const char * pFormat,
+                   ... ) ICE_LOG_FORMAT_CHECK( 3, 4 );
+
+/* Log ring sink. recordCount must be a power of two. Register Ice_LogRingCallback ( pUserData unused ) and attach
+ * one ring to each thread driving agents with Ice_LogRingAttachThread; each thread logs into its own ring only. */
+
+IceResult_t Ice_GetLogRingMemorySize( uint32_t recordCount,
+                                      size_t * pRingMemorySize );
+
+IceResult_t Ice_CreateLogRing( IceLogRing_t * pLogRing,
+                               uint32_t recordCount,
+                               uint8_t * pRingMemory,
+                               size_t ringMemorySize );
+
+void Ice_LogRingAttachThread( IceLogRing_t * pLogRing );
+
+void Ice_LogRingCallback( void * pUserData,
+                          uint32_t level,
+                          const char * pMessage,
+                          size_t messageLength );
+
+bool Ice_LogRingRead( IceLogRing_t * pLogRing,
+                      IceLogRecord_t * pLogRecord );
+
+/************************************************************************************************************************************************/
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    }
+#endif
+/* *INDENT-ON* */
+
+#endif /* ICE_LOG_H */
@@ -0,0 +1,52 @@
+#ifndef ICE_RANDOM_H
+#define ICE_RANDOM_H
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    extern "C" {
+#endif
+/* *INDENT-ON* */
+
+/* Standard includes. */
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "ice_data_types.h"
+
+/************************************************************************************************************************************************/
+
+/* Random numbers for transaction IDs, tie-breakers and hash seeds. The built-in generator is the ChaCha20 key stream
+ * ( RFC 8439, zero nonce, 64-bit block counter ) under a 32-byte seed read from the system, produced a 64-byte
+ * block at a time. A generator is not thread safe, each agent owns one. */
+
+IceResult_t Ice_RandomGetEntropy( uint8_t * pBuffer,
+                                  size_t length );
+
+IceResult_t Ice_RandomInit( IceRandom_t * pRandom,
+                            IceRandomSource_t source,
+                            void * pSourceData );
+
+void Ice_RandomInitFromSeed( IceRandom_t * pRandom,
+                             const uint8_t * pSeed );
+
+void Ice_RandomFill( IceRandom_t * pRandom,
+                     uint8_t * pBuffer,
+                     size_t length );
+
+uint32_t Ice_RandomUint32( IceRandom_t * pRandom );
+
+uint64_t Ice_RandomUint64( IceRandom_t * pRandom );
+
+IceResult_t Ice_RandomFillThreadLocal( uint8_t * pBuffer,
+                                       size_t length );
+
+/************************************************************************************************************************************************/
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    }
+#endif
+/* *INDENT-ON* */
+
+#endif /* ICE_RANDOM_H */
@@ -0,0 +1,47 @@
+#ifndef ICE_STATS_H
+#define ICE_STATS_H
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    extern "C" {
+#endif
+/* *INDENT-ON* */
+
+/* Standard includes. */
+#include <stdint.h>
+#include <stddef.h>
+
+#include "ice_data_types.h"
+
+/************************************************************************************************************************************************/
+
+/* Agent instrumentation. Each agent keeps its IceAgentStats_t in its own structure and updates it with plain
+ * increments from the thread driving it, so the hot path pays no atomics or locks. That thread takes snapshots with
+ * Ice_GetAgentStats, or Ice_AgentManagerGetStats for all the agents of a manager, and snapshots of several agents,
+ * managers or threads are summed with Ice_AccumulateAgentStats. */
+
+void Ice_HistogramRecord( IceHistogram_t * pHistogram,
+                          uint64_t value );
+
+void Ice_HistogramMerge( IceHistogram_t * pTotal,
+                         const IceHistogram_t * pHistogram );
+
+/* Upper bound of the bucket holding the given percentile ( 0 - 100 ) of the recorded values, 0 when empty. */
+uint64_t Ice_HistogramPercentile( const IceHistogram_t * pHistogram,
+                                  uint32_t percentile );
+
+IceResult_t Ice_GetAgentStats( const IceAgent_t * pIceAgent,
+                               IceAgentStats_t * pStats );
+
+void Ice_AccumulateAgentStats( IceAgentStats_t * pTotal,
+                               const IceAgentStats_t * pStats );
+
+/************************************************************************************************************************************************/
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    }
+#endif
+/* *INDENT-ON* */
+
+#endif /* ICE_STATS_H */
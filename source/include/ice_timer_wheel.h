@@ -0,0 +1,58 @@
+#ifndef ICE_TIMER_WHEEL_H
+#define ICE_TIMER_WHEEL_H
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    extern "C" {
+#endif
+/* *INDENT-ON* */
+
+/* Standard includes. */
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "ice_data_types.h"
+
+/************************************************************************************************************************************************/
+
+/* Hierarchical timer wheel with 1 ms ticks. Scheduling and cancelling a timer are O(1); advancing the wheel costs O(1)
+ * per expired timer plus one cascade per timer and level it crosses, empty slots are skipped through the occupancy bitmaps.
+ * Timers are intrusive: the wheel links the IceTimer_t embedded in the caller's objects and never allocates.
+ * Expired timers are queued by Ice_TimerWheelAdvance and handed out one at a time by Ice_TimerWheelPopExpired,
+ * so the caller can stop early and resume on its next call. */
+
+void Ice_TimerWheelInit( IceTimerWheel_t * pTimerWheel,
+                         uint64_t currentTime );
+
+void Ice_TimerInit( IceTimer_t * pTimer,
+                    void * pContext );
+
+bool Ice_TimerIsPending( const IceTimer_t * pTimer );
+
+/* Schedules, or reschedules, pTimer to expire at expiry. An expiry already passed fires on the next tick. */
+void Ice_TimerWheelSchedule( IceTimerWheel_t * pTimerWheel,
+                             IceTimer_t * pTimer,
+                             uint64_t expiry );
+
+void Ice_TimerWheelCancel( IceTimerWheel_t * pTimerWheel,
+                           IceTimer_t * pTimer );
+
+void Ice_TimerWheelAdvance( IceTimerWheel_t * pTimerWheel,
+                            uint64_t currentTime );
+
+IceTimer_t * Ice_TimerWheelPopExpired( IceTimerWheel_t * pTimerWheel );
+
+/* Earliest time Ice_TimerWheelAdvance needs to be called at, a lower bound of the next expiry.
+ * ICE_TIME_INFINITE when no timer is scheduled. */
+uint64_t Ice_TimerWheelGetNextExpiry( const IceTimerWheel_t * pTimerWheel );
+
+/************************************************************************************************************************************************/
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+    }
+#endif
+/* *INDENT-ON* */
+
+#endif /* ICE_TIMER_WHEEL_H */
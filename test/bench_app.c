@@ -0,0 +1,543 @@
+/* Standard includes. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Ice includes. */
+#include "ice_api.h"
+#include "ice_data_types.h"
+#include "ice_crc32.h"
+#include "ice_hmac_sha1.h"
+#include "ice_lite.h"
+#include "ice_random.h"
+
+#define BENCH_ITERATIONS        200
+#define BENCH_CRC32_ITERATIONS  1000000
+#define BENCH_HMAC_ITERATIONS   200000
+#define BENCH_LITE_ITERATIONS   500000
+#define BENCH_RANDOM_ITERATIONS 1000000
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static uint64_t bench_GetTimeNs( void )
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return ( ( uint64_t ) now.tv_sec * 1000000000ULL ) + ( uint64_t ) now.tv_nsec;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static void bench_MakeAddress( IceIPAddress_t * pIceIpAddress,
+                               uint32_t index,
+                               uint8_t isRemote )
+{
+    memset( pIceIpAddress, 0, sizeof( IceIPAddress_t ) );
+
+    pIceIpAddress->ipAddress.family = STUN_ADDRESS_IPv4;
+    pIceIpAddress->ipAddress.port = ( uint16_t ) ( 10000 + index );
+    pIceIpAddress->ipAddress.address[ 0 ] = isRemote ? 192 : 10;
+    pIceIpAddress->ipAddress.address[ 1 ] = 168;
+    pIceIpAddress->ipAddress.address[ 2 ] = ( uint8_t ) ( index >> 8 );
+    pIceIpAddress->ipAddress.address[ 3 ] = ( uint8_t ) index;
+    pIceIpAddress->isPointToPoint = 0;
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+/* bench_CandidatePairing - Adds candidateCount local host candidates and candidateCount remote candidates,
+ * which forms candidateCount^2 candidate pairs, and reports the average cost per created pair. */
+
+static void bench_CandidatePairing( uint32_t candidateCount )
+{
+    IceAgent_t iceAgent;
+    IceAgentConfig_t agentConfig;
+    IceIPAddress_t iceIpAddress;
+    IceCandidate_t * candidate = NULL;
+    IceResult_t result = ICE_RESULT_OK;
+    uint8_t * pAgentMemory;
+    size_t agentMemorySize = 0;
+    uint64_t startTime, totalTime = 0;
+    uint32_t i, iteration;
+    char localUsername[] = "local", localPassword[] = "abc123", remoteUsername[] = "remote", remotePassword[] = "xyz789";
+
+    agentConfig.maxLocalCandidates = candidateCount;
+    agentConfig.maxRemoteCandidates = candidateCount;
+    agentConfig.maxCandidatePairs = candidateCount * candidateCount;
+    agentConfig.stunMessageBufferCount = 4;
+    agentConfig.stunMessageBufferSize = ICE_OUTBOUND_BUFFER_SIZE;
+    agentConfig.maxTransactionIdCount = DEFAULT_MAX_STORED_TRANSACTION_ID_COUNT;
+    agentConfig.checkPacingInterval = 0;
+    agentConfig.initialRto = 0;
+    agentConfig.maxRequestCount = 0;
+    agentConfig.statsClock = NULL;
+    agentConfig.nominationPolicy = ICE_NOMINATION_POLICY_PRIORITY;
+    agentConfig.nominationPriorityWindow = 0;
+    agentConfig.randomSource = NULL;
+    agentConfig.pRandomSourceData = NULL;
+
+    if( Ice_GetIceAgentMemorySize( &agentConfig, &agentMemorySize ) != ICE_RESULT_OK )
+    {
+        printf( "Invalid configuration for %u candidates.\n", candidateCount );
+        return;
+    }
+
+    pAgentMemory = malloc( agentMemorySize );
+
+    for( iteration = 0; ( iteration < BENCH_ITERATIONS ) && ( result == ICE_RESULT_OK ); iteration++ )
+    {
+        result = Ice_CreateIceAgent( &iceAgent, &agentConfig, pAgentMemory, agentMemorySize,
+                                     localUsername, localPassword, remoteUsername, remotePassword );
+
+        startTime = bench_GetTimeNs();
+
+        for( i = 0; ( i < candidateCount ) && ( result == ICE_RESULT_OK ); i++ )
+        {
+            bench_MakeAddress( &iceIpAddress, i, 0 );
+            result = Ice_AddHostCandidate( iceIpAddress, &iceAgent, &candidate );
+        }
+
+        for( i = 0; ( i < candidateCount ) && ( result == ICE_RESULT_OK ); i++ )
+        {
+            bench_MakeAddress( &iceIpAddress, i, 1 );
+            result = Ice_AddRemoteCandidate( &iceAgent, ICE_CANDIDATE_TYPE_HOST, &candidate, iceIpAddress, ICE_SOCKET_PROTOCOL_UDP, 1000 + i );
+        }
+
+        totalTime += bench_GetTimeNs() - startTime;
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        printf( "%4u x %-4u candidates : %5u pairs, %10.1f ns per agent, %8.1f ns per pair\n",
+                candidateCount, candidateCount, Ice_GetValidCandidatePairCount( &iceAgent ),
+                ( double ) totalTime / BENCH_ITERATIONS,
+                ( double ) totalTime / BENCH_ITERATIONS / Ice_GetValidCandidatePairCount( &iceAgent ) );
+    }
+    else
+    {
+        printf( "Pairing benchmark for %u candidates failed with result %d.\n", candidateCount, result );
+    }
+
+    free( pAgentMemory );
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+/* bench_ConnectivityCheckGeneration - Pairs candidateCount local and remote host candidates, then generates the
+ * connectivity checks of all candidateCount^2 pairs in one batch and reports the average cost per check. */
+
+static void bench_ConnectivityCheckGeneration( uint32_t candidateCount )
+{
+    IceAgent_t iceAgent;
+    IceAgentConfig_t agentConfig;
+    IceIPAddress_t iceIpAddress;
+    IceCandidate_t * candidate = NULL;
+    IceOutboundPacket_t * pPackets;
+    IceResult_t result = ICE_RESULT_OK;
+    uint8_t * pAgentMemory, * pPacketArena;
+    size_t agentMemorySize = 0, packetArenaSize;
+    uint64_t startTime, totalTime = 0;
+    uint32_t i, iteration, packetCount = 0;
+    char localUsername[] = "local", localPassword[] = "abc123", remoteUsername[] = "remote", remotePassword[] = "xyz789";
+
+    agentConfig.maxLocalCandidates = candidateCount;
+    agentConfig.maxRemoteCandidates = candidateCount;
+    agentConfig.maxCandidatePairs = candidateCount * candidateCount;
+    agentConfig.stunMessageBufferCount = 4;
+    agentConfig.stunMessageBufferSize = 128;
+    agentConfig.maxTransactionIdCount = MAX_STORED_TRANSACTION_ID_COUNT;
+    agentConfig.checkPacingInterval = 0;
+    agentConfig.initialRto = 0;
+    agentConfig.maxRequestCount = 0;
+    agentConfig.statsClock = NULL;
+    agentConfig.nominationPolicy = ICE_NOMINATION_POLICY_PRIORITY;
+    agentConfig.nominationPriorityWindow = 0;
+    agentConfig.randomSource = NULL;
+    agentConfig.pRandomSourceData = NULL;
+
+    if( Ice_GetIceAgentMemorySize( &agentConfig, &agentMemorySize ) != ICE_RESULT_OK )
+    {
+        printf( "Invalid configuration for %u candidates.\n", candidateCount );
+        return;
+    }
+
+    packetArenaSize = ( size_t ) agentConfig.maxCandidatePairs * agentConfig.stunMessageBufferSize;
+    pAgentMemory = malloc( agentMemorySize );
+    pPacketArena = malloc( packetArenaSize );
+    pPackets = malloc( sizeof( IceOutboundPacket_t ) * agentConfig.maxCandidatePairs );
+
+    for( iteration = 0; ( iteration < BENCH_ITERATIONS ) && ( result == ICE_RESULT_OK ); iteration++ )
+    {
+        result = Ice_CreateIceAgent( &iceAgent, &agentConfig, pAgentMemory, agentMemorySize,
+                                     localUsername, localPassword, remoteUsername, remotePassword );
+
+        for( i = 0; ( i < candidateCount ) && ( result == ICE_RESULT_OK ); i++ )
+        {
+            bench_MakeAddress( &iceIpAddress, i, 0 );
+            result = Ice_AddHostCandidate( iceIpAddress, &iceAgent, &candidate );
+        }
+
+        for( i = 0; ( i < candidateCount ) && ( result == ICE_RESULT_OK ); i++ )
+        {
+            bench_MakeAddress( &iceIpAddress, i, 1 );
+            result = Ice_AddRemoteCandidate( &iceAgent, ICE_CANDIDATE_TYPE_HOST, &candidate, iceIpAddress, ICE_SOCKET_PROTOCOL_UDP, 1000 + i );
+        }
+
+        startTime = bench_GetTimeNs();
+
+        if( result == ICE_RESULT_OK )
+        {
+            result = Ice_CreateConnectivityChecks( &iceAgent, pPacketArena, packetArenaSize, pPackets, agentConfig.maxCandidatePairs, &packetCount );
+        }
+
+        totalTime += bench_GetTimeNs() - startTime;
+    }
+
+    if( ( result == ICE_RESULT_OK ) && ( packetCount > 0 ) )
+    {
+        printf( "%4u x %-4u candidates : %5u checks, %10.1f ns per batch, %8.1f ns per check\n",
+                candidateCount, candidateCount, packetCount,
+                ( double ) totalTime / BENCH_ITERATIONS,
+                ( double ) totalTime / BENCH_ITERATIONS / packetCount );
+    }
+    else
+    {
+        printf( "Check generation benchmark for %u candidates failed with result %d.\n", candidateCount, result );
+    }
+
+    free( pPackets );
+    free( pPacketArena );
+    free( pAgentMemory );
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+/* bench_Crc32 - Reports the cost of the FINGERPRINT CRC-32 over a STUN message sized buffer. */
+
+static void bench_Crc32( const char * pName,
+                         IceCrc32Function_t crc32Function,
+                         size_t messageLength )
+{
+    uint8_t message[ 256 ];
+    uint64_t startTime, totalTime;
+    uint32_t i, crc = 0;
+
+    for( i = 0; i < sizeof( message ); i++ )
+    {
+        message[ i ] = ( uint8_t ) ( i * 31 + 7 );
+    }
+
+    startTime = bench_GetTimeNs();
+
+    for( i = 0; i < BENCH_CRC32_ITERATIONS; i++ )
+    {
+        /* Chain the result into the message so the calls cannot be hoisted. */
+        message[ 0 ] = ( uint8_t ) crc;
+        crc = crc32Function( 0, message, messageLength );
+    }
+
+    totalTime = bench_GetTimeNs() - startTime;
+
+    printf( "%-12s %4zu bytes : %8.1f ns per message, %6.2f ns per byte ( 0x%08X )\n",
+            pName, messageLength,
+            ( double ) totalTime / BENCH_CRC32_ITERATIONS,
+            ( double ) totalTime / BENCH_CRC32_ITERATIONS / messageLength, crc );
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+/* bench_HmacSha1 - Reports the cost of MESSAGE-INTEGRITY over a binding request sized buffer, with the key state
+ * precomputed once per agent and with the key pads rehashed for every message. */
+
+static void bench_HmacSha1( size_t messageLength )
+{
+    IceHmacSha1Key_t hmacKey;
+    uint8_t message[ 256 ];
+    uint8_t mac[ ICE_SHA1_DIGEST_LENGTH ] = { 0 };
+    const uint8_t password[] = "0123456789abcdefghijkl";
+    uint64_t startTime, cachedTime, rekeyedTime;
+    uint32_t i;
+
+    for( i = 0; i < sizeof( message ); i++ )
+    {
+        message[ i ] = ( uint8_t ) ( i * 31 + 7 );
+    }
+
+    Ice_HmacSha1SetKey( &hmacKey, password, sizeof( password ) - 1 );
+    startTime = bench_GetTimeNs();
+
+    for( i = 0; i < BENCH_HMAC_ITERATIONS; i++ )
+    {
+        message[ 0 ] = mac[ 0 ];
+        Ice_HmacSha1( &hmacKey, message, messageLength, mac );
+    }
+
+    cachedTime = bench_GetTimeNs() - startTime;
+    startTime = bench_GetTimeNs();
+
+    for( i = 0; i < BENCH_HMAC_ITERATIONS; i++ )
+    {
+        message[ 0 ] = mac[ 0 ];
+        Ice_HmacSha1SetKey( &hmacKey, password, sizeof( password ) - 1 );
+        Ice_HmacSha1( &hmacKey, message, messageLength, mac );
+    }
+
+    rekeyedTime = bench_GetTimeNs() - startTime;
+
+    printf( "%-8s %4zu bytes : %8.1f ns per message with cached key state, %8.1f ns rehashing the key pads\n",
+            Ice_GetSha1ImplementationName(), messageLength,
+            ( double ) cachedTime / BENCH_HMAC_ITERATIONS,
+            ( double ) rekeyedTime / BENCH_HMAC_ITERATIONS );
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+/* bench_AgentSetup - Reports the cost of setting up a new session on an agent sized for the compile-time maximums, after a
+ * session that used sessionCandidateCount x sessionCandidateCount, with Ice_CreateIceAgent and with Ice_ResetAgent. */
+
+static void bench_AgentSetup( uint32_t sessionCandidateCount )
+{
+    IceAgent_t iceAgent;
+    IceAgentConfig_t agentConfig;
+    IceIPAddress_t iceIpAddress;
+    IceCandidate_t * candidate = NULL;
+    IceResult_t result = ICE_RESULT_OK;
+    uint8_t * pAgentMemory;
+    size_t agentMemorySize = 0;
+    uint64_t startTime, createTime = 0, resetTime = 0;
+    uint32_t i, iteration, isReset;
+    char localUsername[] = "local", localPassword[] = "abc123", remoteUsername[] = "remote", remotePassword[] = "xyz789";
+
+    agentConfig.maxLocalCandidates = ICE_MAX_LOCAL_CANDIDATE_COUNT;
+    agentConfig.maxRemoteCandidates = ICE_MAX_REMOTE_CANDIDATE_COUNT;
+    agentConfig.maxCandidatePairs = ICE_MAX_CANDIDATE_PAIR_COUNT;
+    agentConfig.stunMessageBufferCount = 64;
+    agentConfig.stunMessageBufferSize = ICE_OUTBOUND_BUFFER_SIZE;
+    agentConfig.maxTransactionIdCount = DEFAULT_MAX_STORED_TRANSACTION_ID_COUNT;
+    agentConfig.checkPacingInterval = 0;
+    agentConfig.initialRto = 0;
+    agentConfig.maxRequestCount = 0;
+    agentConfig.statsClock = NULL;
+    agentConfig.nominationPolicy = ICE_NOMINATION_POLICY_PRIORITY;
+    agentConfig.nominationPriorityWindow = 0;
+    agentConfig.randomSource = NULL;
+    agentConfig.pRandomSourceData = NULL;
+
+    if( Ice_GetIceAgentMemorySize( &agentConfig, &agentMemorySize ) != ICE_RESULT_OK )
+    {
+        printf( "Invalid configuration for the setup benchmark.\n" );
+        return;
+    }
+
+    pAgentMemory = malloc( agentMemorySize );
+    result = Ice_CreateIceAgent( &iceAgent, &agentConfig, pAgentMemory, agentMemorySize,
+                                 localUsername, localPassword, remoteUsername, remotePassword );
+
+    for( iteration = 0; ( iteration < 2 * BENCH_ITERATIONS ) && ( result == ICE_RESULT_OK ); iteration++ )
+    {
+        /* The previous session. */
+        for( i = 0; ( i < sessionCandidateCount ) && ( result == ICE_RESULT_OK ); i++ )
+        {
+            bench_MakeAddress( &iceIpAddress, i, 0 );
+            result = Ice_AddHostCandidate( iceIpAddress, &iceAgent, &candidate );
+        }
+
+        for( i = 0; ( i < sessionCandidateCount ) && ( result == ICE_RESULT_OK ); i++ )
+        {
+            bench_MakeAddress( &iceIpAddress, i, 1 );
+            result = Ice_AddRemoteCandidate( &iceAgent, ICE_CANDIDATE_TYPE_HOST, &candidate, iceIpAddress, ICE_SOCKET_PROTOCOL_UDP, 1000 + i );
+        }
+
+        isReset = iteration & 1;
+        startTime = bench_GetTimeNs();
+
+        if( result != ICE_RESULT_OK )
+        {
+            break;
+        }
+        else if( isReset )
+        {
+            result = Ice_ResetAgent( &iceAgent, localUsername, localPassword, remoteUsername, remotePassword );
+            resetTime += bench_GetTimeNs() - startTime;
+        }
+        else
+        {
+            result = Ice_CreateIceAgent( &iceAgent, &agentConfig, pAgentMemory, agentMemorySize,
+                                         localUsername, localPassword, remoteUsername, remotePassword );
+            createTime += bench_GetTimeNs() - startTime;
+        }
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        printf( "%4u x %-4u candidates used : %10.1f ns to create, %10.1f ns to reset\n",
+                sessionCandidateCount, sessionCandidateCount,
+                ( double ) createTime / BENCH_ITERATIONS,
+                ( double ) resetTime / BENCH_ITERATIONS );
+    }
+    else
+    {
+        printf( "Setup benchmark for %u candidates failed with result %d.\n", sessionCandidateCount, result );
+    }
+
+    free( pAgentMemory );
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+/* bench_TransactionIdGeneration - Reports the cost of a 12-byte transaction ID from the agent's ChaCha20 generator
+ * and from one rand() call per byte. */
+
+static void bench_TransactionIdGeneration( void )
+{
+    IceRandom_t random;
+    uint8_t transactionId[ STUN_HEADER_TRANSACTION_ID_LENGTH ] = { 0 };
+    uint64_t startTime, chachaTime, randTime;
+    uint32_t i, j, checksum = 0;
+
+    Ice_RandomInit( &random, NULL, NULL );
+    startTime = bench_GetTimeNs();
+
+    for( i = 0; i < BENCH_RANDOM_ITERATIONS; i++ )
+    {
+        Ice_RandomFill( &random, transactionId, sizeof( transactionId ) );
+        checksum += transactionId[ 0 ];
+    }
+
+    chachaTime = bench_GetTimeNs() - startTime;
+    startTime = bench_GetTimeNs();
+
+    for( i = 0; i < BENCH_RANDOM_ITERATIONS; i++ )
+    {
+        for( j = 0; j < STUN_HEADER_TRANSACTION_ID_LENGTH; j++ )
+        {
+            transactionId[ j ] = ( uint8_t ) rand();
+        }
+
+        checksum += transactionId[ 0 ];
+    }
+
+    randTime = bench_GetTimeNs() - startTime;
+
+    printf( "ChaCha20 : %6.1f ns per transaction ID, rand() : %6.1f ns per transaction ID ( %u )\n",
+            ( double ) chachaTime / BENCH_RANDOM_ITERATIONS,
+            ( double ) randTime / BENCH_RANDOM_ITERATIONS, checksum & 0xFF );
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+/* bench_LiteBindingResponse - Reports the cost of validating a binding request and building its response with an
+ * ICE-lite agent, i.e. the checks one core answers per second. */
+
+static void bench_LiteBindingResponse( void )
+{
+    IceResult_t result;
+    IceLiteAgent_t liteAgent;
+    IceIPAddress_t localAddress, srcAddress;
+    uint8_t request[ 128 ] = { 0x00, 0x01, 0x00, 0x00, 0x21, 0x12, 0xA4, 0x42 };
+    uint8_t response[ ICE_LITE_MAX_RESPONSE_LENGTH ];
+    const char username[] = "lite:peer";
+    size_t requestLength, responseLength = 0;
+    uint64_t startTime, elapsedTime;
+    uint32_t i;
+
+    bench_MakeAddress( &localAddress, 1, 0 );
+    bench_MakeAddress( &srcAddress, 1, 1 );
+
+    result = Ice_CreateLiteAgent( &liteAgent, "lite", "0123456789abcdefghijkl" );
+
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_LiteAddHostCandidate( &liteAgent, &localAddress );
+    }
+
+    /* Binding request with USERNAME, USE-CANDIDATE, MESSAGE-INTEGRITY and FINGERPRINT. */
+    request[ 20 ] = 0x00;
+    request[ 21 ] = 0x06;
+    request[ 22 ] = 0x00;
+    request[ 23 ] = sizeof( username ) - 1;
+    memcpy( request + 24, username, sizeof( username ) - 1 );
+    request[ 36 ] = 0x00;
+    request[ 37 ] = 0x25;
+    requestLength = Ice_AppendIntegrityAndFingerprint( &( liteAgent.localPasswordKey ), request, 40 );
+
+    startTime = bench_GetTimeNs();
+
+    for( i = 0; ( result == ICE_RESULT_OK ) && ( i < BENCH_LITE_ITERATIONS ); i++ )
+    {
+        result = Ice_LiteHandleBindingRequest( &liteAgent, request, requestLength, &localAddress, &srcAddress,
+                                               response, sizeof( response ), &responseLength );
+        result = ( result == ICE_RESULT_USE_CANDIDATE_FLAG ) ? ICE_RESULT_OK : result;
+    }
+
+    elapsedTime = bench_GetTimeNs() - startTime;
+
+    if( result == ICE_RESULT_OK )
+    {
+        printf( "%zu byte request, %zu byte response : %8.1f ns per check, %8.0f checks per second\n",
+                requestLength, responseLength,
+                ( double ) elapsedTime / BENCH_LITE_ITERATIONS,
+                1e9 * BENCH_LITE_ITERATIONS / ( double ) elapsedTime );
+    }
+    else
+    {
+        printf( "ICE-lite benchmark failed with result %d.\n", result );
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+int main( void )
+{
+    uint32_t candidateCount;
+    size_t messageLength;
+
+    printf( "\nCandidate pairing cost\n\n" );
+
+    for( candidateCount = 2; candidateCount <= 32; candidateCount <<= 1 )
+    {
+        bench_CandidatePairing( candidateCount );
+    }
+
+    printf( "\nConnectivity check generation cost\n\n" );
+
+    for( candidateCount = 2; candidateCount <= 32; candidateCount <<= 1 )
+    {
+        bench_ConnectivityCheckGeneration( candidateCount );
+    }
+
+    printf( "\nFINGERPRINT CRC-32 cost\n\n" );
+
+    for( messageLength = 60; messageLength <= 120; messageLength += 20 )
+    {
+        bench_Crc32( "slice-by-8", Ice_Crc32Portable, messageLength );
+        bench_Crc32( Ice_GetCrc32ImplementationName(), Ice_Crc32, messageLength );
+    }
+
+    printf( "\nMESSAGE-INTEGRITY HMAC-SHA1 cost\n\n" );
+
+    for( messageLength = 60; messageLength <= 120; messageLength += 20 )
+    {
+        bench_HmacSha1( messageLength );
+    }
+
+    printf( "\nICE-lite binding response cost\n\n" );
+
+    bench_LiteBindingResponse();
+
+    printf( "\nTransaction ID generation cost\n\n" );
+
+    bench_TransactionIdGeneration();
+
+    printf( "\nSession setup cost\n\n" );
+
+    for( candidateCount = 2; candidateCount <= 32; candidateCount <<= 1 )
+    {
+        bench_AgentSetup( candidateCount );
+    }
+
+    return 0;
+}
@@ -6,7 +6,17 @@
 /* Ice incluudes. */
 #include "ice_api.h"
 #include "ice_data_types.h"
+#include "ice_timer_wheel.h"
+#include "ice_agent_manager.h"
+#include "ice_connection_table.h"
+#include "ice_lite.h"
+#include "ice_stats.h"
+#include "ice_log.h"
+#include "ice_random.h"
+#include "ice_hash.h"
+#include "ice_crc32.h"
 #include "stun_serializer.h"
+#include "stun_deserializer.h"
 
 typedef enum RequestType{
     NOMINATING_CANDIDATE,
@@ -14,7 +24,23 @@ typedef enum RequestType{
     RESPONSE_FOR_REQUEST
 } RequestType_t;
 
-TransactionIdStore_t buffer[MAX_STORED_TRANSACTION_ID_COUNT] = { 0 };
+IceAgentConfig_t agentConfig = {
+    .maxLocalCandidates = 10,
+    .maxRemoteCandidates = 10,
+    .maxCandidatePairs = 100,
+    .stunMessageBufferCount = 16,
+    .stunMessageBufferSize = ICE_OUTBOUND_BUFFER_SIZE,
+    .maxTransactionIdCount = DEFAULT_MAX_STORED_TRANSACTION_ID_COUNT
+};
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static void test_LogToStdout( void * pUserData, uint32_t level, const char * pMessage, size_t messageLength )
+{
+    ( void ) pUserData;
+
+    printf( "[%u] %.*s\n", level, ( int ) messageLength, pMessage );
+}
 
 /*--------------------------------------------------------------------------------------------------------------------------------------------------------------------*/
 
@@ -23,9 +49,17 @@ void test_IceAgentInit( IceAgent_t * iceAgent )
     IceResult_t result;
 
     char str1[] = "local", str2[] = "abc123", str3[] = "remote", str4[] = "xyz789";
-    char str5[] = "remote:local";
+    size_t agentMemorySize = 0;
+    uint8_t * pAgentMemory = NULL;
 
-    result = Ice_CreateIceAgent( iceAgent, str1, str2, str3, str4, str5, buffer );
+    result = Ice_GetIceAgentMemorySize( &agentConfig, &agentMemorySize );
+
+    if( result == ICE_RESULT_OK )
+    {
+        printf("Ice Agent memory size : %zu bytes.\n", agentMemorySize );
+        pAgentMemory = malloc( agentMemorySize );
+        result = Ice_CreateIceAgent( iceAgent, &agentConfig, pAgentMemory, agentMemorySize, str1, str2, str3, str4 );
+    }
     
     if( result == ICE_RESULT_OK )
     {
@@ -46,7 +80,7 @@ void test_GenerateHostCandidate( IceAgent_t * iceAgent )
     IceResult_t result ;
     StunAttributeAddress_t stunAddress1, stunAddress2;
     IceIPAddress_t iceIpAddress1, iceIpAddress2;
-    IceCandidate_t localCandidate;
+    IceCandidate_t * localCandidate = NULL;
 
     uint8_t ipAddress1V6[] = { 0x20, 0x01, 0x0D, 0xB8, 0x12, 0x34, 0x56, 0x78,
                                 0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77 }; 
@@ -73,7 +107,7 @@ void test_GenerateHostCandidate( IceAgent_t * iceAgent )
 
     if( result == ICE_RESULT_OK )
     {
-        printf("Local Candidate --> Port : %d\n", iceAgent->localCandidates[ 0 ].ipAddress.ipAddress.port );
+        printf("Local Candidate --> Port : %d\n", localCandidate->ipAddress.ipAddress.port );
     }
     else
     {
@@ -84,7 +118,7 @@ void test_GenerateHostCandidate( IceAgent_t * iceAgent )
     
     if( result == ICE_RESULT_OK )
     {
-        printf("Local Candidate --> Port : %d\n", iceAgent->localCandidates[ 1 ].ipAddress.ipAddress.port );
+        printf("Local Candidate --> Port : %d\n", localCandidate->ipAddress.ipAddress.port );
     }
     else
     {
@@ -103,7 +137,7 @@ void test_GenerateSrflxCandidate( IceAgent_t * iceAgent )
     IceIPAddress_t iceIpAddress;
     uint8_t stunMessageBuffer[ 1024 ] = { 0 };
     int i;
-    IceCandidate_t srflxCandidate;
+    IceCandidate_t * srflxCandidate = NULL;
 
     uint8_t ipAddressV6[] = { 0x20, 0x01, 0x0D, 0xB8, 0x12, 0x34, 0x56, 0x78,
                               0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77 };
@@ -123,7 +157,7 @@ void test_GenerateSrflxCandidate( IceAgent_t * iceAgent )
 
     if( result == ICE_RESULT_OK )
     {
-        printf("\nLocal Candidate --> Port %d\n", iceAgent->localCandidates[ 2 ].ipAddress.ipAddress.port );
+        printf("\nLocal Candidate --> Port %d\n", srflxCandidate->ipAddress.ipAddress.port );
         
         printf( "\nSerialized Message for Srflx request :\n\n" );
         
@@ -132,7 +166,7 @@ void test_GenerateSrflxCandidate( IceAgent_t * iceAgent )
             printf( "0x%02x ", stunMessageBuffer[ i ] );
         }
 
-        printf(" \n\nTransaction Id Count %d",iceAgent->pStunBindingRequestTransactionIdStore->transactionIdCount );
+        printf(" \n\nTransaction Id Count %d",iceAgent->stunBindingRequestTransactionIdStore.transactionIdCount );
     }
     else
     {
@@ -149,7 +183,7 @@ void test_GenerateRemoteCandidate( IceAgent_t * iceAgent )
     IceResult_t result ;
     StunAttributeAddress_t stunAddress;
     IceIPAddress_t iceIpAddress;
-    IceCandidate_t * remoteCandidate = malloc( sizeof( struct IceCandidate ) );
+    IceCandidate_t * remoteCandidate = NULL;
 
     uint8_t ipAddressV6[] = { 0x20, 0x01, 0x0D, 0xB8, 0x12, 0x34, 0x56, 0x78,
                               0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77 }; 
@@ -162,11 +196,11 @@ void test_GenerateRemoteCandidate( IceAgent_t * iceAgent )
     iceIpAddress.ipAddress = stunAddress;
     iceIpAddress.isPointToPoint = 0;
 
-    result = Ice_AddRemoteCandidate( iceAgent, ICE_CANDIDATE_TYPE_SERVER_REFLEXIVE, remoteCandidate, iceIpAddress, ICE_SOCKET_PROTOCOL_TCP, 5 );
+    result = Ice_AddRemoteCandidate( iceAgent, ICE_CANDIDATE_TYPE_SERVER_REFLEXIVE, &remoteCandidate, iceIpAddress, ICE_SOCKET_PROTOCOL_TCP, 5 );
 
     if( result == ICE_RESULT_OK )
     {
-        printf("Remote Candidate --> Port %d\n", iceAgent->remoteCandidates[ 0 ].ipAddress.ipAddress.port );
+        printf("Remote Candidate --> Port %d\n", remoteCandidate->ipAddress.ipAddress.port );
     }
     else
     {
@@ -179,8 +213,8 @@ void test_GenerateRemoteCandidate( IceAgent_t * iceAgent )
 void test_DisplayCandidatePairs( IceAgent_t * iceAgent )
 {
     printf( "\n\nPrinting Candidate Pairs\n" );
-    int i;
-    for( i = 0; i < ICE_MAX_CANDIDATE_PAIR_COUNT; i++ )
+    uint32_t i;
+    for( i = 0; i < iceAgent->maxCandidatePairs; i++ )
     {
         if( iceAgent->iceCandidatePairs[i].state != ICE_CANDIDATE_PAIR_STATE_INVALID )
         {
@@ -266,6 +300,31 @@ void test_GenerateStunRequests( IceAgent_t * iceAgent , RequestType_t index )
 
 /*--------------------------------------------------------------------------------------------------------------------------------------------------------------------*/
 
+void test_CreateConnectivityChecks( IceAgent_t * iceAgent )
+{
+    printf("\nGenerating Connectivity checks for the waiting Candidate Pairs. \n");
+    IceResult_t result;
+    IceOutboundPacket_t packets[ 4 ];
+    uint8_t packetArena[ 4 * ICE_STUN_MESSAGE_BUFFER_SIZE ];
+    uint32_t i, packetCount = 0;
+
+    result = Ice_CreateConnectivityChecks( iceAgent, packetArena, sizeof( packetArena ), packets, 4, &packetCount );
+
+    if( result == ICE_RESULT_OK )
+    {
+        for( i = 0; i < packetCount; i++ )
+        {
+            printf("Check %u : Local Candidate Port %d --> Remote Candidate Port %d, %u bytes at offset %u.\n", i, packets[ i ].localAddress.ipAddress.port, packets[ i ].destination.ipAddress.port, packets[ i ].length, packets[ i ].offset );
+        }
+    }
+    else
+    {
+        printf("Generating Connectivity checks failed with result %d.\n", result );
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
 void test_HandleStunResponseFromIceServerForSrflxCandidate( IceAgent_t * iceAgent )
 {
     printf("\nHandling Stun Response from IceServer. \n");
@@ -287,14 +346,15 @@ void test_HandleStunResponseFromIceServerForSrflxCandidate( IceAgent_t * iceAgen
     memcpy( stunAddress.address, ipAddressV6, STUN_IPV6_ADDRESS_SIZE );
 
     /* Initialise Dummy STUN Response and add it to Transaction ID store */
-    result = Ice_InitializeStunPacket( &pStunCxt, transactionId, stunMessageBuffer, &pStunHeader, 0, 0 );
-    result = StunSerializer_AddAttributeXorMappedAddress( &pStunCxt , &stunAddress );
+    result = Ice_InitializeStunPacket( &pStunCxt, transactionId, stunMessageBuffer, sizeof( stunMessageBuffer ), &pStunHeader, 0, 0 );
+    result = ( IceResult_t ) StunSerializer_AddAttributeXorMappedAddress( &pStunCxt , &stunAddress );
 
     if( result == ICE_RESULT_OK )
     {
-        Ice_TransactionIdStoreInsert( iceAgent->pStunBindingRequestTransactionIdStore, pStunHeader.pTransactionId );
+        Ice_TransactionIdStoreInsert( &( iceAgent->stunBindingRequestTransactionIdStore ), pStunHeader.pTransactionId,
+                                      ICE_TRANSACTION_PURPOSE_SRFLX_REQUEST, NULL, &( iceAgent->localCandidates[ 2 ] ), 0 );
 
-        result = Ice_PackageStunPacket( &pStunCxt, NULL, 0 );
+        result = Ice_PackageStunPacket( &pStunCxt, NULL );
     }
 
     printf("\n");
@@ -318,7 +378,6 @@ void test_HandleStunRequestFromRemoteCandidate( IceAgent_t * iceAgent )
     printf("\nHandling Stun Request from Remote Candidate. \n");
 
     IceResult_t result;
-    int i;
     StunContext_t pStunCxt;
     StunHeader_t pStunHeader;
     uint8_t stunMessageBuffer[ 1024 ] = { 0 };
@@ -338,12 +397,12 @@ void test_HandleStunRequestFromRemoteCandidate( IceAgent_t * iceAgent )
     iceIpAddress.isPointToPoint = 0;
 
     /* Initialise Dummy STUN Request */
-    result = Ice_InitializeStunPacket( &pStunCxt, transactionId, stunMessageBuffer, &pStunHeader, 1, 1 );
-    result =  StunSerializer_AddAttributeXorMappedAddress( &pStunCxt , &stunAddress );
+    result = Ice_InitializeStunPacket( &pStunCxt, transactionId, stunMessageBuffer, sizeof( stunMessageBuffer ), &pStunHeader, 1, 1 );
+    result =  ( IceResult_t ) StunSerializer_AddAttributeXorMappedAddress( &pStunCxt , &stunAddress );
 
     if( result == ICE_RESULT_OK )
     {
-        result = Ice_PackageStunPacket( &pStunCxt, NULL, 0 );
+        result = Ice_PackageStunPacket( &pStunCxt, NULL );
     }
     /* Call API for handling the STUN repsonse. */
     result = Ice_HandleStunResponse( iceAgent, stunMessageBuffer, 52, transactionId, iceAgent->iceCandidatePairs[0].local, iceIpAddress, &( iceAgent->iceCandidatePairs[0] ) );
@@ -384,12 +443,12 @@ void test_HandleStunResponseFromRemoteInResponseToLocalCandidateRequest( IceAgen
     iceIpAddress.isPointToPoint = 0;
 
     /* Initialise Dummy STUN Response */
-    result = Ice_InitializeStunPacket( &pStunCxt, transactionId, stunMessageBuffer, &pStunHeader, 1, 0 );
-    result =  StunSerializer_AddAttributeXorMappedAddress( &pStunCxt , &stunAddress );
+    result = Ice_InitializeStunPacket( &pStunCxt, transactionId, stunMessageBuffer, sizeof( stunMessageBuffer ), &pStunHeader, 1, 0 );
+    result =  ( IceResult_t ) StunSerializer_AddAttributeXorMappedAddress( &pStunCxt , &stunAddress );
 
     if( result == ICE_RESULT_OK )
     {
-        result = Ice_PackageStunPacket( &pStunCxt, NULL, 0 );
+        result = Ice_PackageStunPacket( &pStunCxt, NULL );
     }
     /* Call API for handling the STUN repsonse. */
     result = Ice_HandleStunResponse( iceAgent, stunMessageBuffer, 52, transactionId, iceAgent->iceCandidatePairs[0].local, iceIpAddress, &( iceAgent->iceCandidatePairs[0] ) );
@@ -430,12 +489,12 @@ void test_HandleStunResponseForNominatingCandidatePair( IceAgent_t * iceAgent )
     iceIpAddress.isPointToPoint = 0;
 
     /* Initialise Dummy STUN Response */
-    result = Ice_InitializeStunPacket( &pStunCxt, transactionId, stunMessageBuffer, &pStunHeader, 1, 1 );
-    result = StunSerializer_AddAttributeUseCandidate( &pStunCxt );
+    result = Ice_InitializeStunPacket( &pStunCxt, transactionId, stunMessageBuffer, sizeof( stunMessageBuffer ), &pStunHeader, 1, 1 );
+    result = ( IceResult_t ) StunSerializer_AddAttributeUseCandidate( &pStunCxt );
 
     if( result == ICE_RESULT_OK )
     {
-        result = Ice_PackageStunPacket( &pStunCxt, NULL, 0 );
+        result = Ice_PackageStunPacket( &pStunCxt, NULL );
     }
     /* Call API for handling the STUN repsonse. */
     result = Ice_HandleStunResponse( iceAgent, stunMessageBuffer, 32, transactionId, iceAgent->iceCandidatePairs[0].local, iceIpAddress, &( iceAgent->iceCandidatePairs[0] ) );
@@ -472,12 +531,12 @@ void test_HandleStunResponseInResponseToNominatingCandidatePairRequest( IceAgent
     iceIpAddress.isPointToPoint = 0;
 
     /* Initialise Dummy STUN Response */
-    result = Ice_InitializeStunPacket( &pStunCxt, transactionId, stunMessageBuffer, &pStunHeader, 1, 0 );
-    result =  StunSerializer_AddAttributeXorMappedAddress( &pStunCxt , &stunAddress );
-    result = StunSerializer_AddAttributeUseCandidate( &pStunCxt );
+    result = Ice_InitializeStunPacket( &pStunCxt, transactionId, stunMessageBuffer, sizeof( stunMessageBuffer ), &pStunHeader, 1, 0 );
+    result =  ( IceResult_t ) StunSerializer_AddAttributeXorMappedAddress( &pStunCxt , &stunAddress );
+    result = ( IceResult_t ) StunSerializer_AddAttributeUseCandidate( &pStunCxt );
     if( result == ICE_RESULT_OK )
     {
-        result = Ice_PackageStunPacket( &pStunCxt, NULL, 0 );
+        result = Ice_PackageStunPacket( &pStunCxt, NULL );
     }
     /* Call API for handling the STUN repsonse. */
     result = Ice_HandleStunResponse( iceAgent, stunMessageBuffer, 56, transactionId, iceAgent->iceCandidatePairs[0].local, iceIpAddress, &( iceAgent->iceCandidatePairs[0] ) );
@@ -493,39 +552,2060 @@ void test_HandleStunResponseInResponseToNominatingCandidatePairRequest( IceAgent
 
 /*--------------------------------------------------------------------------------------------------------------------------------------------------------------------*/
 
-int main( void )
+void test_HandleReceivedStunPacketFromUnknownSource( IceAgent_t * iceAgent )
 {
-    IceAgent_t * iceAgent = malloc(sizeof(struct IceAgent));
+    printf("\nHandling Stun Request received from an unknown source address. \n");
+    IceResult_t result;
+    StunContext_t pStunCxt;
+    StunHeader_t pStunHeader;
+    IceCandidatePair_t * pIceCandidatePair = NULL;
+    IceOutboundBuffer_t * pOutboundBuffer;
+    uint8_t stunMessageBuffer[ 1024 ] = { 0 };
+    uint8_t transactionId[ STUN_HEADER_TRANSACTION_ID_LENGTH ] = { 0 };
+    IceIPAddress_t srcAddress;
+    int remoteCandidateCount = Ice_GetValidRemoteCandidateCount( iceAgent );
+    uint32_t peerReflexivePriority = 0x6E7F1EFF;
+    uint32_t echoedCount = 0, mismatchCount = 0;
 
-    test_IceAgentInit( iceAgent );
+    uint8_t ipAddress[] = { 0xC0, 0xA8, 0x01, 0x63 };
 
-    test_GenerateHostCandidate( iceAgent );
+    /* Initialise source IP address, not known to the agent yet. */
+    srcAddress.ipAddress.family = STUN_ADDRESS_IPv4;
+    srcAddress.ipAddress.port = 40000;
+    memcpy( srcAddress.ipAddress.address, ipAddress, STUN_IPV4_ADDRESS_SIZE );
+    srcAddress.isPointToPoint = 0;
 
-    test_GenerateSrflxCandidate( iceAgent );
+    /* Send, then release, whatever earlier tests left queued. */
+    while( ( pOutboundBuffer = Ice_GetOutboundBuffer( iceAgent ) ) != NULL )
+    {
+        Ice_ReleaseOutboundBuffer( iceAgent, pOutboundBuffer );
+    }
 
-    test_GenerateRemoteCandidate( iceAgent );
+    /* Initialise Dummy STUN Request */
+    memset( transactionId, 0xA5, sizeof( transactionId ) );
+    result = Ice_InitializeStunPacket( &pStunCxt, transactionId, stunMessageBuffer, sizeof( stunMessageBuffer ), &pStunHeader, 1, 1 );
 
-    test_DisplayCandidatePairs( iceAgent );
+    if( result == ICE_RESULT_OK )
+    {
+        result = ( IceResult_t ) StunSerializer_AddAttributePriority( &pStunCxt, peerReflexivePriority );
+    }
 
-    /* Test Stun Request creation for Nominating Candidate Pair. */
-    test_GenerateStunRequests( iceAgent, 0 );
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_PackageStunPacket( &pStunCxt, &( iceAgent->localPasswordKey ) );
+    }
 
-    /* Test Stun Request creation for Connectivity Check. */
-    test_GenerateStunRequests( iceAgent, 1 );
+    /* The library has to find the pair on its own, creating a peer reflexive candidate for the new source. */
+    result = Ice_HandleReceivedStunPacket( iceAgent, stunMessageBuffer, Ice_GetStunMessageLength( stunMessageBuffer ), &( iceAgent->localCandidates[ 0 ].ipAddress ), &srcAddress, &pIceCandidatePair );
 
-    /* Test Stun Request creation for Response for Remote candidate requests. */
-    test_GenerateStunRequests( iceAgent, 2 );
+    /* The response has to echo the transaction ID of the request it answers. */
+    while( ( pOutboundBuffer = Ice_GetOutboundBuffer( iceAgent ) ) != NULL )
+    {
+        if( ( pOutboundBuffer->pBuffer[ 0 ] == 0x01 ) && ( pOutboundBuffer->pBuffer[ 1 ] == 0x01 ) )
+        {
+            if( memcmp( pOutboundBuffer->pBuffer + STUN_HEADER_TRANSACTION_ID_OFFSET, transactionId, STUN_HEADER_TRANSACTION_ID_LENGTH ) == 0 )
+            {
+                echoedCount++;
+            }
+            else
+            {
+                mismatchCount++;
+            }
+        }
+        Ice_ReleaseOutboundBuffer( iceAgent, pOutboundBuffer );
+    }
 
-    /* Test Parsing Stun responses. */
-    test_HandleStunResponseFromIceServerForSrflxCandidate( iceAgent );
+    if( ( pIceCandidatePair != NULL ) &&
+        ( echoedCount == 1 ) &&
+        ( mismatchCount == 0 ) &&
+        ( pIceCandidatePair->local == &( iceAgent->localCandidates[ 0 ] ) ) &&
+        ( pIceCandidatePair->remote->iceCandidateType == ICE_CANDIDATE_TYPE_PEER_REFLEXIVE ) &&
+        ( pIceCandidatePair->remote->priority == peerReflexivePriority ) &&
+        ( Ice_GetValidRemoteCandidateCount( iceAgent ) == remoteCandidateCount + 1 ) )
+    {
+        printf("Success, peer reflexive candidate pair Local Candidate Port %d --> Remote Candidate Port %d created.\n",pIceCandidatePair->local->ipAddress.ipAddress.port,pIceCandidatePair->remote->ipAddress.ipAddress.port);
+    }
+    else
+    {
+        printf("Failure in routing the received STUN request : Result - %d, echoed responses %u, mismatched %u\n",result,echoedCount,mismatchCount);
+    }
+}
 
-    test_HandleStunRequestFromRemoteCandidate( iceAgent );
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------------------*/
 
-    test_HandleStunResponseFromRemoteInResponseToLocalCandidateRequest( iceAgent );
+void test_HandleStunPacketsBatch( IceAgent_t * iceAgent )
+{
+    printf("\nHandling a batch of Stun Requests. \n");
+    StunContext_t pStunCxt;
+    StunHeader_t pStunHeader;
+    IceReceivedPacket_t packets[ 2 ];
+    IcePacketResult_t results[ 2 ];
+    IceOutboundBuffer_t * pOutboundBuffer;
+    uint8_t stunMessageBuffers[ 2 ][ 128 ] = { 0 };
+    uint8_t transactionId[ STUN_HEADER_TRANSACTION_ID_LENGTH ] = { 0 };
+    uint8_t ipAddress[] = { 0xC0, 0xA8, 0x01, 0x64 };
+    uint32_t i, handledCount, failedCount = 0, responseCount = 0;
 
-    test_HandleStunResponseForNominatingCandidatePair( iceAgent );
+    /* Send, then release, whatever earlier tests left queued. */
+    while( ( pOutboundBuffer = Ice_GetOutboundBuffer( iceAgent ) ) != NULL )
+    {
+        Ice_ReleaseOutboundBuffer( iceAgent, pOutboundBuffer );
+    }
 
-    test_HandleStunResponseInResponseToNominatingCandidatePairRequest( iceAgent );
+    for( i = 0; i < 2; i++ )
+    {
+        /* Initialise Dummy STUN Request from a distinct source port, with its own transaction ID. */
+        transactionId[ 0 ] = ( uint8_t ) ( 0xB0 + i );
+        Ice_InitializeStunPacket( &pStunCxt, transactionId, stunMessageBuffers[ i ], sizeof( stunMessageBuffers[ i ] ), &pStunHeader, 1, 1 );
+        Ice_PackageStunPacket( &pStunCxt, &( iceAgent->localPasswordKey ) );
+
+        packets[ i ].pBuffer = stunMessageBuffers[ i ];
+        packets[ i ].bufferLength = Ice_GetStunMessageLength( stunMessageBuffers[ i ] );
+        packets[ i ].localAddress = iceAgent->localCandidates[ 0 ].ipAddress;
+        packets[ i ].srcAddress.ipAddress.family = STUN_ADDRESS_IPv4;
+        packets[ i ].srcAddress.ipAddress.port = ( uint16_t ) ( 41000 + i );
+        memcpy( packets[ i ].srcAddress.ipAddress.address, ipAddress, STUN_IPV4_ADDRESS_SIZE );
+        packets[ i ].srcAddress.isPointToPoint = 0;
+    }
+
+    handledCount = Ice_HandleStunPackets( iceAgent, packets, results, 2 );
+
+    for( i = 0; i < handledCount; i++ )
+    {
+        if( ( results[ i ].pIceCandidatePair != NULL ) &&
+            ( ( results[ i ].result == ICE_RESULT_SEND_STUN_LOCAL_REMOTE ) || ( results[ i ].result == ICE_RESULT_SEND_STUN_REQUEST_RESPONSE ) ) &&
+            ( memcmp( results[ i ].transactionId, stunMessageBuffers[ i ] + STUN_HEADER_TRANSACTION_ID_OFFSET, STUN_HEADER_TRANSACTION_ID_LENGTH ) == 0 ) )
+        {
+            printf("Packet %u : Result - %d, Remote Candidate Port %d, %u outbound message(s).\n", i, results[ i ].result, results[ i ].pIceCandidatePair->remote->ipAddress.ipAddress.port, results[ i ].outboundBufferCount );
+        }
+        else
+        {
+            printf("Packet %u : Failure in routing the received STUN request : Result - %d\n", i, results[ i ].result );
+            failedCount++;
+        }
+    }
+
+    /* Each request is answered by a binding success response echoing its transaction ID. */
+    while( ( pOutboundBuffer = Ice_GetOutboundBuffer( iceAgent ) ) != NULL )
+    {
+        i = ( uint32_t ) ( pOutboundBuffer->destination.ipAddress.port - 41000 );
+
+        if( ( pOutboundBuffer->pBuffer[ 0 ] == 0x01 ) && ( pOutboundBuffer->pBuffer[ 1 ] == 0x01 ) && ( i < 2 ) )
+        {
+            if( memcmp( pOutboundBuffer->pBuffer + STUN_HEADER_TRANSACTION_ID_OFFSET,
+                        stunMessageBuffers[ i ] + STUN_HEADER_TRANSACTION_ID_OFFSET,
+                        STUN_HEADER_TRANSACTION_ID_LENGTH ) == 0 )
+            {
+                responseCount++;
+            }
+            else
+            {
+                failedCount++;
+            }
+        }
+        Ice_ReleaseOutboundBuffer( iceAgent, pOutboundBuffer );
+    }
+
+    if( ( handledCount != 2 ) || ( failedCount != 0 ) || ( responseCount != 2 ) )
+    {
+        printf("Failure, %u packets of the batch handled, %u failed, %u matching responses.\n", handledCount, failedCount, responseCount );
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void test_OutboundBufferPool( IceAgent_t * iceAgent )
+{
+    printf("\nCollecting outbound messages from the buffer pool. \n");
+    StunContext_t pStunCxt;
+    StunHeader_t pStunHeader;
+    IceReceivedPacket_t packet;
+    IcePacketResult_t result;
+    IceOutboundBuffer_t * pOutboundBuffer;
+    IceResult_t doubleReleaseResult = ICE_RESULT_OK;
+    uint8_t stunMessageBuffer[ 128 ] = { 0 };
+    uint8_t transactionId[ STUN_HEADER_TRANSACTION_ID_LENGTH ] = { 0 };
+    uint8_t ipAddress[] = { 0xC0, 0xA8, 0x01, 0x64 };
+    uint32_t handledCount, queuedCount = 0, lengthErrors = 0, releasedCount = 0;
+
+    /* Send, then release, whatever earlier tests left queued. */
+    while( ( pOutboundBuffer = Ice_GetOutboundBuffer( iceAgent ) ) != NULL )
+    {
+        Ice_ReleaseOutboundBuffer( iceAgent, pOutboundBuffer );
+    }
+
+    if( iceAgent->outboundFreeCount != iceAgent->stunMessageBufferCount )
+    {
+        printf("Failure, %u of %u outbound buffers free after draining.\n", iceAgent->outboundFreeCount, iceAgent->stunMessageBufferCount );
+    }
+
+    Ice_InitializeStunPacket( &pStunCxt, transactionId, stunMessageBuffer, sizeof( stunMessageBuffer ), &pStunHeader, 1, 1 );
+    Ice_PackageStunPacket( &pStunCxt, &( iceAgent->localPasswordKey ) );
+
+    packet.pBuffer = stunMessageBuffer;
+    packet.bufferLength = Ice_GetStunMessageLength( stunMessageBuffer );
+    packet.localAddress = iceAgent->localCandidates[ 0 ].ipAddress;
+    packet.srcAddress.ipAddress.family = STUN_ADDRESS_IPv4;
+    packet.srcAddress.ipAddress.port = 41000;
+    memcpy( packet.srcAddress.ipAddress.address, ipAddress, STUN_IPV4_ADDRESS_SIZE );
+    packet.srcAddress.isPointToPoint = 0;
+
+    /* Keep answering without sending until the pool cannot take another packet's messages. */
+    do
+    {
+        handledCount = Ice_HandleStunPackets( iceAgent, &packet, &result, 1 );
+        queuedCount += ( handledCount == 1 ) ? result.outboundBufferCount : 0;
+    } while( ( handledCount == 1 ) && ( result.outboundBufferCount > 0 ) );
+
+    while( ( pOutboundBuffer = Ice_GetOutboundBuffer( iceAgent ) ) != NULL )
+    {
+        if( ( pOutboundBuffer->length != Ice_GetStunMessageLength( pOutboundBuffer->pBuffer ) ) ||
+            ( pOutboundBuffer->length > iceAgent->stunMessageBufferSize ) ||
+            ( pOutboundBuffer->destination.ipAddress.port != 41000 ) )
+        {
+            lengthErrors++;
+        }
+        Ice_ReleaseOutboundBuffer( iceAgent, pOutboundBuffer );
+        queuedCount--;
+
+        /* Releasing the first buffer again must not put it on the free stack twice. */
+        if( releasedCount++ == 0 )
+        {
+            doubleReleaseResult = Ice_ReleaseOutboundBuffer( iceAgent, pOutboundBuffer );
+        }
+    }
+
+    if( ( handledCount == 0 ) && ( queuedCount == 0 ) && ( lengthErrors == 0 ) &&
+        ( doubleReleaseResult == ICE_RESULT_BAD_PARAM ) &&
+        ( iceAgent->outboundFreeCount == iceAgent->stunMessageBufferCount ) &&
+        ( Ice_ReleaseOutboundBuffer( iceAgent, &( iceAgent->pOutboundBuffers[ 0 ] ) ) == ICE_RESULT_BAD_PARAM ) )
+    {
+        printf("Success, a full pool holds packets back and every collected buffer returns to it.\n");
+    }
+    else
+    {
+        printf("Failure with the outbound buffer pool : handled %u, unaccounted %u, bad buffers %u, free %u, double release %d.\n", handledCount, queuedCount, lengthErrors, iceAgent->outboundFreeCount, doubleReleaseResult );
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void test_ClassifyStunPacket( IceAgent_t * iceAgent )
+{
+    printf("\nClassifying received packets. \n");
+    StunContext_t pStunCxt;
+    StunHeader_t pStunHeader;
+    uint8_t stunMessageBuffer[ 128 ] = { 0 };
+    uint8_t transactionId[ STUN_HEADER_TRANSACTION_ID_LENGTH ] = { 0 };
+    uint8_t dtlsRecord[ 24 ] = { 0x16, 0xFE, 0xFD };
+    size_t stunMessageLength;
+    IceResult_t validResult, dtlsResult, unsignedResult, fingerprintResult, integrityResult, unfingerprintedResult, appendedResult;
+
+    /* A correctly signed binding request. */
+    Ice_InitializeStunPacket( &pStunCxt, transactionId, stunMessageBuffer, sizeof( stunMessageBuffer ), &pStunHeader, 1, 1 );
+    Ice_PackageStunPacket( &pStunCxt, &( iceAgent->localPasswordKey ) );
+    stunMessageLength = Ice_GetStunMessageLength( stunMessageBuffer );
+    validResult = Ice_ClassifyStunPacket( iceAgent, stunMessageBuffer, stunMessageLength );
+
+    /* A DTLS record sharing the port. */
+    dtlsResult = Ice_ClassifyStunPacket( iceAgent, dtlsRecord, sizeof( dtlsRecord ) );
+
+    /* A corrupted FINGERPRINT. */
+    stunMessageBuffer[ stunMessageLength - 1 ] ^= 0x01;
+    fingerprintResult = Ice_ClassifyStunPacket( iceAgent, stunMessageBuffer, stunMessageLength );
+
+    /* Signed with the wrong password. */
+    Ice_InitializeStunPacket( &pStunCxt, transactionId, stunMessageBuffer, sizeof( stunMessageBuffer ), &pStunHeader, 1, 1 );
+    Ice_PackageStunPacket( &pStunCxt, &( iceAgent->remotePasswordKey ) );
+    integrityResult = Ice_ClassifyStunPacket( iceAgent, stunMessageBuffer, Ice_GetStunMessageLength( stunMessageBuffer ) );
+
+    /* Not signed at all. */
+    Ice_InitializeStunPacket( &pStunCxt, transactionId, stunMessageBuffer, sizeof( stunMessageBuffer ), &pStunHeader, 1, 1 );
+    Ice_PackageStunPacket( &pStunCxt, NULL );
+    unsignedResult = Ice_ClassifyStunPacket( iceAgent, stunMessageBuffer, Ice_GetStunMessageLength( stunMessageBuffer ) );
+
+    /* Signed, with the FINGERPRINT cut off. */
+    Ice_InitializeStunPacket( &pStunCxt, transactionId, stunMessageBuffer, sizeof( stunMessageBuffer ), &pStunHeader, 1, 1 );
+    Ice_PackageStunPacket( &pStunCxt, &( iceAgent->localPasswordKey ) );
+    stunMessageLength = Ice_GetStunMessageLength( stunMessageBuffer ) - ( STUN_ATTRIBUTE_HEADER_LENGTH + sizeof( uint32_t ) );
+    stunMessageBuffer[ 2 ] = ( uint8_t ) ( ( stunMessageLength - STUN_HEADER_LENGTH ) >> 8 );
+    stunMessageBuffer[ 3 ] = ( uint8_t ) ( stunMessageLength - STUN_HEADER_LENGTH );
+    unfingerprintedResult = Ice_ClassifyStunPacket( iceAgent, stunMessageBuffer, stunMessageLength );
+
+    /* An attribute appended after MESSAGE-INTEGRITY, which does not cover it. */
+    stunMessageBuffer[ stunMessageLength ] = ( uint8_t ) ( STUN_ATTRIBUTE_TYPE_USE_CANDIDATE >> 8 );
+    stunMessageBuffer[ stunMessageLength + 1 ] = ( uint8_t ) STUN_ATTRIBUTE_TYPE_USE_CANDIDATE;
+    stunMessageBuffer[ stunMessageLength + 2 ] = 0;
+    stunMessageBuffer[ stunMessageLength + 3 ] = 0;
+    stunMessageLength += STUN_ATTRIBUTE_HEADER_LENGTH;
+    stunMessageBuffer[ 2 ] = ( uint8_t ) ( ( stunMessageLength - STUN_HEADER_LENGTH ) >> 8 );
+    stunMessageBuffer[ 3 ] = ( uint8_t ) ( stunMessageLength - STUN_HEADER_LENGTH );
+    appendedResult = Ice_ClassifyStunPacket( iceAgent, stunMessageBuffer, stunMessageLength );
+
+    if( ( validResult == ICE_RESULT_OK ) &&
+        ( dtlsResult == ICE_RESULT_NOT_STUN_PACKET ) &&
+        ( fingerprintResult == ICE_RESULT_FINGERPRINT_MISMATCH ) &&
+        ( integrityResult == ICE_RESULT_INTEGRITY_MISMATCH ) &&
+        ( unsignedResult == ICE_RESULT_INTEGRITY_MISSING ) &&
+        ( unfingerprintedResult == ICE_RESULT_FINGERPRINT_MISSING ) &&
+        ( appendedResult == ICE_RESULT_MALFORMED_STUN_PACKET ) )
+    {
+        printf("Success, rejected : not STUN %llu, bad fingerprint %llu, bad integrity %llu, missing integrity %llu.\n",
+               ( unsigned long long ) iceAgent->stats.rejectCounters.notStun,
+               ( unsigned long long ) iceAgent->stats.rejectCounters.badFingerprint,
+               ( unsigned long long ) iceAgent->stats.rejectCounters.badIntegrity,
+               ( unsigned long long ) iceAgent->stats.rejectCounters.missingIntegrity );
+    }
+    else
+    {
+        printf("Failure in classifying packets : Results - %d %d %d %d %d %d %d\n", validResult, dtlsResult, fingerprintResult, integrityResult, unsignedResult, unfingerprintedResult, appendedResult );
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void test_RequestTemplateRoleChange( IceAgent_t * iceAgent )
+{
+    printf("\nSwitching role between two connectivity checks. \n");
+    StunContext_t pStunCxt;
+    StunHeader_t pStunHeader;
+    IceStunAttributeTable_t attributeTable;
+    uint8_t stunMessageBuffer[ 1024 ] = { 0 };
+    uint8_t transactionId[ STUN_HEADER_TRANSACTION_ID_LENGTH ] = { 0 };
+    uint32_t isControlling = iceAgent->isControlling;
+    uint32_t controlledFlags = 0, controllingFlags = 0;
+    uint32_t role;
+
+    for( role = 0; role < 2; role++ )
+    {
+        iceAgent->isControlling = role;
+
+        if( ( Ice_CreateRequestForConnectivityCheck( iceAgent, stunMessageBuffer, transactionId ) == ICE_RESULT_OK ) &&
+            ( StunDeserializer_Init( &pStunCxt, stunMessageBuffer, Ice_GetStunMessageLength( stunMessageBuffer ), &pStunHeader ) == STUN_RESULT_OK ) &&
+            ( Ice_DeserializeStunPacket( &pStunCxt, &pStunHeader, &attributeTable ) == ICE_RESULT_OK ) )
+        {
+            if( role == 0 )
+            {
+                controlledFlags = attributeTable.flags;
+            }
+            else
+            {
+                controllingFlags = attributeTable.flags;
+            }
+        }
+    }
+
+    iceAgent->isControlling = isControlling;
+
+    if( ( controlledFlags & ICE_STUN_ATTRIBUTE_FLAG( ICE_STUN_ATTRIBUTE_INDEX_ICE_CONTROLLED ) ) &&
+        ( controllingFlags & ICE_STUN_ATTRIBUTE_FLAG( ICE_STUN_ATTRIBUTE_INDEX_ICE_CONTROLLING ) ) &&
+        ( Ice_GetStunAttributeUint64( &attributeTable, ICE_STUN_ATTRIBUTE_INDEX_ICE_CONTROLLING ) == iceAgent->tieBreaker ) &&
+        ( controlledFlags & ICE_STUN_ATTRIBUTE_FLAG( ICE_STUN_ATTRIBUTE_INDEX_FINGERPRINT ) ) )
+    {
+        printf("Success, each role's request carries its own role attribute.\n");
+    }
+    else
+    {
+        printf("Failure in switching the request template role : Flags - %x %x\n", controlledFlags, controllingFlags );
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void test_TickPacing( IceAgent_t * iceAgent )
+{
+    printf("\nPacing connectivity checks with Ice_Tick. \n");
+    IceResult_t result;
+    IceCandidate_t * remoteCandidate = NULL;
+    IceIPAddress_t iceIpAddress;
+    IceOutboundPacket_t packets[ 2 ];
+    uint8_t packetArena[ 2 * ICE_STUN_MESSAGE_BUFFER_SIZE ];
+    uint8_t ipAddress[] = { 0xC0, 0xA8, 0x01, 0x65 };
+    uint32_t firstCount = 0, earlyCount = 0, pacedCount = 0;
+    uint64_t startTime = iceAgent->currentTime + 1000;
+    uint64_t firstDeadline = 0, earlyDeadline = 0, pacedDeadline = 0;
+
+    /* A new remote candidate queues one waiting pair per local candidate. */
+    iceIpAddress.ipAddress.family = STUN_ADDRESS_IPv4;
+    iceIpAddress.ipAddress.port = 42000;
+    memcpy( iceIpAddress.ipAddress.address, ipAddress, STUN_IPV4_ADDRESS_SIZE );
+    iceIpAddress.isPointToPoint = 0;
+
+    result = Ice_AddRemoteCandidate( iceAgent, ICE_CANDIDATE_TYPE_HOST, &remoteCandidate, iceIpAddress, ICE_SOCKET_PROTOCOL_UDP, 100 );
+
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_Tick( iceAgent, startTime, packetArena, sizeof( packetArena ), packets, 2, &firstCount, &firstDeadline );
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_Tick( iceAgent, startTime + 1, packetArena, sizeof( packetArena ), packets, 2, &earlyCount, &earlyDeadline );
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_Tick( iceAgent, earlyDeadline, packetArena, sizeof( packetArena ), packets, 2, &pacedCount, &pacedDeadline );
+    }
+
+    if( ( result == ICE_RESULT_OK ) &&
+        ( firstCount == 1 ) &&
+        ( earlyCount == 0 ) &&
+        ( earlyDeadline == startTime + ICE_DEFAULT_CHECK_PACING_INTERVAL_MS ) &&
+        ( pacedCount == 1 ) )
+    {
+        printf("Success, checks sent at %llu and %llu ms, next deadline %llu ms.\n",
+               ( unsigned long long ) startTime, ( unsigned long long ) earlyDeadline, ( unsigned long long ) pacedDeadline );
+    }
+    else
+    {
+        printf("Failure in pacing the connectivity checks : Result - %d, Checks - %u %u %u\n", result, firstCount, earlyCount, pacedCount );
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void test_RetransmitUnansweredCheck( IceAgent_t * iceAgent )
+{
+    printf("\nRetransmitting an unanswered connectivity check from the timer wheel. \n");
+    IceResult_t result;
+    IceTimerWheel_t timerWheel;
+    IceOutboundPacket_t packets[ 8 ];
+    IceCandidatePair_t * pIceCandidatePair = NULL;
+    uint8_t packetArena[ 8 * ICE_STUN_MESSAGE_BUFFER_SIZE ];
+    uint8_t transactionId[ STUN_HEADER_TRANSACTION_ID_LENGTH ];
+    uint32_t packetCount = 0, sendCount = 0, i;
+    uint64_t startTime = iceAgent->currentTime + 1000;
+    uint64_t lastSendTime = 0, nextDeadline = 0, now;
+    IceCandidatePairState_t stateBeforeTimeout = ICE_CANDIDATE_PAIR_STATE_FAILED;
+
+    Ice_TimerWheelInit( &timerWheel, iceAgent->currentTime );
+    result = Ice_SetTimerWheel( iceAgent, &timerWheel );
+
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_Tick( iceAgent, startTime, packetArena, sizeof( packetArena ), packets, 1, &packetCount, &nextDeadline );
+    }
+
+    if( ( result == ICE_RESULT_OK ) && ( packetCount == 1 ) )
+    {
+        memcpy( transactionId, packetArena + packets[ 0 ].offset + STUN_HEADER_TRANSACTION_ID_OFFSET, STUN_HEADER_TRANSACTION_ID_LENGTH );
+        pIceCandidatePair = packets[ 0 ].pIceCandidatePair;
+        sendCount = 1;
+    }
+
+    /* Serve the wheel at each expiry until the final timeout, counting the sends of this check. */
+    now = startTime;
+
+    while( ( result == ICE_RESULT_OK ) &&
+           ( pIceCandidatePair != NULL ) &&
+           ( now < startTime + 39500 ) )
+    {
+        now = Ice_TimerWheelGetNextExpiry( &timerWheel );
+
+        if( now > startTime + 39500 )
+        {
+            now = startTime + 39500;
+        }
+
+        if( now == startTime + 39500 )
+        {
+            stateBeforeTimeout = pIceCandidatePair->state;
+        }
+
+        result = Ice_HandleExpiredTimers( &timerWheel, now, packetArena, sizeof( packetArena ), packets, 8, &packetCount );
+
+        for( i = 0; ( result == ICE_RESULT_OK ) && ( i < packetCount ); i++ )
+        {
+            if( memcmp( packetArena + packets[ i ].offset + STUN_HEADER_TRANSACTION_ID_OFFSET, transactionId, STUN_HEADER_TRANSACTION_ID_LENGTH ) == 0 )
+            {
+                sendCount++;
+                lastSendTime = now;
+            }
+        }
+    }
+
+    if( ( result == ICE_RESULT_OK ) &&
+        ( pIceCandidatePair != NULL ) &&
+        ( sendCount == ICE_DEFAULT_MAX_REQUEST_COUNT ) &&
+        ( lastSendTime == startTime + 31500 ) &&
+        ( stateBeforeTimeout != ICE_CANDIDATE_PAIR_STATE_FAILED ) &&
+        ( pIceCandidatePair->state == ICE_CANDIDATE_PAIR_STATE_FAILED ) &&
+        ( Ice_TransactionIdStoreHasId( &( iceAgent->stunBindingRequestTransactionIdStore ), transactionId ) == false ) )
+    {
+        printf("Success, check sent %u times, last at %llu ms, pair failed at %llu ms.\n",
+               sendCount, ( unsigned long long ) ( lastSendTime - startTime ), ( unsigned long long ) ( now - startTime ) );
+    }
+    else
+    {
+        printf("Failure in retransmitting the connectivity check : Result - %d, Sends - %u\n", result, sendCount );
+    }
+
+    Ice_SetTimerWheel( iceAgent, NULL );
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void test_AgentManagerDemux( IceAgent_t * iceAgent )
+{
+    printf("\nRouting packets of a shared socket through the agent manager. \n");
+    IceResult_t result, duplicateResult = ICE_RESULT_OK, unknownResult = ICE_RESULT_OK;
+    IceAgentManager_t agentManager;
+    IceAgentManagerConfig_t managerConfig = { .maxAgentCount = 4, .maxTransactionIdCount = DEFAULT_MAX_STORED_TRANSACTION_ID_COUNT };
+    IceAgent_t * secondAgent = malloc( sizeof( struct IceAgent ) );
+    IceAgent_t * duplicateAgent = malloc( sizeof( struct IceAgent ) );
+    IceAgent_t * requestAgent = NULL, * responseAgent = NULL, * unknownAgent = NULL;
+    char str1[] = "second", str2[] = "def456", str3[] = "peer", str4[] = "uvw321";
+    char str6[] = "local";
+    size_t agentMemorySize = 0, managerMemorySize = 0;
+    uint8_t * pManagerMemory = NULL;
+    uint8_t transactionId[ STUN_HEADER_TRANSACTION_ID_LENGTH ] = { 0x51, 0x52, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x5B, 0x5C };
+
+    /* Binding request to "second" from "peer", and a success response to a request "second" sent. */
+    uint8_t request[] = { 0x00, 0x01, 0x00, 0x10, 0x21, 0x12, 0xA4, 0x42,
+                          0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C,
+                          0x00, 0x06, 0x00, 0x0B, 's', 'e', 'c', 'o', 'n', 'd', ':', 'p', 'e', 'e', 'r', 0x00 };
+    uint8_t response[ STUN_HEADER_LENGTH ] = { 0x01, 0x01, 0x00, 0x00, 0x21, 0x12, 0xA4, 0x42 };
+
+    memcpy( response + STUN_HEADER_TRANSACTION_ID_OFFSET, transactionId, STUN_HEADER_TRANSACTION_ID_LENGTH );
+
+    result = Ice_GetIceAgentMemorySize( &agentConfig, &agentMemorySize );
+
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_CreateIceAgent( secondAgent, &agentConfig, malloc( agentMemorySize ), agentMemorySize, str1, str2, str3, str4 );
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_CreateIceAgent( duplicateAgent, &agentConfig, malloc( agentMemorySize ), agentMemorySize, str6, str2, str3, str4 );
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_GetAgentManagerMemorySize( &managerConfig, &managerMemorySize );
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        pManagerMemory = malloc( managerMemorySize );
+        result = Ice_CreateAgentManager( &agentManager, &managerConfig, pManagerMemory, managerMemorySize );
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_AgentManagerAddAgent( &agentManager, iceAgent );
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_AgentManagerAddAgent( &agentManager, secondAgent );
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        duplicateResult = Ice_AgentManagerAddAgent( &agentManager, duplicateAgent );
+        result = Ice_TransactionIdStoreInsert( &( secondAgent->stunBindingRequestTransactionIdStore ), transactionId,
+                                               ICE_TRANSACTION_PURPOSE_CONNECTIVITY_CHECK, NULL, NULL, 0 );
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_AgentManagerFindAgent( &agentManager, request, sizeof( request ), &requestAgent );
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_AgentManagerFindAgent( &agentManager, response, sizeof( response ), &responseAgent );
+    }
+
+    /* Once answered, the transaction no longer routes. */
+    if( result == ICE_RESULT_OK )
+    {
+        Ice_TransactionIdStoreRemove( &( secondAgent->stunBindingRequestTransactionIdStore ), transactionId );
+        unknownResult = Ice_AgentManagerFindAgent( &agentManager, response, sizeof( response ), &unknownAgent );
+        result = Ice_AgentManagerRemoveAgent( &agentManager, secondAgent );
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_AgentManagerRemoveAgent( &agentManager, iceAgent );
+    }
+
+    if( ( result == ICE_RESULT_OK ) &&
+        ( duplicateResult == ICE_RESULT_DUPLICATE_USERNAME ) &&
+        ( requestAgent == secondAgent ) &&
+        ( responseAgent == secondAgent ) &&
+        ( unknownResult == ICE_RESULT_AGENT_NOT_FOUND ) &&
+        ( agentManager.agentCount == 0 ) &&
+        ( agentManager.transactionIndex.entryCount == 0 ) )
+    {
+        printf("Success, request and response routed to agent %s.\n", requestAgent->localUsername );
+    }
+    else
+    {
+        printf("Failure in routing through the agent manager : Result - %d\n", result );
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void test_ConnectionTableLookup( IceAgent_t * iceAgent )
+{
+    printf("\nLooking up connections of nominated pairs. \n");
+    IceResult_t result;
+    IceConnectionTable_t connectionTable;
+    IceCandidatePair_t * pIceCandidatePair = &( iceAgent->iceCandidatePairs[ 0 ] );
+    IceCandidatePair_t * pFoundPair = NULL, * pReversedPair = NULL, * pDetachedPair = NULL;
+    IceCandidatePairState_t savedState = pIceCandidatePair->state;
+    IceAgent_t * pFoundAgent = NULL;
+    size_t tableMemorySize = 0;
+    uint8_t * pTableMemory = NULL;
+
+    result = Ice_GetConnectionTableMemorySize( 16, &tableMemorySize );
+
+    if( result == ICE_RESULT_OK )
+    {
+        pTableMemory = malloc( tableMemorySize );
+        result = Ice_CreateConnectionTable( &connectionTable, 16, pTableMemory, tableMemorySize );
+    }
+
+    /* A pair nominated before the table is attached is published on attach. */
+    if( result == ICE_RESULT_OK )
+    {
+        pIceCandidatePair->state = ICE_CANDIDATE_PAIR_STATE_SUCCEEDED;
+        result = Ice_SetConnectionTable( iceAgent, &connectionTable );
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        pFoundPair = Ice_ConnectionTableLookup( &connectionTable, &( pIceCandidatePair->local->ipAddress.ipAddress ),
+                                                &( pIceCandidatePair->remote->ipAddress.ipAddress ), &pFoundAgent );
+        pReversedPair = Ice_ConnectionTableLookup( &connectionTable, &( pIceCandidatePair->remote->ipAddress.ipAddress ),
+                                                   &( pIceCandidatePair->local->ipAddress.ipAddress ), NULL );
+        result = Ice_SetConnectionTable( iceAgent, NULL );
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        pDetachedPair = Ice_ConnectionTableLookup( &connectionTable, &( pIceCandidatePair->local->ipAddress.ipAddress ),
+                                                   &( pIceCandidatePair->remote->ipAddress.ipAddress ), NULL );
+    }
+
+    pIceCandidatePair->state = savedState;
+
+    if( ( result == ICE_RESULT_OK ) &&
+        ( pFoundPair == pIceCandidatePair ) &&
+        ( pFoundAgent == iceAgent ) &&
+        ( pReversedPair == NULL ) &&
+        ( pDetachedPair == NULL ) &&
+        ( connectionTable.connectionCount == 0 ) )
+    {
+        printf("Success, connection resolved to its pair and withdrawn on detach.\n");
+    }
+    else
+    {
+        printf("Failure in looking up the connection : Result - %d\n", result );
+    }
+
+    free( pTableMemory );
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void test_LiteAgentAnswersChecks( IceAgent_t * iceAgent )
+{
+    printf("\nAnswering checks of the full agent with an ICE-lite agent. \n");
+    IceResult_t result, checkResult = ICE_RESULT_OK, nominationResult = ICE_RESULT_OK;
+    IceLiteAgent_t liteAgent;
+    IceCandidatePair_t * pIceCandidatePair = &( iceAgent->iceCandidatePairs[ 0 ] );
+    uint8_t stunMessageBuffer[ ICE_STUN_MESSAGE_BUFFER_SIZE ];
+    uint8_t responseBuffer[ ICE_LITE_MAX_RESPONSE_LENGTH ];
+    uint8_t transactionId[ STUN_HEADER_TRANSACTION_ID_LENGTH ];
+    size_t responseLength = 0;
+    StunContext_t pStunCxt;
+    StunHeader_t pStunHeader;
+    IceStunAttributeTable_t attributeTable;
+    StunAttributeAddress_t mappedAddress;
+
+    /* The lite agent plays the remote peer of the full agent, the full agent's local address is its source. */
+    result = Ice_CreateLiteAgent( &liteAgent, iceAgent->remoteUsername, iceAgent->remotePassword );
+
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_LiteAddHostCandidate( &liteAgent, &( pIceCandidatePair->remote->ipAddress ) );
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_CreateRequestForConnectivityCheck( iceAgent, stunMessageBuffer, transactionId );
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        checkResult = Ice_LiteHandleBindingRequest( &liteAgent, stunMessageBuffer, Ice_GetStunMessageLength( stunMessageBuffer ),
+                                                    &( pIceCandidatePair->remote->ipAddress ), &( pIceCandidatePair->local->ipAddress ),
+                                                    responseBuffer, sizeof( responseBuffer ), &responseLength );
+    }
+
+    /* The full agent must accept the response and find its own address mapped in it. */
+    if( ( result == ICE_RESULT_OK ) && ( checkResult == ICE_RESULT_OK ) )
+    {
+        result = Ice_ClassifyStunPacket( iceAgent, responseBuffer, responseLength );
+    }
+
+    if( ( result == ICE_RESULT_OK ) && ( checkResult == ICE_RESULT_OK ) )
+    {
+        if( ( StunDeserializer_Init( &pStunCxt, responseBuffer, responseLength, &pStunHeader ) != STUN_RESULT_OK ) ||
+            ( Ice_DeserializeStunPacket( &pStunCxt, &pStunHeader, &attributeTable ) != ICE_RESULT_OK ) )
+        {
+            result = ICE_RESULT_MALFORMED_STUN_PACKET;
+        }
+        else
+        {
+            result = Ice_GetStunAttributeAddress( &pStunCxt, &attributeTable, ICE_STUN_ATTRIBUTE_INDEX_XOR_MAPPED_ADDRESS, &mappedAddress );
+        }
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_CreateRequestForNominatingValidCandidatePair( iceAgent, stunMessageBuffer, pIceCandidatePair, transactionId );
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        nominationResult = Ice_LiteHandleBindingRequest( &liteAgent, stunMessageBuffer, Ice_GetStunMessageLength( stunMessageBuffer ),
+                                                         &( pIceCandidatePair->remote->ipAddress ), &( pIceCandidatePair->local->ipAddress ),
+                                                         responseBuffer, sizeof( responseBuffer ), &responseLength );
+    }
+
+    if( ( result == ICE_RESULT_OK ) &&
+        ( checkResult == ICE_RESULT_OK ) &&
+        ( Ice_IsSameIpAddress( &mappedAddress, &( pIceCandidatePair->local->ipAddress.ipAddress ), true ) ) &&
+        ( nominationResult == ICE_RESULT_USE_CANDIDATE_FLAG ) &&
+        ( liteAgent.isSelected == 1 ) &&
+        ( liteAgent.selectedRemoteAddress.ipAddress.port == pIceCandidatePair->local->ipAddress.ipAddress.port ) )
+    {
+        printf("Success, check answered in %zu bytes and nomination accepted.\n", responseLength );
+    }
+    else
+    {
+        printf("Failure in the ICE-lite agent : Result - %d, Check - %d, Nomination - %d\n", result, checkResult, nominationResult );
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void test_LiteIgnoresUnsignedNomination( IceAgent_t * iceAgent )
+{
+    printf("\nAppending USE-CANDIDATE after MESSAGE-INTEGRITY of a check to an ICE-lite agent. \n");
+    IceResult_t result, checkResult = ICE_RESULT_OK;
+    IceLiteAgent_t liteAgent;
+    IceCandidatePair_t * pIceCandidatePair = &( iceAgent->iceCandidatePairs[ 0 ] );
+    uint8_t stunMessageBuffer[ ICE_STUN_MESSAGE_BUFFER_SIZE ];
+    uint8_t responseBuffer[ ICE_LITE_MAX_RESPONSE_LENGTH ];
+    uint8_t transactionId[ STUN_HEADER_TRANSACTION_ID_LENGTH ];
+    size_t responseLength = 0, messageLength = 0;
+    uint32_t fingerprint;
+
+    result = Ice_CreateLiteAgent( &liteAgent, iceAgent->remoteUsername, iceAgent->remotePassword );
+
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_LiteAddHostCandidate( &liteAgent, &( pIceCandidatePair->remote->ipAddress ) );
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_CreateRequestForConnectivityCheck( iceAgent, stunMessageBuffer, transactionId );
+    }
+
+    /* Replace the FINGERPRINT by USE-CANDIDATE, then append a FINGERPRINT over the forged message again. */
+    if( result == ICE_RESULT_OK )
+    {
+        messageLength = Ice_GetStunMessageLength( stunMessageBuffer ) - ( STUN_ATTRIBUTE_HEADER_LENGTH + sizeof( uint32_t ) );
+        stunMessageBuffer[ messageLength ] = ( uint8_t ) ( STUN_ATTRIBUTE_TYPE_USE_CANDIDATE >> 8 );
+        stunMessageBuffer[ messageLength + 1 ] = ( uint8_t ) STUN_ATTRIBUTE_TYPE_USE_CANDIDATE;
+        stunMessageBuffer[ messageLength + 2 ] = 0;
+        stunMessageBuffer[ messageLength + 3 ] = 0;
+        messageLength += STUN_ATTRIBUTE_HEADER_LENGTH;
+
+        stunMessageBuffer[ 2 ] = ( uint8_t ) ( ( messageLength + STUN_ATTRIBUTE_HEADER_LENGTH + sizeof( uint32_t ) - STUN_HEADER_LENGTH ) >> 8 );
+        stunMessageBuffer[ 3 ] = ( uint8_t ) ( messageLength + STUN_ATTRIBUTE_HEADER_LENGTH + sizeof( uint32_t ) - STUN_HEADER_LENGTH );
+        fingerprint = Ice_Crc32( 0, stunMessageBuffer, messageLength ) ^ STUN_ATTRIBUTE_FINGERPRINT_XOR_VALUE;
+
+        stunMessageBuffer[ messageLength ] = ( uint8_t ) ( STUN_ATTRIBUTE_TYPE_FINGERPRINT >> 8 );
+        stunMessageBuffer[ messageLength + 1 ] = ( uint8_t ) STUN_ATTRIBUTE_TYPE_FINGERPRINT;
+        stunMessageBuffer[ messageLength + 2 ] = 0;
+        stunMessageBuffer[ messageLength + 3 ] = sizeof( uint32_t );
+        stunMessageBuffer[ messageLength + 4 ] = ( uint8_t ) ( fingerprint >> 24 );
+        stunMessageBuffer[ messageLength + 5 ] = ( uint8_t ) ( fingerprint >> 16 );
+        stunMessageBuffer[ messageLength + 6 ] = ( uint8_t ) ( fingerprint >> 8 );
+        stunMessageBuffer[ messageLength + 7 ] = ( uint8_t ) fingerprint;
+        messageLength += STUN_ATTRIBUTE_HEADER_LENGTH + sizeof( uint32_t );
+
+        checkResult = Ice_LiteHandleBindingRequest( &liteAgent, stunMessageBuffer, messageLength,
+                                                    &( pIceCandidatePair->remote->ipAddress ), &( pIceCandidatePair->local->ipAddress ),
+                                                    responseBuffer, sizeof( responseBuffer ), &responseLength );
+    }
+
+    if( ( result == ICE_RESULT_OK ) &&
+        ( checkResult != ICE_RESULT_USE_CANDIDATE_FLAG ) &&
+        ( liteAgent.isSelected == 0 ) )
+    {
+        printf("Success, the unauthenticated USE-CANDIDATE nominated nothing : Result - %d\n", checkResult );
+    }
+    else
+    {
+        printf("Failure in ignoring USE-CANDIDATE after MESSAGE-INTEGRITY : Results - %d %d, Selected - %u\n", result, checkResult, liteAgent.isSelected );
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static uint64_t testClockTime = 0;
+
+static uint64_t test_StatsClock( void )
+{
+    testClockTime += 250;
+    return testClockTime;
+}
+
+void test_AgentStats( void )
+{
+    printf("\nCounting an agent's traffic into its stats. \n");
+    IceResult_t result;
+    IceAgentConfig_t statsConfig = agentConfig;
+    IceAgent_t * statsAgent = malloc( sizeof( struct IceAgent ) );
+    IceAgentManager_t agentManager;
+    IceAgentManagerConfig_t managerConfig = { .maxAgentCount = 2, .maxTransactionIdCount = DEFAULT_MAX_STORED_TRANSACTION_ID_COUNT };
+    IceAgentStats_t snapshot, total, managerStats;
+    IceCandidate_t localCandidate, remoteCandidate;
+    IceCandidatePair_t candidatePair;
+    IceReceivedPacket_t packet;
+    IcePacketResult_t packetResult;
+    StunContext_t pStunCxt;
+    StunHeader_t pStunHeader;
+    StunAttributeAddress_t stunAddress = { .family = STUN_ADDRESS_IPv4, .port = 32853, .address = { 0xC0, 0xA8, 0x01, 0x64 } };
+    IceIPAddress_t iceIpAddress = { .ipAddress = stunAddress, .isPointToPoint = 0 };
+    uint8_t requestBuffer[ ICE_OUTBOUND_BUFFER_SIZE ], responseBuffer[ 128 ];
+    uint8_t transactionId[ STUN_HEADER_TRANSACTION_ID_LENGTH ];
+    uint8_t dtlsRecord[ 24 ] = { 0x16, 0xFE, 0xFD };
+    char str1[] = "stats", str2[] = "ghi789", str3[] = "peer", str4[] = "uvw321";
+    size_t agentMemorySize = 0, managerMemorySize = 0;
+
+    statsConfig.statsClock = test_StatsClock;
+    memset( &localCandidate, 0, sizeof( localCandidate ) );
+    memset( &remoteCandidate, 0, sizeof( remoteCandidate ) );
+    memset( &candidatePair, 0, sizeof( candidatePair ) );
+    localCandidate.iceCandidateType = ICE_CANDIDATE_TYPE_HOST;
+    remoteCandidate.iceCandidateType = ICE_CANDIDATE_TYPE_HOST;
+    remoteCandidate.ipAddress = iceIpAddress;
+    candidatePair.local = &localCandidate;
+    candidatePair.remote = &remoteCandidate;
+    candidatePair.state = ICE_CANDIDATE_PAIR_STATE_WAITING;
+
+    result = Ice_GetIceAgentMemorySize( &statsConfig, &agentMemorySize );
+
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_CreateIceAgent( statsAgent, &statsConfig, malloc( agentMemorySize ), agentMemorySize, str1, str2, str3, str4 );
+    }
+
+    /* A check sent at 1000 ms and answered 40 ms later. */
+    if( result == ICE_RESULT_OK )
+    {
+        Ice_UpdateCurrentTime( statsAgent, 1000 );
+        result = Ice_CreateRequestForConnectivityCheck( statsAgent, requestBuffer, transactionId );
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        Ice_UpdateCurrentTime( statsAgent, 1040 );
+        Ice_InitializeStunPacket( &pStunCxt, transactionId, responseBuffer, sizeof( responseBuffer ), &pStunHeader, 0, 0 );
+        StunSerializer_AddAttributeXorMappedAddress( &pStunCxt, &stunAddress );
+        Ice_PackageStunPacket( &pStunCxt, NULL );
+        result = Ice_HandleStunResponse( statsAgent, responseBuffer, Ice_GetStunMessageLength( responseBuffer ), transactionId, &localCandidate, iceIpAddress, &candidatePair );
+    }
+
+    /* The nominated pair succeeds at 1100 ms, 100 ms after the first check. */
+    if( result == ICE_RESULT_OK )
+    {
+        Ice_UpdateCurrentTime( statsAgent, 1100 );
+        candidatePair.state = ICE_CANDIDATE_PAIR_STATE_NOMINATED;
+        candidatePair.connectivityChecks = ICE_CONNECTIVITY_SUCCESS_FLAG;
+        result = Ice_HandleStunResponse( statsAgent, responseBuffer, Ice_GetStunMessageLength( responseBuffer ), transactionId, &localCandidate, iceIpAddress, &candidatePair );
+        result = ( result == ICE_RESULT_CANDIDATE_PAIR_READY ) ? ICE_RESULT_OK : result;
+    }
+
+    /* A DTLS record on the socket is rejected, the time spent on it is still measured. */
+    if( result == ICE_RESULT_OK )
+    {
+        packet.pBuffer = dtlsRecord;
+        packet.bufferLength = sizeof( dtlsRecord );
+        packet.localAddress = iceIpAddress;
+        packet.srcAddress = iceIpAddress;
+        ( void ) Ice_HandleStunPackets( statsAgent, &packet, &packetResult, 1 );
+        result = Ice_GetAgentStats( statsAgent, &snapshot );
+    }
+
+    memset( &total, 0, sizeof( total ) );
+    Ice_AccumulateAgentStats( &total, &snapshot );
+    Ice_AccumulateAgentStats( &total, &snapshot );
+
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_GetAgentManagerMemorySize( &managerConfig, &managerMemorySize );
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_CreateAgentManager( &agentManager, &managerConfig, malloc( managerMemorySize ), managerMemorySize );
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_AgentManagerAddAgent( &agentManager, statsAgent );
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_AgentManagerGetStats( &agentManager, &managerStats );
+        Ice_AgentManagerRemoveAgent( &agentManager, statsAgent );
+    }
+
+    if( ( result == ICE_RESULT_OK ) &&
+        ( snapshot.requestsSent == 1 ) &&
+        ( snapshot.rejectCounters.notStun == 1 ) &&
+        ( snapshot.pairRtt.count == 1 ) && ( snapshot.pairRtt.buckets[ 6 ] == 1 ) &&
+        ( Ice_HistogramPercentile( &( snapshot.pairRtt ), 50 ) == 40 ) &&
+        ( snapshot.timeToConnect.count == 1 ) && ( snapshot.timeToConnect.sum == 100 ) &&
+        ( snapshot.pairStateTransitions[ ICE_CANDIDATE_PAIR_STATE_SUCCEEDED ] == 1 ) &&
+        ( snapshot.handlerTime.count == 1 ) && ( snapshot.handlerTime.sum == 250 ) &&
+        ( total.requestsSent == 2 ) && ( total.pairRtt.count == 2 ) && ( total.pairRtt.max == 40 ) &&
+        ( memcmp( &managerStats, &snapshot, sizeof( snapshot ) ) == 0 ) )
+    {
+        printf("Success, %llu request, RTT %llu ms, connected in %llu ms, %llu ns per packet handled.\n",
+               ( unsigned long long ) snapshot.requestsSent, ( unsigned long long ) snapshot.pairRtt.sum,
+               ( unsigned long long ) snapshot.timeToConnect.sum, ( unsigned long long ) snapshot.handlerTime.sum );
+    }
+    else
+    {
+        printf("Failure in counting the agent stats : Result - %d, Requests - %llu, RTT samples - %llu, Connect samples - %llu\n",
+               result, ( unsigned long long ) snapshot.requestsSent, ( unsigned long long ) snapshot.pairRtt.count,
+               ( unsigned long long ) snapshot.timeToConnect.count );
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static IceResult_t test_AnswerCheck( IceAgent_t * rttAgent,
+                                     IceCandidatePair_t * pIceCandidatePair,
+                                     uint64_t sendTime,
+                                     uint64_t rtt )
+{
+    IceResult_t result;
+    StunContext_t pStunCxt;
+    StunHeader_t pStunHeader;
+    uint8_t requestBuffer[ ICE_OUTBOUND_BUFFER_SIZE ], responseBuffer[ 64 ];
+    uint8_t transactionId[ STUN_HEADER_TRANSACTION_ID_LENGTH ];
+
+    Ice_UpdateCurrentTime( rttAgent, sendTime );
+    result = Ice_CreateRequestForConnectivityCheck( rttAgent, requestBuffer, transactionId );
+
+    if( result == ICE_RESULT_OK )
+    {
+        Ice_UpdateCurrentTime( rttAgent, sendTime + rtt );
+        Ice_InitializeStunPacket( &pStunCxt, transactionId, responseBuffer, sizeof( responseBuffer ), &pStunHeader, 0, 0 );
+        Ice_PackageStunPacket( &pStunCxt, NULL );
+        result = Ice_HandleStunResponse( rttAgent, responseBuffer, Ice_GetStunMessageLength( responseBuffer ), transactionId,
+                                         pIceCandidatePair->local, pIceCandidatePair->remote->ipAddress, pIceCandidatePair );
+    }
+
+    return result;
+}
+
+void test_RttAwareNomination( void )
+{
+    printf("\nSelecting the pair to nominate from measured RTTs. \n");
+    IceResult_t result, noSampleResult = ICE_RESULT_OK;
+    IceAgent_t * rttAgent = malloc( sizeof( struct IceAgent ) );
+    IceCandidate_t * candidate = NULL;
+    IceCandidatePair_t * hostPair, * srflxPair, unmeasuredPair;
+    IceCandidatePair_t * byPriority = NULL, * narrowWindow = NULL, * wideWindow = NULL;
+    IceIPAddress_t iceIpAddress = { .ipAddress = { .family = STUN_ADDRESS_IPv4, .port = 5000, .address = { 10, 0, 0, 1 } }, .isPointToPoint = 0 };
+    char str1[] = "rtt", str2[] = "jkl012", str3[] = "peer", str4[] = "uvw321";
+    size_t agentMemorySize = 0;
+    uint32_t smoothedRtt = 0, rttVariation = 0;
+
+    memset( &unmeasuredPair, 0, sizeof( unmeasuredPair ) );
+    result = Ice_GetIceAgentMemorySize( &agentConfig, &agentMemorySize );
+
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_CreateIceAgent( rttAgent, &agentConfig, malloc( agentMemorySize ), agentMemorySize, str1, str2, str3, str4 );
+    }
+
+    /* One local host candidate paired with a remote host and a remote server reflexive candidate. */
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_AddHostCandidate( iceIpAddress, rttAgent, &candidate );
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        iceIpAddress.ipAddress.address[ 3 ] = 2;
+        result = Ice_AddRemoteCandidate( rttAgent, ICE_CANDIDATE_TYPE_HOST, &candidate, iceIpAddress, ICE_SOCKET_PROTOCOL_UDP, 2130706431 );
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        iceIpAddress.ipAddress.address[ 3 ] = 3;
+        result = Ice_AddRemoteCandidate( rttAgent, ICE_CANDIDATE_TYPE_SERVER_REFLEXIVE, &candidate, iceIpAddress, ICE_SOCKET_PROTOCOL_UDP, 1694498815 );
+    }
+
+    /* The host path is congested ( 120 ms ), the server reflexive one answers in 20 then 28 ms. */
+    hostPair = &( rttAgent->iceCandidatePairs[ 0 ] );
+    srflxPair = &( rttAgent->iceCandidatePairs[ 1 ] );
+    hostPair->connectivityChecks = ICE_CONNECTIVITY_SUCCESS_FLAG;
+    srflxPair->connectivityChecks = ICE_CONNECTIVITY_SUCCESS_FLAG;
+
+    if( result == ICE_RESULT_OK )
+    {
+        result = test_AnswerCheck( rttAgent, hostPair, 1000, 120 );
+        result = ( result == ICE_RESULT_START_NOMINATION ) ? test_AnswerCheck( rttAgent, srflxPair, 1200, 20 ) : result;
+        result = ( result == ICE_RESULT_START_NOMINATION ) ? test_AnswerCheck( rttAgent, srflxPair, 1300, 28 ) : result;
+        result = ( result == ICE_RESULT_START_NOMINATION ) ? ICE_RESULT_OK : result;
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        byPriority = Ice_SelectPairToNominate( rttAgent );
+
+        rttAgent->nominationPolicy = ICE_NOMINATION_POLICY_LOWEST_RTT;
+        rttAgent->nominationPriorityWindow = 10;
+        narrowWindow = Ice_SelectPairToNominate( rttAgent );
+
+        rttAgent->nominationPriorityWindow = 25;
+        wideWindow = Ice_SelectPairToNominate( rttAgent );
+
+        result = Ice_GetCandidatePairRtt( srflxPair, &smoothedRtt, &rttVariation );
+        noSampleResult = Ice_GetCandidatePairRtt( &unmeasuredPair, &smoothedRtt, NULL );
+    }
+
+    if( ( result == ICE_RESULT_OK ) &&
+        ( byPriority == hostPair ) && ( narrowWindow == hostPair ) && ( wideWindow == srflxPair ) &&
+        ( smoothedRtt == 21000 ) && ( rttVariation == 9500 ) &&
+        ( noSampleResult == ICE_RESULT_NO_RTT_SAMPLE ) )
+    {
+        printf("Success, host pair by priority, srflx pair by RTT ( %u us, jitter %u us ).\n", smoothedRtt, rttVariation );
+    }
+    else
+    {
+        printf("Failure in RTT-aware nomination : Result - %d, SRTT - %u us, RTTVAR - %u us\n", result, smoothedRtt, rttVariation );
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void test_LogRingSink( IceAgent_t * iceAgent )
+{
+    printf("\nCollecting agent log messages through a log ring. \n");
+    IceResult_t result;
+    IceLogRing_t logRing;
+    IceLogRecord_t logRecord = { 0 };
+    size_t ringMemorySize = 0;
+    uint32_t i, debugCount = 0, filteredCount = 0, drainedCount = 0, detachedCount = 0;
+    uint8_t indication[ STUN_HEADER_LENGTH ] = { 0x00, 0x11, 0x00, 0x00, 0x21, 0x12, 0xA4, 0x42,
+                                                 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C };
+    uint8_t transactionId[ STUN_HEADER_TRANSACTION_ID_LENGTH ] = { 0 };
+    IceCandidatePair_t * pIceCandidatePair = &( iceAgent->iceCandidatePairs[ 0 ] );
+
+    result = Ice_GetLogRingMemorySize( 4, &ringMemorySize );
+
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_CreateLogRing( &logRing, 4, malloc( ringMemorySize ), ringMemorySize );
+    }
+
+    /* The ring collects the messages of this thread only. */
+    if( result == ICE_RESULT_OK )
+    {
+        Ice_LogRingAttachThread( &logRing );
+        result = Ice_SetAgentLogCallback( iceAgent, Ice_LogRingCallback, NULL, ICE_LOG_LEVEL_DEBUG );
+    }
+
+    /* A binding indication is logged at debug level. */
+    if( result == ICE_RESULT_OK )
+    {
+        Ice_HandleStunResponse( iceAgent, indication, sizeof( indication ), transactionId, pIceCandidatePair->local, pIceCandidatePair->remote->ipAddress, pIceCandidatePair );
+
+        while( Ice_LogRingRead( &logRing, &logRecord ) )
+        {
+            debugCount += ( ( logRecord.level == ICE_LOG_LEVEL_DEBUG ) && ( strstr( logRecord.message, "indication" ) != NULL ) ) ? 1 : 0;
+        }
+
+        /* Filtered out at warning level. */
+        Ice_SetAgentLogCallback( iceAgent, Ice_LogRingCallback, NULL, ICE_LOG_LEVEL_WARN );
+        Ice_HandleStunResponse( iceAgent, indication, sizeof( indication ), transactionId, pIceCandidatePair->local, pIceCandidatePair->remote->ipAddress, pIceCandidatePair );
+
+        while( Ice_LogRingRead( &logRing, &logRecord ) )
+        {
+            filteredCount++;
+        }
+
+        /* More messages than records before the consumer runs: the excess is dropped, not blocked on. */
+        Ice_SetAgentLogCallback( iceAgent, Ice_LogRingCallback, NULL, ICE_LOG_LEVEL_DEBUG );
+
+        for( i = 0; i < 6; i++ )
+        {
+            Ice_HandleStunResponse( iceAgent, indication, sizeof( indication ), transactionId, pIceCandidatePair->local, pIceCandidatePair->remote->ipAddress, pIceCandidatePair );
+        }
+
+        while( Ice_LogRingRead( &logRing, &logRecord ) )
+        {
+            drainedCount++;
+        }
+
+        /* Once the thread is detached its messages reach no ring. */
+        Ice_LogRingAttachThread( NULL );
+        Ice_HandleStunResponse( iceAgent, indication, sizeof( indication ), transactionId, pIceCandidatePair->local, pIceCandidatePair->remote->ipAddress, pIceCandidatePair );
+
+        while( Ice_LogRingRead( &logRing, &logRecord ) )
+        {
+            detachedCount++;
+        }
+
+        Ice_SetAgentLogCallback( iceAgent, NULL, NULL, ICE_LOG_LEVEL_NONE );
+    }
+
+    if( ( result == ICE_RESULT_OK ) &&
+        ( debugCount == 1 ) && ( filteredCount == 0 ) &&
+        ( drainedCount == 4 ) && ( logRing.droppedCount == 2 ) && ( detachedCount == 0 ) )
+    {
+        printf("Success, \"%s\" logged, %llu messages dropped by the full ring.\n", logRecord.message, ( unsigned long long ) logRing.droppedCount );
+    }
+    else
+    {
+        printf("Failure in logging through the ring : Result - %d, Debug - %u, Filtered - %u, Drained - %u, Detached - %u\n", result, debugCount, filteredCount, drainedCount, detachedCount );
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+static uint32_t testRandomSourceCalls = 0;
+
+static void test_RandomSource( void * pUserData, uint8_t * pBuffer, size_t length )
+{
+    testRandomSourceCalls++;
+    memset( pBuffer, *( ( uint8_t * ) pUserData ), length );
+}
+
+void test_RandomGenerator( void )
+{
+    printf("\nGenerating transaction IDs and tie-breakers. \n");
+    IceResult_t result = ICE_RESULT_OK;
+    IceRandom_t random;
+    IceAgentConfig_t randomConfig = agentConfig;
+    IceAgent_t * randomAgent = malloc( sizeof( struct IceAgent ) );
+    /* RFC 8439 appendix A.1 test vectors 1 and 2: ChaCha20 blocks 0 and 1 of the all-zero key and nonce. */
+    const uint8_t expectedKeyStream[ 2 * ICE_RANDOM_BLOCK_LENGTH ] = {
+        0x76, 0xB8, 0xE0, 0xAD, 0xA0, 0xF1, 0x3D, 0x90, 0x40, 0x5D, 0x6A, 0xE5, 0x53, 0x86, 0xBD, 0x28,
+        0xBD, 0xD2, 0x19, 0xB8, 0xA0, 0x8D, 0xED, 0x1A, 0xA8, 0x36, 0xEF, 0xCC, 0x8B, 0x77, 0x0D, 0xC7,
+        0xDA, 0x41, 0x59, 0x7C, 0x51, 0x57, 0x48, 0x8D, 0x77, 0x24, 0xE0, 0x3F, 0xB8, 0xD8, 0x4A, 0x37,
+        0x6A, 0x43, 0xB8, 0xF4, 0x15, 0x18, 0xA1, 0x1C, 0xC3, 0x87, 0xB6, 0x69, 0xB2, 0xEE, 0x65, 0x86,
+        0x9F, 0x07, 0xE7, 0xBE, 0x55, 0x51, 0x38, 0x7A, 0x98, 0xBA, 0x97, 0x7C, 0x73, 0x2D, 0x08, 0x0D,
+        0xCB, 0x0F, 0x29, 0xA0, 0x48, 0xE3, 0x65, 0x69, 0x12, 0xC6, 0x53, 0x3E, 0x32, 0xEE, 0x7A, 0xED,
+        0x29, 0xB7, 0x21, 0x76, 0x9C, 0xE6, 0x4E, 0x43, 0xD5, 0x71, 0x33, 0xB0, 0x74, 0xD8, 0x39, 0xD5,
+        0x31, 0xED, 0x1F, 0x28, 0x51, 0x0A, 0xFB, 0x45, 0xAC, 0xE1, 0x0A, 0x1F, 0x4B, 0x79, 0x4D, 0x6F
+    };
+    uint8_t seed[ ICE_RANDOM_SEED_LENGTH ] = { 0 };
+    uint8_t keyStream[ 2 * ICE_RANDOM_BLOCK_LENGTH ];
+    uint8_t firstId[ STUN_HEADER_TRANSACTION_ID_LENGTH ], secondId[ STUN_HEADER_TRANSACTION_ID_LENGTH ];
+    uint8_t sourceByte = 0xA5;
+    char str1[] = "random", str2[] = "mno345", str3[] = "peer", str4[] = "uvw321";
+    size_t agentMemorySize = 0;
+    uint32_t offset = 0;
+
+    /* Transaction ID sized draws from the first block, then its last bytes followed by a whole block generated in place. */
+    Ice_RandomInitFromSeed( &random, seed );
+
+    while( offset + STUN_HEADER_TRANSACTION_ID_LENGTH <= ICE_RANDOM_BLOCK_LENGTH )
+    {
+        Ice_RandomFill( &random, &( keyStream[ offset ] ), STUN_HEADER_TRANSACTION_ID_LENGTH );
+        offset += STUN_HEADER_TRANSACTION_ID_LENGTH;
+    }
+
+    Ice_RandomFill( &random, &( keyStream[ offset ] ), sizeof( keyStream ) - offset );
+
+    if( memcmp( keyStream, expectedKeyStream, sizeof( keyStream ) ) != 0 )
+    {
+        result = ICE_RESULT_BAD_PARAM;
+    }
+
+    /* Agents without a seed of their own read the system's entropy, so their IDs differ. */
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_RandomFillThreadLocal( firstId, sizeof( firstId ) );
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_RandomFillThreadLocal( secondId, sizeof( secondId ) );
+    }
+
+    if( ( result == ICE_RESULT_OK ) && ( memcmp( firstId, secondId, sizeof( firstId ) ) == 0 ) )
+    {
+        result = ICE_RESULT_BAD_PARAM;
+    }
+
+    /* An application source replaces the built-in generator. */
+    randomConfig.randomSource = test_RandomSource;
+    randomConfig.pRandomSourceData = &sourceByte;
+
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_GetIceAgentMemorySize( &randomConfig, &agentMemorySize );
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_CreateIceAgent( randomAgent, &randomConfig, malloc( agentMemorySize ), agentMemorySize, str1, str2, str3, str4 );
+    }
+
+    if( ( result == ICE_RESULT_OK ) &&
+        ( randomAgent->tieBreaker == 0xA5A5A5A5A5A5A5A5ULL ) &&
+        ( testRandomSourceCalls > 0 ) )
+    {
+        printf("Success, key stream matches RFC 8439, tie-breaker from the application source : 0x%016llX.\n", ( unsigned long long ) randomAgent->tieBreaker );
+    }
+    else
+    {
+        printf("Failure in generating random values : Result - %d, Source calls - %u\n", result, testRandomSourceCalls );
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void test_RemoteCredentials( IceAgent_t * iceAgent )
+{
+    printf("\nReplacing the remote credentials of an agent. \n");
+    IceResult_t oversizedResult, result;
+    StunContext_t pStunCxt;
+    StunHeader_t pStunHeader;
+    IceStunAttributeTable_t attributeTable;
+    uint8_t stunMessageBuffer[ 1024 ] = { 0 };
+    uint8_t transactionId[ STUN_HEADER_TRANSACTION_ID_LENGTH ] = { 0 };
+    char oversizedUsername[ MAX_ICE_CONFIG_USER_NAME_LEN + 2 ];
+    char str1[] = "peer2", str2[] = "pqr678", str3[] = "remote", str4[] = "xyz789";
+    bool usernameMatches = false;
+
+    /* Too long to store, the agent keeps its credentials. */
+    memset( oversizedUsername, 'a', sizeof( oversizedUsername ) - 1 );
+    oversizedUsername[ sizeof( oversizedUsername ) - 1 ] = '\0';
+    oversizedResult = Ice_SetRemoteCredentials( iceAgent, oversizedUsername, str2 );
+
+    result = Ice_SetRemoteCredentials( iceAgent, str1, str2 );
+
+    /* The next check carries the rebuilt USERNAME. */
+    if( ( result == ICE_RESULT_OK ) &&
+        ( Ice_CreateRequestForConnectivityCheck( iceAgent, stunMessageBuffer, transactionId ) == ICE_RESULT_OK ) &&
+        ( StunDeserializer_Init( &pStunCxt, stunMessageBuffer, Ice_GetStunMessageLength( stunMessageBuffer ), &pStunHeader ) == STUN_RESULT_OK ) &&
+        ( Ice_DeserializeStunPacket( &pStunCxt, &pStunHeader, &attributeTable ) == ICE_RESULT_OK ) )
+    {
+        usernameMatches = ( attributeTable.valueLengths[ ICE_STUN_ATTRIBUTE_INDEX_USERNAME ] == strlen( "peer2:local" ) ) &&
+                          ( memcmp( &( stunMessageBuffer[ attributeTable.valueOffsets[ ICE_STUN_ATTRIBUTE_INDEX_USERNAME ] ] ),
+                                    "peer2:local", strlen( "peer2:local" ) ) == 0 );
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_SetRemoteCredentials( iceAgent, str3, str4 );
+    }
+
+    if( ( oversizedResult == ICE_RESULT_BAD_PARAM ) &&
+        ( result == ICE_RESULT_OK ) &&
+        usernameMatches &&
+        ( iceAgent->combinedUserNameLength == strlen( "remote:local" ) ) &&
+        ( strcmp( iceAgent->combinedUserName, "remote:local" ) == 0 ) )
+    {
+        printf("Success, requests carry the USERNAME built from the new remote username fragment.\n");
+    }
+    else
+    {
+        printf("Failure in replacing the remote credentials : Results - %d %d, USERNAME - %d\n", oversizedResult, result, usernameMatches );
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void test_ResetAgent( void )
+{
+    printf("\nResetting an agent for a new session. \n");
+    IceResult_t result, oversizedResult = ICE_RESULT_OK;
+    IceAgent_t * resetAgent = malloc( sizeof( struct IceAgent ) );
+    IceAgent_t * pLookupAgent = NULL;
+    IceConnectionTable_t connectionTable;
+    IceCandidate_t * localCandidate = NULL, * remoteCandidate = NULL;
+    IceCandidatePair_t * pFoundPair = NULL, * pPublishedPair = NULL, * pWithdrawnPair = NULL;
+    IceIPAddress_t localAddress = { .ipAddress = { .family = STUN_ADDRESS_IPv4, .port = 5000, .address = { 10, 0, 0, 1 } }, .isPointToPoint = 0 };
+    IceIPAddress_t remoteAddress = { .ipAddress = { .family = STUN_ADDRESS_IPv4, .port = 5000, .address = { 10, 0, 0, 2 } }, .isPointToPoint = 0 };
+    uint8_t requestBuffer[ ICE_OUTBOUND_BUFFER_SIZE ];
+    uint8_t transactionId[ STUN_HEADER_TRANSACTION_ID_LENGTH ];
+    char oversizedPassword[ MAX_ICE_CONFIG_CREDENTIAL_LEN + 2 ];
+    char str1[] = "reset", str2[] = "stu901", str3[] = "peer", str4[] = "uvw321";
+    char str5[] = "reset2", str6[] = "vwx234", str7[] = "peer3", str8[] = "yza567";
+    size_t agentMemorySize = 0, tableMemorySize = 0;
+    uint32_t dirtyIndexEntries = 0, dirtyTransactions = 0;
+
+    result = Ice_GetIceAgentMemorySize( &agentConfig, &agentMemorySize );
+
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_CreateIceAgent( resetAgent, &agentConfig, malloc( agentMemorySize ), agentMemorySize, str1, str2, str3, str4 );
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_GetConnectionTableMemorySize( 4, &tableMemorySize );
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_CreateConnectionTable( &connectionTable, 4, malloc( tableMemorySize ), tableMemorySize );
+    }
+
+    /* The previous session: a pair with a check in flight, then published as succeeded. */
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_AddHostCandidate( localAddress, resetAgent, &localCandidate );
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_AddRemoteCandidate( resetAgent, ICE_CANDIDATE_TYPE_HOST, &remoteCandidate, remoteAddress, ICE_SOCKET_PROTOCOL_UDP, 2130706431 );
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_CreateRequestForConnectivityCheck( resetAgent, requestBuffer, transactionId );
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        resetAgent->iceCandidatePairs[ 0 ].state = ICE_CANDIDATE_PAIR_STATE_SUCCEEDED;
+        resetAgent->iceCandidatePairs[ 0 ].rttSampleCount = 3;
+        result = Ice_SetConnectionTable( resetAgent, &connectionTable );
+        pPublishedPair = Ice_ConnectionTableLookup( &connectionTable, &( localAddress.ipAddress ), &( remoteAddress.ipAddress ), &pLookupAgent );
+    }
+
+    /* Rejected before anything is cleared. */
+    if( result == ICE_RESULT_OK )
+    {
+        memset( oversizedPassword, 'b', sizeof( oversizedPassword ) - 1 );
+        oversizedPassword[ sizeof( oversizedPassword ) - 1 ] = '\0';
+        oversizedResult = Ice_ResetAgent( resetAgent, str5, oversizedPassword, str7, str8 );
+        oversizedResult = ( resetAgent->iceCandidatePairCount == 1 ) ? oversizedResult : ICE_RESULT_OK;
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_ResetAgent( resetAgent, str5, str6, str7, str8 );
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        dirtyIndexEntries = resetAgent->localCandidateIndex.entryCount + resetAgent->remoteCandidateIndex.entryCount +
+                            resetAgent->candidatePairIndex.entryCount;
+        dirtyTransactions = resetAgent->stunBindingRequestTransactionIdStore.transactionIdCount;
+        pWithdrawnPair = Ice_ConnectionTableLookup( &connectionTable, &( localAddress.ipAddress ), &( remoteAddress.ipAddress ), &pLookupAgent );
+    }
+
+    /* The new session starts from clean slots. */
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_AddHostCandidate( localAddress, resetAgent, &localCandidate );
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_AddRemoteCandidate( resetAgent, ICE_CANDIDATE_TYPE_HOST, &remoteCandidate, remoteAddress, ICE_SOCKET_PROTOCOL_UDP, 2130706431 );
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        pFoundPair = Ice_FindCandidatePair( resetAgent, &( resetAgent->localCandidates[ 0 ] ), &remoteAddress );
+    }
+
+    if( ( result == ICE_RESULT_OK ) &&
+        ( oversizedResult == ICE_RESULT_BAD_PARAM ) &&
+        ( pPublishedPair != NULL ) && ( pWithdrawnPair == NULL ) &&
+        ( dirtyIndexEntries == 0 ) && ( dirtyTransactions == 0 ) &&
+        ( resetAgent->iceCandidatePairCount == 1 ) &&
+        ( pFoundPair == &( resetAgent->iceCandidatePairs[ 0 ] ) ) &&
+        ( pFoundPair->state == ICE_CANDIDATE_PAIR_STATE_WAITING ) &&
+        ( pFoundPair->rttSampleCount == 0 ) &&
+        ( strcmp( resetAgent->combinedUserName, "peer3:reset2" ) == 0 ) )
+    {
+        printf("Success, the agent starts over as %s with only the previous session's slots cleared.\n", resetAgent->combinedUserName );
+    }
+    else
+    {
+        printf("Failure in resetting the agent : Results - %d %d, Index entries - %u, Transactions - %u\n", result, oversizedResult, dirtyIndexEntries, dirtyTransactions );
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void test_ResponseEchoesTransactionId( IceAgent_t * iceAgent )
+{
+    printf("\nCreating a response to a Stun Binding Request. \n");
+    IceResult_t result;
+    IceIPAddress_t srcAddress = { .ipAddress = { .family = STUN_ADDRESS_IPv4, .port = 6000, .address = { 10, 0, 0, 3 } }, .isPointToPoint = 0 };
+    uint8_t responseBuffer[ ICE_OUTBOUND_BUFFER_SIZE ];
+    uint8_t requestTransactionId[ STUN_HEADER_TRANSACTION_ID_LENGTH ];
+    uint8_t transactionId[ STUN_HEADER_TRANSACTION_ID_LENGTH ];
+    int i;
+
+    for( i = 0; i < STUN_HEADER_TRANSACTION_ID_LENGTH; i++ )
+    {
+        requestTransactionId[ i ] = ( uint8_t ) ( 0xA0 + i );
+    }
+
+    memcpy( transactionId, requestTransactionId, STUN_HEADER_TRANSACTION_ID_LENGTH );
+
+    result = Ice_CreateResponseForRequest( iceAgent, responseBuffer, &srcAddress, transactionId );
+
+    if( ( result == ICE_RESULT_OK ) &&
+        ( memcmp( &( responseBuffer[ STUN_HEADER_TRANSACTION_ID_OFFSET ] ), requestTransactionId, STUN_HEADER_TRANSACTION_ID_LENGTH ) == 0 ) &&
+        ( memcmp( transactionId, requestTransactionId, STUN_HEADER_TRANSACTION_ID_LENGTH ) == 0 ) )
+    {
+        printf("Success, the response carries the transaction ID of the request.\n");
+    }
+    else
+    {
+        printf("Failure in echoing the request's transaction ID : Result - %d\n", result );
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void test_UnsignedResponses( IceAgent_t * iceAgent )
+{
+    printf("\nClassifying responses without MESSAGE-INTEGRITY. \n");
+    StunContext_t pStunCxt;
+    StunHeader_t pStunHeader;
+    uint8_t stunMessageBuffer[ 128 ] = { 0 };
+    uint8_t checkTransactionId[ STUN_HEADER_TRANSACTION_ID_LENGTH ] = { 0xC1, 0xC2, 0xC3 };
+    uint8_t srflxTransactionId[ STUN_HEADER_TRANSACTION_ID_LENGTH ] = { 0xD1, 0xD2, 0xD3 };
+    IceResult_t result, checkResult = ICE_RESULT_OK, srflxResult = ICE_RESULT_OK;
+
+    result = Ice_TransactionIdStoreInsert( &( iceAgent->stunBindingRequestTransactionIdStore ), checkTransactionId,
+                                           ICE_TRANSACTION_PURPOSE_CONNECTIVITY_CHECK, NULL, NULL, 0 );
+
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_TransactionIdStoreInsert( &( iceAgent->stunBindingRequestTransactionIdStore ), srflxTransactionId,
+                                               ICE_TRANSACTION_PURPOSE_SRFLX_REQUEST, NULL, NULL, 0 );
+    }
+
+    /* A success response to the connectivity check, not signed. */
+    if( result == ICE_RESULT_OK )
+    {
+        Ice_InitializeStunPacket( &pStunCxt, checkTransactionId, stunMessageBuffer, sizeof( stunMessageBuffer ), &pStunHeader, 0, 0 );
+        Ice_PackageStunPacket( &pStunCxt, NULL );
+        checkResult = Ice_ClassifyStunPacket( iceAgent, stunMessageBuffer, Ice_GetStunMessageLength( stunMessageBuffer ) );
+    }
+
+    /* The same from the STUN server. */
+    if( result == ICE_RESULT_OK )
+    {
+        Ice_InitializeStunPacket( &pStunCxt, srflxTransactionId, stunMessageBuffer, sizeof( stunMessageBuffer ), &pStunHeader, 0, 0 );
+        Ice_PackageStunPacket( &pStunCxt, NULL );
+        srflxResult = Ice_ClassifyStunPacket( iceAgent, stunMessageBuffer, Ice_GetStunMessageLength( stunMessageBuffer ) );
+    }
+
+    Ice_TransactionIdStoreRemove( &( iceAgent->stunBindingRequestTransactionIdStore ), checkTransactionId );
+    Ice_TransactionIdStoreRemove( &( iceAgent->stunBindingRequestTransactionIdStore ), srflxTransactionId );
+
+    if( ( result == ICE_RESULT_OK ) &&
+        ( checkResult == ICE_RESULT_INTEGRITY_MISSING ) &&
+        ( srflxResult == ICE_RESULT_OK ) )
+    {
+        printf("Success, only the STUN server's response is accepted without MESSAGE-INTEGRITY.\n");
+    }
+    else
+    {
+        printf("Failure in classifying unsigned responses : Results - %d %d %d\n", result, checkResult, srflxResult );
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void test_TriggeredCheckRetransmitted( void )
+{
+    printf("\nRetransmitting a triggered check from the timer wheel. \n");
+    IceResult_t result, handleResult = ICE_RESULT_OK;
+    IceAgent_t * checkedAgent = malloc( sizeof( struct IceAgent ) );
+    IceAgent_t * peerAgent = malloc( sizeof( struct IceAgent ) );
+    IceTimerWheel_t timerWheel;
+    IceOutboundBuffer_t * pOutboundBuffer;
+    IceOutboundPacket_t packets[ 4 ];
+    IceCandidatePair_t * pIceCandidatePair = NULL;
+    IceCandidate_t * localCandidate = NULL, * remoteCandidate = NULL;
+    IceIPAddress_t localAddress = { .ipAddress = { .family = STUN_ADDRESS_IPv4, .port = 5000, .address = { 10, 0, 0, 1 } }, .isPointToPoint = 0 };
+    IceIPAddress_t remoteAddress = { .ipAddress = { .family = STUN_ADDRESS_IPv4, .port = 5000, .address = { 10, 0, 0, 2 } }, .isPointToPoint = 0 };
+    StunContext_t pStunCxt;
+    StunHeader_t pStunHeader;
+    IceStunAttributeTable_t attributeTable;
+    uint8_t requestBuffer[ ICE_OUTBOUND_BUFFER_SIZE ];
+    uint8_t packetArena[ 4 * ICE_STUN_MESSAGE_BUFFER_SIZE ];
+    uint8_t transactionId[ STUN_HEADER_TRANSACTION_ID_LENGTH ];
+    uint8_t triggeredTransactionId[ STUN_HEADER_TRANSACTION_ID_LENGTH ];
+    char str1[] = "trig", str2[] = "bcd789", str3[] = "peer", str4[] = "uvw321";
+    size_t agentMemorySize = 0;
+    uint32_t packetCount = 0, ordinaryCount = 0, triggeredCount = 0, resentCount = 0, priority = 0, roleFlags = 0, i;
+    uint32_t roleMask = ICE_STUN_ATTRIBUTE_FLAG( ICE_STUN_ATTRIBUTE_INDEX_ICE_CONTROLLING ) | ICE_STUN_ATTRIBUTE_FLAG( ICE_STUN_ATTRIBUTE_INDEX_ICE_CONTROLLED );
+
+    result = Ice_GetIceAgentMemorySize( &agentConfig, &agentMemorySize );
+
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_CreateIceAgent( checkedAgent, &agentConfig, malloc( agentMemorySize ), agentMemorySize, str1, str2, str3, str4 );
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_CreateIceAgent( peerAgent, &agentConfig, malloc( agentMemorySize ), agentMemorySize, str3, str4, str1, str2 );
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_AddHostCandidate( localAddress, checkedAgent, &localCandidate );
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_AddRemoteCandidate( checkedAgent, ICE_CANDIDATE_TYPE_HOST, &remoteCandidate, remoteAddress, ICE_SOCKET_PROTOCOL_UDP, 2130706431 );
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        Ice_TimerWheelInit( &timerWheel, checkedAgent->currentTime );
+        result = Ice_SetTimerWheel( checkedAgent, &timerWheel );
+    }
+
+    /* The peer checks the pair first, the agent answers and triggers its own check of the pair. */
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_CreateRequestForConnectivityCheck( peerAgent, requestBuffer, transactionId );
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        handleResult = Ice_HandleReceivedStunPacket( checkedAgent, requestBuffer, Ice_GetStunMessageLength( requestBuffer ),
+                                                     &localAddress, &remoteAddress, &pIceCandidatePair );
+    }
+
+    while( ( pOutboundBuffer = Ice_GetOutboundBuffer( checkedAgent ) ) != NULL )
+    {
+        if( ( ( pOutboundBuffer->pBuffer[ 0 ] << 8 ) | pOutboundBuffer->pBuffer[ 1 ] ) == STUN_MESSAGE_TYPE_BINDING_REQUEST )
+        {
+            memcpy( triggeredTransactionId, pOutboundBuffer->pBuffer + STUN_HEADER_TRANSACTION_ID_OFFSET, STUN_HEADER_TRANSACTION_ID_LENGTH );
+
+            if( ( StunDeserializer_Init( &pStunCxt, pOutboundBuffer->pBuffer, pOutboundBuffer->length, &pStunHeader ) == STUN_RESULT_OK ) &&
+                ( Ice_DeserializeStunPacket( &pStunCxt, &pStunHeader, &attributeTable ) == ICE_RESULT_OK ) )
+            {
+                priority = Ice_GetStunAttributeUint32( &attributeTable, ICE_STUN_ATTRIBUTE_INDEX_PRIORITY );
+                roleFlags = attributeTable.flags & roleMask;
+            }
+            triggeredCount++;
+        }
+        Ice_ReleaseOutboundBuffer( checkedAgent, pOutboundBuffer );
+    }
+
+    /* The triggered check took the pair off the check list, no ordinary check of it follows. */
+    if( ( result == ICE_RESULT_OK ) && ( triggeredCount == 1 ) )
+    {
+        result = Ice_CreateConnectivityChecks( checkedAgent, packetArena, sizeof( packetArena ), packets, 4, &ordinaryCount );
+    }
+
+    /* Unanswered, the triggered check is sent again once its RTO expires, in the role it was first sent in. */
+    if( ( result == ICE_RESULT_OK ) && ( triggeredCount == 1 ) )
+    {
+        checkedAgent->isControlling = !checkedAgent->isControlling;
+        result = Ice_HandleExpiredTimers( &timerWheel, checkedAgent->currentTime + checkedAgent->stunBindingRequestTransactionIdStore.initialRto,
+                                          packetArena, sizeof( packetArena ), packets, 4, &packetCount );
+    }
+
+    for( i = 0; ( result == ICE_RESULT_OK ) && ( i < packetCount ); i++ )
+    {
+        if( ( memcmp( packetArena + packets[ i ].offset + STUN_HEADER_TRANSACTION_ID_OFFSET, triggeredTransactionId, STUN_HEADER_TRANSACTION_ID_LENGTH ) == 0 ) &&
+            ( packets[ i ].pIceCandidatePair == pIceCandidatePair ) &&
+            ( StunDeserializer_Init( &pStunCxt, packetArena + packets[ i ].offset, packets[ i ].length, &pStunHeader ) == STUN_RESULT_OK ) &&
+            ( Ice_DeserializeStunPacket( &pStunCxt, &pStunHeader, &attributeTable ) == ICE_RESULT_OK ) &&
+            ( Ice_GetStunAttributeUint32( &attributeTable, ICE_STUN_ATTRIBUTE_INDEX_PRIORITY ) == priority ) &&
+            ( ( attributeTable.flags & roleMask ) == roleFlags ) )
+        {
+            resentCount++;
+        }
+    }
+
+    if( ( result == ICE_RESULT_OK ) &&
+        ( handleResult == ICE_RESULT_SEND_STUN_REQUEST_RESPONSE ) &&
+        ( triggeredCount == 1 ) &&
+        ( ordinaryCount == 0 ) &&
+        ( resentCount == 1 ) &&
+        ( priority != 0 ) &&
+        ( roleFlags != 0 ) )
+    {
+        printf("Success, the triggered check with PRIORITY %u was sent alone, and again in its first role after its RTO.\n", priority );
+    }
+    else
+    {
+        printf("Failure in retransmitting the triggered check : Results - %d %d, Sends - %u %u %u\n", result, handleResult, triggeredCount, ordinaryCount, resentCount );
+    }
+
+    Ice_SetTimerWheel( checkedAgent, NULL );
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void test_SrflxPairsNotQueued( void )
+{
+    printf("\nQueuing the pairs of a server reflexive candidate. \n");
+    IceResult_t result, nullAgentResult = ICE_RESULT_OK;
+    IceAgent_t * srflxAgent = malloc( sizeof( struct IceAgent ) );
+    IceCandidate_t * hostCandidate = NULL, * srflxCandidate = NULL, * remoteCandidate = NULL;
+    IceIPAddress_t hostAddress = { .ipAddress = { .family = STUN_ADDRESS_IPv4, .port = 5000, .address = { 10, 0, 0, 1 } }, .isPointToPoint = 0 };
+    IceIPAddress_t mappedAddress = { .ipAddress = { .family = STUN_ADDRESS_IPv4, .port = 40000, .address = { 203, 0, 113, 5 } }, .isPointToPoint = 0 };
+    IceIPAddress_t remoteAddress = { .ipAddress = { .family = STUN_ADDRESS_IPv4, .port = 5000, .address = { 10, 0, 0, 2 } }, .isPointToPoint = 0 };
+    IceOutboundPacket_t packets[ 4 ];
+    uint8_t packetArena[ 4 * ICE_STUN_MESSAGE_BUFFER_SIZE ];
+    uint8_t stunMessageBuffer[ ICE_OUTBOUND_BUFFER_SIZE ];
+    uint8_t transactionId[ STUN_HEADER_TRANSACTION_ID_LENGTH ];
+    char str1[] = "srflx", str2[] = "cde012", str3[] = "peer", str4[] = "uvw321";
+    size_t agentMemorySize = 0;
+    uint32_t packetCount = 0, queuedCount = 0;
+
+    result = Ice_GetIceAgentMemorySize( &agentConfig, &agentMemorySize );
+
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_CreateIceAgent( srflxAgent, &agentConfig, malloc( agentMemorySize ), agentMemorySize, str1, str2, str3, str4 );
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_AddHostCandidate( hostAddress, srflxAgent, &hostCandidate );
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_AddSrflxCandidate( hostAddress, srflxAgent, &srflxCandidate, stunMessageBuffer, transactionId );
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_AddRemoteCandidate( srflxAgent, ICE_CANDIDATE_TYPE_HOST, &remoteCandidate, remoteAddress, ICE_SOCKET_PROTOCOL_UDP, 2130706431 );
+    }
+
+    /* The STUN server answered, the server reflexive candidate is paired too. */
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_UpdateSrflxCandidateAddress( srflxAgent, srflxCandidate, &mappedAddress );
+    }
+
+    /* A duplicate answer of the STUN server does not pair the candidate again. */
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_UpdateSrflxCandidateAddress( srflxAgent, srflxCandidate, &mappedAddress );
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        nullAgentResult = Ice_UpdateSrflxCandidateAddress( NULL, srflxCandidate, &mappedAddress );
+        queuedCount = srflxAgent->checkListCount;
+        result = Ice_CreateConnectivityChecks( srflxAgent, packetArena, sizeof( packetArena ), packets, 4, &packetCount );
+    }
+
+    if( ( result == ICE_RESULT_OK ) &&
+        ( nullAgentResult == ICE_RESULT_BAD_PARAM ) &&
+        ( srflxAgent->iceCandidatePairCount == 2 ) &&
+        ( queuedCount == 1 ) &&
+        ( packetCount == 1 ) &&
+        ( packets[ 0 ].pIceCandidatePair->local == hostCandidate ) &&
+        ( srflxAgent->checkListCount == 0 ) )
+    {
+        printf("Success, of %u pairs only the one on the host candidate was queued and checked.\n", srflxAgent->iceCandidatePairCount );
+    }
+    else
+    {
+        printf("Failure in queuing the server reflexive pairs : Result - %d, Pairs - %u, Queued - %u, Checks - %u\n", result, srflxAgent->iceCandidatePairCount, queuedCount, packetCount );
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void test_SharedIndexFullInsert( IceAgent_t * iceAgent )
+{
+    printf("\nInserting a transaction while the shared index is full. \n");
+    IceResult_t result, fullResult;
+    TransactionIdStore_t * pTransactionIdStore = &( iceAgent->stunBindingRequestTransactionIdStore );
+    IceHashIndex_t sharedIndex;
+    IceHashBucket_t sharedBuckets[ 2 ];
+    uint8_t transactionId[ STUN_HEADER_TRANSACTION_ID_LENGTH ] = { 0xE1, 0xE2, 0xE3 };
+    uint32_t transactionIdCount = pTransactionIdStore->transactionIdCount;
+    uint32_t newestTransactionIndex = pTransactionIdStore->newestTransactionIndex;
+    bool isFound;
+
+    /* Two buckets hold a single entry, which is taken. */
+    memset( sharedBuckets, 0, sizeof( sharedBuckets ) );
+    Ice_HashIndexInit( &sharedIndex, sharedBuckets, 2 );
+    result = Ice_HashIndexInsert( &sharedIndex, 0, 0 );
+
+    pTransactionIdStore->pSharedIndex = &sharedIndex;
+    fullResult = Ice_TransactionIdStoreInsert( pTransactionIdStore, transactionId, ICE_TRANSACTION_PURPOSE_CONNECTIVITY_CHECK, NULL, NULL, 0 );
+    pTransactionIdStore->pSharedIndex = NULL;
+
+    isFound = Ice_TransactionIdStoreHasId( pTransactionIdStore, transactionId );
+
+    if( ( result == ICE_RESULT_OK ) &&
+        ( fullResult == ICE_RESULT_OUT_OF_MEMORY ) &&
+        !isFound &&
+        ( pTransactionIdStore->transactionIdCount == transactionIdCount ) &&
+        ( pTransactionIdStore->newestTransactionIndex == newestTransactionIndex ) &&
+        ( sharedIndex.entryCount == 1 ) )
+    {
+        printf("Success, the transaction was not stored.\n");
+    }
+    else
+    {
+        printf("Failure in rolling back the transaction : Results - %d %d, Found - %d\n", result, fullResult, isFound );
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void test_PairTransactionsSettle( void )
+{
+    printf("\nSettling the outstanding checks of a candidate pair. \n");
+    IceResult_t result;
+    IceAgent_t * settleAgent = malloc( sizeof( struct IceAgent ) );
+    IceCandidate_t * localCandidate = NULL, * remoteCandidate = NULL;
+    IceCandidatePair_t * pIceCandidatePair = NULL;
+    IceIPAddress_t localAddress = { .ipAddress = { .family = STUN_ADDRESS_IPv4, .port = 5000, .address = { 10, 0, 0, 1 } }, .isPointToPoint = 0 };
+    IceIPAddress_t remoteAddress = { .ipAddress = { .family = STUN_ADDRESS_IPv4, .port = 5000, .address = { 10, 0, 0, 2 } }, .isPointToPoint = 0 };
+    TransactionIdStore_t * pTransactionIdStore;
+    IceTimerWheel_t timerWheel;
+    IceOutboundPacket_t packets[ 4 ];
+    uint8_t packetArena[ 4 * ICE_STUN_MESSAGE_BUFFER_SIZE ];
+    uint8_t responseBuffer[ ICE_OUTBOUND_BUFFER_SIZE ];
+    uint8_t checkTransactionId[ STUN_HEADER_TRANSACTION_ID_LENGTH ] = { 0 };
+    uint8_t triggeredTransactionId[ STUN_HEADER_TRANSACTION_ID_LENGTH ] = { 0xE1, 0xE2, 0xE3 };
+    uint8_t lateTransactionId[ STUN_HEADER_TRANSACTION_ID_LENGTH ] = { 0xF1, 0xF2, 0xF3 };
+    char str1[] = "settle", str2[] = "fgh345", str3[] = "peer", str4[] = "uvw321";
+    size_t agentMemorySize = 0;
+    uint32_t packetCount = 0, outstandingCount = 0, i;
+    uint64_t currentTime;
+    bool triggeredCancelled = false;
+
+    result = Ice_GetIceAgentMemorySize( &agentConfig, &agentMemorySize );
+
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_CreateIceAgent( settleAgent, &agentConfig, malloc( agentMemorySize ), agentMemorySize, str1, str2, str3, str4 );
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_AddHostCandidate( localAddress, settleAgent, &localCandidate );
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_AddRemoteCandidate( settleAgent, ICE_CANDIDATE_TYPE_HOST, &remoteCandidate, remoteAddress, ICE_SOCKET_PROTOCOL_UDP, 2130706431 );
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        pTransactionIdStore = &( settleAgent->stunBindingRequestTransactionIdStore );
+        pIceCandidatePair = Ice_FindCandidatePair( settleAgent, localCandidate, &remoteAddress );
+        Ice_TimerWheelInit( &timerWheel, settleAgent->currentTime );
+        result = Ice_SetTimerWheel( settleAgent, &timerWheel );
+    }
+
+    /* An ordinary check of the pair, and a triggered check of the same pair still outstanding. */
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_CreateConnectivityChecks( settleAgent, packetArena, sizeof( packetArena ), packets, 4, &packetCount );
+    }
+
+    if( ( result == ICE_RESULT_OK ) && ( packetCount == 1 ) )
+    {
+        memcpy( checkTransactionId, packetArena + packets[ 0 ].offset + STUN_HEADER_TRANSACTION_ID_OFFSET, STUN_HEADER_TRANSACTION_ID_LENGTH );
+        result = Ice_TransactionIdStoreInsert( pTransactionIdStore, triggeredTransactionId, ICE_TRANSACTION_PURPOSE_CONNECTIVITY_CHECK,
+                                               pIceCandidatePair, localCandidate, settleAgent->currentTime );
+    }
+
+    /* The answer to the ordinary check completes the triggered one too. */
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_CreateResponseForRequest( settleAgent, responseBuffer, &localAddress, checkTransactionId );
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        ( void ) Ice_HandleStunResponse( settleAgent, responseBuffer, Ice_GetStunMessageLength( responseBuffer ), checkTransactionId,
+                                         localCandidate, remoteAddress, pIceCandidatePair );
+        triggeredCancelled = !Ice_TransactionIdStoreHasId( pTransactionIdStore, triggeredTransactionId );
+    }
+
+    /* A check left unanswered on a pair another check already validated does not fail the pair. */
+    if( result == ICE_RESULT_OK )
+    {
+        pIceCandidatePair->state = ICE_CANDIDATE_PAIR_STATE_VALID;
+        result = Ice_TransactionIdStoreInsert( pTransactionIdStore, lateTransactionId, ICE_TRANSACTION_PURPOSE_CONNECTIVITY_CHECK,
+                                               pIceCandidatePair, localCandidate, settleAgent->currentTime );
+    }
+
+    currentTime = settleAgent->currentTime;
+
+    for( i = 0; ( result == ICE_RESULT_OK ) && ( i < 16 ) && ( pTransactionIdStore->transactionIdCount > 0 ); i++ )
+    {
+        currentTime += ( uint64_t ) pTransactionIdStore->initialRto * ICE_FINAL_RESPONSE_WAIT_MULTIPLIER;
+        result = Ice_HandleExpiredTimers( &timerWheel, currentTime, packetArena, sizeof( packetArena ), packets, 4, &packetCount );
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        outstandingCount = pTransactionIdStore->transactionIdCount;
+    }
+
+    if( ( result == ICE_RESULT_OK ) &&
+        triggeredCancelled &&
+        ( outstandingCount == 0 ) &&
+        ( settleAgent->stats.transactionTimeouts == 1 ) &&
+        ( pIceCandidatePair->state == ICE_CANDIDATE_PAIR_STATE_VALID ) )
+    {
+        printf("Success, the answered pair cancelled its triggered check and outlived its unanswered one.\n");
+    }
+    else
+    {
+        printf("Failure in settling the pair's checks : Result - %d, Triggered cancelled - %d, Outstanding - %u, Pair state - %d\n",
+               result, triggeredCancelled, outstandingCount, ( pIceCandidatePair != NULL ) ? ( int ) pIceCandidatePair->state : -1 );
+    }
+
+    Ice_SetTimerWheel( settleAgent, NULL );
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void test_LegacyCheckPriority( IceAgent_t * iceAgent )
+{
+    printf("\nPRIORITY of a connectivity check created without a pair. \n");
+    IceResult_t result;
+    StunContext_t pStunCxt;
+    StunHeader_t pStunHeader;
+    IceStunAttributeTable_t attributeTable;
+    IceCandidate_t peerReflexiveCandidate = iceAgent->localCandidates[ 0 ];
+    uint8_t stunMessageBuffer[ ICE_OUTBOUND_BUFFER_SIZE ];
+    uint8_t transactionId[ STUN_HEADER_TRANSACTION_ID_LENGTH ];
+    uint32_t priority = 0, expectedPriority;
+
+    peerReflexiveCandidate.iceCandidateType = ICE_CANDIDATE_TYPE_PEER_REFLEXIVE;
+    expectedPriority = Ice_ComputeCandidatePriority( &peerReflexiveCandidate );
+
+    result = Ice_CreateRequestForConnectivityCheck( iceAgent, stunMessageBuffer, transactionId );
+
+    if( result == ICE_RESULT_OK )
+    {
+        result = ( IceResult_t ) StunDeserializer_Init( &pStunCxt, stunMessageBuffer, Ice_GetStunMessageLength( stunMessageBuffer ), &pStunHeader );
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_DeserializeStunPacket( &pStunCxt, &pStunHeader, &attributeTable );
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        priority = Ice_GetStunAttributeUint32( &attributeTable, ICE_STUN_ATTRIBUTE_INDEX_PRIORITY );
+    }
+
+    Ice_TransactionIdStoreRemove( &( iceAgent->stunBindingRequestTransactionIdStore ), transactionId );
+
+    if( ( result == ICE_RESULT_OK ) && ( priority == expectedPriority ) )
+    {
+        printf("Success, the check carries the peer reflexive PRIORITY %u of the first local candidate.\n", priority );
+    }
+    else
+    {
+        printf("Failure in the PRIORITY of the connectivity check : Result - %d, PRIORITY %u instead of %u\n", result, priority, expectedPriority );
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+void test_GatheringTime( void )
+{
+    printf("\nTiming the gathering of a server reflexive candidate. \n");
+    IceResult_t result;
+    IceAgent_t * gatherAgent = malloc( sizeof( struct IceAgent ) );
+    IceAgentStats_t snapshot, total;
+    IceCandidate_t * hostCandidate = NULL, * srflxCandidate = NULL;
+    IceIPAddress_t hostAddress = { .ipAddress = { .family = STUN_ADDRESS_IPv4, .port = 5000, .address = { 10, 0, 0, 1 } }, .isPointToPoint = 0 };
+    IceIPAddress_t serverAddress = { .ipAddress = { .family = STUN_ADDRESS_IPv4, .port = 3478, .address = { 198, 51, 100, 1 } }, .isPointToPoint = 0 };
+    StunAttributeAddress_t mappedAddress = { .family = STUN_ADDRESS_IPv4, .port = 40000, .address = { 203, 0, 113, 5 } };
+    StunContext_t pStunCxt;
+    StunHeader_t pStunHeader;
+    uint8_t requestBuffer[ ICE_OUTBOUND_BUFFER_SIZE ], responseBuffer[ 128 ];
+    uint8_t transactionId[ STUN_HEADER_TRANSACTION_ID_LENGTH ];
+    char str1[] = "gather", str2[] = "ijk678", str3[] = "peer", str4[] = "uvw321";
+    size_t agentMemorySize = 0;
+
+    memset( &snapshot, 0, sizeof( snapshot ) );
+    memset( &total, 0, sizeof( total ) );
+
+    result = Ice_GetIceAgentMemorySize( &agentConfig, &agentMemorySize );
+
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_CreateIceAgent( gatherAgent, &agentConfig, malloc( agentMemorySize ), agentMemorySize, str1, str2, str3, str4 );
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_AddHostCandidate( hostAddress, gatherAgent, &hostCandidate );
+    }
+
+    /* The request to the STUN server leaves at 2000 ms, its answer arrives 30 ms later. */
+    if( result == ICE_RESULT_OK )
+    {
+        Ice_UpdateCurrentTime( gatherAgent, 2000 );
+        result = Ice_AddSrflxCandidate( hostAddress, gatherAgent, &srflxCandidate, requestBuffer, transactionId );
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        Ice_UpdateCurrentTime( gatherAgent, 2030 );
+        Ice_InitializeStunPacket( &pStunCxt, transactionId, responseBuffer, sizeof( responseBuffer ), &pStunHeader, 0, 0 );
+        StunSerializer_AddAttributeXorMappedAddress( &pStunCxt, &mappedAddress );
+        Ice_PackageStunPacket( &pStunCxt, NULL );
+        result = Ice_HandleStunResponse( gatherAgent, responseBuffer, Ice_GetStunMessageLength( responseBuffer ), transactionId, hostCandidate, serverAddress, NULL );
+    }
+
+    if( result == ICE_RESULT_OK )
+    {
+        result = Ice_GetAgentStats( gatherAgent, &snapshot );
+        Ice_AccumulateAgentStats( &total, &snapshot );
+        Ice_AccumulateAgentStats( &total, &snapshot );
+    }
+
+    if( ( result == ICE_RESULT_OK ) &&
+        ( srflxCandidate->state == ICE_CANDIDATE_STATE_VALID ) &&
+        ( snapshot.gatheringTime.count == 1 ) && ( snapshot.gatheringTime.sum == 30 ) &&
+        ( total.gatheringTime.count == 2 ) )
+    {
+        printf("Success, the server reflexive candidate was gathered in %llu ms.\n", ( unsigned long long ) snapshot.gatheringTime.sum );
+    }
+    else
+    {
+        printf("Failure in timing the gathering : Result - %d, Samples - %llu, Time - %llu ms\n", result,
+               ( unsigned long long ) snapshot.gatheringTime.count, ( unsigned long long ) snapshot.gatheringTime.sum );
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------------------------------------------------------------*/
+
+int main( void )
+{
+    IceAgent_t * iceAgent = malloc(sizeof(struct IceAgent));
+
+    Ice_SetLogCallback( test_LogToStdout, NULL, ICE_LOG_LEVEL_DEBUG );
+
+    test_IceAgentInit( iceAgent );
+
+    test_GenerateHostCandidate( iceAgent );
+
+    test_GenerateSrflxCandidate( iceAgent );
+
+    test_GenerateRemoteCandidate( iceAgent );
+
+    test_DisplayCandidatePairs( iceAgent );
+
+    /* Test Stun Request creation for Nominating Candidate Pair. */
+    test_GenerateStunRequests( iceAgent, 0 );
+
+    /* Test Stun Request creation for Connectivity Check. */
+    test_GenerateStunRequests( iceAgent, 1 );
+
+    /* Test Stun Request creation for Response for Remote candidate requests. */
+    test_GenerateStunRequests( iceAgent, 2 );
+
+    /* Test batched Connectivity check generation. */
+    test_CreateConnectivityChecks( iceAgent );
+
+    /* Test Parsing Stun responses. */
+    test_HandleStunResponseFromIceServerForSrflxCandidate( iceAgent );
+
+    test_HandleStunRequestFromRemoteCandidate( iceAgent );
+
+    test_HandleStunResponseFromRemoteInResponseToLocalCandidateRequest( iceAgent );
+
+    test_HandleStunResponseForNominatingCandidatePair( iceAgent );
+
+    test_HandleStunResponseInResponseToNominatingCandidatePairRequest( iceAgent );
+
+    test_HandleReceivedStunPacketFromUnknownSource( iceAgent );
+
+    test_HandleStunPacketsBatch( iceAgent );
+
+    test_OutboundBufferPool( iceAgent );
+
+    test_ClassifyStunPacket( iceAgent );
+
+    test_RequestTemplateRoleChange( iceAgent );
+
+    test_TickPacing( iceAgent );
+
+    test_RetransmitUnansweredCheck( iceAgent );
+
+    test_AgentManagerDemux( iceAgent );
+
+    test_ConnectionTableLookup( iceAgent );
+
+    test_LiteAgentAnswersChecks( iceAgent );
+
+    test_LiteIgnoresUnsignedNomination( iceAgent );
+
+    test_AgentStats();
+
+    test_RttAwareNomination();
+
+    test_LogRingSink( iceAgent );
+
+    test_RandomGenerator();
+
+    test_RemoteCredentials( iceAgent );
+
+    test_ResetAgent();
+
+    test_ResponseEchoesTransactionId( iceAgent );
+
+    test_UnsignedResponses( iceAgent );
+
+    test_TriggeredCheckRetransmitted();
+
+    test_SrflxPairsNotQueued();
+
+    test_SharedIndexFullInsert( iceAgent );
+
+    test_PairTransactionsSettle();
+
+    test_LegacyCheckPriority( iceAgent );
+
+    test_GatheringTime();
 
     return 0;
 }